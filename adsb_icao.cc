@@ -27,8 +27,6 @@
 #include "adsb_icao.h"
 
 kis_adsb_icao::kis_adsb_icao() {
-    mutex.set_name("kis_adsb_icao");
-
     auto entrytracker = Globalreg::fetch_mandatory_global_as<entry_tracker>();
 
     icao_id = 
@@ -89,163 +87,101 @@ kis_adsb_icao::kis_adsb_icao() {
     auto expanded =
         Globalreg::globalreg->kismet_config->expand_log_path(fname, "", "", 0, 1);
 
-    if ((zmfile = gzopen(expanded.c_str(), "r")) == nullptr) {
-        _MSG_ERROR("Could not open ICAO database {}, ADSB ICAO lookup will not be available.",
+    auto parser = [this, expanded](std::vector<kis_lookup_table::table_record>& records) -> bool {
+        return parse_icao_file(expanded, records);
+    };
+
+    if (!icao_table.load(expanded, 5, parser)) {
+        _MSG_ERROR("Could not load ICAO database {}, ADSB ICAO lookup will not be available.",
                 expanded);
         return;
     }
 
-    index();
+    icao_records.resize(icao_table.size());
+
+    _MSG_INFO("Loaded {} ADSB ICAO records from {}", icao_table.size(), expanded);
 }
 
-void kis_adsb_icao::index() {
+bool kis_adsb_icao::parse_icao_file(const std::string& fname,
+        std::vector<kis_lookup_table::table_record>& records) {
     char buf[2048];
     int line = 0;
-    z_off_t prev_pos;
-    uint32_t last_icao = 0;
 
-    kis_lock_guard<kis_mutex> lk(mutex, "adsb icao index");
+    auto zmfile = gzopen(fname.c_str(), "r");
 
     if (zmfile == nullptr)
-        return;
+        return false;
 
     _MSG_INFO("Indexing ADSB ICAO db");
 
-    prev_pos = gzseek(zmfile, 0, SEEK_CUR);
-
     while (!gzeof(zmfile)) {
-        if (gzgets(zmfile, buf, 2048) == NULL || gzeof(zmfile))
+        if (gzgets(zmfile, buf, 2048) == NULL)
             break;
 
-        if (buf[0] == '#') {
-            line--;
-            continue;
-        }
+        line++;
 
-        if ((line % 50) == 0) {
-            auto fields = quote_str_tokenize(buf, "\t");
+        if (buf[0] == '#')
+            continue;
 
-            if (fields.size() != 6) {
-                _MSG_ERROR("Invalid ICAO entry: '{}'", buf);
-                gzclose(zmfile);
-                zmfile = nullptr;
-                return;
-            }
+        auto fields = quote_str_tokenize(buf, "\t");
 
-            index_pos ip;
-            
-            auto icao = string_to_n<uint32_t>(fields[0], std::hex);
+        if (fields.size() != 6 || fields[5].length() == 0) {
+            _MSG_ERROR("Invalid ICAO entry: '{}'", buf);
+            gzclose(zmfile);
+            return false;
+        }
 
-            if (icao < last_icao) {
-                _MSG_ERROR("ADSB ICAO file appears to be out of order, expected sorted "
-                        "ICAO records.");
-                gzclose(zmfile);
-                zmfile = nullptr;
-                return;
-            }
+        kis_lookup_table::table_record r;
+        r.key = string_to_n<uint32_t>(fields[0], std::hex);
 
-            ip.icao = icao;
-            ip.pos = prev_pos;
+        for (unsigned int f = 1; f < 5; f++)
+            r.fields.push_back(fields[f]);
 
-            index_vec.push_back(ip);
-        }
+        r.fields.push_back(std::string(1, fields[5][0]));
 
-        prev_pos = gzseek(zmfile, 0, SEEK_CUR);
-        line++;
+        records.push_back(r);
     }
 
-    _MSG_INFO("Completed indexing ADSB ICAO db, {} lines {} indexes",
-            line, index_vec.size());
+    gzclose(zmfile);
+
+    _MSG_INFO("Completed indexing ADSB ICAO db, {} lines {} records",
+            line, records.size());
+
+    return true;
 }
 
 std::shared_ptr<tracked_adsb_icao> kis_adsb_icao::lookup_icao(uint32_t icao) {
-    int matched = -1;
-    char buf[2048];
+    auto r = icao_table.find(icao);
 
-    if (zmfile == nullptr) {
+    if (r < 0)
         return unknown_icao;
-    }
 
-    {
-        kis_lock_guard<kis_mutex> lk(mutex, "adsb icao lookup");
+    auto icao_rec = std::atomic_load(&icao_records[r]);
 
-        auto cached = icao_map.find(icao);
-        if (cached != icao_map.end())
-            return cached->second;
+    if (icao_rec != nullptr)
+        return icao_rec;
 
-        for (unsigned int x = 0; x < index_vec.size(); x++) {
-            if (icao > index_vec[x].icao) {
-                matched = x;
-                continue;
-            }
-
-            break;
-        }
+    auto new_rec = std::make_shared<tracked_adsb_icao>(icao_id);
+    new_rec->set_icao(icao);
+    new_rec->set_regid(munge_to_printable(icao_table.field(r, 0)));
+    new_rec->set_model_type(munge_to_printable(icao_table.field(r, 1)));
+    new_rec->set_model(munge_to_printable(icao_table.field(r, 2)));
+    new_rec->set_owner(munge_to_printable(icao_table.field(r, 3)));
 
-        if (matched < 0) {
-            icao_map[icao] = unknown_icao;
-            return unknown_icao;
-        }
+    auto atype_short = icao_table.field(r, 4)[0];
+    auto atype_l = atype_map.find(atype_short);
 
-        if (matched > 0)
-            matched -= 1;
-
-        gzseek(zmfile, index_vec[matched].pos, SEEK_SET);
-    
-        while (!gzeof(zmfile)) {
-            if (gzgets(zmfile, buf, 2048) == NULL || gzeof(zmfile))
-                break;
-
-            if (buf[0] == '#') {
-                continue;
-            }
-
-            auto fields = quote_str_tokenize(buf, "\t");
-
-            if (fields.size() != 6) {
-                _MSG_ERROR("Invalid ICAO entry: '{}'", buf);
-                icao_map[icao] = unknown_icao;
-                return unknown_icao;
-            }
-
-            auto f_icao = string_to_n<uint32_t>(fields[0], std::hex);
-
-            if (f_icao == icao) {
-                if (fields[5].length() == 0) {
-                    _MSG_ERROR("Invalid ICAO entry: '{}'", buf);
-                    icao_map[icao] = unknown_icao;
-                    return unknown_icao;
-                }
-
-                auto icao_rec = 
-                    std::make_shared<tracked_adsb_icao>(icao_id);
-                icao_rec->set_icao(icao);
-                icao_rec->set_regid(munge_to_printable(fields[1]));
-                icao_rec->set_model_type(munge_to_printable(fields[2]));
-                icao_rec->set_model(munge_to_printable(fields[3]));
-                icao_rec->set_owner(munge_to_printable(fields[4]));
-
-                auto atype_l = atype_map.find(fields[5][0]);
-
-                if (atype_l == atype_map.end()) {
-                    icao_rec->set_atype(atype_map['U']);
-                    icao_rec->set_atype_short('U');
-                } else {
-                    icao_rec->set_atype(atype_l->second);
-                    icao_rec->set_atype_short(fields[5][0]);
-                }
-
-                icao_map[icao] = icao_rec;
-                return icao_rec;
-            } else if (f_icao > icao) {
-                icao_map[icao] = unknown_icao;
-                return unknown_icao;
-            }
-        }
+    if (atype_l == atype_map.end()) {
+        new_rec->set_atype(atype_map['U']);
+        new_rec->set_atype_short('U');
+    } else {
+        new_rec->set_atype(atype_l->second);
+        new_rec->set_atype_short(atype_short);
     }
 
-    return unknown_icao;
-}
-
-
+    // If another thread got here first, use theirs
+    if (std::atomic_compare_exchange_strong(&icao_records[r], &icao_rec, new_rec))
+        return new_rec;
 
+    return icao_rec;
+}
@@ -38,6 +38,7 @@
 
 #include "util.h"
 #include "globalregistry.h"
+#include "kis_lookup_table.h"
 
 #include "robin_hood.h"
 #include "trackedelement.h"
@@ -109,8 +110,6 @@ class kis_adsb_icao {
 public:
     kis_adsb_icao();
 
-    void index();
-
     std::shared_ptr<tracked_adsb_icao> get_unknown_icao() const {
         return unknown_icao;
     }
@@ -120,28 +119,25 @@ public:
         return lookup_icao(string_to_n<uint32_t>(icao, std::hex));
     }
 
-    struct index_pos {
-        uint32_t icao;
-        z_off_t pos;
-    };
-
     struct icao_data {
         uint32_t icao;
         std::shared_ptr<tracked_adsb_icao> icao_record;
     };
 
 protected:
-    kis_mutex mutex;
-    std::map<char, std::shared_ptr<tracker_element_string>> atype_map;
+    // Parse the text ICAO file into table records of regid, type, model, owner, and atype
+    bool parse_icao_file(const std::string& fname, std::vector<kis_lookup_table::table_record>& records);
 
-    gzFile zmfile;
+    std::map<char, std::shared_ptr<tracker_element_string>> atype_map;
 
     int icao_id;
     int icao_type_id;
     std::shared_ptr<tracked_adsb_icao> unknown_icao;
 
-    std::vector<index_pos> index_vec;
-    robin_hood::unordered_node_map<uint32_t, std::shared_ptr<tracked_adsb_icao>> icao_map;
+    // Compiled ICAO table and the records built from it, created on first lookup and
+    // accessed atomically so that lookups are lock-free
+    kis_lookup_table icao_table;
+    std::vector<std::shared_ptr<tracked_adsb_icao>> icao_records;
 };
 
 
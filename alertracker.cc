@@ -132,12 +132,14 @@ alert_tracker::alert_tracker() : lifetime_global() {
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) -> std::shared_ptr<tracker_element> {
                 return last_alerts_endpoint(con, false);
             }));
+    httpd->enable_route_cache("/alerts/last-time/:timestamp/alerts");
 
     httpd->register_route("/alerts/wrapped/last-time/:timestamp/alerts", {"GET", "POST"}, httpd->RO_ROLE,
             {}, std::make_shared<kis_net_web_tracked_endpoint>(
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) -> std::shared_ptr<tracker_element> {
                 return last_alerts_endpoint(con, true);
             }));
+    httpd->enable_route_cache("/alerts/wrapped/last-time/:timestamp/alerts");
 
 #ifdef PRELUDE
     prelude_alerts = Globalreg::globalreg->kismet_config->fetch_opt_bool("prelude_alerts", true);
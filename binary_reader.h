@@ -0,0 +1,363 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __BINARY_READER_H__
+#define __BINARY_READER_H__
+
+#include <stdexcept>
+#include <string>
+#include <string.h>
+#include <unordered_map>
+
+#include "nlohmann/json.hpp"
+
+// Decoder for the CBOR and MessagePack output of binary_writer, converting it back to
+// the same JSON the json serializer would have produced.
+//
+// Integer map keys are field ids, and are resolved with the field dictionary from
+// /system/tracked_fields or from the FIELDS snapshots in a kismetdb log.  This only
+// depends on the JSON library, so it can be used by the log tools as well as the server.
+class binary_reader {
+public:
+    enum class format {
+        json, cbor, msgpack, unknown
+    };
+
+    using field_dictionary = std::unordered_map<uint64_t, std::string>;
+
+    binary_reader() { }
+    binary_reader(const field_dictionary& fields) :
+        fields{fields} { }
+
+    // Merge a field dictionary, as served by /system/tracked_fields.json
+    void add_fields(const nlohmann::json& dict) {
+        auto names = dict.find("kismet.fields.names");
+
+        if (names == dict.end() || !names->is_object())
+            throw std::runtime_error("field dictionary missing kismet.fields.names");
+
+        for (const auto& i : names->items()) {
+            if (i.value().is_string())
+                fields[std::stoull(i.key())] = i.value().get<std::string>();
+        }
+    }
+
+    const field_dictionary& get_fields() const {
+        return fields;
+    }
+
+    // Identify a serialized object, such as a device record, by the first byte; the map
+    // headers of each format don't overlap.  Arrays are ambiguous between CBOR and
+    // MessagePack and need the format to be given.
+    static format detect(const std::string& data) {
+        if (data.length() == 0)
+            return format::unknown;
+
+        auto c = static_cast<uint8_t>(data[0]);
+
+        if (c == '{')
+            return format::json;
+
+        // CBOR map major type
+        if (c >= 0xa0 && c <= 0xbb)
+            return format::cbor;
+
+        // MessagePack fixmap, map16, map32
+        if ((c >= 0x80 && c <= 0x8f) || c == 0xde || c == 0xdf)
+            return format::msgpack;
+
+        return format::unknown;
+    }
+
+    nlohmann::json decode(const std::string& data) {
+        return decode(data, detect(data));
+    }
+
+    nlohmann::json decode(const std::string& data, format f) {
+        if (f == format::json)
+            return nlohmann::json::parse(data);
+
+        if (f == format::unknown)
+            throw std::runtime_error("unknown record format");
+
+        pos = reinterpret_cast<const uint8_t *>(data.data());
+        end = pos + data.length();
+
+        auto ret = f == format::cbor ? read_cbor(0) : read_msgpack(0);
+
+        if (pos != end)
+            throw std::runtime_error("trailing data after record");
+
+        return ret;
+    }
+
+    // Apply a device delta from the device_deltas table of a kismetdb log to the decoded
+    // device record.  Deltas replace whole top-level fields (kismet.device.delta.set),
+    // replace fields inside a nested map (kismet.device.delta.merge), and remove fields
+    // by name, or by 'name/nested name' (kismet.device.delta.remove).
+    static void apply_device_delta(nlohmann::json& device, const nlohmann::json& delta) {
+        auto set = delta.find("kismet.device.delta.set");
+        if (set != delta.end()) {
+            for (const auto& i : set->items())
+                device[i.key()] = i.value();
+        }
+
+        auto merge = delta.find("kismet.device.delta.merge");
+        if (merge != delta.end()) {
+            for (const auto& i : merge->items()) {
+                auto& nested = device[i.key()];
+
+                if (!nested.is_object())
+                    nested = nlohmann::json::object();
+
+                for (const auto& ni : i.value().items())
+                    nested[ni.key()] = ni.value();
+            }
+        }
+
+        auto remove = delta.find("kismet.device.delta.remove");
+        if (remove != delta.end()) {
+            for (const auto& i : *remove) {
+                auto path = i.get<std::string>();
+                auto slash = path.find('/');
+
+                if (slash == std::string::npos) {
+                    device.erase(path);
+                    continue;
+                }
+
+                auto nested = device.find(path.substr(0, slash));
+
+                if (nested != device.end() && nested->is_object())
+                    nested->erase(path.substr(slash + 1));
+            }
+        }
+    }
+
+protected:
+    field_dictionary fields;
+
+    const uint8_t *pos = nullptr;
+    const uint8_t *end = nullptr;
+
+    static const unsigned int max_depth = 512;
+
+    uint64_t read_be(unsigned int n) {
+        if ((size_t) (end - pos) < n)
+            throw std::runtime_error("truncated record");
+
+        uint64_t v = 0;
+        for (unsigned int i = 0; i < n; i++)
+            v = (v << 8) | *pos++;
+
+        return v;
+    }
+
+    uint8_t read_byte() {
+        return static_cast<uint8_t>(read_be(1));
+    }
+
+    std::string read_bytes(uint64_t n) {
+        if ((uint64_t) (end - pos) < n)
+            throw std::runtime_error("truncated record");
+
+        std::string s(reinterpret_cast<const char *>(pos), n);
+        pos += n;
+
+        return s;
+    }
+
+    static double as_double(uint64_t bits) {
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        return d;
+    }
+
+    static float as_float(uint32_t bits) {
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    std::string field_name(const nlohmann::json& key) {
+        if (key.is_string())
+            return key.get<std::string>();
+
+        if (key.is_number_unsigned()) {
+            auto id = key.get<uint64_t>();
+            auto fi = fields.find(id);
+
+            if (fi != fields.end())
+                return fi->second;
+
+            return "field.unknown." + std::to_string(id);
+        }
+
+        throw std::runtime_error("unexpected map key type");
+    }
+
+    nlohmann::json read_cbor(unsigned int depth) {
+        if (depth > max_depth)
+            throw std::runtime_error("record nested too deeply");
+
+        auto ib = read_byte();
+        auto major = ib >> 5;
+        auto info = ib & 0x1f;
+
+        // Simple values and floats
+        if (major == 7) {
+            switch (info) {
+                case 20:
+                    return false;
+                case 21:
+                    return true;
+                case 22:
+                case 23:
+                    return nullptr;
+                case 26:
+                    return as_float(read_be(4));
+                case 27:
+                    return as_double(read_be(8));
+                default:
+                    throw std::runtime_error("unsupported CBOR simple value");
+            }
+        }
+
+        uint64_t arg;
+
+        if (info < 24)
+            arg = info;
+        else if (info <= 27)
+            arg = read_be(1 << (info - 24));
+        else
+            throw std::runtime_error("unsupported CBOR length");
+
+        switch (major) {
+            case 0:
+                return arg;
+            case 1:
+                return -1 - static_cast<int64_t>(arg);
+            case 2:
+            case 3:
+                return read_bytes(arg);
+            case 4: {
+                auto ret = nlohmann::json::array();
+                for (uint64_t i = 0; i < arg; i++)
+                    ret.push_back(read_cbor(depth + 1));
+                return ret;
+            }
+            case 5: {
+                auto ret = nlohmann::json::object();
+                for (uint64_t i = 0; i < arg; i++) {
+                    auto k = field_name(read_cbor(depth + 1));
+                    ret[k] = read_cbor(depth + 1);
+                }
+                return ret;
+            }
+            case 6:
+                // Tags carry no meaning for us
+                return read_cbor(depth + 1);
+        }
+
+        throw std::runtime_error("unsupported CBOR type");
+    }
+
+    nlohmann::json read_msgpack_array(uint64_t n, unsigned int depth) {
+        auto ret = nlohmann::json::array();
+        for (uint64_t i = 0; i < n; i++)
+            ret.push_back(read_msgpack(depth + 1));
+        return ret;
+    }
+
+    nlohmann::json read_msgpack_map(uint64_t n, unsigned int depth) {
+        auto ret = nlohmann::json::object();
+        for (uint64_t i = 0; i < n; i++) {
+            auto k = field_name(read_msgpack(depth + 1));
+            ret[k] = read_msgpack(depth + 1);
+        }
+        return ret;
+    }
+
+    nlohmann::json read_msgpack(unsigned int depth) {
+        if (depth > max_depth)
+            throw std::runtime_error("record nested too deeply");
+
+        auto b = read_byte();
+
+        if (b <= 0x7f)
+            return static_cast<uint64_t>(b);
+        if (b >= 0xe0)
+            return static_cast<int64_t>(static_cast<int8_t>(b));
+        if (b >= 0x80 && b <= 0x8f)
+            return read_msgpack_map(b & 0x0f, depth);
+        if (b >= 0x90 && b <= 0x9f)
+            return read_msgpack_array(b & 0x0f, depth);
+        if (b >= 0xa0 && b <= 0xbf)
+            return read_bytes(b & 0x1f);
+
+        switch (b) {
+            case 0xc0:
+                return nullptr;
+            case 0xc2:
+                return false;
+            case 0xc3:
+                return true;
+            case 0xc4:
+            case 0xd9:
+                return read_bytes(read_be(1));
+            case 0xc5:
+            case 0xda:
+                return read_bytes(read_be(2));
+            case 0xc6:
+            case 0xdb:
+                return read_bytes(read_be(4));
+            case 0xca:
+                return as_float(read_be(4));
+            case 0xcb:
+                return as_double(read_be(8));
+            case 0xcc:
+                return read_be(1);
+            case 0xcd:
+                return read_be(2);
+            case 0xce:
+                return read_be(4);
+            case 0xcf:
+                return read_be(8);
+            case 0xd0:
+                return static_cast<int64_t>(static_cast<int8_t>(read_be(1)));
+            case 0xd1:
+                return static_cast<int64_t>(static_cast<int16_t>(read_be(2)));
+            case 0xd2:
+                return static_cast<int64_t>(static_cast<int32_t>(read_be(4)));
+            case 0xd3:
+                return static_cast<int64_t>(read_be(8));
+            case 0xdc:
+                return read_msgpack_array(read_be(2), depth);
+            case 0xdd:
+                return read_msgpack_array(read_be(4), depth);
+            case 0xde:
+                return read_msgpack_map(read_be(2), depth);
+            case 0xdf:
+                return read_msgpack_map(read_be(4), depth);
+        }
+
+        throw std::runtime_error("unsupported MessagePack type");
+    }
+};
+
+#endif
@@ -0,0 +1,485 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <math.h>
+
+#include "binary_writer.h"
+#include "entrytracker.h"
+
+// Hand the buffer to the stream once it gets this large
+static const size_t binary_writer_flush_sz = 16384;
+
+// CBOR major types
+static const uint8_t cbor_uint = 0;
+static const uint8_t cbor_negint = 1;
+static const uint8_t cbor_text = 3;
+static const uint8_t cbor_array = 4;
+static const uint8_t cbor_map = 5;
+
+binary_writer::binary_writer(std::ostream& stream,
+        std::shared_ptr<tracker_element_serializer::rename_map> name_map,
+        format out_format) :
+    stream{stream},
+    name_map{name_map},
+    out_format{out_format} {
+    buf.reserve(binary_writer_flush_sz * 2);
+}
+
+binary_writer::~binary_writer() {
+    flush();
+}
+
+void binary_writer::flush() {
+    if (buf.size() == 0)
+        return;
+
+    stream.write(buf.data(), buf.size());
+    buf.resize(0);
+}
+
+void binary_writer::put_be(uint64_t v, unsigned int n) {
+    for (unsigned int i = n; i > 0; i--)
+        put(static_cast<uint8_t>(v >> ((i - 1) * 8)));
+}
+
+void binary_writer::cbor_header(uint8_t major, uint64_t v) {
+    // Initial byte and argument, in the shortest form
+    major <<= 5;
+
+    if (v < 24) {
+        put(major | v);
+    } else if (v <= 0xFF) {
+        put(major | 24);
+        put_be(v, 1);
+    } else if (v <= 0xFFFF) {
+        put(major | 25);
+        put_be(v, 2);
+    } else if (v <= 0xFFFFFFFFUL) {
+        put(major | 26);
+        put_be(v, 4);
+    } else {
+        put(major | 27);
+        put_be(v, 8);
+    }
+}
+
+void binary_writer::pack_uint(uint64_t v) {
+    if (out_format == format::cbor) {
+        cbor_header(cbor_uint, v);
+        return;
+    }
+
+    if (v < 0x80) {
+        put(v);
+    } else if (v <= 0xFF) {
+        put(0xcc);
+        put_be(v, 1);
+    } else if (v <= 0xFFFF) {
+        put(0xcd);
+        put_be(v, 2);
+    } else if (v <= 0xFFFFFFFFUL) {
+        put(0xce);
+        put_be(v, 4);
+    } else {
+        put(0xcf);
+        put_be(v, 8);
+    }
+}
+
+void binary_writer::pack_int(int64_t v) {
+    if (v >= 0) {
+        pack_uint(v);
+        return;
+    }
+
+    if (out_format == format::cbor) {
+        // -1 - n, without overflowing on INT64_MIN
+        cbor_header(cbor_negint, static_cast<uint64_t>(-(v + 1)));
+        return;
+    }
+
+    if (v >= -32) {
+        put(static_cast<uint8_t>(v));
+    } else if (v >= std::numeric_limits<int8_t>::min()) {
+        put(0xd0);
+        put_be(static_cast<uint64_t>(v), 1);
+    } else if (v >= std::numeric_limits<int16_t>::min()) {
+        put(0xd1);
+        put_be(static_cast<uint64_t>(v), 2);
+    } else if (v >= std::numeric_limits<int32_t>::min()) {
+        put(0xd2);
+        put_be(static_cast<uint64_t>(v), 4);
+    } else {
+        put(0xd3);
+        put_be(static_cast<uint64_t>(v), 8);
+    }
+}
+
+void binary_writer::pack_double(double d) {
+    // Same as the JSON output; invalid numbers are 0, and whole numbers are integers,
+    // which are also more compact
+    if (std::isnan(d) || std::isinf(d)) {
+        pack_uint(0);
+        return;
+    }
+
+    if (floor(d) == d && d >= -9.2e18 && d <= 9.2e18) {
+        pack_int(static_cast<int64_t>(d));
+        return;
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+
+    put(out_format == format::cbor ? 0xfb : 0xcb);
+    put_be(bits, 8);
+}
+
+void binary_writer::pack_string(const char *s, size_t len) {
+    if (out_format == format::cbor) {
+        cbor_header(cbor_text, len);
+    } else if (len < 32) {
+        put(0xa0 | len);
+    } else if (len <= 0xFF) {
+        put(0xd9);
+        put_be(len, 1);
+    } else if (len <= 0xFFFF) {
+        put(0xda);
+        put_be(len, 2);
+    } else {
+        put(0xdb);
+        put_be(len, 4);
+    }
+
+    put(s, len);
+}
+
+void binary_writer::pack_null() {
+    put(out_format == format::cbor ? 0xf6 : 0xc0);
+}
+
+void binary_writer::pack_array_header(size_t n) {
+    if (out_format == format::cbor) {
+        cbor_header(cbor_array, n);
+    } else if (n < 16) {
+        put(0x90 | n);
+    } else if (n <= 0xFFFF) {
+        put(0xdc);
+        put_be(n, 2);
+    } else {
+        put(0xdd);
+        put_be(n, 4);
+    }
+}
+
+void binary_writer::pack_map_header(size_t n) {
+    if (out_format == format::cbor) {
+        cbor_header(cbor_map, n);
+    } else if (n < 16) {
+        put(0x80 | n);
+    } else if (n <= 0xFFFF) {
+        put(0xde);
+        put_be(n, 2);
+    } else {
+        put(0xdf);
+        put_be(n, 4);
+    }
+}
+
+void binary_writer::pack_field_key(const shared_tracker_element& e, int id) {
+    if (name_map != nullptr) {
+        auto nmi = name_map->find(e);
+
+        if (nmi != name_map->end() && nmi->second->rename.length() != 0) {
+            pack_string(nmi->second->rename);
+            return;
+        }
+    }
+
+    // Placeholders and aliases carry their own names
+    if (e->get_type() == tracker_type::tracker_placeholder_missing) {
+        auto tname = static_cast<tracker_element_placeholder *>(e.get())->get_name();
+
+        if (tname.length() != 0) {
+            pack_string(tname);
+            return;
+        }
+    } else if (e->get_type() == tracker_type::tracker_alias) {
+        auto tname = static_cast<tracker_element_alias *>(e.get())->get_alias_name();
+
+        if (tname.length() != 0) {
+            pack_string(tname);
+            return;
+        }
+    }
+
+    if (id < 0)
+        id = 0;
+
+    pack_uint(id);
+}
+
+template<typename M, typename KF>
+void binary_writer::pack_keyed_map(M *m, KF key_fn) {
+    auto as_vector = m->as_vector();
+    auto as_key_vector = m->as_key_vector();
+
+    size_t n = 0;
+    for (const auto& i : *m) {
+        if (i.second != nullptr || as_key_vector)
+            n++;
+    }
+
+    if (as_vector || as_key_vector)
+        pack_array_header(n);
+    else
+        pack_map_header(n);
+
+    for (const auto& i : *m) {
+        if (i.second == nullptr && !as_key_vector)
+            continue;
+
+        if (!as_vector)
+            pack_string(key_fn(i.first));
+
+        if (!as_key_vector)
+            pack(i.second);
+    }
+}
+
+static std::string double_key_string(double k) {
+    if (std::isnan(k) || std::isinf(k))
+        return "0";
+    else if (floor(k) == k)
+        return fmt::format("{:.0f}", k);
+
+    return fmt::format("{:f}", k);
+}
+
+void binary_writer::pack(shared_tracker_element e) {
+    if (e == nullptr) {
+        pack_null();
+        return;
+    }
+
+    serializer_scope s(e, name_map);
+
+    // If we're serializing an alias, remap as the aliased element
+    if (e->get_type() == tracker_type::tracker_alias) {
+        e = static_cast<tracker_element_alias *>(e.get())->get();
+
+        if (e == nullptr) {
+            pack_null();
+            return;
+        }
+    }
+
+    switch (e->get_type()) {
+        case tracker_type::tracker_string:
+            pack_string(static_cast<tracker_element_string *>(e.get())->get());
+            break;
+        case tracker_type::tracker_int8:
+            pack_int(static_cast<tracker_element_int8 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_uint8:
+            pack_uint(static_cast<tracker_element_uint8 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_int16:
+            pack_int(static_cast<tracker_element_int16 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_uint16:
+            pack_uint(static_cast<tracker_element_uint16 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_int32:
+            pack_int(static_cast<tracker_element_int32 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_uint32:
+            pack_uint(static_cast<tracker_element_uint32 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_int64:
+            pack_int(static_cast<tracker_element_int64 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_uint64:
+            pack_uint(static_cast<tracker_element_uint64 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_float:
+            pack_double(static_cast<tracker_element_float *>(e.get())->get());
+            break;
+        case tracker_type::tracker_double:
+            pack_double(static_cast<tracker_element_double *>(e.get())->get());
+            break;
+        case tracker_type::tracker_vector: {
+            auto v = static_cast<tracker_element_vector *>(e.get());
+
+            size_t n = 0;
+            for (const auto& i : *v) {
+                if (i != nullptr)
+                    n++;
+            }
+
+            pack_array_header(n);
+
+            for (const auto& i : *v) {
+                if (i != nullptr)
+                    pack(i);
+            }
+
+            break;
+        }
+        case tracker_type::tracker_vector_double: {
+            auto v = static_cast<tracker_element_vector_double *>(e.get());
+
+            pack_array_header(v->size());
+
+            for (auto i : *v)
+                pack_double(i);
+
+            break;
+        }
+        case tracker_type::tracker_vector_string: {
+            auto v = static_cast<tracker_element_vector_string *>(e.get());
+
+            pack_array_header(v->size());
+
+            for (const auto& i : *v)
+                pack_string(i);
+
+            break;
+        }
+        case tracker_type::tracker_map: {
+            auto m = static_cast<tracker_element_map *>(e.get());
+            auto as_vector = m->as_vector();
+            auto as_key_vector = m->as_key_vector();
+
+            size_t n = 0;
+            for (const auto& i : *m) {
+                if (i.second != nullptr)
+                    n++;
+            }
+
+            if (as_vector || as_key_vector)
+                pack_array_header(n);
+            else
+                pack_map_header(n);
+
+            for (const auto& i : *m) {
+                if (i.second == nullptr)
+                    continue;
+
+                if (!as_vector)
+                    pack_field_key(i.second, i.first);
+
+                if (!as_key_vector)
+                    pack(i.second);
+            }
+
+            break;
+        }
+        case tracker_type::tracker_int_map:
+            pack_keyed_map(static_cast<tracker_element_int_map *>(e.get()),
+                    [](int k) { return fmt::format("{}", k); });
+            break;
+        case tracker_type::tracker_mac_map:
+            pack_keyed_map(static_cast<tracker_element_mac_map *>(e.get()),
+                    [](const mac_addr& k) { return k.mac_to_string(); });
+            break;
+        case tracker_type::tracker_uuid_map:
+            pack_keyed_map(static_cast<tracker_element_uuid_map *>(e.get()),
+                    [](const uuid& k) { return k.uuid_to_string(); });
+            break;
+        case tracker_type::tracker_string_map:
+            pack_keyed_map(static_cast<tracker_element_string_map *>(e.get()),
+                    [](const std::string& k) { return k; });
+            break;
+        case tracker_type::tracker_double_map:
+            pack_keyed_map(static_cast<tracker_element_double_map *>(e.get()),
+                    [](double k) { return double_key_string(k); });
+            break;
+        case tracker_type::tracker_hashkey_map:
+            pack_keyed_map(static_cast<tracker_element_hashkey_map *>(e.get()),
+                    [](size_t k) { return fmt::format("{}", (long) k); });
+            break;
+        case tracker_type::tracker_double_map_double: {
+            auto m = static_cast<tracker_element_double_map_double *>(e.get());
+            auto as_vector = m->as_vector();
+            auto as_key_vector = m->as_key_vector();
+
+            if (as_vector || as_key_vector)
+                pack_array_header(m->size());
+            else
+                pack_map_header(m->size());
+
+            for (const auto& i : *m) {
+                if (!as_vector)
+                    pack_string(double_key_string(i.first));
+
+                if (!as_key_vector)
+                    pack_double(i.second);
+            }
+
+            break;
+        }
+        case tracker_type::tracker_key_map:
+            pack_keyed_map(static_cast<tracker_element_device_key_map *>(e.get()),
+                    [](const device_key& k) { return k.as_string(); });
+            break;
+        case tracker_type::tracker_pair_double: {
+            const auto& p = static_cast<tracker_element_pair_double *>(e.get())->get();
+            pack_array_header(2);
+            pack_double(std::get<0>(p));
+            pack_double(std::get<1>(p));
+            break;
+        }
+        case tracker_type::tracker_summary_mapvec: {
+            auto v = static_cast<tracker_element_mapvec *>(e.get());
+
+            size_t n = 0;
+            for (const auto& i : *v) {
+                if (i != nullptr)
+                    n++;
+            }
+
+            pack_map_header(n);
+
+            for (const auto& i : *v) {
+                if (i == nullptr)
+                    continue;
+
+                pack_field_key(i, i->get_id());
+                pack(i);
+            }
+
+            break;
+        }
+        default:
+            // Remaining scalar types (mac, uuid, key, byte arrays, ipv4, placeholders)
+            if (e->is_stringable())
+                pack_string(e->as_string());
+            else
+                pack_null();
+            break;
+    }
+
+    if (buf.size() >= binary_writer_flush_sz)
+        flush();
+}
@@ -0,0 +1,132 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __BINARY_WRITER_H__
+#define __BINARY_WRITER_H__
+
+#include "config.h"
+
+#include <string>
+
+#include "fmt.h"
+#include "globalregistry.h"
+#include "trackedelement.h"
+
+// Buffered CBOR (RFC 8949) or MessagePack writer for tracked elements.
+//
+// The structure matches the JSON output, with two differences: fields in a tracked map
+// are keyed by their numeric field id instead of their name, and numbers are written
+// in binary.  Every other map key - renamed fields, int/mac/uuid/string map keys - is
+// written as a string, the same as it appears in JSON, so an integer map key is always
+// a field id.  Field ids are resolved with the dictionary served at
+// /system/tracked_fields.[cbor|msgpack|json]; ids are never reused while the server is
+// running, but new fields may appear, so clients should refetch the dictionary when
+// they find an id they don't know.
+//
+// binary_reader.h decodes this back to JSON.
+class binary_writer {
+public:
+    enum class format {
+        cbor, msgpack
+    };
+
+    binary_writer(std::ostream& stream,
+            std::shared_ptr<tracker_element_serializer::rename_map> name_map,
+            format out_format);
+    ~binary_writer();
+
+    void pack(shared_tracker_element e);
+
+    // Hand everything buffered so far to the stream
+    void flush();
+
+protected:
+    void put(uint8_t c) {
+        buf.push_back(static_cast<char>(c));
+    }
+
+    void put(const char *s, size_t len) {
+        buf.append(s, s + len);
+    }
+
+    // Big-endian integer of n bytes
+    void put_be(uint64_t v, unsigned int n);
+
+    void cbor_header(uint8_t major, uint64_t v);
+
+    void pack_uint(uint64_t v);
+    void pack_int(int64_t v);
+    void pack_double(double d);
+    void pack_string(const char *s, size_t len);
+    void pack_null();
+
+    void pack_string(const std::string& s) {
+        pack_string(s.data(), s.length());
+    }
+
+    void pack_array_header(size_t n);
+    void pack_map_header(size_t n);
+
+    // Field id, or the name for renamed fields, placeholders, and aliases
+    void pack_field_key(const shared_tracker_element& e, int id);
+
+    template<typename M, typename KF>
+    void pack_keyed_map(M *m, KF key_fn);
+
+    std::ostream& stream;
+    std::shared_ptr<tracker_element_serializer::rename_map> name_map;
+    format out_format;
+
+    fmt::memory_buffer buf;
+};
+
+namespace cbor_adapter {
+
+class serializer : public tracker_element_serializer {
+public:
+    serializer() :
+        tracker_element_serializer() { }
+
+    virtual int serialize(shared_tracker_element in_elem, std::ostream &stream,
+            std::shared_ptr<rename_map> name_map = nullptr) override {
+        binary_writer w(stream, name_map, binary_writer::format::cbor);
+        w.pack(in_elem);
+        return 0;
+    }
+};
+
+}
+
+namespace msgpack_adapter {
+
+class serializer : public tracker_element_serializer {
+public:
+    serializer() :
+        tracker_element_serializer() { }
+
+    virtual int serialize(shared_tracker_element in_elem, std::ostream &stream,
+            std::shared_ptr<rename_map> name_map = nullptr) override {
+        binary_writer w(stream, name_map, binary_writer::format::msgpack);
+        w.pack(in_elem);
+        return 0;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,103 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __BLOOM_FILTER_H__
+#define __BLOOM_FILTER_H__
+
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Simple bloom filter over 64 bit hashes, for skipping lookups which almost always miss.
+// The bit positions are derived from the one hash by double hashing, so callers should
+// pass a well mixed hash (see bloom_filter::mix).
+//
+// Not thread safe; callers provide their own locking.
+class bloom_filter {
+public:
+    // Size for the expected number of entries, at no more than a 2-3% false positive rate
+    bloom_filter(size_t expected = 0) {
+        reset(expected);
+    }
+
+    void reset(size_t expected) {
+        size_t n_bits = 1024;
+
+        while (n_bits < expected * bits_per_entry)
+            n_bits <<= 1;
+
+        bits.assign(n_bits / 64, 0);
+        mask = n_bits - 1;
+        n_entries = 0;
+    }
+
+    void insert(uint64_t h) {
+        uint64_t h2 = (h >> 32) | 1;
+
+        for (unsigned int i = 0; i < n_hashes; i++) {
+            auto b = (h + i * h2) & mask;
+            bits[b / 64] |= (uint64_t) 1 << (b % 64);
+        }
+
+        n_entries++;
+    }
+
+    bool maybe_contains(uint64_t h) const {
+        uint64_t h2 = (h >> 32) | 1;
+
+        for (unsigned int i = 0; i < n_hashes; i++) {
+            auto b = (h + i * h2) & mask;
+
+            if ((bits[b / 64] & ((uint64_t) 1 << (b % 64))) == 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Past this the false positive rate climbs and the filter should be rebuilt larger
+    bool overfull() const {
+        return n_entries * bits_per_entry > bits.size() * 64;
+    }
+
+    size_t size() const {
+        return n_entries;
+    }
+
+    // Finalizer from splitmix64, to spread keys which are only partially random
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+
+protected:
+    static const size_t bits_per_entry = 8;
+    static const unsigned int n_hashes = 4;
+
+    std::vector<uint64_t> bits;
+    uint64_t mask;
+    size_t n_entries;
+};
+
+#endif
@@ -421,6 +421,12 @@ kis_capture_handler_t *cf_handler_init(const char *in_type) {
     ch->in_ringbuf = NULL;
     ch->out_ringbuf = NULL;
 
+    ch->batch_reports = 0;
+    ch->batch_buf = NULL;
+    ch->batch_buf_len = 0;
+    ch->batch_count = 0;
+    ch->batch_seqno = 0;
+
     pthread_mutexattr_init(&mutexattr);
     pthread_mutexattr_settype(&mutexattr, PTHREAD_MUTEX_RECURSIVE);
     pthread_mutex_init(&(ch->out_ringbuf_lock), &mutexattr);
@@ -510,6 +516,9 @@ void cf_handler_free(kis_capture_handler_t *caph) {
     if (caph->out_ringbuf != NULL)
         kis_simple_ringbuf_free(caph->out_ringbuf);
 
+    if (caph->batch_buf != NULL)
+        free(caph->batch_buf);
+
     for (szi = 0; szi < caph->channel_hop_list_sz; szi++) {
         if (caph->channel_hop_list[szi] != NULL)
             free(caph->channel_hop_list[szi]);
@@ -1630,6 +1639,21 @@ int cf_dispatch_rx_content(kis_capture_handler_t *caph, const char *command,
                 cbret = -1;
                 goto finish;
             }
+
+            /* Batch data reports if the server supports them; older servers never
+             * set this, and websocket mode always sends individual reports */
+            if (open_cmd->has_batch_reports && open_cmd->batch_reports &&
+                    (caph->use_tcp || caph->use_ipc)) {
+                pthread_mutex_lock(&(caph->out_ringbuf_lock));
+
+                if (caph->batch_buf == NULL)
+                    caph->batch_buf = (uint8_t *) malloc(CAP_FRAMEWORK_BATCH_MAX_SZ);
+
+                if (caph->batch_buf != NULL)
+                    caph->batch_reports = 1;
+
+                pthread_mutex_unlock(&(caph->out_ringbuf_lock));
+            }
             
             msgstr[0] = 0;
             cbret = (*(caph->open_cb))(caph,
@@ -2409,11 +2433,15 @@ int cf_handler_loop(kis_capture_handler_t *caph) {
             /* Inspect the write buffer - do we have data? */
             pthread_mutex_lock(&(caph->out_ringbuf_lock));
 
+            /* Push out any batched reports which have waited long enough, or everything
+             * if we're spinning down */
+            cf_flush_batch_expired_nl(caph, spindown);
+
             if (kis_simple_ringbuf_used(caph->out_ringbuf) != 0) {
                 FD_SET(write_fd, &wset);
                 if (max_fd < write_fd)
                     max_fd = write_fd;
-            } else if (spindown != 0) {
+            } else if (spindown != 0 && caph->batch_count == 0) {
                 pthread_mutex_unlock(&(caph->out_ringbuf_lock));
                 rv = 0;
                 break;
@@ -2421,8 +2449,12 @@ int cf_handler_loop(kis_capture_handler_t *caph) {
 
             pthread_mutex_unlock(&(caph->out_ringbuf_lock));
 
+            /* Wake up often enough to honor the batch latency */
             tm.tv_sec = 0;
-            tm.tv_usec = 500000;
+            if (caph->batch_reports)
+                tm.tv_usec = CAP_FRAMEWORK_BATCH_LATENCY_US;
+            else
+                tm.tv_usec = 500000;
 
             if ((ret = select(max_fd + 1, &rset, &wset, NULL, &tm)) < 0) {
                 if (errno != EINTR && errno != EAGAIN) {
@@ -3227,6 +3259,127 @@ int cf_send_openresp(kis_capture_handler_t *caph, uint32_t seq, unsigned int suc
     return cf_send_packet(caph, "KDSOPENSOURCEREPORT", buf, buf_len);
 }
 
+/* Worst-case overhead of a report in a batch:  the field tag and the varint length */
+#define CF_BATCH_ENTRY_OVERHEAD     11
+
+/* Flush any pending batched reports to the output ringbuffer as a single
+ * KDSDATAREPORTBATCH frame.  Must be called with the out_ringbuf_lock held.
+ *
+ * Returns:
+ * -1   An error occurred
+ *  0   Insufficient space in buffer
+ *  1   Success, or nothing to flush
+ */
+static int cf_flush_batch_nl(kis_capture_handler_t *caph) {
+    kismet_external_frame_v2_t *frame;
+    uint8_t *send_buffer;
+    size_t rs_sz;
+
+    if (caph->batch_count == 0)
+        return 1;
+
+    if (caph->out_ringbuf == NULL)
+        return -1;
+
+    rs_sz = kis_simple_ringbuf_reserve(caph->out_ringbuf, (void **) &send_buffer,
+            caph->batch_buf_len + sizeof(kismet_external_frame_v2_t));
+
+    if (rs_sz != caph->batch_buf_len + sizeof(kismet_external_frame_v2_t))
+        return 0;
+
+    frame = (kismet_external_frame_v2_t *) send_buffer;
+
+    frame->signature = htonl(KIS_EXTERNAL_PROTO_SIG);
+    frame->data_sz = htonl(caph->batch_buf_len);
+
+    frame->v2_sentinel = htons(KIS_EXTERNAL_V2_SIG);
+    frame->frame_version = htons(2);
+
+    frame->seqno = htonl(caph->batch_seqno);
+
+    strncpy(frame->command, "KDSDATAREPORTBATCH", 32);
+
+    memcpy(frame->data, caph->batch_buf, caph->batch_buf_len);
+
+    kis_simple_ringbuf_commit(caph->out_ringbuf, send_buffer, rs_sz);
+
+    caph->batch_buf_len = 0;
+    caph->batch_count = 0;
+
+    return 1;
+}
+
+/* Flush the pending batch if it has reached the latency bound, or unconditionally
+ * if force is set.  Must be called with the out_ringbuf_lock held. */
+static int cf_flush_batch_expired_nl(kis_capture_handler_t *caph, int force) {
+    struct timeval now;
+    long age_us;
+
+    if (caph->batch_count == 0)
+        return 1;
+
+    if (!force) {
+        gettimeofday(&now, NULL);
+
+        age_us = (now.tv_sec - caph->batch_start.tv_sec) * 1000000L + 
+            (now.tv_usec - caph->batch_start.tv_usec);
+
+        if (age_us < CAP_FRAMEWORK_BATCH_LATENCY_US)
+            return 1;
+    }
+
+    return cf_flush_batch_nl(caph);
+}
+
+/* Serialize a data report into the pending batch as a repeated 'reports' field,
+ * flushing the batch first if the report would not fit.  Must be called with the
+ * out_ringbuf_lock held.
+ *
+ * Returns:
+ * -1   An error occurred
+ *  0   Insufficient space in buffer
+ *  1   Success
+ */
+static int cf_batch_data_report_nl(kis_capture_handler_t *caph, 
+        KismetDatasource__DataReport *kedata, size_t report_len, uint32_t seqno) {
+    uint8_t *pos;
+    size_t varlen;
+
+    if (caph->batch_buf_len + report_len + CF_BATCH_ENTRY_OVERHEAD > CAP_FRAMEWORK_BATCH_MAX_SZ) {
+        if (cf_flush_batch_nl(caph) < 1)
+            return 0;
+    }
+
+    if (caph->batch_count == 0) {
+        caph->batch_seqno = seqno;
+        gettimeofday(&(caph->batch_start), NULL);
+    }
+
+    pos = caph->batch_buf + caph->batch_buf_len;
+
+    /* Field 1, length delimited */
+    *pos++ = (1 << 3) | 2;
+
+    varlen = report_len;
+    while (varlen >= 0x80) {
+        *pos++ = (uint8_t) (varlen | 0x80);
+        varlen >>= 7;
+    }
+    *pos++ = (uint8_t) varlen;
+
+    pos += kismet_datasource__data_report__pack(kedata, pos);
+
+    caph->batch_buf_len = pos - caph->batch_buf;
+    caph->batch_count++;
+
+    /* A full batch is sent immediately; if the ringbuffer is full it will be retried
+     * by the next report or by the io loop */
+    if (caph->batch_count >= CAP_FRAMEWORK_BATCH_MAX_REPORTS)
+        cf_flush_batch_nl(caph);
+
+    return 1;
+}
+
 int cf_send_data(kis_capture_handler_t *caph,
         KismetExternal__MsgbusMessage *kv_message,
         KismetDatasource__SubSignal *kv_signal,
@@ -3303,6 +3456,28 @@ int cf_send_data(kis_capture_handler_t *caph,
 
         buf_len = kismet_datasource__data_report__get_packed_size(&kedata);
 
+        /* Coalesce into the pending batch if the server supports it; reports too 
+         * large to batch are sent on their own */
+        if (caph->batch_reports && 
+                buf_len + CF_BATCH_ENTRY_OVERHEAD <= CAP_FRAMEWORK_BATCH_MAX_SZ) {
+            int r = cf_batch_data_report_nl(caph, &kedata, buf_len, seqno);
+
+            pthread_mutex_unlock(&(caph->out_ringbuf_lock));
+
+            if (kegps.name != NULL)
+                free(kegps.name);
+            if (kegps.type != NULL)
+                free(kegps.type);
+
+            return r;
+        }
+
+        /* Keep the reports in order if we're sending this one directly */
+        if (cf_flush_batch_nl(caph) < 1) {
+            pthread_mutex_unlock(&(caph->out_ringbuf_lock));
+            return 0;
+        }
+
         rs_sz = kis_simple_ringbuf_reserve(caph->out_ringbuf, (void **) &send_buffer, 
                 buf_len + sizeof(kismet_external_frame_v2_t));
 
@@ -85,6 +85,13 @@ struct cf_ws_msg {
 #define CAP_FRAMEWORK_RINGBUF_OUT_SZ    (1024 * 1024 * 4)
 #define CAP_FRAMEWORK_WS_BUF_SZ         (1024 * 4)
 
+/* Data report batching, when supported by the Kismet server.  Batches are flushed
+ * when they would exceed the maximum size (which must fit in a single v2 frame),
+ * hold the maximum number of reports, or have been pending for the latency bound */
+#define CAP_FRAMEWORK_BATCH_MAX_SZ      (1024 * 12)
+#define CAP_FRAMEWORK_BATCH_MAX_REPORTS 64
+#define CAP_FRAMEWORK_BATCH_LATENCY_US  10000
+
 /* List devices callback
  * Called to list devices available
  *
@@ -341,6 +348,17 @@ struct kis_capture_handler {
     /* Lock for output buffer or output ws ring */
     pthread_mutex_t out_ringbuf_lock;
 
+    /* Batched data reports, enabled when Kismet advertises support in the open 
+     * command; protected by the out_ringbuf_lock.  The batch buffer holds the 
+     * serialized DataReportBatch content and is sent with the sequence number of
+     * the first report in the batch */
+    int batch_reports;
+    uint8_t *batch_buf;
+    size_t batch_buf_len;
+    unsigned int batch_count;
+    uint32_t batch_seqno;
+    struct timeval batch_start;
+
     /* conditional waiter for ringbuf flushing data */
     pthread_cond_t out_ringbuf_flush_cond;
     pthread_mutex_t out_ringbuf_flush_cond_mutex;
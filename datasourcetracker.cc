@@ -574,6 +574,7 @@ void datasource_tracker::trigger_deferred_startup() {
 
     httpd->register_route("/datasource/all_sources", {"GET", "POST"}, httpd->RO_ROLE, {},
             std::make_shared<kis_net_web_tracked_endpoint>(datasource_vec, dst_lock));
+    httpd->enable_route_cache("/datasource/all_sources");
 
     httpd->register_route("/datasource/defaults", {"GET", "POST"}, httpd->RO_ROLE, {},
             std::make_shared<kis_net_web_tracked_endpoint>(config_defaults, dst_lock));
@@ -23,8 +23,10 @@
 #include <stdio.h>
 #include <time.h>
 #include <list>
+#include <limits>
 #include <map>
 #include <vector>
+#include <unordered_set>
 
 #include "kismet_algorithm.h"
 
@@ -48,11 +50,13 @@
 #include "json_adapter.h"
 #include "kis_datasource.h"
 #include "kis_databaselogfile.h"
+#include "kis_slab.h"
 #include "manuf.h"
 #include "messagebus.h"
 #include "packet.h"
 #include "packetchain.h"
 #include "pcapng_stream_futurebuf.h"
+#include "sqlite3_cpp11.h"
 #include "util.h"
 #include "zstr.hpp"
 
@@ -71,6 +75,52 @@ device_tracker::device_tracker() :
     // create a vector
     immutable_tracked_vec = std::make_shared<tracker_element_vector>();
 
+    num_tracked_devices = 0;
+
+    // Size the device index shards; by default we use a power of two comfortably above
+    // the number of packet threads, so that packet threads rarely collide on a shard
+    unsigned int n_shards =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("tracker_device_shards", 0);
+
+    if (n_shards == 0) {
+        n_shards =
+            Globalreg::globalreg->kismet_config->fetch_opt_uint("kismet_packet_threads", 0);
+
+        if (n_shards == 0)
+            n_shards = std::thread::hardware_concurrency();
+
+        n_shards = std::max(n_shards, 1U) * 4;
+    }
+
+    size_t shard_sz = 1;
+    while (shard_sz < n_shards && shard_sz < 4096)
+        shard_sz <<= 1;
+
+    device_shard_mask = shard_sz - 1;
+
+    for (size_t n = 0; n < shard_sz; n++) {
+        device_shards.push_back(std::make_unique<device_shard>());
+        device_shards.back()->mutex.set_name(fmt::format("devicetracker::shard {}", n));
+    }
+
+    // Size the change log; it needs to hold the devices modified between monitor 
+    // passes, anything larger than that which falls out forces a full scan
+    unsigned int n_changes =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("tracker_change_log_size", 131072);
+
+    size_t change_sz = 1024;
+    while (change_sz < n_changes && change_sz < (1 << 24))
+        change_sz <<= 1;
+
+    change_log.resize(change_sz);
+    change_log_mask = change_sz - 1;
+    change_log_head = 0;
+
+    change_log_mutex.set_name("device_tracker change_log");
+    monitor_cache_mutex.set_name("device_tracker monitor_cache");
+    stored_device_mutex.set_name("device_tracker stored_devices");
+    monitor_cache_tick = 0;
+
     entrytracker =
         Globalreg::fetch_mandatory_global_as<entry_tracker>();
 
@@ -189,6 +239,13 @@ device_tracker::device_tracker() :
         ram_no_rrd = false;
     }
 
+    compact_devices =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("tracker_compact_devices", true);
+
+    if (!compact_devices)
+        _MSG_INFO("Compact device records disabled; devices will use more RAM.  To save RAM, "
+                "set tracker_compact_devices=true");
+
     if (!Globalreg::globalreg->kismet_config->fetch_opt_bool("track_device_seenby_views", true)) {
         _MSG("Not building device seenby views to save RAM", MSGFLAG_INFO);
         map_seenby_views = false;
@@ -377,9 +434,8 @@ device_tracker::device_tracker() :
 
                     auto devvec = std::make_shared<tracker_element_vector>();
 
-                    const auto mmp = tracked_mac_multimap.equal_range(mac);
-                    for (auto mmpi = mmp.first; mmpi != mmp.second; ++mmpi)
-                        devvec->push_back(mmpi->second);
+                    for (const auto& d : fetch_devices(mac))
+                        devvec->push_back(d);
 
                     return devvec;
                 }, get_devicelist_mutex()));
@@ -407,6 +463,7 @@ device_tracker::device_tracker() :
 
                     return do_readonly_device_work(ts_worker);
                 }, get_devicelist_mutex()));
+    httpd->enable_route_cache("/devices/last-time/:timestamp/devices");
 
     httpd->register_route("/devices/by-key/:key/set_name", {"POST"}, httpd->LOGON_ROLE, {"cmd"},
             std::make_shared<kis_net_web_function_endpoint>(
@@ -685,34 +742,66 @@ device_tracker::device_tracker() :
                                 if (kt_v != key_timer_map.end())
                                     timetracker->remove_timer(kt_v->second);
 
-                                auto rename_map = Globalreg::new_from_pool<tracker_element_serializer::rename_map>();
+                                // Per-monitor position in the change log, and the last time we
+                                // sent records for the non-wildcard monitors
+                                struct monitor_state {
+                                    time_t last_tm = 0;
+                                    uint64_t cursor = std::numeric_limits<uint64_t>::max();
+                                };
 
-                                time_t last_tm = 0;
+                                auto state = std::make_shared<monitor_state>();
+
+                                std::string summary_key = format_t + ":";
+                                if (json.contains("fields"))
+                                    summary_key += json["fields"].dump();
 
                                 // Generate a timer event that goes and looks for the devices and
                                 // serializes them with the fields record
                                 auto tid = 
                                     timetracker->register_timer(std::chrono::seconds(rate), true,
-                                            [this, con, dev_r, dev_k, dev_m, json, ws, &last_tm, rename_map, format_t](int) -> int {
+                                            [this, con, dev_r, dev_k, dev_m, json, ws, state, format_t, summary_key](int) -> int {
                                                 if (dev_r == "*") {
-                                                    auto worker = device_tracker_view_function_worker([json, last_tm, format_t, this, ws](std::shared_ptr<kis_tracked_device_base> dev) -> bool {
-                                                        if (dev->get_mod_time() > last_tm) {
-                                                            std::stringstream ss;
-                                                            entrytracker->serialize_with_json_summary(format_t, ss, dev, json);
-                                                            auto data = ss.str();
-                                                            ws->write(data);
-                                                        }
+                                                    std::vector<device_key> changed;
+
+                                                    if (fetch_changed_devices(state->cursor, changed)) {
+                                                        // Only the devices which changed since the last pass; a device
+                                                        // is logged once per tick, so may appear more than once
+                                                        std::unordered_set<device_key> seen;
+
+                                                        kis_lock_guard<kis_mutex> lk(get_devicelist_mutex(), "ws monitor change log");
+
+                                                        for (const auto& k : changed) {
+                                                            if (!seen.insert(k).second)
+                                                                continue;
 
-                                                        return false;
-                                                    });
+                                                            auto dev = fetch_device_nr(k);
+                                                            if (dev == nullptr)
+                                                                continue;
 
-                                                    do_device_work(worker);
+                                                            ws->write(serialize_monitored_device(format_t, summary_key, dev, json));
+                                                        }
+                                                    } else {
+                                                        // New monitor, or we fell behind the change log
+                                                        auto last_tm = state->last_tm;
+                                                        auto worker = device_tracker_view_function_worker([json, last_tm, format_t, this, ws](std::shared_ptr<kis_tracked_device_base> dev) -> bool {
+                                                            if (dev->get_mod_time() >= last_tm) {
+                                                                std::stringstream ss;
+                                                                entrytracker->serialize_with_json_summary(format_t, ss, dev, json);
+                                                                auto data = ss.str();
+                                                                ws->write(data);
+                                                            }
+
+                                                            return false;
+                                                        });
+
+                                                        do_device_work(worker);
+                                                    }
                                                 } else if (!dev_k.get_error()) {
                                                     kis_lock_guard<kis_mutex> lk(get_devicelist_mutex(), "ws monitor timer serialize lambda");
 
                                                     auto dev = fetch_device(dev_k);
                                                     if (dev != nullptr) {
-                                                        if (dev->get_mod_time() > last_tm) {
+                                                        if (dev->get_mod_time() > state->last_tm) {
                                                             std::stringstream ss;
                                                             entrytracker->serialize_with_json_summary(format_t, ss, dev, json);
                                                             auto data = ss.str();
@@ -722,18 +811,17 @@ device_tracker::device_tracker() :
                                                 } else if (!dev_m.error()) {
                                                     kis_lock_guard<kis_mutex> lk(get_devicelist_mutex(), "ws monitor timer serialize lambda");
 
-                                                    const auto mmp = tracked_mac_multimap.equal_range(dev_m);
-                                                    for (auto mmpi = mmp.first; mmpi != mmp.second; ++mmpi) {
-                                                        if (mmpi->second->get_mod_time() > last_tm) {
+                                                    for (const auto& d : fetch_devices(dev_m)) {
+                                                        if (d->get_mod_time() > state->last_tm) {
                                                             std::stringstream ss;
-                                                            entrytracker->serialize_with_json_summary(format_t, ss, mmpi->second, json);
+                                                            entrytracker->serialize_with_json_summary(format_t, ss, d, json);
                                                             auto data = ss.str();
                                                             ws->write(data);
                                                         }
                                                     }
                                                 }
 
-                                                last_tm = (time_t) Globalreg::globalreg->last_tv_sec;
+                                                state->last_tm = (time_t) Globalreg::globalreg->last_tv_sec;
 
                                                 return 1;
                                             });
@@ -795,6 +883,9 @@ device_tracker::device_tracker() :
     database_open("");
     database_upgrade_db();
 
+    load_stored_devices();
+    storage_write_thread = std::thread([this]() { storage_writer(); });
+
     new_datasource_evt_id = 
         eventbus->register_listener(datasource_tracker::event_new_datasource(),
                 [this](std::shared_ptr<eventbus_event> evt) {
@@ -863,6 +954,12 @@ device_tracker::device_tracker() :
     device_location_signal_threshold =
         Globalreg::globalreg->kismet_config->fetch_opt_as<int>("device_location_signal_threshold", 0);
 
+    if (Globalreg::globalreg->kismet_config->fetch_opt_bool("devicetracker_spatial_index", true)) {
+        auto cell_deg =
+            Globalreg::globalreg->kismet_config->fetch_opt_as<double>("devicetracker_spatial_cell", 0.01);
+        spatial_index = std::make_shared<device_spatial_index>(cell_deg);
+    }
+
     // httpd->register_alias("/devices/summary/devices.json", "/devices/views/all/devices.json");
 }
 
@@ -909,11 +1006,24 @@ device_tracker::~device_tracker() {
 		delete track_filter;
     */
 
+    // Flush any pending name and tag writes before the database is closed
+    if (storage_write_thread.joinable()) {
+        stored_device_write shutdown;
+        shutdown.shutdown = true;
+        storage_write_queue.enqueue(std::move(shutdown));
+        storage_write_thread.join();
+    }
+
     for (auto p : phy_handler_map)
         delete(p.second);
 
     immutable_tracked_vec->clear();
-    tracked_mac_multimap.clear();
+
+    for (auto& shard : device_shards) {
+        kis_lock_guard<kis_shared_mutex> lk(shard->mutex, "~device_tracker");
+        shard->key_map.clear();
+        shard->mac_map.clear();
+    }
 }
 
 void device_tracker::macdevice_timer_event() {
@@ -979,9 +1089,7 @@ std::string device_tracker::fetch_phy_name(int in_phy) {
 }
 
 int device_tracker::fetch_num_devices() {
-    kis_lock_guard<kis_mutex> lk(get_devicelist_mutex(), "device_tracker fetch_num_devices");
-
-    return tracked_map.size();
+    return num_tracked_devices;
 }
 
 int device_tracker::fetch_num_packets() {
@@ -1040,34 +1148,164 @@ void device_tracker::update_full_refresh() {
     full_refresh_time = (time_t) Globalreg::globalreg->last_tv_sec;
 }
 
+device_tracker::device_shard& device_tracker::fetch_device_shard(const device_key& in_key) {
+    // Fold the key hash so that both the phy and the mac components spread across
+    // the shards
+    uint64_t h = std::hash<device_key>{}(in_key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+
+    return *device_shards[h & device_shard_mask];
+}
+
+void device_tracker::shard_insert_device(std::shared_ptr<kis_tracked_device_base> in_device) {
+    auto& shard = fetch_device_shard(in_device->get_key());
+    kis_lock_guard<kis_shared_mutex> lk(shard.mutex, "device_tracker shard_insert_device");
+
+    shard.key_map[in_device->get_key()] = in_device;
+    shard.mac_map.emplace(in_device->get_macaddr(), in_device);
+
+    num_tracked_devices++;
+}
+
+void device_tracker::shard_remove_device(std::shared_ptr<kis_tracked_device_base> in_device) {
+    auto& shard = fetch_device_shard(in_device->get_key());
+    kis_lock_guard<kis_shared_mutex> lk(shard.mutex, "device_tracker shard_remove_device");
+
+    auto mi = shard.key_map.find(in_device->get_key());
+    if (mi == shard.key_map.end())
+        return;
+
+    shard.key_map.erase(mi);
+
+    auto mmp = shard.mac_map.equal_range(in_device->get_macaddr());
+    for (auto mmpi = mmp.first; mmpi != mmp.second; ++mmpi) {
+        if (mmpi->second->get_key() == in_device->get_key()) {
+            shard.mac_map.erase(mmpi);
+            break;
+        }
+    }
+
+    num_tracked_devices--;
+
+    if (spatial_index != nullptr)
+        spatial_index->remove(in_device);
+}
+
 std::shared_ptr<kis_tracked_device_base> device_tracker::fetch_device(device_key in_key) {
-    kis_lock_guard<kis_mutex> lk(get_devicelist_mutex(), "device_tracker fetch_device");
+    auto& shard = fetch_device_shard(in_key);
+    std::shared_lock<kis_shared_mutex> lk(shard.mutex);
 
-	device_itr i = tracked_map.find(in_key);
+	auto i = shard.key_map.find(in_key);
 
-	if (i != tracked_map.end())
+	if (i != shard.key_map.end())
 		return i->second;
 
 	return NULL;
 }
 
 std::shared_ptr<kis_tracked_device_base> device_tracker::fetch_device_nr(device_key in_key) {
-	device_itr i = tracked_map.find(in_key);
+    // Shards are only modified under the devicelist lock, which the caller must hold
+    auto& shard = fetch_device_shard(in_key);
+
+	auto i = shard.key_map.find(in_key);
 
-	if (i != tracked_map.end())
+	if (i != shard.key_map.end())
 		return i->second;
 
 	return NULL;
 }
 
+void device_tracker::log_device_change(std::shared_ptr<kis_tracked_device_base> in_device) {
+    time_t now = (time_t) Globalreg::globalreg->last_tv_sec;
+
+    // Already recorded this tick; the devicelist lock protects the device tick
+    if (in_device->get_change_log_tick() == now)
+        return;
+
+    in_device->set_change_log_tick(now);
+
+    kis_lock_guard<kis_mutex> lk(change_log_mutex, "device_tracker log_device_change");
+
+    auto& e = change_log[change_log_head & change_log_mask];
+    e.tick = now;
+    e.key = in_device->get_key();
+
+    change_log_head++;
+}
+
+bool device_tracker::fetch_changed_devices(uint64_t& cursor, std::vector<device_key>& changed) {
+    time_t now = (time_t) Globalreg::globalreg->last_tv_sec;
+
+    kis_lock_guard<kis_mutex> lk(change_log_mutex, "device_tracker fetch_changed_devices");
+
+    if (cursor > change_log_head || change_log_head - cursor > change_log.size()) {
+        // Rewind to the start of the current tick; the caller's full scan covers 
+        // everything before it
+        cursor = change_log_head;
+
+        while (cursor > 0 && change_log_head - cursor < change_log.size() &&
+                change_log[(cursor - 1) & change_log_mask].tick >= now)
+            cursor--;
+
+        return false;
+    }
+
+    while (cursor < change_log_head) {
+        const auto& e = change_log[cursor & change_log_mask];
+
+        if (e.tick >= now)
+            break;
+
+        changed.push_back(e.key);
+        cursor++;
+    }
+
+    return true;
+}
+
+std::string device_tracker::serialize_monitored_device(const std::string& format, 
+        const std::string& summary_key, std::shared_ptr<kis_tracked_device_base> device, 
+        const nlohmann::json& json) {
+    auto cache_key = summary_key + ":" + device->get_key().as_string();
+
+    {
+        kis_lock_guard<kis_mutex> lk(monitor_cache_mutex, "device_tracker serialize_monitored_device");
+
+        // Records are only shared within a tick; any later change lands in the change
+        // log and is picked up on the next pass
+        if (monitor_cache_tick != (time_t) Globalreg::globalreg->last_tv_sec) {
+            monitor_cache.clear();
+            monitor_cache_tick = (time_t) Globalreg::globalreg->last_tv_sec;
+        }
+
+        auto ci = monitor_cache.find(cache_key);
+        if (ci != monitor_cache.end())
+            return ci->second;
+    }
+
+    std::stringstream ss;
+    entrytracker->serialize_with_json_summary(format, ss, device, json);
+    auto data = ss.str();
+
+    kis_lock_guard<kis_mutex> lk(monitor_cache_mutex, "device_tracker serialize_monitored_device");
+    monitor_cache[cache_key] = data;
+
+    return data;
+}
+
 // Fetch one or more devices by mac address or mac mask
 std::vector<std::shared_ptr<kis_tracked_device_base>> device_tracker::fetch_devices(mac_addr in_mac) {
-    kis_lock_guard<kis_mutex> lk(get_devicelist_mutex(), "device_tracker fetch_device mac");
     std::vector<std::shared_ptr<kis_tracked_device_base>> ret;
-   
-    const auto mmp = tracked_mac_multimap.equal_range(in_mac);
-    for (auto mmpi = mmp.first; mmpi != mmp.second; ++mmpi) {
-        ret.push_back(mmpi->second);
+
+    for (auto& shard : device_shards) {
+        std::shared_lock<kis_shared_mutex> lk(shard->mutex);
+
+        const auto mmp = shard->mac_map.equal_range(in_mac);
+        for (auto mmpi = mmp.first; mmpi != mmp.second; ++mmpi) {
+            ret.push_back(mmpi->second);
+        }
     }
 
     return ret;
@@ -1151,11 +1389,6 @@ std::shared_ptr<kis_tracked_device_base>
             mac_addr in_mac, kis_phy_handler *in_phy, std::shared_ptr<kis_packet> in_pack, 
             unsigned int in_flags, std::string in_basic_type) {
 
-    // Updating devices can only happen in serial because we don't know that a device is being
-    // created & we don't know how to append the data until we get to the end of processing
-    // so the entire chain is perforce locked
-    kis_lock_guard<kis_mutex> lg(get_devicelist_mutex(), "device_tracker update_common_device");
-
     std::stringstream sstr;
 
     bool new_device = false;
@@ -1171,15 +1404,18 @@ std::shared_ptr<kis_tracked_device_base>
 
     key = device_key(in_phy->fetch_phyname_hash(), in_mac);
 
-	if ((device = fetch_device_nr(key)) == NULL) {
+    // Look the device up in its shard without the devicelist lock, and build a new
+    // device record (including the manuf and stored name lookups) outside of the
+    // devicelist lock; only the update of the device content is serialized.
+	if ((device = fetch_device(key)) == NULL) {
         if (in_flags & UCD_UPDATE_EXISTING_ONLY)
             return NULL;
 
-        device = std::make_shared<kis_tracked_device_base>(device_builder.get());
-
-        // Device ID is the size of the vector so a new device always gets put
-        // in it's numbered slot
-        device->set_kis_internal_id(immutable_tracked_vec->size());
+        if (compact_devices)
+            device = std::allocate_shared<kis_tracked_device_base>(
+                    kis_slab_allocator<kis_tracked_device_base>(), device_builder.get());
+        else
+            device = std::make_shared<kis_tracked_device_base>(device_builder.get());
 
         device->set_key(key);
 
@@ -1197,12 +1433,35 @@ std::shared_ptr<kis_tracked_device_base>
             device->set_manuf(Globalreg::globalreg->manufdb->lookup_oui(in_mac));
         }
 
-        load_stored_username(device);
-        load_stored_tags(device);
+        apply_stored_device(device);
+
+        // Without compact records, build the full element set up front as before
+        if (!compact_devices)
+            device->materialize();
 
         new_device = true;
     }
 
+    // Updating device content happens in serial, we don't know how to append the data
+    // until we get to the end of processing
+    kis_lock_guard<kis_mutex> lg(get_devicelist_mutex(), "device_tracker update_common_device");
+
+    if (new_device) {
+        // Another packet thread may have created the same device while we were
+        // building ours; shards are only modified under the devicelist lock so
+        // this check is definitive
+        auto existing = fetch_device_nr(key);
+
+        if (existing != nullptr) {
+            device = existing;
+            new_device = false;
+        } else {
+            // Device ID is the size of the vector so a new device always gets put
+            // in it's numbered slot
+            device->set_kis_internal_id(immutable_tracked_vec->size());
+        }
+    }
+
     // Tag the packet with the base device
     auto devinfo = in_pack->fetch<kis_tracked_device_info>(pack_comp_device);
 
@@ -1215,6 +1474,7 @@ std::shared_ptr<kis_tracked_device_base>
 
     // Update the mod data
     device->update_modtime();
+    log_device_change(device);
 
     // Raise alerts for new devices or devices which have been
     // idle and re-appeared
@@ -1318,22 +1578,22 @@ std::shared_ptr<kis_tracked_device_base>
             // Throttle history cloud to one update per second to prevent floods of
             // data from swamping the cloud
             if (track_history_cloud && pack_gpsinfo->fix >= 2) {
-                auto histloc = Globalreg::new_from_pool<kis_historic_location>();
+                kis_historic_location_sample histloc = {};
 
-                histloc->set_lat(pack_gpsinfo->lat);
-                histloc->set_lon(pack_gpsinfo->lon);
-                histloc->set_alt(pack_gpsinfo->alt);
-                histloc->set_speed(pack_gpsinfo->speed);
-                histloc->set_heading(pack_gpsinfo->heading);
+                histloc.lat = pack_gpsinfo->lat;
+                histloc.lon = pack_gpsinfo->lon;
+                histloc.alt = pack_gpsinfo->alt;
+                histloc.speed = pack_gpsinfo->speed;
+                histloc.heading = pack_gpsinfo->heading;
 
-                histloc->set_time_sec(in_pack->ts.tv_sec);
+                histloc.time_sec = in_pack->ts.tv_sec;
 
                 if (pack_l1info != NULL) {
-                    histloc->set_frequency(pack_l1info->freq_khz);
+                    histloc.frequency = pack_l1info->freq_khz;
                     if (pack_l1info->signal_dbm != 0)
-                        histloc->set_signal(pack_l1info->signal_dbm);
+                        histloc.signal = pack_l1info->signal_dbm;
                     else
-                        histloc->set_signal(pack_l1info->signal_rssi);
+                        histloc.signal = pack_l1info->signal_rssi;
                 }
 
                 device->get_location_cloud()->add_sample(histloc);
@@ -1344,6 +1604,10 @@ std::shared_ptr<kis_tracked_device_base>
                             pack_gpsinfo->heading);
         }
 
+        // Some phys (ADSB) report locations without a GPS fix level, so only skip the
+        // empty location
+        if (spatial_index != nullptr && (pack_gpsinfo->lat != 0 || pack_gpsinfo->lon != 0))
+            spatial_index->update(device, pack_gpsinfo->lat, pack_gpsinfo->lon);
     }
 
 	// Update seenby records for time, frequency, packets
@@ -1382,12 +1646,9 @@ std::shared_ptr<kis_tracked_device_base>
 
     if (new_device) {
         // Add the new device to the list
-        tracked_map[key] = device;
-
         immutable_tracked_vec->push_back(device);
 
-        auto mm_pair = std::make_pair(in_mac, device);
-        tracked_mac_multimap.insert(mm_pair);
+        shard_insert_device(device);
 
         // If we have no packet info, add it to the device list immediately,
         // otherwise, flag the packet to trigger a new device event at the
@@ -1462,19 +1723,8 @@ void device_tracker::timetracker_event(int eventid) {
                 (d->get_packets() < device_idle_min_packets ||
                  device_idle_min_packets <= 0)) {
 
-                device_itr mi = tracked_map.find(d->get_key());
-                if (mi != tracked_map.end())
-                    tracked_map.erase(mi);
-
-                // Erase it from the multimap
-                auto mmp = tracked_mac_multimap.equal_range(d->get_macaddr());
-
-                for (auto mmpi = mmp.first; mmpi != mmp.second; ++mmpi) {
-                    if (mmpi->second->get_key() == d->get_key()) {
-                        tracked_mac_multimap.erase(mmpi);
-                        break;
-                    }
-                }
+                // Erase it from the key and mac index
+                shard_remove_device(d);
 
                 // Forget it from any views
                 remove_view_device(d);
@@ -1498,7 +1748,7 @@ void device_tracker::timetracker_event(int eventid) {
             return;
 
 		// Do nothing if the number of devices is less than the max
-		if (tracked_map.size() <= max_num_devices)
+		if (num_tracked_devices <= max_num_devices)
             return;
 
         // Now this gets expensive; clone the immutable vec, sort it, and then we start
@@ -1514,19 +1764,8 @@ void device_tracker::timetracker_event(int eventid) {
         for (auto i = sorted_vec.begin() + max_num_devices; i != sorted_vec.end(); ++i) {
             auto d = std::static_pointer_cast<kis_tracked_device_base>(*i);
 
-            device_itr mi = tracked_map.find(d->get_key());
-            if (mi != tracked_map.end())
-                tracked_map.erase(mi);
-
-            // Erase it from the multimap
-            auto mmp = tracked_mac_multimap.equal_range(d->get_macaddr());
-
-            for (auto mmpi = mmp.first; mmpi != mmp.second; ++mmpi) {
-                if (mmpi->second->get_key() == d->get_key()) {
-                    tracked_mac_multimap.erase(mmpi);
-                    break;
-                }
-            }
+            // Erase it from the key and mac index
+            shard_remove_device(d);
 
             // Forget it from the immutable vec, but keep its
             // position; we need to have vecpos = devid
@@ -1644,11 +1883,9 @@ void device_tracker::add_device(std::shared_ptr<kis_tracked_device_base> device)
     // in it's numbered slot
     device->set_kis_internal_id(immutable_tracked_vec->size());
 
-    tracked_map[device->get_key()] = device;
     immutable_tracked_vec->push_back(device);
 
-    auto mm_pair = std::make_pair(device->get_macaddr(), device);
-    tracked_mac_multimap.emplace(mm_pair);
+    shard_insert_device(device);
 }
 
 bool device_tracker::add_view(std::shared_ptr<device_tracker_view> in_view) {
@@ -1751,116 +1988,167 @@ void device_tracker::databaselog_write_devices() {
     last_database_logged = log_time;
 }
 
-void device_tracker::load_stored_username(std::shared_ptr<kis_tracked_device_base> in_dev) {
-    // Lock the database; we're doing a single query
+void device_tracker::load_stored_devices() {
     kis_lock_guard<kis_mutex> lk(ds_mutex);
 
     if (!database_valid())
         return;
 
-    // This should only get called inside device creation which should be a safe time, don't lock here
-    // Lock the device itself
-    // auto devlocker = devicelist_range_scope_locker(shared_from_this(), in_dev);
+    using namespace kissqlite3;
 
-    std::string sql;
-    std::string keystring = in_dev->get_key().as_string();
+    kis_lock_guard<kis_shared_mutex> slk(stored_device_mutex, "load_stored_devices");
 
-    int r;
-    sqlite3_stmt *stmt = NULL;
-    const char *pz = NULL;
+    stored_device_map.clear();
 
-    sql = 
-        "SELECT name FROM device_names WHERE key = ? ";
+    try {
+        auto names_q = _SELECT(db, "device_names", {"key", "name"});
 
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &stmt, &pz);
+        for (auto n : names_q) {
+            auto& info = stored_device_entry(device_key(sqlite3_column_as<std::string>(n, 0)));
+            info.has_username = true;
+            info.username = sqlite3_column_as<std::string>(n, 1);
+        }
 
-    if (r != SQLITE_OK) {
-        _MSG("device_tracker unable to prepare database query for stored devicename in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        return;
+        auto tags_q = _SELECT(db, "device_tags", {"key", "tag", "content"});
+
+        for (auto t : tags_q) {
+            auto& info = stored_device_entry(device_key(sqlite3_column_as<std::string>(t, 0)));
+            info.tags.push_back(std::make_pair(sqlite3_column_as<std::string>(t, 1),
+                        sqlite3_column_as<std::string>(t, 2)));
+        }
+    } catch (const std::exception& e) {
+        _MSG_ERROR("device_tracker unable to load stored device names and tags from {}: {}",
+                ds_dbfile, e.what());
     }
 
-    sqlite3_reset(stmt);
-    sqlite3_bind_text(stmt, 1, keystring.c_str(), keystring.length(), 0);
+    // Size the filter for what we loaded, with room for names set while running
+    stored_device_bloom.reset(stored_device_map.size() * 2);
 
-    while (1) {
-        r = sqlite3_step(stmt);
+    for (const auto& i : stored_device_map)
+        stored_device_bloom.insert(stored_device_hash(i.first));
+}
 
-        if (r == SQLITE_ROW) {
-            const unsigned char *rowstr;
+device_tracker::stored_device_info& device_tracker::stored_device_entry(const device_key& key) {
+    auto i = stored_device_map.find(key);
 
-            rowstr = (const unsigned char *) sqlite3_column_text(stmt, 0);
+    if (i != stored_device_map.end())
+        return i->second;
 
-            in_dev->set_username(std::string((const char *) rowstr));
+    auto& info = stored_device_map[key];
 
-        } else if (r == SQLITE_DONE) {
-            break;
-        } else {
-            _MSG("device_tracker encountered an error loading stored device username: " + 
-                    std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            break;
-        }
+    if (stored_device_bloom.overfull()) {
+        stored_device_bloom.reset(stored_device_map.size() * 2);
+
+        for (const auto& si : stored_device_map)
+            stored_device_bloom.insert(stored_device_hash(si.first));
+    } else {
+        stored_device_bloom.insert(stored_device_hash(key));
     }
 
-    sqlite3_finalize(stmt);
+    return info;
 }
 
-void device_tracker::load_stored_tags(std::shared_ptr<kis_tracked_device_base> in_dev) {
-    // Lock the database; we're doing a single query
-    kis_lock_guard<kis_mutex> lk(ds_mutex);
+void device_tracker::apply_stored_device(std::shared_ptr<kis_tracked_device_base> in_dev) {
+    // Called during device creation, before the device is visible to anyone else
+    auto key = in_dev->get_key();
 
-    if (!database_valid())
-        return;
+    std::shared_lock<kis_shared_mutex> lk(stored_device_mutex);
 
-    // This should be safe b/c it's only called inside device creation, don't lock
-    // Lock the device itself
-    // auto devlocker = devicelist_range_scope_locker(shared_from_this(), in_dev);
+    if (!stored_device_bloom.maybe_contains(stored_device_hash(key)))
+        return;
 
-    std::string sql;
-    std::string keystring = in_dev->get_key().as_string();
+    auto i = stored_device_map.find(key);
 
-    int r;
-    sqlite3_stmt *stmt = NULL;
-    const char *pz = NULL;
+    if (i == stored_device_map.end())
+        return;
 
-    sql = 
-        "SELECT tag, content FROM device_tags WHERE key = ?";
+    if (i->second.has_username)
+        in_dev->set_username(i->second.username);
 
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &stmt, &pz);
+    for (const auto& t : i->second.tags) {
+        auto tagc = std::make_shared<tracker_element_string>();
+        tagc->set(t.second);
 
-    if (r != SQLITE_OK) {
-        _MSG("device_tracker unable to prepare database query for stored devicetag in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        return;
+        in_dev->get_tag_map()->insert(t.first, tagc);
     }
+}
 
-    sqlite3_reset(stmt);
-    sqlite3_bind_text(stmt, 1, keystring.c_str(), keystring.length(), 0);
+void device_tracker::storage_writer() {
+    std::vector<stored_device_write> batch(64);
+    sqlite3_stmt *name_stmt = nullptr, *tag_stmt = nullptr;
 
-    while (1) {
-        r = sqlite3_step(stmt);
+    const std::string name_sql = 
+        "INSERT INTO device_names "
+        "(key, name) "
+        "VALUES (?, ?)";
+
+    const std::string tag_sql = 
+        "INSERT INTO device_tags "
+        "(key, tag, content) "
+        "VALUES (?, ?, ?)";
 
-        if (r == SQLITE_ROW) {
-            const unsigned char *tagstr;
-            const unsigned char *contentstr;
+    bool shutdown = false;
 
-            tagstr = (const unsigned char *) sqlite3_column_text(stmt, 0);
-            contentstr = (const unsigned char *) sqlite3_column_text(stmt, 1);
+    while (!shutdown) {
+        auto n = storage_write_queue.wait_dequeue_bulk(batch.begin(), batch.size());
 
-            auto tagc = std::make_shared<tracker_element_string>();
-            tagc->set(std::string((const char *) contentstr));
+        kis_lock_guard<kis_mutex> lk(ds_mutex);
 
-            in_dev->get_tag_map()->insert(std::string((const char *) tagstr), tagc);
-        } else if (r == SQLITE_DONE) {
-            break;
-        } else {
-            _MSG("device_tracker encountered an error loading stored device username: " + 
-                    std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            break;
+        if (database_valid() && name_stmt == nullptr) {
+            const char *pz = nullptr;
+
+            if (sqlite3_prepare_v2(db, name_sql.c_str(), name_sql.length(), &name_stmt, &pz) != SQLITE_OK ||
+                    sqlite3_prepare_v2(db, tag_sql.c_str(), tag_sql.length(), &tag_stmt, &pz) != SQLITE_OK) {
+                _MSG("device_tracker unable to prepare database insert for device names and tags in " +
+                        ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
+                sqlite3_finalize(name_stmt);
+                sqlite3_finalize(tag_stmt);
+                name_stmt = tag_stmt = nullptr;
+            }
         }
+
+        if (name_stmt != nullptr)
+            sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+        for (size_t i = 0; i < n; i++) {
+            auto& w = batch[i];
+
+            if (w.shutdown) {
+                shutdown = true;
+                continue;
+            }
+
+            if (name_stmt == nullptr)
+                continue;
+
+            auto stmt = w.is_username ? name_stmt : tag_stmt;
+            int spos = 1;
+
+            sqlite3_reset(stmt);
+
+            sqlite3_bind_text(stmt, spos++, w.key.c_str(), w.key.length(), SQLITE_STATIC);
+            if (!w.is_username)
+                sqlite3_bind_text(stmt, spos++, w.tag.c_str(), w.tag.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, spos++, w.content.c_str(), w.content.length(), SQLITE_STATIC);
+
+            if (sqlite3_step(stmt) != SQLITE_DONE)
+                _MSG_ERROR("device_tracker unable to store device {} in {}: {}",
+                        w.is_username ? "name" : "tag", ds_dbfile, sqlite3_errmsg(db));
+
+            sqlite3_reset(stmt);
+        }
+
+        if (name_stmt != nullptr)
+            sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
+
+        for (size_t i = 0; i < n; i++)
+            batch[i] = stored_device_write{};
     }
 
-    sqlite3_finalize(stmt);
+    kis_lock_guard<kis_mutex> lk(ds_mutex);
+
+    sqlite3_finalize(name_stmt);
+    sqlite3_finalize(tag_stmt);
 }
 
 void device_tracker::set_device_user_name(std::shared_ptr<kis_tracked_device_base> in_dev,
@@ -1876,41 +2164,19 @@ void device_tracker::set_device_user_name(std::shared_ptr<kis_tracked_device_bas
         return;
     }
 
-    std::string sql;
-
-    int r;
-    sqlite3_stmt *stmt = NULL;
-    const char *pz = NULL;
-
-    std::string keystring = in_dev->get_key().as_string();
-
-    sql = 
-        "INSERT INTO device_names "
-        "(key, name) "
-        "VALUES (?, ?)";
-
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &stmt, &pz);
-
-    if (r != SQLITE_OK) {
-        _MSG("device_tracker unable to prepare database insert for device name in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        return;
-    }
- 
-    sqlite3_reset(stmt);
-
-    sqlite3_bind_text(stmt, 1, keystring.c_str(), keystring.length(), 0);
-    sqlite3_bind_text(stmt, 2, in_username.c_str(), in_username.length(), 0);
-
-    // Only lock the database while we're inserting
     {
-        kis_lock_guard<kis_mutex> lk(ds_mutex);
-        sqlite3_step(stmt);
+        kis_lock_guard<kis_shared_mutex> slk(stored_device_mutex, "set_device_user_name");
+        auto& info = stored_device_entry(in_dev->get_key());
+        info.has_username = true;
+        info.username = in_username;
     }
 
-    sqlite3_finalize(stmt);
+    stored_device_write w;
+    w.is_username = true;
+    w.key = in_dev->get_key().as_string();
+    w.content = in_username;
 
-    return;
+    storage_write_queue.enqueue(std::move(w));
 }
 
 void device_tracker::set_device_tag(std::shared_ptr<kis_tracked_device_base> in_dev,
@@ -1936,42 +2202,25 @@ void device_tracker::set_device_tag(std::shared_ptr<kis_tracked_device_base> in_
         return;
     }
 
-    std::string sql;
-
-    int r;
-    sqlite3_stmt *stmt = NULL;
-    const char *pz = NULL;
-
-    std::string keystring = in_dev->get_key().as_string();
-
-    sql = 
-        "INSERT INTO device_tags "
-        "(key, tag, content) "
-        "VALUES (?, ?, ?)";
-
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &stmt, &pz);
-
-    if (r != SQLITE_OK) {
-        _MSG("device_tracker unable to prepare database insert for device tags in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        return;
-    }
- 
-    sqlite3_reset(stmt);
+    {
+        kis_lock_guard<kis_shared_mutex> slk(stored_device_mutex, "set_device_tag");
+        auto& info = stored_device_entry(in_dev->get_key());
 
-    sqlite3_bind_text(stmt, 1, keystring.c_str(), keystring.length(), 0);
-    sqlite3_bind_text(stmt, 2, in_tag.c_str(), in_tag.length(), 0);
-    sqlite3_bind_text(stmt, 3, in_content.c_str(), in_content.length(), 0);
+        auto ti = std::find_if(info.tags.begin(), info.tags.end(),
+                [&in_tag](const std::pair<std::string, std::string>& p) { return p.first == in_tag; });
 
-    // Only lock the database while we're inserting
-    {
-        kis_lock_guard<kis_mutex> lk(ds_mutex);
-        sqlite3_step(stmt);
+        if (ti != info.tags.end())
+            ti->second = in_content;
+        else
+            info.tags.push_back(std::make_pair(in_tag, in_content));
     }
 
-    sqlite3_finalize(stmt);
+    stored_device_write w;
+    w.key = in_dev->get_key().as_string();
+    w.tag = in_tag;
+    w.content = in_content;
 
-    return;
+    storage_write_queue.enqueue(std::move(w));
 }
 
 void device_tracker::handle_new_datasource_event(std::shared_ptr<eventbus_event> evt) {
@@ -30,6 +30,7 @@
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <thread>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -38,6 +39,7 @@
 #include <utility>
 
 #include "globalregistry.h"
+#include "bloom_filter.h"
 #include "kis_mutex.h"
 #include "trackedelement.h"
 #include "entrytracker.h"
@@ -53,11 +55,14 @@
 #include "kis_net_beast_httpd.h"
 #include "devicetracker_view.h"
 #include "devicetracker_view_workers.h"
+#include "devicetracker_spatial.h"
 #include "kis_database.h"
 #include "eventbus.h"
 #include "robin_hood.h"
 #include "streamtracker.h"
 
+#include "moodycamel/blockingconcurrentqueue.h"
+
 #define KIS_PHY_ANY	-1
 #define KIS_PHY_UNKNOWN -2
 
@@ -125,6 +130,12 @@ public:
     // lock to be safely used
     std::shared_ptr<kis_tracked_device_base> fetch_device_nr(device_key in_key);
 
+    // Collect the keys of devices changed since the cursor and advance it; only completed
+    // ticks are consumed.  Returns false if the cursor is new or has fallen out of the 
+    // change log, in which case the caller must do a full scan and the cursor is moved
+    // to the start of the current tick.
+    bool fetch_changed_devices(uint64_t& cursor, std::vector<device_key>& changed);
+
     // Do work on all devices, this applies to the 'all' device view
     std::shared_ptr<tracker_element_vector> do_device_work(device_tracker_view_worker& worker);
     std::shared_ptr<tracker_element_vector> do_readonly_device_work(device_tracker_view_worker& worker);
@@ -236,6 +247,11 @@ public:
         return devicelist_mutex;
     }
 
+    // Spatial index of device locations, or nullptr if disabled
+    std::shared_ptr<device_spatial_index> get_spatial_index() {
+        return spatial_index;
+    }
+
 protected:
     std::shared_ptr<entry_tracker> entrytracker;
     std::shared_ptr<packet_chain> packetchain;
@@ -336,13 +352,67 @@ protected:
     // Signal threshold
     int device_location_signal_threshold;
 
-	// Tracked devices
-    device_map_t tracked_map;
+    // Grid index of the last location of each device, for map queries
+    std::shared_ptr<device_spatial_index> spatial_index;
 
+    // Tracked devices are indexed across a number of shards, selected by the hash of the
+    // device key.  Each shard holds the key map and the MAC multimap for the devices
+    // which hash into it, under its own shared lock; lookups only take the shard lock
+    // in shared mode and never touch the devicelist mutex.  Shards are only ever
+    // modified while also holding the devicelist mutex, so code already holding the
+    // devicelist lock sees a stable index.
+    //
     // MAC address lookups are incredibly expensive from the webui if we don't
     // track by map; in theory multiple objects in different PHYs could have the
-    // same MAC so it's not a simple 1:1 map
-    std::multimap<mac_addr, std::shared_ptr<kis_tracked_device_base> > tracked_mac_multimap;
+    // same MAC so it's not a simple 1:1 map.  MAC lookups may be masked, so they
+    // are resolved against every shard.
+    using device_mac_map_t = std::multimap<mac_addr, std::shared_ptr<kis_tracked_device_base>>;
+
+    struct device_shard {
+        kis_shared_mutex mutex;
+        device_map_t key_map;
+        device_mac_map_t mac_map;
+    };
+
+    std::vector<std::unique_ptr<device_shard>> device_shards;
+    size_t device_shard_mask;
+
+    std::atomic<size_t> num_tracked_devices;
+
+    device_shard& fetch_device_shard(const device_key& in_key);
+
+    // Add and remove devices from the sharded index; must be called under the devicelist mutex
+    void shard_insert_device(std::shared_ptr<kis_tracked_device_base> in_device);
+    void shard_remove_device(std::shared_ptr<kis_tracked_device_base> in_device);
+
+    // Ring of devices modified per tick.  update_common_device records each device the
+    // first time it changes in a tick (one second of server time), so the log holds at
+    // most one entry per device per tick; consumers such as the device monitor keep a
+    // cursor into it instead of comparing the mod time of every device.  Entries from
+    // the current tick are left until the tick completes, so a device which changes
+    // again later in the tick is still seen.
+    struct device_change_entry {
+        time_t tick;
+        device_key key;
+    };
+
+    kis_mutex change_log_mutex;
+    std::vector<device_change_entry> change_log;
+    uint64_t change_log_mask;
+    uint64_t change_log_head;
+
+    // Record a modified device; must be called under the devicelist mutex
+    void log_device_change(std::shared_ptr<kis_tracked_device_base> in_device);
+
+    // Device records serialized for websocket monitors in the current tick, keyed by
+    // the format, field summary, and device, so that monitors asking for the same 
+    // summary share a single serialization of each changed device
+    kis_mutex monitor_cache_mutex;
+    time_t monitor_cache_tick;
+    std::unordered_map<std::string, std::string> monitor_cache;
+
+    std::string serialize_monitored_device(const std::string& format, const std::string& summary_key,
+            std::shared_ptr<kis_tracked_device_base> device, const nlohmann::json& json);
 
     // Immutable vector, one entry per device; may never be sorted.  Devices
     // which are removed are set to 'null'.  Each position corresponds to the
@@ -381,6 +451,9 @@ protected:
     // Do we constrain memory by not tracking RRD data?
     bool ram_no_rrd;
 
+    // Do we allocate devices from the slab and build their fixed fields lazily?
+    bool compact_devices;
+
     // Handle new datasources and create endpoints for them
     void handle_new_datasource_event(std::shared_ptr<eventbus_event> evt);
 
@@ -390,11 +463,44 @@ protected:
     // Insert a device directly into the records
     void add_device(std::shared_ptr<kis_tracked_device_base> device);
 
-    // Load stored username
-    void load_stored_username(std::shared_ptr<kis_tracked_device_base> in_dev);
+    // Stored names and tags are loaded from the database at startup, so that creating a
+    // device never waits on sqlite.  Nearly all new devices have nothing stored, which
+    // the bloom filter answers without touching the map.
+    struct stored_device_info {
+        bool has_username {false};
+        std::string username;
+        std::vector<std::pair<std::string, std::string>> tags;
+    };
+
+    robin_hood::unordered_node_map<device_key, stored_device_info> stored_device_map;
+    bloom_filter stored_device_bloom;
+    kis_shared_mutex stored_device_mutex;
+
+    static uint64_t stored_device_hash(const device_key& key) {
+        return bloom_filter::mix(key.get_spkey() ^ bloom_filter::mix(key.get_dkey()));
+    }
+
+    // Load the device_names and device_tags tables
+    void load_stored_devices();
+
+    // Add a name or tag to the stored map; must hold stored_device_mutex
+    stored_device_info& stored_device_entry(const device_key& key);
+
+    // Apply any stored username and tags to a new device
+    void apply_stored_device(std::shared_ptr<kis_tracked_device_base> in_dev);
+
+    // Names and tags are written to the database by the storage writer thread
+    struct stored_device_write {
+        bool shutdown {false};
+        bool is_username {false};
+        std::string key;
+        std::string tag;
+        std::string content;
+    };
 
-    // Load stored tags
-    void load_stored_tags(std::shared_ptr<kis_tracked_device_base> in_dev);
+    moodycamel::BlockingConcurrentQueue<stored_device_write> storage_write_queue;
+    std::thread storage_write_thread;
+    void storage_writer();
 
     // Cached device type map
     std::map<std::string, std::shared_ptr<tracker_element_string>> device_type_cache;
@@ -441,13 +441,136 @@ void kis_tracked_device_base::inc_seenby_count(kis_datasource *source,
     }
 }
 
+const kis_tracked_device_base::compact_field_ids& kis_tracked_device_base::compact_ids() {
+    static compact_field_ids ids = []() {
+        auto et = Globalreg::globalreg->entrytracker;
+        compact_field_ids r;
+
+        r.key_id = 
+            et->register_field("kismet.device.base.key",
+                    tracker_element_factory<tracker_element_device_key>(),
+                    "unique device key across phy and server");
+        r.macaddr_id =
+            et->register_field("kismet.device.base.macaddr",
+                    tracker_element_factory<tracker_element_mac_addr>(), "mac address");
+        r.basic_type_set_id =
+            et->register_field("kismet.device.base.basic_type_set",
+                    tracker_element_factory<tracker_element_uint64>(), "bitset of basic type");
+        r.basic_crypt_set_id =
+            et->register_field("kismet.device.base.basic_crypt_set",
+                    tracker_element_factory<tracker_element_uint64>(), "bitset of basic encryption");
+        r.first_time_id =
+            et->register_field("kismet.device.base.first_time",
+                    tracker_element_factory<tracker_element_uint64>(), "first time seen time_t");
+        r.last_time_id =
+            et->register_field("kismet.device.base.last_time",
+                    tracker_element_factory<tracker_element_uint64>(), "last time seen time_t");
+        r.mod_time_id =
+            et->register_field("kismet.device.base.mod_time",
+                    tracker_element_factory<tracker_element_uint64>(),
+                    "timestamp of last seen time (local clock)");
+        r.packets_id =
+            et->register_field("kismet.device.base.packets.total",
+                    tracker_element_factory<tracker_element_uint64>(),
+                    "total packets seen of all types");
+        r.llc_packets_id =
+            et->register_field("kismet.device.base.packets.llc",
+                    tracker_element_factory<tracker_element_uint64>(),
+                    "observed protocol control packets");
+        r.error_packets_id =
+            et->register_field("kismet.device.base.packets.error",
+                    tracker_element_factory<tracker_element_uint64>(), "corrupt/error packets");
+        r.data_packets_id =
+            et->register_field("kismet.device.base.packets.data",
+                    tracker_element_factory<tracker_element_uint64>(), "data packets");
+        r.crypt_packets_id =
+            et->register_field("kismet.device.base.packets.crypt",
+                    tracker_element_factory<tracker_element_uint64>(),
+                    "data packets using encryption");
+        r.filter_packets_id =
+            et->register_field("kismet.device.base.packets.filtered",
+                    tracker_element_factory<tracker_element_uint64>(), "packets dropped by filter");
+        r.datasize_id =
+            et->register_field("kismet.device.base.datasize",
+                    tracker_element_factory<tracker_element_uint64>(),
+                    "transmitted data in bytes");
+        r.frequency_id =
+            et->register_field("kismet.device.base.frequency",
+                    tracker_element_factory<tracker_element_double>(), "frequency");
+        r.alert_id =
+            et->register_field("kismet.device.base.num_alerts",
+                    tracker_element_factory<tracker_element_uint32>(),
+                    "number of alerts on this device");
+
+        return r;
+    }();
+
+    return ids;
+}
+
+void kis_tracked_device_base::materialize() {
+    if (compact_materialized.load(std::memory_order_acquire) &&
+            !compact_dirty.load(std::memory_order_relaxed))
+        return;
+
+    // Views and the serializers can reach the same device from several threads at once;
+    // only one of them builds or refreshes the elements
+    std::lock_guard<kis_spinlock> lk(compact_lock);
+
+    const auto& ids = compact_ids();
+
+    if (!compact_materialized.load(std::memory_order_relaxed)) {
+        insert(std::make_shared<tracker_element_device_key>(ids.key_id));
+        insert(std::make_shared<tracker_element_mac_addr>(ids.macaddr_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.basic_type_set_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.basic_crypt_set_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.first_time_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.last_time_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.mod_time_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.packets_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.llc_packets_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.error_packets_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.data_packets_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.crypt_packets_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.filter_packets_id));
+        insert(std::make_shared<tracker_element_uint64>(ids.datasize_id));
+        insert(std::make_shared<tracker_element_double>(ids.frequency_id));
+        insert(std::make_shared<tracker_element_uint32>(ids.alert_id));
+    } else if (!compact_dirty.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // Clear before copying so that a change racing the refresh marks it dirty again
+    compact_dirty.store(false, std::memory_order_relaxed);
+
+    get_sub_as<tracker_element_device_key>(ids.key_id)->set(compact.key);
+    get_sub_as<tracker_element_mac_addr>(ids.macaddr_id)->set(compact.macaddr);
+    get_sub_as<tracker_element_uint64>(ids.basic_type_set_id)->set(compact.basic_type_set);
+    get_sub_as<tracker_element_uint64>(ids.basic_crypt_set_id)->set(compact.basic_crypt_set);
+    get_sub_as<tracker_element_uint64>(ids.first_time_id)->set(compact.first_time);
+    get_sub_as<tracker_element_uint64>(ids.last_time_id)->set(compact.last_time);
+    get_sub_as<tracker_element_uint64>(ids.mod_time_id)->set(compact.mod_time);
+    get_sub_as<tracker_element_uint64>(ids.packets_id)->set(compact.packets);
+    get_sub_as<tracker_element_uint64>(ids.llc_packets_id)->set(compact.llc_packets);
+    get_sub_as<tracker_element_uint64>(ids.error_packets_id)->set(compact.error_packets);
+    get_sub_as<tracker_element_uint64>(ids.data_packets_id)->set(compact.data_packets);
+    get_sub_as<tracker_element_uint64>(ids.crypt_packets_id)->set(compact.crypt_packets);
+    get_sub_as<tracker_element_uint64>(ids.filter_packets_id)->set(compact.filter_packets);
+    get_sub_as<tracker_element_uint64>(ids.datasize_id)->set(compact.datasize);
+    get_sub_as<tracker_element_double>(ids.frequency_id)->set(compact.frequency);
+    get_sub_as<tracker_element_uint32>(ids.alert_id)->set(compact.alert);
+
+    compact_materialized.store(true, std::memory_order_release);
+}
+
 void kis_tracked_device_base::register_fields() {
     tracker_component::register_fields();
     
     phy_id = 0;
 
-    register_field("kismet.device.base.key", "unique device key across phy and server", &key);
-    register_field("kismet.device.base.macaddr", "mac address", &macaddr);
+    // Compact fields are registered once and held inline, not as elements
+    compact_ids();
+
     register_field("kismet.device.base.phyname", "phy name", &phyname);
     register_field("kismet.device.base.name", "printable device name", &devicename);
     username_id = 
@@ -455,21 +578,7 @@ void kis_tracked_device_base::register_fields() {
     register_field("kismet.device.base.commonname", 
             "common name alias of custom or device names", &commonname);
     register_field("kismet.device.base.type", "printable device type", &type_string);
-    register_field("kismet.device.base.basic_type_set", "bitset of basic type", &basic_type_set);
     register_field("kismet.device.base.crypt", "printable encryption type", &crypt_string);
-    register_field("kismet.device.base.basic_crypt_set", 
-            "bitset of basic encryption", &basic_crypt_set);
-    register_field("kismet.device.base.first_time", "first time seen time_t", &first_time);
-    register_field("kismet.device.base.last_time", "last time seen time_t", &last_time);
-    register_field("kismet.device.base.mod_time", 
-            "timestamp of last seen time (local clock)", &mod_time);
-    register_field("kismet.device.base.packets.total", "total packets seen of all types", &packets);
-    register_field("kismet.device.base.packets.llc", "observed protocol control packets", &llc_packets);
-    register_field("kismet.device.base.packets.error", "corrupt/error packets", &error_packets);
-    register_field("kismet.device.base.packets.data", "data packets", &data_packets);
-    register_field("kismet.device.base.packets.crypt", "data packets using encryption", &crypt_packets);
-    register_field("kismet.device.base.packets.filtered", "packets dropped by filter", &filter_packets);
-    register_field("kismet.device.base.datasize", "transmitted data in bytes", &datasize);
     
     packets_rrd_id =
         register_dynamic_field<kis_tracked_rrd<>>("kismet.device.base.packets.rrd", "packet rate rrd");
@@ -481,9 +590,7 @@ void kis_tracked_device_base::register_fields() {
 
     register_field("kismet.device.base.freq_khz_map", "packets seen per frequency (khz)", &freq_khz_map);
     register_field("kismet.device.base.channel", "channel (phy specific)", &channel);
-    register_field("kismet.device.base.frequency", "frequency", &frequency);
     register_field("kismet.device.base.manuf", "manufacturer name", &manuf);
-    register_field("kismet.device.base.num_alerts", "number of alerts on this device", &alert);
     
     tag_map_id =
         register_dynamic_field("kismet.device.base.tags", "set of arbitrary tags, including user notes", &tag_map);
@@ -524,6 +631,45 @@ void kis_tracked_device_base::reserve_fields(std::shared_ptr<tracker_element_map
     seenby_map->set_as_vector(true);
 
     if (e != NULL) {
+        // Pull any compact fields out of the imported record; the elements themselves are
+        // rebuilt by materialize()
+        const auto& ids = compact_ids();
+
+        if (auto v = e->get_sub(ids.key_id))
+            compact.key = get_tracker_value<device_key>(v);
+        if (auto v = e->get_sub(ids.macaddr_id))
+            compact.macaddr = get_tracker_value<mac_addr>(v);
+        if (auto v = e->get_sub(ids.basic_type_set_id))
+            compact.basic_type_set = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.basic_crypt_set_id))
+            compact.basic_crypt_set = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.first_time_id))
+            compact.first_time = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.last_time_id))
+            compact.last_time = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.mod_time_id))
+            compact.mod_time = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.packets_id))
+            compact.packets = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.llc_packets_id))
+            compact.llc_packets = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.error_packets_id))
+            compact.error_packets = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.data_packets_id))
+            compact.data_packets = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.crypt_packets_id))
+            compact.crypt_packets = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.filter_packets_id))
+            compact.filter_packets = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.datasize_id))
+            compact.datasize = get_tracker_value<uint64_t>(v);
+        if (auto v = e->get_sub(ids.frequency_id))
+            compact.frequency = get_tracker_value<double>(v);
+        if (auto v = e->get_sub(ids.alert_id))
+            compact.alert = get_tracker_value<uint32_t>(v);
+
+        compact_dirty.store(true, std::memory_order_relaxed);
+
         // If we're inheriting, it's our responsibility to kick submaps with
         // complex types as well; since they're not themselves complex objects
         for (auto s : *seenby_map) {
@@ -305,6 +305,96 @@ protected:
 #define KIS_DEVICE_BASICCRYPT_WEAKCRYPT	(1 << 4)
 #define KIS_DEVICE_BASICCRYPT_DECRYPTED	(1 << 5)
 
+// Fixed scalar fields of a device.  These are updated on every packet and are the
+// bulk of a device record by count, so they are kept inline in the device instead of
+// as individually allocated tracked elements; see kis_tracked_device_base::materialize()
+struct kis_tracked_device_compact {
+    kis_tracked_device_compact() :
+        basic_type_set{0},
+        basic_crypt_set{0},
+        first_time{0},
+        last_time{0},
+        mod_time{0},
+        packets{0},
+        llc_packets{0},
+        error_packets{0},
+        data_packets{0},
+        crypt_packets{0},
+        filter_packets{0},
+        datasize{0},
+        frequency{0},
+        alert{0} { }
+
+    device_key key;
+    mac_addr macaddr;
+
+    uint64_t basic_type_set;
+    uint64_t basic_crypt_set;
+
+    uint64_t first_time;
+    uint64_t last_time;
+    uint64_t mod_time;
+
+    uint64_t packets;
+    uint64_t llc_packets;
+    uint64_t error_packets;
+    uint64_t data_packets;
+    uint64_t crypt_packets;
+    uint64_t filter_packets;
+
+    uint64_t datasize;
+
+    double frequency;
+
+    uint32_t alert;
+};
+
+// Proxy a field held in the compact device record; the value lives inline and the
+// tracked element is only built (and refreshed) when something needs the element
+#define __ProxyCompact(name, ptype, itype, rtype, cvar) \
+    inline shared_tracker_element get_tracker_##name() { \
+        materialize(); \
+        return get_sub(compact_ids().cvar##_id); \
+    } \
+    inline rtype get_##name() const { \
+        return (rtype) compact.cvar; \
+    } \
+    inline void set_##name(const itype& in) { \
+        compact.cvar = (ptype) in; \
+        compact_dirty.store(true, std::memory_order_relaxed); \
+    }
+
+#define __ProxyCompactIncDec(name, ptype, rtype, cvar) \
+    inline void inc_##name() { \
+        compact.cvar += 1; \
+        compact_dirty.store(true, std::memory_order_relaxed); \
+    } \
+    inline void inc_##name(rtype i) { \
+        compact.cvar += (ptype) i; \
+        compact_dirty.store(true, std::memory_order_relaxed); \
+    } \
+    inline void dec_##name() { \
+        compact.cvar -= 1; \
+        compact_dirty.store(true, std::memory_order_relaxed); \
+    } \
+    inline void dec_##name(rtype i) { \
+        compact.cvar -= (ptype) i; \
+        compact_dirty.store(true, std::memory_order_relaxed); \
+    }
+
+#define __ProxyCompactBitset(name, ptype, cvar) \
+    inline void bitset_##name(ptype bs) { \
+        compact.cvar |= bs; \
+        compact_dirty.store(true, std::memory_order_relaxed); \
+    } \
+    inline void bitclear_##name(ptype bs) { \
+        compact.cvar &= ~(bs); \
+        compact_dirty.store(true, std::memory_order_relaxed); \
+    } \
+    inline ptype bitcheck_##name(ptype bs) { \
+        return (ptype) (compact.cvar & bs); \
+    }
+
 // Base of all device tracking under the new trackerentry system
 class kis_tracked_device_base : public tracker_component {
 public:
@@ -327,9 +417,8 @@ public:
     }
 
     kis_tracked_device_base(const kis_tracked_device_base *p) :
-        tracker_component{p} {
-            __ImportField(key, p);
-            __ImportField(macaddr, p);
+        tracker_component{p},
+        compact{p->compact} {
             __ImportField(phyname, p);
             __ImportField(devicename, p);
 
@@ -337,34 +426,16 @@ public:
 
             __ImportField(commonname, p);
             __ImportField(type_string, p);
-            __ImportField(basic_type_set,p );
             __ImportField(crypt_string, p);
-            __ImportField(basic_crypt_set, p);
-            __ImportField(first_time, p);
-            __ImportField(last_time, p);
-            __ImportField(mod_time, p);
-
-            __ImportField(packets, p);
-            __ImportField(llc_packets, p);
-            __ImportField(error_packets, p);
-            __ImportField(data_packets, p);
-            __ImportField(crypt_packets, p);
-            __ImportField(filter_packets, p);
-
-
-            __ImportField(datasize, p);
 
             __ImportId(packets_rrd_id, p);
             __ImportId(data_rrd_id, p);
 
             __ImportField(channel, p);
-            __ImportField(frequency, p);
-
             __ImportId(signal_data_id, p);
 
             __ImportField(freq_khz_map, p);
             __ImportField(manuf, p);
-            __ImportField(alert, p);
 
             __ImportId(tag_map_id, p);
             __ImportId(tag_entry_id, p);
@@ -401,17 +472,25 @@ public:
         return r;
     }
 
-    __Proxy(key, device_key, device_key, device_key, key);
-    __ProxyL(macaddr, mac_addr, mac_addr, mac_addr, macaddr,
-            [this](mac_addr m) -> bool {
+    __ProxyCompact(key, device_key, device_key, device_key, key);
 
-            // Only set the mac as the common name to the mac if it's empty
-            if (get_commonname() == "")
-                set_commonname(m.mac_to_string());
+    shared_tracker_element get_tracker_macaddr() {
+        materialize();
+        return get_sub(compact_ids().macaddr_id);
+    }
 
-            return true;
-            
-            });
+    mac_addr get_macaddr() const {
+        return compact.macaddr;
+    }
+
+    void set_macaddr(const mac_addr& m) {
+        compact.macaddr = m;
+        compact_dirty.store(true, std::memory_order_relaxed);
+
+        // Only set the mac as the common name to the mac if it's empty
+        if (get_commonname() == "")
+            set_commonname(m.mac_to_string());
+    }
 
     // __Proxy(phyname, std::string, std::string, std::string, phyname);
     __ProxySwappingTrackable(phyname, tracker_element_string, phyname);
@@ -455,8 +534,8 @@ public:
     // __Proxy(type_string, std::string, std::string, std::string, type_string);
     __ProxySwappingTrackable(type_string, tracker_element_string, type_string);
 
-    __Proxy(basic_type_set, uint64_t, uint64_t, uint64_t, basic_type_set);
-    __ProxyBitset(basic_type_set, uint64_t, basic_type_set);
+    __ProxyCompact(basic_type_set, uint64_t, uint64_t, uint64_t, basic_type_set);
+    __ProxyCompactBitset(basic_type_set, uint64_t, basic_type_set);
 
     __ProxyGet(type_string, std::string, std::string, type_string);
 
@@ -494,38 +573,41 @@ public:
 
     __Proxy(crypt_string, std::string, std::string, std::string, crypt_string);
 
-    __Proxy(basic_crypt_set, uint64_t, uint64_t, uint64_t, basic_crypt_set);
-    void add_basic_crypt(uint64_t in) { (*basic_crypt_set) |= in; }
+    __ProxyCompact(basic_crypt_set, uint64_t, uint64_t, uint64_t, basic_crypt_set);
+    void add_basic_crypt(uint64_t in) {
+        compact.basic_crypt_set |= in;
+        compact_dirty.store(true, std::memory_order_relaxed);
+    }
 
-    __Proxy(first_time, uint64_t, time_t, time_t, first_time);
-    __Proxy(last_time, uint64_t, time_t, time_t, last_time);
+    __ProxyCompact(first_time, uint64_t, time_t, time_t, first_time);
+    __ProxyCompact(last_time, uint64_t, time_t, time_t, last_time);
 
     // Simple management of last modified time
-    __Proxy(mod_time, uint64_t, time_t, time_t, mod_time);
+    __ProxyCompact(mod_time, uint64_t, time_t, time_t, mod_time);
     void update_modtime() {
         set_mod_time(Globalreg::globalreg->last_tv_sec);
     }
 
-    __Proxy(packets, uint64_t, uint64_t, uint64_t, packets);
-    __ProxyIncDec(packets, uint64_t, uint64_t, packets);
+    __ProxyCompact(packets, uint64_t, uint64_t, uint64_t, packets);
+    __ProxyCompactIncDec(packets, uint64_t, uint64_t, packets);
 
-    __Proxy(llc_packets, uint64_t, uint64_t, uint64_t, llc_packets);
-    __ProxyIncDec(llc_packets, uint64_t, uint64_t, llc_packets);
+    __ProxyCompact(llc_packets, uint64_t, uint64_t, uint64_t, llc_packets);
+    __ProxyCompactIncDec(llc_packets, uint64_t, uint64_t, llc_packets);
 
-    __Proxy(error_packets, uint64_t, uint64_t, uint64_t, error_packets);
-    __ProxyIncDec(error_packets, uint64_t, uint64_t, error_packets);
+    __ProxyCompact(error_packets, uint64_t, uint64_t, uint64_t, error_packets);
+    __ProxyCompactIncDec(error_packets, uint64_t, uint64_t, error_packets);
 
-    __Proxy(data_packets, uint64_t, uint64_t, uint64_t, data_packets);
-    __ProxyIncDec(data_packets, uint64_t, uint64_t, data_packets);
+    __ProxyCompact(data_packets, uint64_t, uint64_t, uint64_t, data_packets);
+    __ProxyCompactIncDec(data_packets, uint64_t, uint64_t, data_packets);
 
-    __Proxy(crypt_packets, uint64_t, uint64_t, uint64_t, crypt_packets);
-    __ProxyIncDec(crypt_packets, uint64_t, uint64_t, crypt_packets);
+    __ProxyCompact(crypt_packets, uint64_t, uint64_t, uint64_t, crypt_packets);
+    __ProxyCompactIncDec(crypt_packets, uint64_t, uint64_t, crypt_packets);
 
-    __Proxy(filter_packets, uint64_t, uint64_t, uint64_t, filter_packets);
-    __ProxyIncDec(filter_packets, uint64_t, uint64_t, filter_packets);
+    __ProxyCompact(filter_packets, uint64_t, uint64_t, uint64_t, filter_packets);
+    __ProxyCompactIncDec(filter_packets, uint64_t, uint64_t, filter_packets);
 
-    __Proxy(datasize, uint64_t, uint64_t, uint64_t, datasize);
-    __ProxyIncDec(datasize, uint64_t, uint64_t, datasize);
+    __ProxyCompact(datasize, uint64_t, uint64_t, uint64_t, datasize);
+    __ProxyCompactIncDec(datasize, uint64_t, uint64_t, datasize);
 
     typedef kis_tracked_rrd<> rrdt;
     __ProxyFullyDynamicTrackable(packets_rrd, kis_tracked_rrd<>, packets_rrd_id);
@@ -534,12 +616,12 @@ public:
     __ProxyFullyDynamicTrackable(data_rrd, rrdt, data_rrd_id);
 
     __Proxy(channel, std::string, std::string, std::string, channel);
-    __Proxy(frequency, double, double, double, frequency);
+    __ProxyCompact(frequency, double, double, double, frequency);
 
     __ProxyTrackable(manuf, tracker_element_string, manuf);
     __Proxy(manuf, std::string, std::string, std::string, manuf);
 
-    __Proxy(num_alerts, uint32_t, unsigned int, unsigned int, alert);
+    __ProxyCompact(num_alerts, uint32_t, unsigned int, unsigned int, alert);
 
     __ProxyDynamicTrackable(signal_data, kis_tracked_signal_data, signal_data,
             signal_data_id);
@@ -571,24 +653,95 @@ public:
         kis_internal_id = in_id;
     }
 
+    // Non-exported tick this device was last recorded in the device tracker change log
+    time_t get_change_log_tick() {
+        return change_log_tick;
+    }
+
+    void set_change_log_tick(time_t in_tick) {
+        change_log_tick = in_tick;
+    }
+
+    // Non-exported cell and location of this device in the device_spatial_index; the
+    // index is the only writer
+    uint64_t get_spatial_cell() const {
+        return spatial_cell;
+    }
+
+    void set_spatial_cell(uint64_t in_cell) {
+        spatial_cell = in_cell;
+    }
+
+    double get_spatial_lat() const {
+        return spatial_lat;
+    }
+
+    double get_spatial_lon() const {
+        return spatial_lon;
+    }
+
+    void set_spatial_location(double in_lat, double in_lon) {
+        spatial_lat = in_lat;
+        spatial_lon = in_lon;
+    }
+
     // Optional location cloud
     __ProxyFullyDynamicTrackable(location_cloud, kis_location_rrd, location_cloud_id);
 
+    // Build the tracked elements for the compact fields if they don't exist yet, and
+    // bring them up to date if any compact field has changed since the last time.
+    // Called before serialization and path lookups, and by get_tracker_X() on compact
+    // fields.  Callers still hold the devicelist mutex as with any other device access.
+    virtual void materialize() override;
+
+    virtual void pre_serialize() override {
+        materialize();
+        tracker_component::pre_serialize();
+    }
+
 protected:
     virtual void register_fields() override;
     virtual void reserve_fields(std::shared_ptr<tracker_element_map> e) override;
 
+    // Field IDs of the compact fields, shared by all devices
+    struct compact_field_ids {
+        int key_id;
+        int macaddr_id;
+        int basic_type_set_id;
+        int basic_crypt_set_id;
+        int first_time_id;
+        int last_time_id;
+        int mod_time_id;
+        int packets_id;
+        int llc_packets_id;
+        int error_packets_id;
+        int data_packets_id;
+        int crypt_packets_id;
+        int filter_packets_id;
+        int datasize_id;
+        int frequency_id;
+        int alert_id;
+    };
+
+    static const compact_field_ids& compact_ids();
+
+    kis_tracked_device_compact compact;
+
+    // Set by any change to a compact field, cleared when the elements are refreshed
+    std::atomic<bool> compact_dirty {true};
+    std::atomic<bool> compact_materialized {false};
+    kis_spinlock compact_lock;
+
     // Unique, meaningless, incremental ID.  Practically, this is the order
     // in which kismet saw devices; it has no purpose other than a sorting
     // key which will always preserve order - time, etc, will not.  Used for breaking
     // up long-running queries.
     uint64_t kis_internal_id;
 
-    // Unique key
-    std::shared_ptr<tracker_element_device_key> key;
+    time_t change_log_tick {0};
 
-    // Mac address (probably the key, but could be different)
-    std::shared_ptr<tracker_element_mac_addr> macaddr;
+    std::atomic<uint64_t> spatial_cell {0};
+    std::atomic<double> spatial_lat {0}, spatial_lon {0};
 
     // Phy name
     std::shared_ptr<tracker_element_string> phyname;
@@ -609,39 +762,17 @@ protected:
     // This should be empty if the phy layer is unable to add something intelligent
     std::shared_ptr<tracker_element_string> type_string;
 
-    // Basic phy-neutral type for sorting and classification
-    std::shared_ptr<tracker_element_uint64> basic_type_set;
-
     // Printable crypt string, which is set by the phy and is the best printable
     // representation of the phy crypt options.  This should be empty if the phy
     // layer hasn't added something intelligent.
     std::shared_ptr<tracker_element_string> crypt_string;
 
-    // Bitset of basic phy-neutral crypt options
-    std::shared_ptr<tracker_element_uint64> basic_crypt_set;
-
-    // First and last seen
-    std::shared_ptr<tracker_element_uint64> first_time;
-    std::shared_ptr<tracker_element_uint64> last_time;
-    std::shared_ptr<tracker_element_uint64> mod_time;
-
-    // Packet counts
-    std::shared_ptr<tracker_element_uint64> packets;
-    std::shared_ptr<tracker_element_uint64> llc_packets;
-    std::shared_ptr<tracker_element_uint64> error_packets;
-    std::shared_ptr<tracker_element_uint64> data_packets;
-    std::shared_ptr<tracker_element_uint64> crypt_packets;
-    std::shared_ptr<tracker_element_uint64> filter_packets;
-
-    std::shared_ptr<tracker_element_uint64> datasize;
-
     // Packets and data RRDs
     uint16_t packets_rrd_id;
     uint16_t data_rrd_id;
 
 	// Channel and frequency as per PHY type
     std::shared_ptr<tracker_element_string> channel;
-    std::shared_ptr<tracker_element_double> frequency;
 
     // Signal data
     uint16_t signal_data_id;
@@ -654,9 +785,6 @@ protected:
     // from other data (phy-dependent)
     std::shared_ptr<tracker_element_string> manuf;
 
-    // Alerts triggered on this device
-    std::shared_ptr<tracker_element_uint32> alert;
-
     // Stringmap of tags
     std::shared_ptr<tracker_element_string_map> tag_map;
     uint16_t tag_map_id;
@@ -0,0 +1,258 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "devicetracker_spatial.h"
+#include "devicetracker_component.h"
+
+device_spatial_index::device_spatial_index(double cell_deg) :
+    n_devices{0} {
+
+    mutex.set_name("device_spatial_index");
+
+    if (cell_deg <= 0 || cell_deg > 90)
+        cell_deg = 0.01;
+
+    this->cell_deg = cell_deg;
+
+    n_lat_cells = (int64_t) std::ceil(180.0 / cell_deg);
+    n_lon_cells = (int64_t) std::ceil(360.0 / cell_deg);
+}
+
+int64_t device_spatial_index::lat_index(double lat) const {
+    auto idx = (int64_t) std::floor((lat + 90.0) / cell_deg);
+    return std::max((int64_t) 0, std::min(idx, n_lat_cells - 1));
+}
+
+int64_t device_spatial_index::lon_index(double lon) const {
+    auto idx = (int64_t) std::floor((lon + 180.0) / cell_deg);
+    return std::max((int64_t) 0, std::min(idx, n_lon_cells - 1));
+}
+
+void device_spatial_index::update(const std::shared_ptr<kis_tracked_device_base>& device,
+        double lat, double lon) {
+    if (std::isnan(lat) || std::isnan(lon) || lat < -90 || lat > 90 || lon < -180 || lon > 180)
+        return;
+
+    device->set_spatial_location(lat, lon);
+
+    auto key = cell_key(lat_index(lat), lon_index(lon));
+
+    if (device->get_spatial_cell() == key)
+        return;
+
+    kis_lock_guard<kis_shared_mutex> lk(mutex, "device_spatial_index update");
+
+    auto old_key = device->get_spatial_cell();
+
+    if (old_key == key)
+        return;
+
+    if (old_key != 0)
+        erase_from_cell(old_key, device);
+    else
+        n_devices++;
+
+    cells[key].push_back(device);
+    device->set_spatial_cell(key);
+}
+
+void device_spatial_index::remove(const std::shared_ptr<kis_tracked_device_base>& device) {
+    if (device->get_spatial_cell() == 0)
+        return;
+
+    kis_lock_guard<kis_shared_mutex> lk(mutex, "device_spatial_index remove");
+
+    auto old_key = device->get_spatial_cell();
+
+    if (old_key == 0)
+        return;
+
+    erase_from_cell(old_key, device);
+    device->set_spatial_cell(0);
+    n_devices--;
+}
+
+void device_spatial_index::erase_from_cell(uint64_t key,
+        const std::shared_ptr<kis_tracked_device_base>& device) {
+    auto ci = cells.find(key);
+
+    if (ci == cells.end())
+        return;
+
+    auto& vec = ci->second;
+
+    for (size_t i = 0; i < vec.size(); i++) {
+        if (vec[i] == device) {
+            vec[i] = vec.back();
+            vec.pop_back();
+            break;
+        }
+    }
+
+    if (vec.size() == 0)
+        cells.erase(ci);
+}
+
+size_t device_spatial_index::size() {
+    std::shared_lock<kis_shared_mutex> lk(mutex);
+    return n_devices;
+}
+
+template<typename F>
+void device_spatial_index::collect(int64_t lat_min_idx, int64_t lat_max_idx,
+        int64_t lon_min_idx, int64_t lon_max_idx, F filter,
+        std::vector<std::shared_ptr<kis_tracked_device_base>>& ret) {
+
+    auto match_cell = [&](const std::vector<std::shared_ptr<kis_tracked_device_base>>& vec) {
+        for (const auto& d : vec) {
+            if (filter(d->get_spatial_lat(), d->get_spatial_lon()))
+                ret.push_back(d);
+        }
+    };
+
+    auto n_range = (uint64_t) (lat_max_idx - lat_min_idx + 1) *
+        (uint64_t) (lon_max_idx - lon_min_idx + 1);
+
+    // A large box on a sparse map covers far more cells than are occupied; walk the
+    // occupied cells instead
+    if (n_range > cells.size()) {
+        for (const auto& c : cells) {
+            auto lat_idx = (int64_t) (c.first >> 32) - 1;
+            auto lon_idx = (int64_t) (c.first & 0xFFFFFFFF) - 1;
+
+            if (lat_idx < lat_min_idx || lat_idx > lat_max_idx ||
+                    lon_idx < lon_min_idx || lon_idx > lon_max_idx)
+                continue;
+
+            match_cell(c.second);
+        }
+
+        return;
+    }
+
+    for (auto lat_idx = lat_min_idx; lat_idx <= lat_max_idx; lat_idx++) {
+        for (auto lon_idx = lon_min_idx; lon_idx <= lon_max_idx; lon_idx++) {
+            auto ci = cells.find(cell_key(lat_idx, lon_idx));
+
+            if (ci != cells.end())
+                match_cell(ci->second);
+        }
+    }
+}
+
+std::vector<std::shared_ptr<kis_tracked_device_base>>
+device_spatial_index::query_bbox(double min_lat, double min_lon, double max_lat, double max_lon) {
+    auto ret = std::vector<std::shared_ptr<kis_tracked_device_base>>{};
+
+    if (min_lat > max_lat)
+        std::swap(min_lat, max_lat);
+
+    std::shared_lock<kis_shared_mutex> lk(mutex);
+
+    auto lat_min_idx = lat_index(min_lat);
+    auto lat_max_idx = lat_index(max_lat);
+
+    if (min_lon <= max_lon) {
+        collect(lat_min_idx, lat_max_idx, lon_index(min_lon), lon_index(max_lon),
+                [&](double lat, double lon) -> bool {
+                    return lat >= min_lat && lat <= max_lat && lon >= min_lon && lon <= max_lon;
+                }, ret);
+    } else {
+        // Split a box across the antimeridian into the eastern and western halves
+        collect(lat_min_idx, lat_max_idx, lon_index(min_lon), n_lon_cells - 1,
+                [&](double lat, double lon) -> bool {
+                    return lat >= min_lat && lat <= max_lat && lon >= min_lon;
+                }, ret);
+        collect(lat_min_idx, lat_max_idx, 0, lon_index(max_lon),
+                [&](double lat, double lon) -> bool {
+                    return lat >= min_lat && lat <= max_lat && lon <= max_lon;
+                }, ret);
+    }
+
+    return ret;
+}
+
+std::vector<std::shared_ptr<kis_tracked_device_base>>
+device_spatial_index::query_radius(double lat, double lon, double meters) {
+    auto ret = std::vector<std::shared_ptr<kis_tracked_device_base>>{};
+
+    if (meters < 0 || lat < -90 || lat > 90 || lon < -180 || lon > 180)
+        return ret;
+
+    // Slightly under the true length of a degree of latitude, so the box always
+    // contains the circle
+    const double m_per_deg = 111000.0;
+
+    auto radius_filter = [&](double d_lat, double d_lon) -> bool {
+        return haversine_m(lat, lon, d_lat, d_lon) <= meters;
+    };
+
+    // Bounding box of the circle, to limit the cells we visit
+    auto d_lat = meters / m_per_deg;
+    auto min_lat = std::max(-90.0, lat - d_lat);
+    auto max_lat = std::min(90.0, lat + d_lat);
+
+    auto cos_lat = std::cos(std::max(std::fabs(min_lat), std::fabs(max_lat)) * M_PI / 180.0);
+
+    std::shared_lock<kis_shared_mutex> lk(mutex);
+
+    // Circles over a pole, or wide enough that the two sides of a split would share a
+    // cell, cover every longitude
+    if (max_lat >= 90 || min_lat <= -90 || cos_lat <= 0 || d_lat / cos_lat >= 180 - cell_deg) {
+        collect(lat_index(min_lat), lat_index(max_lat), 0, n_lon_cells - 1, radius_filter, ret);
+        return ret;
+    }
+
+    auto d_lon = d_lat / cos_lat;
+    auto min_lon = lon - d_lon;
+    auto max_lon = lon + d_lon;
+
+    if (min_lon < -180) {
+        collect(lat_index(min_lat), lat_index(max_lat), lon_index(min_lon + 360), n_lon_cells - 1,
+                radius_filter, ret);
+        min_lon = -180;
+    } else if (max_lon > 180) {
+        collect(lat_index(min_lat), lat_index(max_lat), 0, lon_index(max_lon - 360),
+                radius_filter, ret);
+        max_lon = 180;
+    }
+
+    collect(lat_index(min_lat), lat_index(max_lat), lon_index(min_lon), lon_index(max_lon),
+            radius_filter, ret);
+
+    return ret;
+}
+
+double device_spatial_index::haversine_m(double lat1, double lon1, double lat2, double lon2) {
+    const double earth_r = 6371008.8;
+    const double rad = M_PI / 180.0;
+
+    auto dlat = (lat2 - lat1) * rad;
+    auto dlon = (lon2 - lon1) * rad;
+
+    auto a = std::sin(dlat / 2) * std::sin(dlat / 2) +
+        std::cos(lat1 * rad) * std::cos(lat2 * rad) * std::sin(dlon / 2) * std::sin(dlon / 2);
+
+    return 2 * earth_r * std::asin(std::min(1.0, std::sqrt(a)));
+}
+
@@ -0,0 +1,92 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __DEVICETRACKER_SPATIAL_H__
+#define __DEVICETRACKER_SPATIAL_H__
+
+#include "config.h"
+
+#include <memory>
+#include <vector>
+
+#include "kis_mutex.h"
+#include "robin_hood.h"
+
+class kis_tracked_device_base;
+
+// Grid index of the last known location of each device, so map views can fetch the
+// devices inside a bounding box or radius without walking every device.
+//
+// The world is divided into cells of a fixed number of degrees; each device lives in
+// the cell of its last location.  A query visits only the cells overlapping the area
+// (or only the occupied cells, if that is fewer), then filters on the exact location.
+//
+// The device records its current cell and coordinates itself, so an update which
+// stays within the same cell - nearly all of them, for fixed devices - takes no lock.
+class device_spatial_index {
+public:
+    device_spatial_index(double cell_deg);
+
+    // Record a new location for a device, moving it between cells if needed
+    void update(const std::shared_ptr<kis_tracked_device_base>& device, double lat, double lon);
+
+    // Drop a device from the index, when it is removed from the device tracker
+    void remove(const std::shared_ptr<kis_tracked_device_base>& device);
+
+    // Devices inside the box, inclusive.  If min_lon is greater than max_lon, the box
+    // crosses the antimeridian.
+    std::vector<std::shared_ptr<kis_tracked_device_base>> query_bbox(double min_lat,
+            double min_lon, double max_lat, double max_lon);
+
+    // Devices within a great circle distance in meters of a point
+    std::vector<std::shared_ptr<kis_tracked_device_base>> query_radius(double lat,
+            double lon, double meters);
+
+    size_t size();
+
+    // Distance in meters between two points on a spherical earth
+    static double haversine_m(double lat1, double lon1, double lat2, double lon2);
+
+protected:
+    kis_shared_mutex mutex;
+
+    double cell_deg;
+    int64_t n_lat_cells, n_lon_cells;
+
+    // Cell key; 0 is reserved for 'not indexed'
+    uint64_t cell_key(int64_t lat_idx, int64_t lon_idx) const {
+        return ((uint64_t) (lat_idx + 1) << 32) | (uint64_t) (lon_idx + 1);
+    }
+
+    int64_t lat_index(double lat) const;
+    int64_t lon_index(double lon) const;
+
+    robin_hood::unordered_map<uint64_t, std::vector<std::shared_ptr<kis_tracked_device_base>>> cells;
+    size_t n_devices;
+
+    // Remove a device from a cell, under lock
+    void erase_from_cell(uint64_t key, const std::shared_ptr<kis_tracked_device_base>& device);
+
+    // Append the devices of a cell range which pass the filter, under shared lock
+    template<typename F>
+    void collect(int64_t lat_min_idx, int64_t lat_max_idx, int64_t lon_min_idx, int64_t lon_max_idx,
+            F filter, std::vector<std::shared_ptr<kis_tracked_device_base>>& ret);
+};
+
+#endif
+
@@ -29,12 +29,16 @@
 
 #include "kis_mutex.h"
 #include "kismet_algorithm.h"
+#include "alphanum.hpp"
+
+#include <limits>
 
 device_tracker_view::device_tracker_view(const std::string& in_id, const std::string& in_description, 
         new_device_cb in_new_cb, updated_device_cb in_update_cb) :
     tracker_component{},
     new_cb {in_new_cb},
-    update_cb {in_update_cb} {
+    update_cb {in_update_cb},
+    sort_change_cursor {std::numeric_limits<uint64_t>::max()} {
 
     devicetracker = Globalreg::fetch_mandatory_global_as<device_tracker>();
 
@@ -54,6 +58,7 @@ device_tracker_view::device_tracker_view(const std::string& in_id, const std::st
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
                     return device_endpoint_handler(con);
                 }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
 
     uri = fmt::format("/devices/views/{}/last-time/:timestamp/devices", in_id);
     httpd->register_route(uri, {"GET", "POST"}, httpd->RO_ROLE, {},
@@ -61,6 +66,23 @@ device_tracker_view::device_tracker_view(const std::string& in_id, const std::st
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
                     return device_time_endpoint(con);
                 }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
+
+    uri = fmt::format("/devices/views/{}/bbox/:min_lat/:min_lon/:max_lat/:max_lon/devices", in_id);
+    httpd->register_route(uri, {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                    return device_bbox_endpoint(con);
+                }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
+
+    uri = fmt::format("/devices/views/{}/radius/:lat/:lon/:meters/devices", in_id);
+    httpd->register_route(uri, {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                    return device_radius_endpoint(con);
+                }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
 }
 
 device_tracker_view::device_tracker_view(const std::string& in_id, const std::string& in_description,
@@ -68,7 +90,8 @@ device_tracker_view::device_tracker_view(const std::string& in_id, const std::st
         new_device_cb in_new_cb, updated_device_cb in_update_cb) :
     tracker_component{},
     new_cb {in_new_cb},
-    update_cb {in_update_cb} {
+    update_cb {in_update_cb},
+    sort_change_cursor {std::numeric_limits<uint64_t>::max()} {
 
     devicetracker = Globalreg::fetch_mandatory_global_as<device_tracker>();
 
@@ -88,6 +111,7 @@ device_tracker_view::device_tracker_view(const std::string& in_id, const std::st
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
                     return device_endpoint_handler(con);
                 }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
 
     uri = fmt::format("/devices/views/{}/last-time/:timestamp/devices", in_id);
     httpd->register_route(uri, {"GET", "POST"}, httpd->RO_ROLE, {},
@@ -95,6 +119,23 @@ device_tracker_view::device_tracker_view(const std::string& in_id, const std::st
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
                     return device_time_endpoint(con);
                 }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
+
+    uri = fmt::format("/devices/views/{}/bbox/:min_lat/:min_lon/:max_lat/:max_lon/devices", in_id);
+    httpd->register_route(uri, {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                    return device_bbox_endpoint(con);
+                }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
+
+    uri = fmt::format("/devices/views/{}/radius/:lat/:lon/:meters/devices", in_id);
+    httpd->register_route(uri, {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                    return device_radius_endpoint(con);
+                }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
 
     uri = fmt::format("/devices/views/{}/monitor", in_id);
     httpd->register_websocket_route(uri, httpd->RO_ROLE, {"ws"},
@@ -243,6 +284,7 @@ device_tracker_view::device_tracker_view(const std::string& in_id, const std::st
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
                     return device_endpoint_handler(con);
                 }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
 
     uri = fmt::format("/devices/views/{}last-time/:timestamp/devices", ss.str());
     httpd->register_route(uri, {"GET", "POST"}, httpd->RO_ROLE, {},
@@ -250,6 +292,23 @@ device_tracker_view::device_tracker_view(const std::string& in_id, const std::st
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
                     return device_time_endpoint(con);
                 }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
+
+    uri = fmt::format("/devices/views/{}bbox/:min_lat/:min_lon/:max_lat/:max_lon/devices", ss.str());
+    httpd->register_route(uri, {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                    return device_bbox_endpoint(con);
+                }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
+
+    uri = fmt::format("/devices/views/{}radius/:lat/:lon/:meters/devices", ss.str());
+    httpd->register_route(uri, {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                    return device_radius_endpoint(con);
+                }, devicetracker->get_devicelist_mutex()));
+    httpd->enable_route_cache(uri);
 }
 
 void device_tracker_view::pre_serialize() {
@@ -375,6 +434,7 @@ void device_tracker_view::new_device(std::shared_ptr<kis_tracked_device_base> de
             if (dpmi == device_presence_map.end()) {
                 device_presence_map[device->get_key()] = true;
                 device_list->push_back(device);
+                mark_sort_dirty(device);
             }
 
             list_sz->set(device_list->size());
@@ -383,13 +443,14 @@ void device_tracker_view::new_device(std::shared_ptr<kis_tracked_device_base> de
 }
 
 void device_tracker_view::update_device(std::shared_ptr<kis_tracked_device_base> device) {
+    // Only called under guard from devicetracker already
+    
+    // Any update may change a sorted column, re-key it before the next sorted request
+    mark_sort_dirty(device);
 
     if (update_cb == nullptr)
         return;
 
-    // Only called under guard from devicetracker already
-    // kis_lock_guard<kis_mutex> lk(devicetracker->get_devicelist_mutex());
-    
     bool retain = update_cb(device);
 
     auto dpmi = device_presence_map.find(device->get_key());
@@ -433,6 +494,8 @@ void device_tracker_view::remove_device(std::shared_ptr<kis_tracked_device_base>
                 break;
             }
         }
+
+        mark_sort_dirty(device);
         
         list_sz->set(device_list->size());
     }
@@ -448,6 +511,7 @@ void device_tracker_view::add_device_direct(std::shared_ptr<kis_tracked_device_b
 
     device_presence_map[device->get_key()] = true;
     device_list->push_back(device);
+    mark_sort_dirty(device);
 
     list_sz->set(device_list->size());
 }
@@ -466,11 +530,219 @@ void device_tracker_view::remove_device_direct(std::shared_ptr<kis_tracked_devic
                 break;
             }
         }
+
+        mark_sort_dirty(device);
         
         list_sz->set(device_list->size());
     }
 }
 
+void device_tracker_view::mark_sort_dirty(std::shared_ptr<kis_tracked_device_base> device) {
+    // Only track changes once something has asked for a sorted index
+    if (sort_indexes.size() == 0)
+        return;
+
+    sort_dirty_set.insert(device->get_key());
+}
+
+void device_tracker_view::make_sort_entry(const std::vector<int>& path, 
+        std::shared_ptr<kis_tracked_device_base> device, sort_entry& entry) {
+    entry.device = device;
+    entry.present = false;
+    entry.is_string = false;
+    entry.num = 0;
+    entry.str.clear();
+
+    auto f = get_tracker_element_path(path, device);
+
+    if (f == nullptr)
+        return;
+
+    switch (f->get_type()) {
+        case tracker_type::tracker_string:
+            entry.present = true;
+            entry.is_string = true;
+            entry.str = static_cast<tracker_element_string *>(f.get())->get();
+            break;
+        case tracker_type::tracker_int8:
+            entry.num = static_cast<tracker_element_int8 *>(f.get())->get();
+            entry.present = true;
+            break;
+        case tracker_type::tracker_uint8:
+            entry.num = static_cast<tracker_element_uint8 *>(f.get())->get();
+            entry.present = true;
+            break;
+        case tracker_type::tracker_int16:
+            entry.num = static_cast<tracker_element_int16 *>(f.get())->get();
+            entry.present = true;
+            break;
+        case tracker_type::tracker_uint16:
+            entry.num = static_cast<tracker_element_uint16 *>(f.get())->get();
+            entry.present = true;
+            break;
+        case tracker_type::tracker_int32:
+            entry.num = static_cast<tracker_element_int32 *>(f.get())->get();
+            entry.present = true;
+            break;
+        case tracker_type::tracker_uint32:
+            entry.num = static_cast<tracker_element_uint32 *>(f.get())->get();
+            entry.present = true;
+            break;
+        case tracker_type::tracker_int64:
+            entry.num = static_cast<tracker_element_int64 *>(f.get())->get();
+            entry.present = true;
+            break;
+        case tracker_type::tracker_uint64:
+            entry.num = static_cast<tracker_element_uint64 *>(f.get())->get();
+            entry.present = true;
+            break;
+        case tracker_type::tracker_float:
+            entry.num = static_cast<tracker_element_float *>(f.get())->get();
+            entry.present = true;
+            break;
+        case tracker_type::tracker_double:
+            entry.num = static_cast<tracker_element_double *>(f.get())->get();
+            entry.present = true;
+            break;
+        default:
+            break;
+    }
+}
+
+bool device_tracker_view::sort_entry_less(const sort_entry& a, const sort_entry& b) {
+    // Missing fields sort before any value, matching the full sort
+    if (a.present != b.present)
+        return b.present;
+
+    if (a.present) {
+        if (a.is_string) {
+            auto c = doj::alphanum_comp(a.str, b.str);
+            if (c != 0)
+                return c < 0;
+        } else if (a.num != b.num) {
+            return a.num < b.num;
+        }
+    }
+
+    // Keep equal values in a fixed order so entries can be merged back in
+    return a.device.get() < b.device.get();
+}
+
+void device_tracker_view::build_sort_index(std::shared_ptr<sort_index> index) {
+    index->entries.clear();
+    index->entries.reserve(device_list->size());
+
+    for (const auto& d : *device_list) {
+        if (d == nullptr)
+            continue;
+
+        index->entries.emplace_back();
+        make_sort_entry(index->path, std::static_pointer_cast<kis_tracked_device_base>(d), 
+                index->entries.back());
+    }
+
+    std::sort(index->entries.begin(), index->entries.end(), sort_entry_less);
+}
+
+std::shared_ptr<device_tracker_view::sort_index> 
+device_tracker_view::fetch_sort_index(const std::vector<int>& path) {
+    // Must be called under the devicelist lock
+
+    if (sort_index_paths.size() == 0) {
+        for (const auto& f : {"kismet.device.base.last_time",
+                "kismet.device.base.signal/kismet.common.signal.last_signal",
+                "kismet.device.base.packets.total",
+                "kismet.device.base.commonname",
+                "kismet.device.base.name",
+                "kismet.device.base.channel"}) {
+            sort_index_paths.push_back(tracker_element_summary(f).resolved_path);
+        }
+    }
+
+    for (const auto& i : sort_indexes) {
+        if (i->path == path)
+            return i;
+    }
+
+    if (std::find(sort_index_paths.begin(), sort_index_paths.end(), path) == sort_index_paths.end())
+        return nullptr;
+
+    if (sort_indexes.size() == 0) {
+        // Start following the change log from here; the index we're about to build
+        // covers everything before it
+        std::vector<device_key> discard;
+        devicetracker->fetch_changed_devices(sort_change_cursor, discard);
+        sort_dirty_set.clear();
+    }
+
+    auto index = std::make_shared<sort_index>();
+    index->path = path;
+    build_sort_index(index);
+
+    sort_indexes.push_back(index);
+
+    return index;
+}
+
+void device_tracker_view::refresh_sort_indexes() {
+    // Must be called under the devicelist lock
+
+    // Devices can change without a view update (such as when per-source views are 
+    // turned off), so also pick up anything the devicetracker has logged as changed
+    // since the last pass.  If we fell too far behind the log, rebuild.
+    auto changed = std::vector<device_key>{};
+
+    if (!devicetracker->fetch_changed_devices(sort_change_cursor, changed)) {
+        for (const auto& i : sort_indexes)
+            build_sort_index(i);
+
+        sort_dirty_set.clear();
+        return;
+    }
+
+    for (const auto& k : changed)
+        sort_dirty_set.insert(k);
+
+    if (sort_dirty_set.size() == 0)
+        return;
+
+    auto dirty_devices = std::vector<std::shared_ptr<kis_tracked_device_base>>{};
+    dirty_devices.reserve(sort_dirty_set.size());
+
+    for (const auto& k : sort_dirty_set) {
+        auto pi = device_presence_map.find(k);
+        if (pi == device_presence_map.end() || pi->second == false)
+            continue;
+
+        auto d = devicetracker->fetch_device(k);
+        if (d != nullptr)
+            dirty_devices.push_back(d);
+    }
+
+    // Pull the stale entries, re-key the changed devices, and merge them back in
+    for (const auto& i : sort_indexes) {
+        auto& entries = i->entries;
+
+        entries.erase(std::remove_if(entries.begin(), entries.end(), 
+                    [this](const sort_entry& e) -> bool {
+                        return sort_dirty_set.find(e.device->get_key()) != sort_dirty_set.end();
+                    }), entries.end());
+
+        auto merge_pos = entries.size();
+
+        for (const auto& d : dirty_devices) {
+            entries.emplace_back();
+            make_sort_entry(i->path, d, entries.back());
+        }
+
+        std::sort(std::next(entries.begin(), merge_pos), entries.end(), sort_entry_less);
+        std::inplace_merge(entries.begin(), std::next(entries.begin(), merge_pos), 
+                entries.end(), sort_entry_less);
+    }
+
+    sort_dirty_set.clear();
+}
+
 std::shared_ptr<tracker_element> 
 device_tracker_view::device_time_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con) {
     auto ret = Globalreg::new_from_pool<tracker_element_vector>();
@@ -516,6 +788,111 @@ device_tracker_view::device_time_endpoint(std::shared_ptr<kis_net_beast_httpd_co
     return next_work_vec;
 }
 
+std::shared_ptr<tracker_element>
+device_tracker_view::device_bbox_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con) {
+    auto min_lat = string_to_n_dfl<double>(con->uri_params()[":min_lat"], 0);
+    auto min_lon = string_to_n_dfl<double>(con->uri_params()[":min_lon"], 0);
+    auto max_lat = string_to_n_dfl<double>(con->uri_params()[":max_lat"], 0);
+    auto max_lon = string_to_n_dfl<double>(con->uri_params()[":max_lon"], 0);
+
+    if (min_lat > max_lat)
+        std::swap(min_lat, max_lat);
+
+    return device_spatial_endpoint(con,
+            [&](device_spatial_index& index) {
+                return index.query_bbox(min_lat, min_lon, max_lat, max_lon);
+            },
+            [&](double lat, double lon) -> bool {
+                if (lat < min_lat || lat > max_lat)
+                    return false;
+
+                // Boxes crossing the antimeridian have min_lon > max_lon
+                if (min_lon <= max_lon)
+                    return lon >= min_lon && lon <= max_lon;
+
+                return lon >= min_lon || lon <= max_lon;
+            });
+}
+
+std::shared_ptr<tracker_element>
+device_tracker_view::device_radius_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con) {
+    auto lat = string_to_n_dfl<double>(con->uri_params()[":lat"], 0);
+    auto lon = string_to_n_dfl<double>(con->uri_params()[":lon"], 0);
+    auto meters = string_to_n_dfl<double>(con->uri_params()[":meters"], 0);
+
+    return device_spatial_endpoint(con,
+            [&](device_spatial_index& index) {
+                return index.query_radius(lat, lon, meters);
+            },
+            [&](double d_lat, double d_lon) -> bool {
+                return device_spatial_index::haversine_m(lat, lon, d_lat, d_lon) <= meters;
+            });
+}
+
+std::shared_ptr<tracker_element>
+device_tracker_view::device_spatial_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con,
+        const std::function<std::vector<std::shared_ptr<kis_tracked_device_base>> (device_spatial_index&)>& query,
+        const std::function<bool (double, double)>& filter) {
+    std::ostream os(&con->response_stream());
+
+    // Regular expression terms, if any
+    auto regex = con->json()["regex"];
+
+    std::shared_ptr<tracker_element_vector> next_work_vec;
+
+    auto index = devicetracker->get_spatial_index();
+
+    if (index != nullptr) {
+        auto candidates = query(*index);
+
+        next_work_vec = std::make_shared<tracker_element_vector>();
+        next_work_vec->reserve(candidates.size());
+
+        kis_lock_guard<kis_mutex> lk(devicetracker->get_devicelist_mutex(), 
+                "device_tracker_view device_spatial_endpoint");
+
+        // The index covers every device; keep the ones in this view
+        for (const auto& d : candidates) {
+            auto pk = device_presence_map.find(d->get_key());
+            if (pk != device_presence_map.end() && pk->second)
+                next_work_vec->push_back(d);
+        }
+    } else {
+        auto worker = 
+            device_tracker_view_function_worker([&](std::shared_ptr<kis_tracked_device_base> dev) -> bool {
+                    auto loc = dev->get_tracker_location();
+
+                    if (loc == nullptr)
+                        return false;
+
+                    auto last_loc = loc->get_last_loc();
+
+                    if (last_loc == nullptr || (last_loc->get_lat() == 0 && last_loc->get_lon() == 0))
+                        return false;
+
+                    return filter(last_loc->get_lat(), last_loc->get_lon());
+                    });
+
+        next_work_vec = do_device_work(worker);
+    }
+
+    // Apply a regex filter
+    if (!regex.is_null()) {
+        try {
+            auto worker = 
+                device_tracker_view_regex_worker(regex);
+            auto r_vec = do_readonly_device_work(worker, next_work_vec);
+            next_work_vec = r_vec;
+        } catch (const std::exception& e) {
+            con->set_status(400);
+            os << "Invalid regex: " << e.what() << "\n";
+            return nullptr;
+        }
+    }
+
+    return next_work_vec;
+}
+
 void device_tracker_view::device_endpoint_handler(std::shared_ptr<kis_net_beast_httpd_connection> con) {
     std::ostream os(&con->response_stream());
 
@@ -681,44 +1058,20 @@ void device_tracker_view::device_endpoint_handler(std::shared_ptr<kis_net_beast_
         return;
     }
 
-    // Next vector we do work on
-    auto next_work_vec = std::make_shared<tracker_element_vector>();
-
-    // Copy the entire vector list, under lock, to the next work vector; this makes it an independent copy
-    // we can sort and manipulate
-    next_work_vec->set(device_list->begin(), device_list->end());
-    total_sz_elem->set(next_work_vec->size());
-
-    // If we have a time filter, apply that first, it's the fastest.
-    if (timestamp_min > 0) {
-        auto worker = 
-            device_tracker_view_function_worker([timestamp_min] (std::shared_ptr<kis_tracked_device_base> dev) -> bool {
-                if (dev->get_last_time() < timestamp_min)
-                    return false;
-                return true;
-            });
+    total_sz_elem->set(device_list->size());
 
-        // Do the work and copy the vector
-        auto ts_vec = do_readonly_device_work(worker, next_work_vec);
-        next_work_vec->set(ts_vec->begin(), ts_vec->end());
-    }
+    // Filters are applied to each device as we walk the list; nothing is copied unless
+    // we have to fall back to sorting
+    std::shared_ptr<device_tracker_view_icasestringmatch_worker> search_worker;
+    std::shared_ptr<device_tracker_view_regex_worker> regex_worker;
 
-    // Apply a string filter
-    if (search_term.length() > 0 && search_paths.size() > 0) {
-        auto worker =
-            device_tracker_view_icasestringmatch_worker(search_term, search_paths);
-        auto s_vec = do_readonly_device_work(worker, next_work_vec);
-        next_work_vec->set(s_vec->begin(), s_vec->end());
-    }
+    if (search_term.length() > 0 && search_paths.size() > 0) 
+        search_worker = 
+            std::make_shared<device_tracker_view_icasestringmatch_worker>(search_term, search_paths);
 
-    // Apply a regex filter
     if (!regex.is_null()) {
         try {
-            auto worker = 
-                device_tracker_view_regex_worker(regex);
-            auto r_vec = do_readonly_device_work(worker, next_work_vec);
-            next_work_vec = r_vec;
-            // next_work_vec->set(r_vec->begin(), r_vec->end());
+            regex_worker = std::make_shared<device_tracker_view_regex_worker>(regex);
         } catch (const std::exception& e) {
             con->set_status(400);
             os << "Invalid regex: " << e.what() << "\n";
@@ -726,60 +1079,145 @@ void device_tracker_view::device_endpoint_handler(std::shared_ptr<kis_net_beast_
         }
     }
 
-    // Apply the filtered length
-    filtered_sz_elem->set(next_work_vec->size());
+    bool filtered = timestamp_min > 0 || search_worker != nullptr || regex_worker != nullptr;
 
-    // Slice from the beginning of the list
-    if (in_window_start >= next_work_vec->size()) 
-        in_window_start = 0;
+    auto match_device = [&](const std::shared_ptr<kis_tracked_device_base>& dev) -> bool {
+        // Time filter first, it's the fastest
+        if (timestamp_min > 0 && dev->get_last_time() < timestamp_min)
+            return false;
 
-    // Update the start
-    start_elem->set(in_window_start);
+        if (search_worker != nullptr && !search_worker->match_device(dev))
+            return false;
+
+        if (regex_worker != nullptr && !regex_worker->match_device(dev))
+            return false;
+
+        return true;
+    };
+
+    // Devices in the requested window
+    auto window_devices = std::vector<std::shared_ptr<kis_tracked_device_base>>{};
+    size_t filtered_sz = 0;
+
+    std::shared_ptr<sort_index> index;
+    if (in_order_column_num.length() && order_field.size() > 0) 
+        index = fetch_sort_index(order_field);
+
+    if (index != nullptr) {
+        refresh_sort_indexes();
+
+        const auto& entries = index->entries;
+        // Same direction handling as the full sort comparator
+        auto entry_at = [&](size_t pos) -> const sort_entry& {
+            if (in_order_direction == 0)
+                return entries[pos];
+            return entries[entries.size() - pos - 1];
+        };
+
+        if (!filtered) {
+            // Slice directly out of the index
+            filtered_sz = entries.size();
+
+            if (in_window_start >= filtered_sz)
+                in_window_start = 0;
+
+            auto end_pos = filtered_sz;
+            if (in_window_len != 0 && in_window_start + in_window_len < filtered_sz)
+                end_pos = in_window_start + in_window_len;
 
-    tracker_element_vector::iterator si = std::next(next_work_vec->begin(), in_window_start);
-    tracker_element_vector::iterator ei;
+            for (auto p = (size_t) in_window_start; p < end_pos; ++p)
+                window_devices.push_back(entry_at(p).device);
+        } else {
+            // Walk the index in order, counting every match but only keeping the window
+            auto walk_index = [&]() {
+                filtered_sz = 0;
+                window_devices.clear();
 
-    if (in_window_len + in_window_start >= next_work_vec->size() || in_window_len == 0)
-        ei = next_work_vec->end();
-    else
-        ei = std::next(next_work_vec->begin(), in_window_start + in_window_len);
+                for (size_t p = 0; p < entries.size(); ++p) {
+                    const auto& e = entry_at(p);
 
-    // Update the end
-    length_elem->set(ei - si);
+                    if (!match_device(e.device))
+                        continue;
 
-    if (in_order_column_num.length() && order_field.size() > 0) {
-        std::stable_sort(
+                    if (filtered_sz >= in_window_start && 
+                            (in_window_len == 0 || filtered_sz < in_window_start + in_window_len))
+                        window_devices.push_back(e.device);
+
+                    filtered_sz++;
+                }
+            };
+
+            walk_index();
+
+            if (in_window_start >= filtered_sz && in_window_start != 0) {
+                in_window_start = 0;
+                walk_index();
+            }
+        }
+    } else {
+        // No index for this column (or no ordering at all); filter into a working copy
+        // and only sort as far as the end of the requested window
+        auto work_vec = std::vector<std::shared_ptr<kis_tracked_device_base>>{};
+        work_vec.reserve(device_list->size());
+
+        for (const auto& d : *device_list) {
+            if (d == nullptr)
+                continue;
+
+            auto dev = std::static_pointer_cast<kis_tracked_device_base>(d);
+
+            if (!filtered || match_device(dev))
+                work_vec.push_back(dev);
+        }
+
+        filtered_sz = work_vec.size();
+
+        if (in_window_start >= filtered_sz)
+            in_window_start = 0;
+
+        auto end_pos = filtered_sz;
+        if (in_window_len != 0 && in_window_start + in_window_len < filtered_sz)
+            end_pos = in_window_start + in_window_len;
+
+        if (in_order_column_num.length() && order_field.size() > 0) {
+            std::partial_sort(
 #if defined(HAVE_CPP17_PARALLEL)
-            std::execution::par_unseq,
+                std::execution::par_unseq,
 #endif
-            next_work_vec->begin(), next_work_vec->end(),
-                [&](shared_tracker_element a, shared_tracker_element b) -> bool {
-                shared_tracker_element fa;
-                shared_tracker_element fb;
+                work_vec.begin(), std::next(work_vec.begin(), end_pos), work_vec.end(),
+                    [&](const std::shared_ptr<kis_tracked_device_base>& a, 
+                        const std::shared_ptr<kis_tracked_device_base>& b) -> bool {
+                    shared_tracker_element fa;
+                    shared_tracker_element fb;
 
-                fa = get_tracker_element_path(order_field, a);
-                fb = get_tracker_element_path(order_field, b);
+                    fa = get_tracker_element_path(order_field, a);
+                    fb = get_tracker_element_path(order_field, b);
 
-                if (fa == nullptr) 
-                    return in_order_direction == 0;
+                    if (fa == nullptr) 
+                        return in_order_direction == 0;
 
-                if (fb == nullptr)
-                    return in_order_direction != 0;
+                    if (fb == nullptr)
+                        return in_order_direction != 0;
 
-                if (in_order_direction == 0)
-                    return fast_sort_tracker_element_less(fa, fb);
+                    if (in_order_direction == 0)
+                        return fast_sort_tracker_element_less(fa, fb);
 
-                return fast_sort_tracker_element_less(fb, fa);
-            });
+                    return fast_sort_tracker_element_less(fb, fa);
+                });
+        }
+
+        window_devices.assign(std::next(work_vec.begin(), in_window_start), 
+                std::next(work_vec.begin(), end_pos));
     }
 
-    // Summarize into the output element
-    auto final_devices_vec = std::make_shared<tracker_element_vector>();
+    // Apply the filtered length and the final window
+    filtered_sz_elem->set(filtered_sz);
+    start_elem->set(in_window_start);
+    length_elem->set(window_devices.size());
 
-    for (auto i = si; i != ei; ++i) {
-        final_devices_vec->push_back(*i);
-        output_devices_elem->push_back(summarize_tracker_element(*i, summary_vec, rename_map));
-    }
+    // Summarize into the output element
+    for (const auto& d : window_devices) 
+        output_devices_elem->push_back(summarize_tracker_element(d, summary_vec, rename_map));
 
     // If the transmit wasn't assigned to a wrapper...
     if (transmit == nullptr)
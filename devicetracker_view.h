@@ -23,12 +23,14 @@
 
 #include <functional>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "uuid.h"
 #include "trackedelement.h"
 #include "trackedcomponent.h"
 #include "devicetracker_component.h"
 #include "devicetracker_view_workers.h"
+#include "devicetracker_spatial.h"
 #include "kis_net_beast_httpd.h"
 
 // Common view holder mechanism which handles view endpoints, view filtering, and so on.
@@ -141,9 +143,58 @@ protected:
     // Map of device presence in our list for fast reference during updates
     std::unordered_map<device_key, bool> device_presence_map;
 
+    // Sorted indexes of the columns most commonly used to order the device list (last
+    // time, signal, packets, name, and channel).  An index is built the first time its
+    // column is used to order a request, and is then kept current by re-keying only the
+    // devices which changed since the previous request, so a page of sorted devices can 
+    // be returned without copying and sorting the entire view.
+    //
+    // Each entry holds a snapshot of the sort value; the snapshot is only refreshed 
+    // under the devicelist lock, so the ordering of the index never changes underneath
+    // a request.
+    struct sort_entry {
+        bool present;
+        bool is_string;
+        double num;
+        std::string str;
+        std::shared_ptr<kis_tracked_device_base> device;
+    };
+
+    struct sort_index {
+        std::vector<int> path;
+        std::vector<sort_entry> entries;
+    };
+
+    // Resolved paths of the columns we maintain indexes for
+    std::vector<std::vector<int>> sort_index_paths;
+    std::vector<std::shared_ptr<sort_index>> sort_indexes;
+
+    // Devices which need to be re-keyed in the indexes before the next request, and our 
+    // position in the devicetracker change log
+    std::unordered_set<device_key> sort_dirty_set;
+    uint64_t sort_change_cursor;
+
+    std::shared_ptr<sort_index> fetch_sort_index(const std::vector<int>& path);
+    void build_sort_index(std::shared_ptr<sort_index> index);
+    void refresh_sort_indexes();
+    void mark_sort_dirty(std::shared_ptr<kis_tracked_device_base> device);
+
+    static void make_sort_entry(const std::vector<int>& path, 
+            std::shared_ptr<kis_tracked_device_base> device, sort_entry& entry);
+    static bool sort_entry_less(const sort_entry& a, const sort_entry& b);
+
     void device_endpoint_handler(std::shared_ptr<kis_net_beast_httpd_connection> con);
     std::shared_ptr<tracker_element> device_time_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con);
 
+    // Devices in this view inside a bounding box or radius, from the devicetracker spatial
+    // index; the query returns candidate devices from the index, and the filter tests
+    // a location directly when the index is disabled
+    std::shared_ptr<tracker_element> device_bbox_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con);
+    std::shared_ptr<tracker_element> device_radius_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con);
+    std::shared_ptr<tracker_element> device_spatial_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con,
+            const std::function<std::vector<std::shared_ptr<kis_tracked_device_base>> (device_spatial_index&)>& query,
+            const std::function<bool (double, double)>& filter);
+
     // device_tracker has direct access to protected methods for new devices and purging devices,
     // nobody else should be calling those
     friend class device_tracker;
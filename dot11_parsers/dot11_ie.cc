@@ -16,6 +16,8 @@
     Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include <stdexcept>
+
 #include "globalregistry.h"
 #include "dot11_ie.h"
 
@@ -31,10 +33,51 @@ void dot11_ie::parse(std::shared_ptr<kaitai::kstream> p_io) {
     }
 }
 
+void dot11_ie::parse(const char *data, size_t len) {
+    // A recycled instance reuses its containers and tag records, unless something
+    // else still holds them
+    if (m_tags == nullptr || m_tags.use_count() > 1)
+        m_tags = Globalreg::new_from_pool<shared_ie_tag_vector>();
+    else
+        m_tags->clear();
+
+    if (m_tags_map == nullptr || m_tags_map.use_count() > 1)
+        m_tags_map = Globalreg::new_from_pool<shared_ie_tag_map>();
+    else
+        m_tags_map->clear();
+
+    size_t pos = 0;
+    size_t spare = 0;
+
+    while (pos < len) {
+        if (len - pos < 2)
+            throw std::runtime_error("truncated IE tag header");
+
+        auto tag_num = (uint8_t) data[pos];
+        auto tag_len = (uint8_t) data[pos + 1];
+
+        if (len - pos - 2 < tag_len)
+            throw std::runtime_error("truncated IE tag");
+
+        if (spare < m_tag_store.size() && m_tag_store[spare].use_count() > 1)
+            m_tag_store[spare] = std::make_shared<dot11_ie_tag>();
+        else if (spare >= m_tag_store.size())
+            m_tag_store.push_back(std::make_shared<dot11_ie_tag>());
+
+        auto t = m_tag_store[spare++];
+        t->set(tag_num, data + pos + 2, tag_len);
+        m_tags->push_back(t);
+        (*m_tags_map)[tag_num] = t;
+
+        pos += 2 + tag_len;
+    }
+}
+
 void dot11_ie::dot11_ie_tag::parse(std::shared_ptr<kaitai::kstream> p_io) {
     m_tag_num = p_io->read_u1();
     m_tag_len = p_io->read_u1();
-    m_tag_data = p_io->read_bytes(tag_len());
-    m_tag_data_stream.reset(new kaitai::kstream(m_tag_data));
+    m_tag_owned = p_io->read_bytes(tag_len());
+    m_tag_view = nonstd::string_view(m_tag_owned);
+    m_tag_data_stream.reset();
 }
 
@@ -21,10 +21,13 @@
 
 /* Parse a dot11 ie stream into individual objects.
  *
- * This uses the kaitai stream buffer from the kaitai runtime as it is a 
- * solid implementation of buffer-bounded operations and data extraction.
+ * Tags can be parsed from a kaitai stream, in which case each tag owns a copy of
+ * its data, or walked in place directly over a buffer (normally the packet data),
+ * in which case the tags only reference it and are valid as long as the buffer is.
  *
- * Much of this is modeled on how kaitai generates parsers.
+ * The kaitai stream for a tag's data, which the typed IE parsers consume, is only
+ * built the first time it is asked for, so tags nothing looks at cost only a
+ * bounds check.
  *
  */
 
@@ -34,6 +37,7 @@
 #include <unordered_map>
 #include <kaitai/kaitaistream.h>
 #include "multi_constexpr.h"
+#include "string_view.hpp"
 
 class dot11_ie {
 public:
@@ -51,6 +55,10 @@ public:
 
     void parse(std::shared_ptr<kaitai::kstream> p_io);
 
+    // Walk the tags in place; throws std::runtime_error on a truncated tag, as the
+    // kaitai parser does
+    void parse(const char *data, size_t len);
+
     std::shared_ptr<shared_ie_tag_vector> tags() const {
         return m_tags;
     }
@@ -60,14 +68,19 @@ public:
     }
 
     void reset() {
-        m_tags->clear();
-        m_tags_map->clear();
+        if (m_tags != nullptr)
+            m_tags->clear();
+        if (m_tags_map != nullptr)
+            m_tags_map->clear();
     }
 
 protected:
     std::shared_ptr<shared_ie_tag_vector> m_tags;
     std::shared_ptr<shared_ie_tag_map> m_tags_map;
 
+    // Tag records kept across reset() for in-place parsing
+    shared_ie_tag_vector m_tag_store;
+
 public:
     class dot11_ie_tag {
     public:
@@ -76,6 +89,15 @@ public:
 
         void parse(std::shared_ptr<kaitai::kstream> p_io);
 
+        // Reference tag data in place
+        void set(uint8_t num, const char *data, uint8_t len) {
+            m_tag_num = num;
+            m_tag_len = len;
+            m_tag_owned.clear();
+            m_tag_view = nonstd::string_view(data, len);
+            m_tag_data_stream.reset();
+        }
+
         constexpr17 uint8_t tag_num() const {
             return m_tag_num;
         }
@@ -85,25 +107,53 @@ public:
         }
 
         std::string tag_data() const {
-            return m_tag_data;
+            return std::string(m_tag_view.data(), m_tag_view.length());
+        }
+
+        const nonstd::string_view& tag_data_view() const {
+            return m_tag_view;
         }
 
         std::shared_ptr<kaitai::kstream> tag_data_stream() const {
+            if (m_tag_data_stream == nullptr)
+                m_tag_data_stream.reset(new kaitai::kstream(tag_data()));
+
             return m_tag_data_stream;
         }
 
+        // Vendor OUI and OUI type of a vendor tag (150, 221) without running the
+        // vendor parser; false if the tag is too short to hold an OUI
+        bool vendor_oui(uint32_t& oui, uint8_t& oui_type) const {
+            if (m_tag_view.length() < 3)
+                return false;
+
+            oui = ((uint32_t) (m_tag_view[0] & 0xFF) << 16) +
+                ((uint32_t) (m_tag_view[1] & 0xFF) << 8) +
+                ((uint32_t) (m_tag_view[2] & 0xFF));
+
+            oui_type = m_tag_view.length() >= 4 ? (uint8_t) m_tag_view[3] : 0;
+
+            return true;
+        }
+
         void reset() {
             m_tag_num = 0;
             m_tag_len = 0;
-            m_tag_data = "";
+            m_tag_owned.clear();
+            m_tag_view = nonstd::string_view();
             m_tag_data_stream.reset();
         }
 
     protected:
         uint8_t m_tag_num;
         uint8_t m_tag_len;
-        std::string m_tag_data;
-        std::shared_ptr<kaitai::kstream> m_tag_data_stream;
+
+        // Copy of the tag data when parsed from a stream; otherwise empty and the
+        // view references the original buffer
+        std::string m_tag_owned;
+        nonstd::string_view m_tag_view;
+
+        mutable std::shared_ptr<kaitai::kstream> m_tag_data_stream;
     };
 
 };
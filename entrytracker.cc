@@ -74,6 +74,13 @@ void entry_tracker::trigger_deferred_startup() {
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
                     return tracked_fields_endp_handler(con);
                 }));
+
+    // Field id dictionary for the binary serializers, in any format
+    httpd->register_route("/system/tracked_fields", {"GET"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection>) {
+                    return field_dictionary();
+                }));
 }
 
 void entry_tracker::trigger_deferred_shutdown() {
@@ -113,6 +120,27 @@ void entry_tracker::tracked_fields_endp_handler(std::shared_ptr<kis_net_beast_ht
 }
 
 
+std::shared_ptr<tracker_element_string_map> entry_tracker::field_dictionary() {
+    kis_lock_guard<kis_mutex> lk(entry_mutex, "entry_tracker field_dictionary");
+
+    auto names = std::make_shared<tracker_element_int_map>();
+
+    for (const auto& i : field_id_map)
+        names->insert(i.first, std::make_shared<tracker_element_string>(i.second->field_name));
+
+    auto ret = std::make_shared<tracker_element_string_map>();
+    ret->insert(std::make_pair("kismet.fields.count",
+                std::make_shared<tracker_element_uint64>(field_id_map.size())));
+    ret->insert(std::make_pair("kismet.fields.names", names));
+
+    return ret;
+}
+
+size_t entry_tracker::get_field_count() {
+    kis_lock_guard<kis_mutex> lk(entry_mutex, "entry_tracker get_field_count");
+    return field_id_map.size();
+}
+
 int entry_tracker::register_field(const std::string& in_name,
         std::shared_ptr<tracker_element> in_builder,
         const std::string& in_desc) {
@@ -88,6 +88,11 @@ public:
                     in_desc));
     }
 
+    // Field id to name dictionary for the binary serializers; ids are never reused, but
+    // fields may be added at any time
+    std::shared_ptr<tracker_element_string_map> field_dictionary();
+    size_t get_field_count();
+
     uint16_t get_field_id(const std::string& in_name);
     std::string get_field_name(uint16_t in_id);
     std::string get_field_description(uint16_t in_id);
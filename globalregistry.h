@@ -272,9 +272,6 @@ public:
     kis_mutex deferred_mutex;
     bool deferred_started;
     std::vector<std::shared_ptr<deferred_startup> > deferred_vec;
-
-    kis_mutex pool_map_mutex;
-    robin_hood::unordered_map<size_t, std::shared_ptr<void>> object_pool_map;
 };
 
 namespace Globalreg {
@@ -336,54 +333,35 @@ namespace Globalreg {
     // has 'reset()' called on it during return, and must implement this
     template<typename T>
     void enable_pool_type(std::function<void (T*)> resetter) {
-        kis_lock_guard<kis_mutex> lk(Globalreg::globalreg->pool_map_mutex, "globalreg enable_pool_type");
-
-        auto p = Globalreg::globalreg->object_pool_map.find(typeid(T).hash_code());
-        if (p != Globalreg::globalreg->object_pool_map.end())
-            return;
-
-        auto pool = std::make_shared<shared_object_pool<T>>();
-        pool->set_max(1024);
-        pool->set_reset(resetter);
-        Globalreg::globalreg->object_pool_map.insert({typeid(T).hash_code(), pool});
+        magazine_object_pool<T>::get().enable(resetter, 1024);
     }
 
     // Grab an object from a pool, with an optional fallback creator for generating it if the pool
     // is not enabled for this type.  By default a uniqueptr is constructed with a generic new
     template<typename T>
     std::shared_ptr<T> new_from_pool(std::function<std::shared_ptr<T> ()> fallback_new = nullptr) {
-        kis_unique_lock<kis_mutex> lk(Globalreg::globalreg->pool_map_mutex, "globalreg new_from_pool");
-
-        auto p = Globalreg::globalreg->object_pool_map.find(typeid(T).hash_code());
-        if (p == Globalreg::globalreg->object_pool_map.end()) {
-            // Unlock before instantiating a new item, in case it in turns needs to touch the pool, 
-            // such as creating complex tracked components
-            lk.unlock();
+        auto& pool = magazine_object_pool<T>::get();
 
+        if (!pool.enabled()) {
             if (fallback_new)
                 return fallback_new();
             return std::make_shared<T>();
         }
 
-        return std::move(std::static_pointer_cast<shared_object_pool<T>>(p->second)->acquire());
+        return pool.acquire();
     }
 
     template<typename T>
         std::shared_ptr<T> new_from_pool(const T* model, std::function<std::shared_ptr<T> (const T*)> fallback_new = nullptr) {
-            kis_unique_lock<kis_mutex> lk(Globalreg::globalreg->pool_map_mutex, "globalreg new_from_pool");
-
-            auto p = Globalreg::globalreg->object_pool_map.find(typeid(T).hash_code());
-            if (p == Globalreg::globalreg->object_pool_map.end()) {
-                // Unlock before instantiating a new item, in case it in turns needs to touch the pool,
-                // such as creating complex tracked components
-                lk.unlock();
+            auto& pool = magazine_object_pool<T>::get();
 
+            if (!pool.enabled()) {
                 if (fallback_new)
                     return fallback_new(model);
                 return std::make_shared<T>(model);
             }
 
-            return std::move(std::static_pointer_cast<shared_object_pool<T>>(p->second)->acquire());
+            return pool.acquire();
         }
 
 }
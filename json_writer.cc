@@ -0,0 +1,513 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <cmath>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "entrytracker.h"
+#include "json_writer.h"
+
+// Hand the buffer to the stream once it gets this large
+static const size_t json_writer_flush_sz = 16384;
+
+json_writer::json_writer(std::ostream& stream,
+        std::shared_ptr<tracker_element_serializer::rename_map> name_map,
+        name_mode mode) :
+    stream{stream},
+    name_map{name_map},
+    mode{mode} {
+    buf.reserve(json_writer_flush_sz * 2);
+}
+
+json_writer::~json_writer() {
+    flush();
+}
+
+void json_writer::flush() {
+    if (buf.size() == 0)
+        return;
+
+    stream.write(buf.data(), buf.size());
+    buf.resize(0);
+}
+
+size_t json_writer::escape_scan(const char *s, size_t len) {
+    size_t i = 0;
+
+    // Quotes, backslashes, and control characters; bytes >= 0x80 are passed through
+    // as-is, same as json_adapter::sanitize_string
+
+#if defined(__AVX2__)
+    const __m256i quote32 = _mm256_set1_epi8('"');
+    const __m256i bslash32 = _mm256_set1_epi8('\\');
+    const __m256i ctrl32 = _mm256_set1_epi8(0x1F);
+
+    for (; i + 32 <= len; i += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+
+        auto m = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, bslash32)),
+                _mm256_cmpeq_epi8(_mm256_max_epu8(v, ctrl32), ctrl32));
+
+        auto mask = (uint32_t) _mm256_movemask_epi8(m);
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i ctrl = _mm_set1_epi8(0x1F);
+
+    for (; i + 16 <= len; i += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+
+        // Unsigned <= 0x1F is max(v, 0x1F) == 0x1F
+        auto m = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+
+        auto mask = (uint32_t) _mm_movemask_epi8(m);
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; i < len; i++) {
+        auto c = static_cast<uint8_t>(s[i]);
+
+        if (c <= 0x1F || c == '"' || c == '\\')
+            return i;
+    }
+
+    return len;
+}
+
+void json_writer::pack_escaped(const char *s, size_t len) {
+    size_t pos = 0;
+
+    while (pos < len) {
+        auto clean = escape_scan(s + pos, len - pos);
+
+        put(s + pos, clean);
+        pos += clean;
+
+        if (pos >= len)
+            break;
+
+        auto c = static_cast<uint8_t>(s[pos]);
+
+        switch (c) {
+            case '"':
+                put("\\\"", 2);
+                break;
+            case '\\':
+                put("\\\\", 2);
+                break;
+            case '\b':
+                put("\\b", 2);
+                break;
+            case '\f':
+                put("\\f", 2);
+                break;
+            case '\n':
+                put("\\n", 2);
+                break;
+            case '\r':
+                put("\\r", 2);
+                break;
+            case '\t':
+                put("\\t", 2);
+                break;
+            default:
+                fmt::format_to(buf, "\\u{:04x}", (int) c);
+                break;
+        }
+
+        pos++;
+    }
+}
+
+void json_writer::pack_double(double d) {
+    // Same as float_numerical_string
+    if (std::isnan(d) || std::isinf(d))
+        put('0');
+    else if (floor(d) == d)
+        fmt::format_to(buf, "{}", (long long) d);
+    else
+        fmt::format_to(buf, "{:f}", d);
+}
+
+void json_writer::pack_field_name(const shared_tracker_element& e, int id) {
+    if (name_map != nullptr) {
+        auto nmi = name_map->find(e);
+
+        if (nmi != name_map->end() && nmi->second->rename.length() != 0) {
+            auto tname = nmi->second->rename;
+
+            if (mode == name_mode::underscored)
+                std::replace(tname.begin(), tname.end(), '.', '_');
+
+            pack_quoted(tname);
+            put(": ", 2);
+            return;
+        }
+    }
+
+    // Placeholders and aliases carry their own names
+    if (e->get_type() == tracker_type::tracker_placeholder_missing ||
+            e->get_type() == tracker_type::tracker_alias) {
+        std::string tname;
+
+        if (e->get_type() == tracker_type::tracker_placeholder_missing)
+            tname = static_cast<tracker_element_placeholder *>(e.get())->get_name();
+        else
+            tname = static_cast<tracker_element_alias *>(e.get())->get_alias_name();
+
+        if (tname.length() != 0) {
+            if (mode == name_mode::underscored)
+                std::replace(tname.begin(), tname.end(), '.', '_');
+
+            pack_quoted(tname);
+            put(": ", 2);
+            return;
+        }
+    }
+
+    if (id < 0)
+        id = 0;
+
+    if ((size_t) id >= name_cache.size())
+        name_cache.resize(id + 1);
+
+    auto& cached = name_cache[id];
+
+    if (cached.length() == 0) {
+        auto tname = Globalreg::globalreg->entrytracker->get_field_name(id);
+
+        if (mode == name_mode::underscored)
+            std::replace(tname.begin(), tname.end(), '.', '_');
+
+        auto start = buf.size();
+        pack_quoted(tname);
+        put(": ", 2);
+        cached = std::string(buf.data() + start, buf.size() - start);
+        return;
+    }
+
+    put(cached.data(), cached.length());
+}
+
+template<typename M, typename KF>
+void json_writer::pack_keyed_map(M *m, KF key_fn) {
+    auto as_vector = m->as_vector();
+    auto as_key_vector = m->as_key_vector();
+
+    put((as_vector || as_key_vector) ? '[' : '{');
+
+    bool prepend_comma = false;
+
+    for (const auto& i : *m) {
+        if (i.second == nullptr && !as_key_vector)
+            continue;
+
+        if (prepend_comma)
+            put(',');
+        prepend_comma = true;
+
+        if (!as_vector) {
+            put('"');
+            key_fn(i.first);
+            put('"');
+
+            if (!as_key_vector)
+                put(": ", 2);
+        }
+
+        if (!as_key_vector)
+            pack(i.second);
+    }
+
+    put((as_vector || as_key_vector) ? ']' : '}');
+}
+
+void json_writer::pack(shared_tracker_element e) {
+    if (e == nullptr)
+        return;
+
+    serializer_scope s(e, name_map);
+
+    // If we're serializing an alias, remap as the aliased element
+    if (e->get_type() == tracker_type::tracker_alias) {
+        e = static_cast<tracker_element_alias *>(e.get())->get();
+
+        if (e == nullptr)
+            return;
+    }
+
+    switch (e->get_type()) {
+        case tracker_type::tracker_string:
+            pack_quoted(static_cast<tracker_element_string *>(e.get())->get());
+            break;
+        case tracker_type::tracker_int8:
+            fmt::format_to(buf, "{}", static_cast<tracker_element_int8 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_uint8:
+            fmt::format_to(buf, "{}", static_cast<tracker_element_uint8 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_int16:
+            fmt::format_to(buf, "{}", static_cast<tracker_element_int16 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_uint16:
+            fmt::format_to(buf, "{}", static_cast<tracker_element_uint16 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_int32:
+            fmt::format_to(buf, "{}", static_cast<tracker_element_int32 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_uint32:
+            fmt::format_to(buf, "{}", static_cast<tracker_element_uint32 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_int64:
+            fmt::format_to(buf, "{}", static_cast<tracker_element_int64 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_uint64:
+            fmt::format_to(buf, "{}", static_cast<tracker_element_uint64 *>(e.get())->get());
+            break;
+        case tracker_type::tracker_float:
+            pack_double(static_cast<tracker_element_float *>(e.get())->get());
+            break;
+        case tracker_type::tracker_double:
+            pack_double(static_cast<tracker_element_double *>(e.get())->get());
+            break;
+        case tracker_type::tracker_vector: {
+            put('[');
+
+            bool prepend_comma = false;
+
+            for (const auto& i : *static_cast<tracker_element_vector *>(e.get())) {
+                if (i == nullptr)
+                    continue;
+
+                if (prepend_comma)
+                    put(',');
+                prepend_comma = true;
+
+                pack(i);
+            }
+
+            put(']');
+            break;
+        }
+        case tracker_type::tracker_vector_double: {
+            put('[');
+
+            bool prepend_comma = false;
+
+            for (auto i : *static_cast<tracker_element_vector_double *>(e.get())) {
+                if (prepend_comma)
+                    put(',');
+                prepend_comma = true;
+
+                pack_double(i);
+            }
+
+            put(']');
+            break;
+        }
+        case tracker_type::tracker_vector_string: {
+            put('[');
+
+            bool prepend_comma = false;
+
+            for (const auto& i : *static_cast<tracker_element_vector_string *>(e.get())) {
+                if (prepend_comma)
+                    put(',');
+                prepend_comma = true;
+
+                pack_quoted(i);
+            }
+
+            put(']');
+            break;
+        }
+        case tracker_type::tracker_map: {
+            auto m = static_cast<tracker_element_map *>(e.get());
+            auto as_vector = m->as_vector();
+            auto as_key_vector = m->as_key_vector();
+
+            put((as_vector || as_key_vector) ? '[' : '{');
+
+            bool prepend_comma = false;
+
+            for (const auto& i : *m) {
+                if (i.second == nullptr)
+                    continue;
+
+                if (prepend_comma)
+                    put(',');
+                prepend_comma = true;
+
+                if (!as_vector)
+                    pack_field_name(i.second, i.first);
+
+                pack(i.second);
+            }
+
+            put((as_vector || as_key_vector) ? ']' : '}');
+            break;
+        }
+        case tracker_type::tracker_int_map:
+            pack_keyed_map(static_cast<tracker_element_int_map *>(e.get()),
+                    [this](int k) { fmt::format_to(buf, "{}", k); });
+            break;
+        case tracker_type::tracker_mac_map:
+            pack_keyed_map(static_cast<tracker_element_mac_map *>(e.get()),
+                    [this](const mac_addr& k) {
+                        auto ks = k.mac_to_string();
+                        put(ks.data(), ks.length());
+                    });
+            break;
+        case tracker_type::tracker_uuid_map:
+            pack_keyed_map(static_cast<tracker_element_uuid_map *>(e.get()),
+                    [this](const uuid& k) {
+                        auto ks = k.uuid_to_string();
+                        put(ks.data(), ks.length());
+                    });
+            break;
+        case tracker_type::tracker_string_map:
+            pack_keyed_map(static_cast<tracker_element_string_map *>(e.get()),
+                    [this](const std::string& k) { pack_escaped(k.data(), k.length()); });
+            break;
+        case tracker_type::tracker_double_map:
+            pack_keyed_map(static_cast<tracker_element_double_map *>(e.get()),
+                    [this](double k) {
+                        if (std::isnan(k) || std::isinf(k))
+                            put('0');
+                        else if (floor(k) == k)
+                            fmt::format_to(buf, "{:.0f}", k);
+                        else
+                            fmt::format_to(buf, "{:f}", k);
+                    });
+            break;
+        case tracker_type::tracker_hashkey_map:
+            pack_keyed_map(static_cast<tracker_element_hashkey_map *>(e.get()),
+                    [this](size_t k) { fmt::format_to(buf, "{}", (long) k); });
+            break;
+        case tracker_type::tracker_double_map_double: {
+            auto m = static_cast<tracker_element_double_map_double *>(e.get());
+            auto as_vector = m->as_vector();
+            auto as_key_vector = m->as_key_vector();
+
+            put((as_vector || as_key_vector) ? '[' : '{');
+
+            bool prepend_comma = false;
+
+            for (const auto& i : *m) {
+                if (prepend_comma)
+                    put(',');
+                prepend_comma = true;
+
+                if (!as_vector) {
+                    put('"');
+
+                    if (std::isnan(i.first) || std::isinf(i.first))
+                        put('0');
+                    else if (floor(i.first) == i.first)
+                        fmt::format_to(buf, "{}", (long) i.first);
+                    else
+                        fmt::format_to(buf, "{:f}", i.first);
+
+                    put('"');
+
+                    if (!as_key_vector)
+                        put(": ", 2);
+                }
+
+                if (!as_key_vector)
+                    pack_double(i.second);
+            }
+
+            put((as_vector || as_key_vector) ? ']' : '}');
+            break;
+        }
+        case tracker_type::tracker_key_map:
+            pack_keyed_map(static_cast<tracker_element_device_key_map *>(e.get()),
+                    [this](const device_key& k) {
+                        auto ks = k.as_string();
+                        put(ks.data(), ks.length());
+                    });
+            break;
+        case tracker_type::tracker_pair_double: {
+            const auto& p = static_cast<tracker_element_pair_double *>(e.get())->get();
+            put('[');
+            pack_double(std::get<0>(p));
+            put(", ", 2);
+            pack_double(std::get<1>(p));
+            put(']');
+            break;
+        }
+        case tracker_type::tracker_summary_mapvec: {
+            put('{');
+
+            bool prepend_comma = false;
+
+            for (const auto& i : *static_cast<tracker_element_mapvec *>(e.get())) {
+                if (i == nullptr)
+                    continue;
+
+                if (prepend_comma)
+                    put(',');
+                prepend_comma = true;
+
+                pack_field_name(i, i->get_id());
+                pack(i);
+            }
+
+            put('}');
+            break;
+        }
+        default:
+            // Remaining scalar types (mac, uuid, key, byte arrays, ipv4, placeholders)
+            if (e->is_stringable()) {
+                auto str = e->as_string();
+
+                if (e->needs_quotes())
+                    pack_quoted(str);
+                else
+                    pack_escaped(str.data(), str.length());
+            }
+            break;
+    }
+
+    if (buf.size() >= json_writer_flush_sz)
+        flush();
+}
@@ -0,0 +1,180 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __JSON_WRITER_H__
+#define __JSON_WRITER_H__
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+#include "fmt.h"
+#include "globalregistry.h"
+#include "trackedelement.h"
+
+// Buffered JSON writer producing the same output as json_adapter::pack (without
+// prettyprinting).
+//
+// json_adapter::pack writes every token through the std::ostream, which for a
+// future_chainbuf means a lock and a copy per token, and builds a sanitized temporary
+// std::string for every string and field name.  The writer instead formats directly
+// into a local buffer which is handed to the stream in large blocks, escapes strings
+// in place with a vectorized scan for the rare characters that need escaping, formats
+// numbers with fmt::format_to into the same buffer, and caches field names for the
+// duration of the serialization.
+class json_writer {
+public:
+    // Field names as registered, or with '.' replaced by '_' for ELK-style output
+    enum class name_mode {
+        kismet, underscored
+    };
+
+    json_writer(std::ostream& stream,
+            std::shared_ptr<tracker_element_serializer::rename_map> name_map,
+            name_mode mode = name_mode::kismet);
+    ~json_writer();
+
+    void pack(shared_tracker_element e);
+
+    void put(char c) {
+        buf.push_back(c);
+    }
+
+    void put(const char *s, size_t len) {
+        buf.append(s, s + len);
+    }
+
+    // Hand everything buffered so far to the stream
+    void flush();
+
+    // Offset of the first byte which needs escaping in a JSON string, or len
+    static size_t escape_scan(const char *s, size_t len);
+
+protected:
+    void pack_escaped(const char *s, size_t len);
+
+    void pack_quoted(const char *s, size_t len) {
+        put('"');
+        pack_escaped(s, len);
+        put('"');
+    }
+
+    void pack_quoted(const std::string& s) {
+        pack_quoted(s.data(), s.length());
+    }
+
+    void pack_double(double d);
+
+    // Write "name": for a field
+    void pack_field_name(const shared_tracker_element& e, int id);
+
+    template<typename M, typename KF>
+    void pack_keyed_map(M *m, KF key_fn);
+
+    std::ostream& stream;
+    std::shared_ptr<tracker_element_serializer::rename_map> name_map;
+    name_mode mode;
+
+    fmt::memory_buffer buf;
+
+    // Quoted, escaped, and permuted field names by field id
+    std::vector<std::string> name_cache;
+};
+
+// Drop-in replacements for the json_adapter, ek_json_adapter, and it_json_adapter
+// serializers
+namespace fast_json_adapter {
+
+class serializer : public tracker_element_serializer {
+public:
+    serializer() :
+        tracker_element_serializer() { }
+
+    virtual int serialize(shared_tracker_element in_elem, std::ostream &stream,
+            std::shared_ptr<rename_map> name_map = nullptr) override {
+        json_writer w(stream, name_map);
+        w.pack(in_elem);
+        return 0;
+    }
+};
+
+}
+
+namespace fast_ek_json_adapter {
+
+class serializer : public tracker_element_serializer {
+public:
+    serializer() :
+        tracker_element_serializer() { }
+
+    virtual int serialize(shared_tracker_element in_elem, std::ostream &stream,
+            std::shared_ptr<rename_map> name_map = nullptr) override {
+        kis_lock_guard<kis_mutex> lk(mutex, "fast ek_json serialize");
+
+        json_writer w(stream, name_map, json_writer::name_mode::underscored);
+
+        if (in_elem->get_type() == tracker_type::tracker_vector) {
+            for (auto i : *(std::static_pointer_cast<tracker_element_vector>(in_elem))) {
+                if (i == nullptr)
+                    continue;
+
+                w.pack(i);
+                w.put('\n');
+            }
+        } else {
+            w.pack(in_elem);
+            w.put('\n');
+        }
+
+        return 0;
+    }
+};
+
+}
+
+namespace fast_it_json_adapter {
+
+class serializer : public tracker_element_serializer {
+public:
+    serializer() :
+        tracker_element_serializer() { }
+
+    virtual int serialize(shared_tracker_element in_elem, std::ostream &stream,
+            std::shared_ptr<rename_map> name_map = nullptr) override {
+        kis_lock_guard<kis_mutex> lk(mutex, "fast it_json serialize");
+
+        json_writer w(stream, name_map);
+
+        if (in_elem->get_type() == tracker_type::tracker_vector) {
+            for (auto i : *(std::static_pointer_cast<tracker_element_vector>(in_elem))) {
+                w.pack(i);
+                w.put('\n');
+            }
+        } else {
+            w.pack(in_elem);
+            w.put('\n');
+        }
+
+        return 1;
+    }
+};
+
+}
+
+#endif
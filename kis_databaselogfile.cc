@@ -18,6 +18,7 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -28,6 +29,7 @@
 #include "messagebus.h"
 #include "packetchain.h"
 #include "sqlite3_cpp11.h"
+#include "xxhash.h"
 
 kis_database_logfile::kis_database_logfile():
     kis_logfile(shared_log_builder(NULL)), 
@@ -37,6 +39,7 @@ kis_database_logfile::kis_database_logfile():
     eventbus = Globalreg::fetch_mandatory_global_as<event_bus>();
 
     transaction_mutex.set_name("kis_database_logfile_transaction");
+    delta_mutex.set_name("kis_database_logfile_delta");
 
     std::shared_ptr<packet_chain> packetchain =
         Globalreg::fetch_mandatory_global_as<packet_chain>("PACKETCHAIN");
@@ -59,6 +62,82 @@ kis_database_logfile::kis_database_logfile():
 
     message_evt_id = 0;
     alert_evt_id = 0;
+
+    transaction_timer = -1;
+    write_stats_timer = -1;
+
+    write_queue_depth = 0;
+    write_queue_max = 0;
+    write_queue_drop = false;
+    write_multi_rows = 1;
+
+    packet_stmt = packet_multi_stmt = nullptr;
+    data_stmt = data_multi_stmt = nullptr;
+    device_stmt = nullptr;
+    device_delta_stmt = device_compact_stmt = nullptr;
+
+    log_device_deltas = false;
+    delta_compact_count = 0;
+    delta_seq = 0;
+
+    commit_pending = false;
+    rows_written = 0;
+    rows_dropped = 0;
+    rows_dropped_last = 0;
+    last_commit_ms = 0;
+
+    auto entrytracker = Globalreg::fetch_mandatory_global_as<entry_tracker>();
+
+    write_queue_depth_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.database.write.queue_depth",
+                tracker_element_factory<tracker_element_uint64>(),
+                "rows waiting for the kismetdb writer");
+    rows_written_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.database.write.rows_written",
+                tracker_element_factory<tracker_element_uint64>(),
+                "rows written by the kismetdb writer");
+    rows_dropped_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.database.write.rows_dropped",
+                tracker_element_factory<tracker_element_uint64>(),
+                "rows dropped because the kismetdb writer queue was full");
+    commit_ms_elem =
+        entrytracker->register_and_get_field_as<tracker_element_double>("kismet.database.write.last_commit_ms",
+                tracker_element_factory<tracker_element_double>(),
+                "time taken by the last kismetdb commit (ms)");
+    write_queue_rrd =
+        entrytracker->register_and_get_field_as<kis_tracked_rrd<kis_tracked_rrd_extreme_aggregator>>("kismet.database.write.queue_rrd",
+                tracker_element_factory<kis_tracked_rrd<kis_tracked_rrd_extreme_aggregator>>(),
+                "kismetdb writer queue depth rrd");
+    commit_latency_rrd =
+        entrytracker->register_and_get_field_as<kis_tracked_rrd<kis_tracked_rrd_extreme_aggregator>>("kismet.database.write.commit_ms_rrd",
+                tracker_element_factory<kis_tracked_rrd<kis_tracked_rrd_extreme_aggregator>>(),
+                "kismetdb commit latency rrd (ms)");
+    rows_dropped_rrd =
+        entrytracker->register_and_get_field_as<kis_tracked_rrd<>>("kismet.database.write.rows_dropped_rrd",
+                tracker_element_factory<kis_tracked_rrd<>>(),
+                "kismetdb dropped rows rrd");
+
+    delta_set_id =
+        entrytracker->register_field("kismet.device.delta.set",
+                tracker_element_factory<tracker_element_map>(),
+                "device fields replaced by a kismetdb device delta");
+    delta_merge_id =
+        entrytracker->register_field("kismet.device.delta.merge",
+                tracker_element_factory<tracker_element_map>(),
+                "nested device fields replaced by a kismetdb device delta");
+    delta_remove_id =
+        entrytracker->register_field("kismet.device.delta.remove",
+                tracker_element_factory<tracker_element_vector_string>(),
+                "device fields removed by a kismetdb device delta");
+
+    write_stats_map = std::make_shared<tracker_element_map>();
+    write_stats_map->insert(write_queue_depth_elem);
+    write_stats_map->insert(rows_written_elem);
+    write_stats_map->insert(rows_dropped_elem);
+    write_stats_map->insert(commit_ms_elem);
+    write_stats_map->insert(write_queue_rrd);
+    write_stats_map->insert(commit_latency_rrd);
+    write_stats_map->insert(rows_dropped_rrd);
 }
 
 kis_database_logfile::~kis_database_logfile() {
@@ -104,18 +183,69 @@ bool kis_database_logfile::open_log(std::string in_path) {
     // Go into transactional mode where we only commit every 10 seconds
     sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
 
+    // Packets, data, and devices are written by the writer thread; the queue is bounded
+    // and either blocks or drops rows when the disk can't keep up
+    write_queue_max =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("kis_log_write_queue", 16384);
+    if (write_queue_max == 0)
+        write_queue_max = 1;
+
+    auto write_policy = 
+        Globalreg::globalreg->kismet_config->fetch_opt_dfl("kis_log_write_policy", "block");
+
+    if (write_policy == "drop") {
+        write_queue_drop = true;
+    } else if (write_policy == "block") {
+        write_queue_drop = false;
+    } else {
+        _MSG_ERROR("Couldn't parse 'kis_log_write_policy', expected 'block' or 'drop', "
+                "defaulting to 'block'.");
+        write_queue_drop = false;
+    }
+
+    // sqlite limits a statement to 999 variables on older builds; the packet table has 
+    // the most columns
+    write_multi_rows =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("kis_log_write_rows", 16);
+    if (write_multi_rows < 1)
+        write_multi_rows = 1;
+    if (write_multi_rows > 40)
+        write_multi_rows = 40;
+
+    if (!db_prepare_writer()) {
+        _MSG_FATAL("Unable to prepare KismetDB log statements for {}", in_path);
+        Globalreg::globalreg->fatal_condition = true;
+        db_finalize_writer();
+        return false;
+    }
+
+    write_thread = std::thread([this]() {
+            thread_set_process_name("kismetdb writer");
+            db_writer();
+        });
+
+    // The writer commits between batches so a commit never interleaves with a
+    // multi-row insert
     transaction_timer = 
         timetracker->register_timer(SERVER_TIMESLICES_SEC * 10, NULL, 1,
             [this](int) -> int {
+            commit_pending = true;
+            return 1;
+        });
 
-            // local_locker dblock(&ds_mutex, "kismetdb transaction_timer");
-
-            in_transaction_sync = true;
+    write_stats_timer =
+        timetracker->register_timer(std::chrono::seconds(1), true,
+            [this](int) -> int {
+            uint64_t dropped = rows_dropped;
 
-            sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
-            sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+            write_queue_depth_elem->set(write_queue_depth);
+            rows_written_elem->set(rows_written);
+            rows_dropped_elem->set(dropped);
+            commit_ms_elem->set(last_commit_ms);
 
-            in_transaction_sync = false;
+            write_queue_rrd->add_sample(write_queue_depth, Globalreg::globalreg->last_tv_sec);
+            rows_dropped_rrd->add_sample(dropped - rows_dropped_last, Globalreg::globalreg->last_tv_sec);
+            rows_dropped_last = dropped;
 
             return 1;
         });
@@ -163,9 +293,25 @@ bool kis_database_logfile::open_log(std::string in_path) {
             timetracker->register_timer(SERVER_TIMESLICES_SEC * 60, NULL, 1,
                     [this](int) -> int {
 
+                    auto dev_time = time(0) - device_timeout;
+
+                    // The last time in the base record is only updated when the deltas
+                    // are compacted, so devices with newer deltas are kept
+                    if (log_device_deltas) {
+                        auto dev_delete = 
+                            fmt::format("DELETE FROM devices WHERE last_time < {} AND devkey NOT IN "
+                                    "(SELECT devkey FROM device_deltas WHERE last_time >= {})",
+                                    dev_time, dev_time);
+
+                        sqlite3_exec(db, dev_delete.c_str(), NULL, NULL, NULL);
+                        sqlite3_exec(db, "DELETE FROM device_deltas WHERE devkey NOT IN "
+                                "(SELECT devkey FROM devices)", NULL, NULL, NULL);
+
+                        return 1;
+                    }
+
                     auto pkt_delete = 
-                        fmt::format("DELETE FROM devices WHERE last_time < {}",
-                                time(0) - device_timeout);
+                        fmt::format("DELETE FROM devices WHERE last_time < {}", dev_time);
 
                     sqlite3_exec(db, pkt_delete.c_str(), NULL, NULL, NULL);
 
@@ -224,7 +370,7 @@ bool kis_database_logfile::open_log(std::string in_path) {
                     [this](int) -> int {
 
                     auto pkt_delete = 
-                        fmt::format("DELETE FROM snapshots WHERE ts_sec < {}",
+                        fmt::format("DELETE FROM snapshots WHERE ts_sec < {} AND snaptype != 'FIELDS'",
                                 time(0) - snapshot_timeout);
 
                     sqlite3_exec(db, pkt_delete.c_str(), NULL, NULL, NULL);
@@ -238,6 +384,25 @@ bool kis_database_logfile::open_log(std::string in_path) {
     log_duplicate_packets =
         Globalreg::globalreg->kismet_config->fetch_opt_bool("kis_log_duplicate_packets", true);
 
+    device_format =
+        Globalreg::globalreg->kismet_config->fetch_opt_dfl("kis_log_device_format", "json");
+
+    if (device_format != "json" && device_format != "cbor" && device_format != "msgpack") {
+        _MSG_ERROR("Unknown kis_log_device_format '{}', expected json, cbor, or msgpack; "
+                "logging devices as json.", device_format);
+        device_format = "json";
+    }
+
+    fields_logged = 0;
+
+    log_device_deltas =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("kis_log_device_deltas", false);
+    delta_compact_count =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("kis_log_device_delta_compact", 30);
+
+    delta_states.clear();
+    delta_seq = 0;
+
     log_data_packets =
         Globalreg::globalreg->kismet_config->fetch_opt_bool("kis_log_data_packets", true);
 
@@ -249,6 +414,9 @@ bool kis_database_logfile::open_log(std::string in_path) {
                     return packet_drop_endpoint_handler(con);
                 }));
 
+    httpd->register_route("/logging/kismetdb/write_stats", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(write_stats_map));
+
     httpd->register_route("/poi/create_poi", {"POST"}, httpd->LOGON_ROLE, {"cmd"},
             std::make_shared<kis_net_web_function_endpoint>(
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
@@ -430,6 +598,7 @@ void kis_database_logfile::close_log() {
 
     if (timetracker != NULL) {
         timetracker->remove_timer(transaction_timer);
+        timetracker->remove_timer(write_stats_timer);
         timetracker->remove_timer(packet_timeout_timer);
         timetracker->remove_timer(alert_timeout_timer);
         timetracker->remove_timer(device_timeout_timer);
@@ -451,6 +620,19 @@ void kis_database_logfile::close_log() {
     set_int_log_open(false);
     db_enabled = false;
 
+    // Release anyone blocked on the queue, then let the writer flush what has already
+    // been queued
+    write_backpressure_cv.notify_all();
+
+    if (write_thread.joinable()) {
+        db_write_row shutdown_row;
+        shutdown_row.type = db_row_type::shutdown;
+        write_queue.enqueue(std::move(shutdown_row));
+        write_thread.join();
+    }
+
+    db_finalize_writer();
+
     // End the transaction
     sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
 
@@ -693,6 +875,36 @@ int kis_database_logfile::database_upgrade_db() {
         return -1;
     }
 
+    sql =
+        "CREATE TABLE device_deltas ("
+
+        "seq INT, " // Order deltas are applied in
+        "last_time INT, " // Device last time as of this delta
+
+        "devkey TEXT, " // Device key
+
+        "phyname TEXT, " // Phy records
+        "devmac TEXT, "
+
+        "delta BLOB " // Changed fields, in the device format
+        ")";
+
+    r = sqlite3_exec(db, sql.c_str(),
+            [] (void *, int, char **, char **) -> int { return 0; }, NULL, &sErrMsg);
+
+    if (r == SQLITE_OK) {
+        sql = "CREATE INDEX device_deltas_devkey ON device_deltas (devkey, seq)";
+        r = sqlite3_exec(db, sql.c_str(),
+                [] (void *, int, char **, char **) -> int { return 0; }, NULL, &sErrMsg);
+    }
+
+    if (r != SQLITE_OK) {
+        _MSG("Kismet log was unable to create device_deltas table in " + ds_dbfile + ": " +
+                std::string(sErrMsg), MSGFLAG_ERROR);
+        close_log();
+        return -1;
+    }
+
     database_set_db_version(KISMETDB_LOG_VERSION);
 
     return 1;
@@ -775,143 +987,293 @@ int kis_database_logfile::log_device(std::shared_ptr<kis_tracked_device_base> d)
     if (!db_enabled)
         return 0;
 
-    std::string sql;
-
-    std::string phystring;
-    std::string macstring;
-    std::string typestring;
-    std::string keystring;
-
     if (d == nullptr)
         return 0;
 
     if (device_mac_filter->filter(d->get_macaddr(), d->get_phyid()))
         return 0;
 
-    phystring = d->get_phyname();
-    macstring = d->get_macaddr().mac_to_string();
-    typestring = d->get_type_string();
-    keystring = d->get_key().as_string();
+    db_write_row row;
+
+    row.type = db_row_type::device;
+
+    // The device is only stable while the caller holds it, so everything is captured 
+    // now and the writer only has to bind it
+    row.first_time = d->get_first_time();
+    row.last_time = d->get_last_time();
+    row.devkey = d->get_key().as_string();
+    row.phyname = d->get_phyname();
+    row.devmac = d->get_macaddr().mac_to_string();
+    row.strongest_signal = d->get_signal_data()->get_max_signal();
+
+    row.has_location = d->has_location() && (d->get_location()->has_min_loc() &&
+            d->get_location()->has_max_loc() &&
+            d->get_location()->has_avg_loc());
+
+    if (row.has_location) {
+        row.min_lat = d->get_location()->get_min_loc()->get_lat();
+        row.min_lon = d->get_location()->get_min_loc()->get_lon();
+        row.max_lat = d->get_location()->get_max_loc()->get_lat();
+        row.max_lon = d->get_location()->get_max_loc()->get_lon();
+        row.avg_lat = d->get_location()->get_avg_loc()->get_lat();
+        row.avg_lon = d->get_location()->get_avg_loc()->get_lon();
+    }
+
+    row.bytes_data = d->get_datasize();
+    row.device_type = d->get_type_string();
 
-    int spos = 1;
+    if (device_format != "json")
+        log_field_dictionary();
+
+    if (log_device_deltas)
+        return log_device_delta(d, std::move(row));
 
     std::stringstream sstr;
 
     // We don't have to lock because we're called by a device worker, which locks
+    int r = Globalreg::globalreg->entrytracker->serialize(device_format, sstr, d, nullptr);
 
-#if 0
-    {
-        kis_lock_guard<kis_mutex> lg_dl(devicetracker->get_devicelist_mutex(), "database_logfile::log_device");
-        int r = Globalreg::globalreg->entrytracker->serialize("json", sstr, d, nullptr);
-
-        if (r < 0) {
-            _MSG_ERROR("Failure serializing device key {} to the kisdatabaselog", d->get_key());
-            return 0;
-        }
+    if (r < 0) {
+        _MSG_ERROR("Failure serializing device key {} to the kisdatabaselog", d->get_key());
+        return 0;
     }
-#endif
 
-    int r = Globalreg::globalreg->entrytracker->serialize("json", sstr, d, nullptr);
+    row.json = sstr.str();
 
-    if (r < 0) {
+    if (!queue_write_row(std::move(row)))
+        return 0;
+
+    return 1;
+}
+
+int kis_database_logfile::log_device_delta(std::shared_ptr<kis_tracked_device_base> d,
+        db_write_row&& row) {
+    auto entrytracker = Globalreg::globalreg->entrytracker;
+
+    struct delta_field {
+        uint32_t path;
+        uint64_t hash;
+        shared_tracker_element elem;
+    };
+
+    std::vector<delta_field> fields;
+    std::stringstream sstr;
+    size_t base_bytes = 0;
+
+    // Fields built at serialization time have to stay in place until the delta has been
+    // serialized, so the device and nested maps stay in scope for the whole function
+    serializer_scope scope(d, nullptr);
+    std::vector<std::unique_ptr<serializer_scope>> nested_scopes;
+
+    auto serialize_failed = [&d]() -> int {
         _MSG_ERROR("Failure serializing device key {} to the kisdatabaselog", d->get_key());
         return 0;
-    }
+    };
 
-    std::string streamstring = sstr.str();
+    auto hash_field = [&](uint32_t path, const shared_tracker_element& e) -> bool {
+        sstr.str("");
 
-    sqlite3_stmt *device_stmt;
-    const char *device_pz;
+        if (entrytracker->serialize(device_format, sstr, e, nullptr) < 0)
+            return false;
 
-    sql =
-        "INSERT INTO devices "
-        "(first_time, last_time, devkey, phyname, devmac, strongest_signal, "
-        "min_lat, min_lon, max_lat, max_lon, "
-        "avg_lat, avg_lon, "
-        "bytes_data, type, device) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+        auto s = sstr.str();
+        base_bytes += s.length();
+        fields.push_back(delta_field{path, XXH64(s.data(), s.length(), 0), e});
 
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &device_stmt, &device_pz);
+        return true;
+    };
 
-    if (r != SQLITE_OK) {
-        _MSG("kis_database_logfile unable to prepare database insert for devices in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
-    }
+    for (const auto& f : *d) {
+        if (f.second == nullptr)
+            continue;
 
-    sqlite3_bind_int64(device_stmt, spos++, d->get_first_time());
-    sqlite3_bind_int64(device_stmt, spos++, d->get_last_time());
-    sqlite3_bind_text(device_stmt, spos++, keystring.c_str(), 
-            keystring.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(device_stmt, spos++, phystring.c_str(), 
-            phystring.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(device_stmt, spos++, macstring.c_str(), 
-            macstring.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_int(device_stmt, spos++, d->get_signal_data()->get_max_signal());
-
-    if (d->has_location() && (d->get_location()->has_min_loc() &&
-                              d->get_location()->has_max_loc() &&
-                              d->get_location()->has_avg_loc())) {
-        sqlite3_bind_double(device_stmt, spos++, 
-                            d->get_location()->get_min_loc()->get_lat());
-        sqlite3_bind_double(device_stmt, spos++,
-                            d->get_location()->get_min_loc()->get_lon());
-        sqlite3_bind_double(device_stmt, spos++,
-                            d->get_location()->get_max_loc()->get_lat());
-        sqlite3_bind_double(device_stmt, spos++,
-                            d->get_location()->get_max_loc()->get_lon());
-        sqlite3_bind_double(device_stmt, spos++,
-                            d->get_location()->get_avg_loc()->get_lat());
-        sqlite3_bind_double(device_stmt, spos++,
-                            d->get_location()->get_avg_loc()->get_lon());
-    } else {
-        // Empty location
-        sqlite3_bind_double(device_stmt, spos++, 0);
-        sqlite3_bind_double(device_stmt, spos++, 0);
-        sqlite3_bind_double(device_stmt, spos++, 0);
-        sqlite3_bind_double(device_stmt, spos++, 0);
-        sqlite3_bind_double(device_stmt, spos++, 0);
-        sqlite3_bind_double(device_stmt, spos++, 0);
+        uint32_t top = static_cast<uint32_t>(f.first) << 16;
+
+        if (f.second->get_type() == tracker_type::tracker_map) {
+            auto m = std::static_pointer_cast<tracker_element_map>(f.second);
+
+            if (!m->as_vector() && !m->as_key_vector()) {
+                nested_scopes.push_back(std::make_unique<serializer_scope>(m, nullptr));
+
+                // The map itself gets a fixed hash, so that it is replaced as a whole when
+                // it first appears or when a field changes between a map and a value
+                fields.push_back(delta_field{top, 1, m});
+
+                for (const auto& sf : *m) {
+                    if (sf.second == nullptr)
+                        continue;
+
+                    if (!hash_field(top | (static_cast<uint32_t>(sf.first) + 1), sf.second))
+                        return serialize_failed();
+                }
+
+                continue;
+            }
+        }
+
+        if (!hash_field(top, f.second))
+            return serialize_failed();
     }
 
-    sqlite3_bind_int64(device_stmt, spos++, d->get_datasize());
-    sqlite3_bind_text(device_stmt, spos++, typestring.c_str(), 
-            typestring.length(), SQLITE_TRANSIENT);
+    std::sort(fields.begin(), fields.end(), 
+            [](const delta_field& a, const delta_field& b) { return a.path < b.path; });
 
-    sqlite3_bind_blob(device_stmt, spos++, streamstring.c_str(), 
-            streamstring.length(), SQLITE_TRANSIENT);
+    {
+        kis_unique_lock<kis_mutex> lk(delta_mutex, "kismetdb log_device_delta");
+
+        auto& state = delta_states[d->get_key()];
+
+        // The base record may have been removed by the device timeout
+        bool base = state.hashes.size() == 0 || 
+            state.n_deltas >= delta_compact_count ||
+            state.delta_bytes >= state.base_bytes ||
+            (device_timeout != 0 && state.last_time < time(0) - (time_t) device_timeout);
+
+        auto set = std::make_shared<tracker_element_map>(delta_set_id);
+        auto merge = std::make_shared<tracker_element_map>(delta_merge_id);
+        auto remove = std::make_shared<tracker_element_vector_string>(delta_remove_id);
+
+        if (!base) {
+            const auto& old_hashes = state.hashes;
+            size_t o = 0, n = 0;
+
+            // Fields under a top-level field which has been replaced or removed as a
+            // whole; nested paths always sort after their parent
+            uint32_t skip_top = 0xFFFFFFFF;
+
+            while (o < old_hashes.size() || n < fields.size()) {
+                if (n >= fields.size() || 
+                        (o < old_hashes.size() && old_hashes[o].first < fields[n].path)) {
+                    auto path = old_hashes[o++].first;
+                    auto top = path & 0xFFFF0000;
+
+                    if (top == skip_top)
+                        continue;
+
+                    if (path == top) {
+                        remove->push_back(entrytracker->get_field_name(path >> 16));
+                        skip_top = top;
+                    } else {
+                        remove->push_back(fmt::format("{}/{}", 
+                                    entrytracker->get_field_name(path >> 16),
+                                    entrytracker->get_field_name((path & 0xFFFF) - 1)));
+                    }
+
+                    continue;
+                }
+
+                const auto& f = fields[n++];
+                auto top = f.path & 0xFFFF0000;
+
+                if (o < old_hashes.size() && old_hashes[o].first == f.path) {
+                    if (old_hashes[o++].second == f.hash)
+                        continue;
+                }
+
+                if (top == skip_top)
+                    continue;
+
+                if (f.path == top) {
+                    set->insert(f.elem);
+                    skip_top = top;
+                    continue;
+                }
+
+                auto nested = merge->get_sub_as<tracker_element_map>(top >> 16);
+
+                if (nested == nullptr) {
+                    nested = std::make_shared<tracker_element_map>(top >> 16);
+                    merge->insert(nested);
+                }
+
+                nested->insert(f.elem);
+            }
+
+            // Nothing we log has changed
+            if (set->size() == 0 && merge->size() == 0 && remove->size() == 0)
+                return 1;
+        }
 
-#if 0
-    kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb log_device");
-    db_lock_with_sync_check(dblock, return);
-#endif
+        state.hashes.clear();
+        state.hashes.reserve(fields.size());
 
-    if (sqlite3_step(device_stmt) != SQLITE_DONE) {
-        _MSG("kis_database_logfile unable to insert device in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
+        for (const auto& f : fields)
+            state.hashes.push_back(std::make_pair(f.path, f.hash));
+
+        state.last_time = row.last_time;
+        row.seq = ++delta_seq;
+
+        if (base) {
+            state.n_deltas = 0;
+            state.delta_bytes = 0;
+            state.base_bytes = base_bytes;
+        } else {
+            auto delta = std::make_shared<tracker_element_map>();
+
+            if (set->size())
+                delta->insert(set);
+            if (merge->size())
+                delta->insert(merge);
+            if (remove->size())
+                delta->insert(remove);
+
+            lk.unlock();
+
+            sstr.str("");
+
+            if (entrytracker->serialize(device_format, sstr, delta, nullptr) < 0)
+                return serialize_failed();
+
+            row.type = db_row_type::device_delta;
+            row.json = sstr.str();
+
+            lk.lock();
+            state.n_deltas++;
+            state.delta_bytes += row.json.length();
+            lk.unlock();
+
+            if (!queue_write_row(std::move(row)))
+                return 0;
+
+            return 1;
+        }
     }
 
-    sqlite3_finalize(device_stmt);
+    sstr.str("");
+
+    if (entrytracker->serialize(device_format, sstr, d, nullptr) < 0)
+        return serialize_failed();
+
+    row.json = sstr.str();
+
+    if (!queue_write_row(std::move(row)))
+        return 0;
 
     return 1;
 }
 
+void kis_database_logfile::log_field_dictionary() {
+    auto n_fields = Globalreg::globalreg->entrytracker->get_field_count();
+    auto logged = fields_logged.load();
+
+    if (n_fields == logged || !fields_logged.compare_exchange_strong(logged, n_fields))
+        return;
+
+    std::stringstream sstr;
+    Globalreg::globalreg->entrytracker->serialize("json", sstr, 
+            Globalreg::globalreg->entrytracker->field_dictionary(), nullptr);
+
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+
+    log_snapshot(nullptr, tv, "FIELDS", sstr.str());
+}
+
 int kis_database_logfile::log_packet(std::shared_ptr<kis_packet> in_pack) {
     if (!db_enabled) {
         return 0;
     }
 
-    std::string phystring;
-    std::string macstring;
-    std::string deststring;
-    std::string transstring;
-    std::string keystring;
-    std::string sourceuuidstring;
-    double frequency;
-
     if (!log_data_packets)
         return 0;
 
@@ -925,17 +1287,191 @@ int kis_database_logfile::log_packet(std::shared_ptr<kis_packet> in_pack) {
         return 0;
     }
 
+    // Packets are not modified once they reach the logging stage, so the writer reads
+    // the components directly from the packet instead of copying them here
+    db_write_row row;
+    row.type = db_row_type::packet;
+    row.packet = in_pack;
+
+    if (!queue_write_row(std::move(row)))
+        return 0;
+
+    return 1;
+}
+
+int kis_database_logfile::log_data(std::shared_ptr<kis_gps_packinfo> gps, struct timeval tv, 
+        std::string phystring, mac_addr devmac, uuid datasource_uuid, 
+        std::string type, std::string json) {
+
+    if (!db_enabled)
+        return 0;
+
+    db_write_row row;
+
+    row.type = db_row_type::data;
+    row.gps = gps;
+    row.tv = tv;
+    row.phyname = std::move(phystring);
+    row.devmac = devmac.mac_to_string();
+    row.datasource = datasource_uuid.uuid_to_string();
+    row.data_type = std::move(type);
+    row.json = std::move(json);
+
+    if (!queue_write_row(std::move(row)))
+        return 0;
+
+    return 1;
+}
+
+bool kis_database_logfile::queue_write_row(db_write_row&& row) {
+    if (write_queue_depth >= write_queue_max) {
+        if (write_queue_drop) {
+            rows_dropped++;
+            return false;
+        }
+
+        // Block the caller until the writer catches up
+        std::unique_lock<std::mutex> lk(write_backpressure_mutex);
+        write_backpressure_cv.wait(lk, [this]() {
+                return write_queue_depth < write_queue_max || !db_enabled;
+            });
+
+        if (!db_enabled)
+            return false;
+    }
+
+    write_queue_depth++;
+    write_queue.enqueue(std::move(row));
+
+    return true;
+}
+
+// Build a multi-row insert of the form 'INSERT INTO x (...) VALUES (?, ...), (?, ...)'
+static std::string multirow_insert_sql(const std::string& prefix, unsigned int ncols, 
+        unsigned int nrows) {
+    std::string row = "(";
+
+    for (unsigned int c = 0; c < ncols; c++) {
+        if (c != 0)
+            row += ", ";
+        row += "?";
+    }
+
+    row += ")";
+
+    std::string sql = prefix + " VALUES ";
+
+    for (unsigned int r = 0; r < nrows; r++) {
+        if (r != 0)
+            sql += ", ";
+        sql += row;
+    }
+
+    return sql;
+}
+
+static const std::string packet_insert_prefix = 
+    "INSERT INTO packets "
+    "(ts_sec, ts_usec, phyname, "
+    "sourcemac, destmac, transmac, devkey, frequency, " 
+    "lat, lon, alt, speed, heading, "
+    "packet_len, signal, "
+    "datasource, "
+    "dlt, packet, "
+    "error, tags, datarate, hash, packetid)";
+static const unsigned int packet_insert_cols = 23;
+
+static const std::string data_insert_prefix = 
+    "INSERT INTO data "
+    "(ts_sec, ts_usec, "
+    "phyname, devmac, "
+    "lat, lon, alt, speed, heading, "
+    "datasource, "
+    "type, json)";
+static const unsigned int data_insert_cols = 12;
+
+static const std::string device_insert_prefix = 
+    "INSERT INTO devices "
+    "(first_time, last_time, devkey, phyname, devmac, strongest_signal, "
+    "min_lat, min_lon, max_lat, max_lon, "
+    "avg_lat, avg_lon, "
+    "bytes_data, type, device)";
+static const unsigned int device_insert_cols = 15;
+
+static const std::string device_delta_insert_prefix = 
+    "INSERT INTO device_deltas "
+    "(seq, last_time, devkey, phyname, devmac, delta)";
+static const unsigned int device_delta_insert_cols = 6;
+
+bool kis_database_logfile::db_prepare_writer() {
+    auto prepare = [this](const std::string& prefix, unsigned int ncols, unsigned int nrows,
+            sqlite3_stmt **stmt) -> bool {
+        auto sql = multirow_insert_sql(prefix, ncols, nrows);
+        const char *pz;
+
+        if (sqlite3_prepare_v2(db, sql.c_str(), sql.length(), stmt, &pz) != SQLITE_OK) {
+            _MSG_ERROR("kis_database_logfile unable to prepare database insert in {}: {}",
+                    ds_dbfile, sqlite3_errmsg(db));
+            *stmt = nullptr;
+            return false;
+        }
+
+        return true;
+    };
+
+    if (!prepare(packet_insert_prefix, packet_insert_cols, 1, &packet_stmt) ||
+            !prepare(data_insert_prefix, data_insert_cols, 1, &data_stmt) ||
+            !prepare(device_insert_prefix, device_insert_cols, 1, &device_stmt) ||
+            !prepare(device_delta_insert_prefix, device_delta_insert_cols, 1, &device_delta_stmt))
+        return false;
+
+    std::string compact_sql = "DELETE FROM device_deltas WHERE devkey = ? AND seq < ?";
+    const char *pz;
+
+    if (sqlite3_prepare_v2(db, compact_sql.c_str(), compact_sql.length(), 
+                &device_compact_stmt, &pz) != SQLITE_OK) {
+        _MSG_ERROR("kis_database_logfile unable to prepare device delta compaction in {}: {}",
+                ds_dbfile, sqlite3_errmsg(db));
+        device_compact_stmt = nullptr;
+        return false;
+    }
+
+    if (write_multi_rows > 1) {
+        if (!prepare(packet_insert_prefix, packet_insert_cols, write_multi_rows, &packet_multi_stmt) ||
+                !prepare(data_insert_prefix, data_insert_cols, write_multi_rows, &data_multi_stmt))
+            return false;
+    }
+
+    return true;
+}
+
+void kis_database_logfile::db_finalize_writer() {
+    for (auto s : {&packet_stmt, &packet_multi_stmt, &data_stmt, &data_multi_stmt, &device_stmt,
+            &device_delta_stmt, &device_compact_stmt}) {
+        if (*s != nullptr) {
+            sqlite3_finalize(*s);
+            *s = nullptr;
+        }
+    }
+}
+
+void kis_database_logfile::bind_packet_row(sqlite3_stmt *stmt, int& sql_pos, const db_write_row& row) {
+    auto& in_pack = row.packet;
+
     auto chunk = in_pack->fetch<kis_datachunk>(pack_comp_linkframe);
     auto radioinfo = in_pack->fetch<kis_layer1_packinfo>(pack_comp_radiodata);
     auto gpsdata = in_pack->fetch<kis_gps_packinfo>(pack_comp_gps);
     auto commoninfo = in_pack->fetch<kis_common_info>(pack_comp_common);
     auto datasrc = in_pack->fetch<packetchain_comp_datasource>(pack_comp_datasource);
-    auto metablob = in_pack->fetch<packet_metablob>(pack_comp_metablob);
 
-    kis_phy_handler *phyh = NULL;
+    std::string phystring;
+    std::string macstring;
+    std::string deststring;
+    std::string transstring;
+    std::string sourceuuidstring;
+    double frequency;
 
-    // Packets are no longer a 1:1 with a device
-    keystring = "0";
+    kis_phy_handler *phyh = NULL;
 
     if (commoninfo != NULL) {
         phyh = devicetracker->fetch_phy_handler(commoninfo->phyid);
@@ -955,215 +1491,332 @@ int kis_database_logfile::log_packet(std::shared_ptr<kis_packet> in_pack) {
     else
         phystring = phyh->fetch_phy_name();
 
-
     if (datasrc != NULL) {
         sourceuuidstring = datasrc->ref_source->get_source_uuid().uuid_to_string();
     } else {
         sourceuuidstring = "00000000-0000-0000-0000-000000000000";
     }
 
-    // Log into the PACKET table if we're a loggable packet (ie, have a link frame)
-    if (chunk != nullptr) {
-        int r;
-        std::string sql;
-        sqlite3_stmt *packet_stmt;
-        const char *packet_pz;
-
-        sql =
-            "INSERT INTO packets "
-            "(ts_sec, ts_usec, phyname, "
-            "sourcemac, destmac, transmac, devkey, frequency, " 
-            "lat, lon, alt, speed, heading, "
-            "packet_len, signal, "
-            "datasource, "
-            "dlt, packet, "
-            "error, tags, datarate, hash, packetid) "
-            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
-
-        r = sqlite3_prepare(db, sql.c_str(), sql.length(), &packet_stmt, &packet_pz);
-
-        if (r != SQLITE_OK) {
-            _MSG("kis_database_logfile unable to prepare database insert for packets in " +
-                    ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            close_log();
-            return -1;
-        }
+    sqlite3_bind_int64(stmt, sql_pos++, in_pack->ts.tv_sec);
+    sqlite3_bind_int64(stmt, sql_pos++, in_pack->ts.tv_usec);
 
-        int sql_pos = 1;
+    sqlite3_bind_text(stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, sql_pos++, deststring.c_str(), deststring.length(), SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, sql_pos++, transstring.c_str(), transstring.length(), SQLITE_TRANSIENT);
 
-        sqlite3_bind_int64(packet_stmt, sql_pos++, in_pack->ts.tv_sec);
-        sqlite3_bind_int64(packet_stmt, sql_pos++, in_pack->ts.tv_usec);
+    // Packets are no longer a 1:1 with a device
+    sqlite3_bind_text(stmt, sql_pos++, "0", 1, SQLITE_STATIC);
+    sqlite3_bind_double(stmt, sql_pos++, frequency);
+
+    if (gpsdata != NULL) {
+        sqlite3_bind_double(stmt, sql_pos++, gpsdata->lat);
+        sqlite3_bind_double(stmt, sql_pos++, gpsdata->lon);
+        sqlite3_bind_double(stmt, sql_pos++, gpsdata->alt);
+        sqlite3_bind_double(stmt, sql_pos++, gpsdata->speed);
+        sqlite3_bind_double(stmt, sql_pos++, gpsdata->heading);
+    } else {
+        sqlite3_bind_double(stmt, sql_pos++, 0);
+        sqlite3_bind_double(stmt, sql_pos++, 0);
+        sqlite3_bind_double(stmt, sql_pos++, 0);
+        sqlite3_bind_double(stmt, sql_pos++, 0);
+        sqlite3_bind_double(stmt, sql_pos++, 0);
+    }
 
-        sqlite3_bind_text(packet_stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, deststring.c_str(), deststring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, transstring.c_str(), transstring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, keystring.c_str(), keystring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_double(packet_stmt, sql_pos++, frequency);
+    sqlite3_bind_int64(stmt, sql_pos++, chunk->length());
 
-        if (gpsdata != NULL) {
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->lat);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->lon);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->alt);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->speed);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->heading);
-        } else {
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-        }
+    if (radioinfo != nullptr) {
+        sqlite3_bind_int(stmt, sql_pos++, radioinfo->signal_dbm);
+    } else {
+        sqlite3_bind_int(stmt, sql_pos++, 0);
+    }
 
-        sqlite3_bind_int64(packet_stmt, sql_pos++, chunk->length());
+    sqlite3_bind_text(stmt, sql_pos++, sourceuuidstring.c_str(), 
+            sourceuuidstring.length(), SQLITE_TRANSIENT);
 
-        if (radioinfo != nullptr) {
-            sqlite3_bind_int(packet_stmt, sql_pos++, radioinfo->signal_dbm);
-        } else {
-            sqlite3_bind_int(packet_stmt, sql_pos++, 0);
-        }
+    sqlite3_bind_int(stmt, sql_pos++, chunk->dlt);
 
-        sqlite3_bind_text(packet_stmt, sql_pos++, sourceuuidstring.c_str(), 
-                sourceuuidstring.length(), SQLITE_TRANSIENT);
+    // The packet is held by the row until the statement has been stepped
+    sqlite3_bind_blob(stmt, sql_pos++, (const char *) chunk->data(), chunk->length(), SQLITE_STATIC);
 
-        sqlite3_bind_int(packet_stmt, sql_pos++, chunk->dlt);
-        sqlite3_bind_blob(packet_stmt, sql_pos++, (const char *) chunk->data(), chunk->length(), 0);
+    sqlite3_bind_int(stmt, sql_pos++, in_pack->error);
 
-        sqlite3_bind_int(packet_stmt, sql_pos++, in_pack->error);
+    std::stringstream tagstream;
+    bool space_needed = false;
 
-        std::stringstream tagstream;
-        bool space_needed = false;
+    for (auto tag : in_pack->tag_map) {
+        if (space_needed)
+            tagstream << " ";
+        space_needed = true;
+        tagstream << tag.first;
+    }
 
-        for (auto tag : in_pack->tag_map) {
-            if (space_needed)
-                tagstream << " ";
-            space_needed = true;
-            tagstream << tag.first;
-        }
+    auto str = tagstream.str();
+    sqlite3_bind_text(stmt, sql_pos++, str.c_str(), str.length(), SQLITE_TRANSIENT);
+
+    if (radioinfo != nullptr)
+        sqlite3_bind_double(stmt, sql_pos++, radioinfo->datarate / 10);
+    else
+        sqlite3_bind_double(stmt, sql_pos++, 0);
 
-        auto str = tagstream.str();
-        sqlite3_bind_text(packet_stmt, sql_pos++, str.c_str(), tagstream.str().length(), SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, sql_pos++, in_pack->hash);
+    sqlite3_bind_int64(stmt, sql_pos++, in_pack->packet_no);
+}
 
-        if (radioinfo != nullptr)
-            sqlite3_bind_double(packet_stmt, sql_pos++, radioinfo->datarate / 10);
-        else
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
+void kis_database_logfile::bind_data_row(sqlite3_stmt *stmt, int& sql_pos, const db_write_row& row) {
+    sqlite3_bind_int64(stmt, sql_pos++, row.tv.tv_sec);
+    sqlite3_bind_int64(stmt, sql_pos++, row.tv.tv_usec);
 
-        sqlite3_bind_int(packet_stmt, sql_pos++, in_pack->hash);
-        sqlite3_bind_int64(packet_stmt, sql_pos++, in_pack->packet_no);
+    sqlite3_bind_text(stmt, sql_pos++, row.phyname.c_str(), row.phyname.length(), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, sql_pos++, row.devmac.c_str(), row.devmac.length(), SQLITE_STATIC);
 
-#if 0
-        kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb log_packet");
-        db_lock_with_sync_check(dblock, return -1);
-#endif
+    if (row.gps != NULL) {
+        sqlite3_bind_double(stmt, sql_pos++, row.gps->lat);
+        sqlite3_bind_double(stmt, sql_pos++, row.gps->lon);
+        sqlite3_bind_double(stmt, sql_pos++, row.gps->alt);
+        sqlite3_bind_double(stmt, sql_pos++, row.gps->speed);
+        sqlite3_bind_double(stmt, sql_pos++, row.gps->heading);
+    } else {
+        sqlite3_bind_double(stmt, sql_pos++, 0);
+        sqlite3_bind_double(stmt, sql_pos++, 0);
+        sqlite3_bind_double(stmt, sql_pos++, 0);
+        sqlite3_bind_double(stmt, sql_pos++, 0);
+        sqlite3_bind_double(stmt, sql_pos++, 0);
+    }
 
-        if (sqlite3_step(packet_stmt) != SQLITE_DONE) {
-            _MSG("kis_database_logfile unable to insert packet in " +
-                    ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            close_log();
-            return -1;
-        }
+    sqlite3_bind_text(stmt, sql_pos++, row.datasource.c_str(), row.datasource.length(), SQLITE_STATIC);
+
+    sqlite3_bind_text(stmt, sql_pos++, row.data_type.data(), row.data_type.length(), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, sql_pos++, row.json.data(), row.json.length(), SQLITE_STATIC);
+}
 
-        sqlite3_finalize(packet_stmt);
+void kis_database_logfile::bind_device_row(sqlite3_stmt *stmt, int& spos, const db_write_row& row) {
+    sqlite3_bind_int64(stmt, spos++, row.first_time);
+    sqlite3_bind_int64(stmt, spos++, row.last_time);
+    sqlite3_bind_text(stmt, spos++, row.devkey.c_str(), row.devkey.length(), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, spos++, row.phyname.c_str(), row.phyname.length(), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, spos++, row.devmac.c_str(), row.devmac.length(), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, spos++, row.strongest_signal);
+
+    if (row.has_location) {
+        sqlite3_bind_double(stmt, spos++, row.min_lat);
+        sqlite3_bind_double(stmt, spos++, row.min_lon);
+        sqlite3_bind_double(stmt, spos++, row.max_lat);
+        sqlite3_bind_double(stmt, spos++, row.max_lon);
+        sqlite3_bind_double(stmt, spos++, row.avg_lat);
+        sqlite3_bind_double(stmt, spos++, row.avg_lon);
+    } else {
+        // Empty location
+        sqlite3_bind_double(stmt, spos++, 0);
+        sqlite3_bind_double(stmt, spos++, 0);
+        sqlite3_bind_double(stmt, spos++, 0);
+        sqlite3_bind_double(stmt, spos++, 0);
+        sqlite3_bind_double(stmt, spos++, 0);
+        sqlite3_bind_double(stmt, spos++, 0);
     }
 
-    // If the packet has a metablob record, log that; if the packet ONLY has meta data we should only get a 'data'
-    // record; if the packet has both, we'll get both a 'packet' and a 'data' record.
-    if (metablob != nullptr) {
-        mac_addr smac("00:00:00:00:00:00");
-        uuid puuid;
+    sqlite3_bind_int64(stmt, spos++, row.bytes_data);
+    sqlite3_bind_text(stmt, spos++, row.device_type.c_str(), row.device_type.length(), SQLITE_STATIC);
+
+    sqlite3_bind_blob(stmt, spos++, row.json.data(), row.json.length(), SQLITE_STATIC);
+}
+
+void kis_database_logfile::bind_device_delta_row(sqlite3_stmt *stmt, int& spos, const db_write_row& row) {
+    sqlite3_bind_int64(stmt, spos++, row.seq);
+    sqlite3_bind_int64(stmt, spos++, row.last_time);
+    sqlite3_bind_text(stmt, spos++, row.devkey.c_str(), row.devkey.length(), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, spos++, row.phyname.c_str(), row.phyname.length(), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, spos++, row.devmac.c_str(), row.devmac.length(), SQLITE_STATIC);
+    sqlite3_bind_blob(stmt, spos++, row.json.data(), row.json.length(), SQLITE_STATIC);
+}
+
+bool kis_database_logfile::compact_device_deltas(const std::vector<const db_write_row *>& rows) {
+    // Deltas are written before base records in each batch, so only deltas which
+    // were logged before the new base are removed
+    for (auto r : rows) {
+        if (r->seq == 0)
+            continue;
+
+        sqlite3_reset(device_compact_stmt);
 
-        if (commoninfo != nullptr)
-            smac = commoninfo->source;
+        sqlite3_bind_text(device_compact_stmt, 1, r->devkey.c_str(), r->devkey.length(), SQLITE_STATIC);
+        sqlite3_bind_int64(device_compact_stmt, 2, r->seq);
 
-        if (datasrc != nullptr) 
-            puuid = datasrc->ref_source->get_source_uuid();
+        if (sqlite3_step(device_compact_stmt) != SQLITE_DONE) {
+            _MSG_ERROR("kis_database_logfile unable to compact device deltas in {}: {}",
+                    ds_dbfile, sqlite3_errmsg(db));
+            sqlite3_reset(device_compact_stmt);
+            return false;
+        }
 
-        log_data(gpsdata, in_pack->ts, phystring, smac, puuid,
-                metablob->meta_type, metablob->meta_data);
+        sqlite3_reset(device_compact_stmt);
     }
 
-    return 1;
+    return true;
 }
 
-int kis_database_logfile::log_data(std::shared_ptr<kis_gps_packinfo> gps, struct timeval tv, 
-        std::string phystring, mac_addr devmac, uuid datasource_uuid, 
-        std::string type, std::string json) {
+template<typename B>
+bool kis_database_logfile::write_rows(sqlite3_stmt *single_stmt, sqlite3_stmt *multi_stmt,
+        const std::vector<const db_write_row *>& rows, const std::string& table, B binder) {
+    size_t i = 0;
 
-    if (!db_enabled)
-        return 0;
+    while (i < rows.size()) {
+        sqlite3_stmt *stmt = single_stmt;
+        size_t nrows = 1;
+
+        if (multi_stmt != nullptr && rows.size() - i >= write_multi_rows) {
+            stmt = multi_stmt;
+            nrows = write_multi_rows;
+        }
 
-    std::string macstring = devmac.mac_to_string();
-    std::string uuidstring = datasource_uuid.uuid_to_string();
+        sqlite3_reset(stmt);
 
-    int r;
-    std::string sql;
-    sqlite3_stmt *data_stmt;
-    const char *data_pz;
+        int pos = 1;
+        for (size_t r = 0; r < nrows; r++)
+            binder(stmt, pos, *rows[i + r]);
 
-    sql =
-        "INSERT INTO data "
-        "(ts_sec, ts_usec, "
-        "phyname, devmac, "
-        "lat, lon, alt, speed, heading, "
-        "datasource, "
-        "type, json) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            _MSG_ERROR("kis_database_logfile unable to insert {} in {}: {}", 
+                    table, ds_dbfile, sqlite3_errmsg(db));
+            sqlite3_reset(stmt);
+            return false;
+        }
 
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &data_stmt, &data_pz);
+        // Release any static bindings before the rows go away
+        sqlite3_reset(stmt);
 
-    if (r != SQLITE_OK) {
-        _MSG("kis_database_logfile unable to prepare database insert for data in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
+        i += nrows;
     }
 
-    sqlite3_reset(data_stmt);
-    sqlite3_clear_bindings(data_stmt);
+    rows_written += rows.size();
 
-    int sql_pos = 1;
+    return true;
+}
 
-    sqlite3_bind_int64(data_stmt, sql_pos++, tv.tv_sec);
-    sqlite3_bind_int64(data_stmt, sql_pos++, tv.tv_usec);
+void kis_database_logfile::db_writer() {
+    std::vector<db_write_row> batch(256);
+    std::vector<db_write_row> meta_rows;
+    std::vector<const db_write_row *> packet_rows, data_rows, device_rows, device_delta_rows;
 
-    sqlite3_bind_text(data_stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(data_stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_TRANSIENT);
+    bool shutdown = false;
+    bool write_ok = true;
 
-    if (gps != NULL) {
-        sqlite3_bind_double(data_stmt, sql_pos++, gps->lat);
-        sqlite3_bind_double(data_stmt, sql_pos++, gps->lon);
-        sqlite3_bind_double(data_stmt, sql_pos++, gps->alt);
-        sqlite3_bind_double(data_stmt, sql_pos++, gps->speed);
-        sqlite3_bind_double(data_stmt, sql_pos++, gps->heading);
-    } else {
-        sqlite3_bind_double(data_stmt, sql_pos++, 0);
-        sqlite3_bind_double(data_stmt, sql_pos++, 0);
-        sqlite3_bind_double(data_stmt, sql_pos++, 0);
-        sqlite3_bind_double(data_stmt, sql_pos++, 0);
-        sqlite3_bind_double(data_stmt, sql_pos++, 0);
-    }
+    while (!shutdown) {
+        auto n = write_queue.wait_dequeue_bulk_timed(batch.begin(), batch.size(), 
+                std::chrono::milliseconds(100));
 
-    sqlite3_bind_text(data_stmt, sql_pos++, uuidstring.c_str(), uuidstring.length(), SQLITE_TRANSIENT);
+        if (n > 0) {
+            write_queue_depth -= n;
 
-    sqlite3_bind_text(data_stmt, sql_pos++, type.data(), type.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(data_stmt, sql_pos++, json.data(), json.length(), SQLITE_TRANSIENT);
+            // Wake up anyone blocked on a full queue; taking the lock ensures a waiter
+            // can't miss the change between checking and sleeping
+            { std::lock_guard<std::mutex> lk(write_backpressure_mutex); }
+            write_backpressure_cv.notify_all();
+        }
 
-#if 0
-    kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb log_data");
-    db_lock_with_sync_check(dblock, return -1);
-#endif
+        packet_rows.clear();
+        data_rows.clear();
+        device_rows.clear();
+        device_delta_rows.clear();
+        meta_rows.clear();
+
+        // Reserve so that pointers into the metadata rows stay valid
+        meta_rows.reserve(n);
+
+        for (size_t i = 0; i < n; i++) {
+            auto& row = batch[i];
+
+            switch (row.type) {
+                case db_row_type::packet:
+                    {
+                        // Log into the PACKET table if we're a loggable packet (ie, have a 
+                        // link frame), and log any metablob as a data record
+                        if (row.packet->fetch<kis_datachunk>(pack_comp_linkframe) != nullptr)
+                            packet_rows.push_back(&row);
+
+                        auto metablob = row.packet->fetch<packet_metablob>(pack_comp_metablob);
+                        if (metablob != nullptr) {
+                            auto commoninfo = row.packet->fetch<kis_common_info>(pack_comp_common);
+                            auto datasrc = row.packet->fetch<packetchain_comp_datasource>(pack_comp_datasource);
+
+                            db_write_row meta;
+                            meta.type = db_row_type::data;
+                            meta.gps = row.packet->fetch<kis_gps_packinfo>(pack_comp_gps);
+                            meta.tv = row.packet->ts;
+
+                            kis_phy_handler *phyh = nullptr;
+                            if (commoninfo != nullptr)
+                                phyh = devicetracker->fetch_phy_handler(commoninfo->phyid);
+
+                            meta.phyname = phyh == nullptr ? "Unknown" : phyh->fetch_phy_name();
+                            meta.devmac = commoninfo == nullptr ? 
+                                "00:00:00:00:00:00" : commoninfo->source.mac_to_string();
+                            meta.datasource = datasrc == nullptr ? 
+                                uuid().uuid_to_string() : 
+                                datasrc->ref_source->get_source_uuid().uuid_to_string();
+                            meta.data_type = metablob->meta_type;
+                            meta.json = metablob->meta_data;
+
+                            meta_rows.push_back(std::move(meta));
+                            data_rows.push_back(&meta_rows.back());
+                        }
+                    }
+                    break;
+                case db_row_type::data:
+                    data_rows.push_back(&row);
+                    break;
+                case db_row_type::device:
+                    device_rows.push_back(&row);
+                    break;
+                case db_row_type::device_delta:
+                    device_delta_rows.push_back(&row);
+                    break;
+                case db_row_type::shutdown:
+                    shutdown = true;
+                    break;
+            }
+        }
 
-    if (sqlite3_step(data_stmt) != SQLITE_DONE) {
-        _MSG("kis_database_logfile unable to insert data in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
-    }
+        if (write_ok) {
+            write_ok = 
+                write_rows(packet_stmt, packet_multi_stmt, packet_rows, "packets",
+                        [this](sqlite3_stmt *s, int& p, const db_write_row& r) { bind_packet_row(s, p, r); }) &&
+                write_rows(data_stmt, data_multi_stmt, data_rows, "data",
+                        [this](sqlite3_stmt *s, int& p, const db_write_row& r) { bind_data_row(s, p, r); }) &&
+                write_rows(device_delta_stmt, nullptr, device_delta_rows, "device_deltas",
+                        [this](sqlite3_stmt *s, int& p, const db_write_row& r) { bind_device_delta_row(s, p, r); }) &&
+                write_rows(device_stmt, nullptr, device_rows, "devices",
+                        [this](sqlite3_stmt *s, int& p, const db_write_row& r) { bind_device_row(s, p, r); }) &&
+                compact_device_deltas(device_rows);
+
+            if (!write_ok) {
+                // Stop accepting rows; the log is closed by the normal shutdown path
+                // and the writer keeps draining the queue until then
+                db_enabled = false;
+                write_backpressure_cv.notify_all();
+            }
+        }
 
-    sqlite3_finalize(data_stmt);
+        if (commit_pending && write_ok) {
+            auto start = std::chrono::steady_clock::now();
 
-    return 1;
+            in_transaction_sync = true;
+
+            sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
+            sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+            in_transaction_sync = false;
+            commit_pending = false;
+
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            last_commit_ms = ms;
+            commit_latency_rrd->add_sample(ms, Globalreg::globalreg->last_tv_sec);
+        }
+
+        // Release the packets and strings held by this batch
+        for (size_t i = 0; i < n; i++)
+            batch[i] = db_write_row{};
+    }
 }
 
 int kis_database_logfile::log_datasources(shared_tracker_element in_datasource_vec) {
@@ -38,8 +38,12 @@
 #include "config.h"
 
 #include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "globalregistry.h"
 #include "kis_mutex.h"
@@ -53,6 +57,9 @@
 #include "class_filter.h"
 #include "packet_filter.h"
 #include "messagebus.h"
+#include "trackedrrd.h"
+
+#include "moodycamel/blockingconcurrentqueue.h"
 
 // Kismetdb version
 
@@ -227,6 +234,137 @@ protected:
 
     bool log_duplicate_packets;
     bool log_data_packets;
+
+    // Devices are logged with any registered serializer; binary formats refer to fields
+    // by id, so the field dictionary is logged as a FIELDS snapshot whenever new fields
+    // have been registered since it was last written
+    std::string device_format;
+    std::atomic<size_t> fields_logged;
+    void log_field_dictionary();
+
+    // Packets, data, and devices are the high-volume tables; rows for them are queued
+    // to a dedicated writer thread so that packet and device threads never wait on
+    // sqlite.  Packets are queued by reference and only read by the writer, data and
+    // device rows are captured when they are logged.
+    enum class db_row_type {
+        packet, data, device, device_delta, shutdown
+    };
+
+    struct db_write_row {
+        db_row_type type {db_row_type::packet};
+
+        std::shared_ptr<kis_packet> packet;
+
+        std::shared_ptr<kis_gps_packinfo> gps;
+        struct timeval tv {0, 0};
+        std::string phyname;
+        std::string devmac;
+        std::string datasource;
+        std::string data_type;
+        std::string json;
+
+        time_t first_time {0};
+        time_t last_time {0};
+        std::string devkey;
+        int strongest_signal {0};
+        bool has_location {false};
+        double min_lat {0}, min_lon {0}, max_lat {0}, max_lon {0}, avg_lat {0}, avg_lon {0};
+        uint64_t bytes_data {0};
+        std::string device_type;
+
+        // Delta sequence, set on device and delta rows when logging deltas
+        uint64_t seq {0};
+    };
+
+    // Queue a row, applying the backpressure policy if the queue is full
+    bool queue_write_row(db_write_row&& row);
+
+    void db_writer();
+    bool db_prepare_writer();
+    void db_finalize_writer();
+
+    // Bind a row to a statement starting at the given position, advancing it
+    void bind_packet_row(sqlite3_stmt *stmt, int& pos, const db_write_row& row);
+    void bind_data_row(sqlite3_stmt *stmt, int& pos, const db_write_row& row);
+    void bind_device_row(sqlite3_stmt *stmt, int& pos, const db_write_row& row);
+    void bind_device_delta_row(sqlite3_stmt *stmt, int& pos, const db_write_row& row);
+
+    // Delete the deltas replaced by newly written base records
+    bool compact_device_deltas(const std::vector<const db_write_row *>& rows);
+
+    // Write a set of rows using the multi-row statement for each full block and the
+    // single row statement for any remainder
+    template<typename B>
+    bool write_rows(sqlite3_stmt *single_stmt, sqlite3_stmt *multi_stmt,
+            const std::vector<const db_write_row *>& rows, const std::string& table, B binder);
+
+    // Device delta logging.  Instead of rewriting the whole device every time it is
+    // logged, each top-level field - and each field of a nested map, such as the phy
+    // records - is hashed, and only the fields which changed since the last time the
+    // device was logged are written as a row in device_deltas.  The devices table holds
+    // the base record, which is rewritten (and the older deltas deleted) once the
+    // deltas grow past it or after kis_log_device_delta_compact deltas.
+    bool log_device_deltas;
+    unsigned int delta_compact_count;
+
+    int log_device_delta(std::shared_ptr<kis_tracked_device_base> d, db_write_row&& row);
+
+    struct device_delta_state {
+        // Field path (field id << 16 | nested field id + 1) and hash of each field the
+        // last time the device was logged, sorted by path
+        std::vector<std::pair<uint32_t, uint64_t>> hashes;
+
+        unsigned int n_deltas {0};
+        size_t delta_bytes {0};
+        size_t base_bytes {0};
+        time_t last_time {0};
+    };
+
+    kis_mutex delta_mutex;
+    std::unordered_map<device_key, device_delta_state> delta_states;
+
+    // Deltas are applied in sequence order; a base record deletes the deltas before it
+    std::atomic<uint64_t> delta_seq;
+
+    int delta_set_id, delta_merge_id, delta_remove_id;
+
+    moodycamel::BlockingConcurrentQueue<db_write_row> write_queue;
+    std::thread write_thread;
+
+    std::atomic<size_t> write_queue_depth;
+    size_t write_queue_max;
+    bool write_queue_drop;
+
+    std::mutex write_backpressure_mutex;
+    std::condition_variable write_backpressure_cv;
+
+    // Number of rows combined into a single insert by the writer
+    unsigned int write_multi_rows;
+
+    sqlite3_stmt *packet_stmt, *packet_multi_stmt;
+    sqlite3_stmt *data_stmt, *data_multi_stmt;
+    sqlite3_stmt *device_stmt;
+    sqlite3_stmt *device_delta_stmt, *device_compact_stmt;
+
+    // Commits are performed by the writer between batches when requested by the 
+    // transaction timer
+    std::atomic<bool> commit_pending;
+
+    std::atomic<uint64_t> rows_written;
+    std::atomic<uint64_t> rows_dropped;
+    uint64_t rows_dropped_last;
+    std::atomic<double> last_commit_ms;
+
+    int write_stats_timer;
+
+    std::shared_ptr<tracker_element_map> write_stats_map;
+    std::shared_ptr<tracker_element_uint64> write_queue_depth_elem;
+    std::shared_ptr<tracker_element_uint64> rows_written_elem;
+    std::shared_ptr<tracker_element_uint64> rows_dropped_elem;
+    std::shared_ptr<tracker_element_double> commit_ms_elem;
+    std::shared_ptr<kis_tracked_rrd<kis_tracked_rrd_extreme_aggregator>> write_queue_rrd;
+    std::shared_ptr<kis_tracked_rrd<kis_tracked_rrd_extreme_aggregator>> commit_latency_rrd;
+    std::shared_ptr<kis_tracked_rrd<>> rows_dropped_rrd;
 };
 
 class kis_database_logfile_builder : public kis_logfile_builder {
@@ -66,6 +66,11 @@ kis_datasource::kis_datasource(shared_datasource_builder in_builder) :
     pack_comp_json = packetchain->register_packet_component("JSON");
     pack_comp_protobuf = packetchain->register_packet_component("PROTOBUF");
 
+    // Data reports are recycled once the packet referencing them is released; clearing
+    // a report keeps the capacity of the string fields for the next parse
+    Globalreg::enable_pool_type<KismetDatasource::DataReport>([](auto *r) { r->Clear(); });
+    Globalreg::enable_pool_type<KismetDatasource::DataReportBatch>([](auto *r) { r->Clear(); });
+
     suppress_gps = false;
 
     error_timer_id = -1;
@@ -902,6 +907,9 @@ bool kis_datasource::dispatch_rx_packet(const nonstd::string_view& command,
     } else if (command.compare("KDSDATAREPORT") == 0) {
         handle_packet_data_report(seqno, content);
         return true;
+    } else if (command.compare("KDSDATAREPORTBATCH") == 0) {
+        handle_packet_data_report_batch(seqno, content);
+        return true;
     } else if (command.compare("KDSERRORREPORT") == 0) {
         handle_packet_error_report(seqno, content);
         return true;
@@ -1362,7 +1370,7 @@ void kis_datasource::handle_packet_data_report(uint32_t in_seqno,
             return;
     }
 
-    auto report = std::make_shared<KismetDatasource::DataReport>();
+    auto report = Globalreg::new_from_pool<KismetDatasource::DataReport>();
 
     if (!report->ParseFromArray(in_content.data(), in_content.length())) {
         _MSG(std::string("Kismet datasource driver ") + get_source_builder()->get_source_type() + 
@@ -1372,6 +1380,39 @@ void kis_datasource::handle_packet_data_report(uint32_t in_seqno,
         return;
     }
 
+    handle_data_report(report);
+}
+
+void kis_datasource::handle_packet_data_report_batch(uint32_t in_seqno,
+        const nonstd::string_view& in_content) {
+    // If we're paused, throw away the entire batch
+    {
+        kis_lock_guard<kis_mutex> lk(ext_mutex, "datasource handle_packet_data_report_batch");
+
+        if (get_source_paused())
+            return;
+    }
+
+    auto batch = Globalreg::new_from_pool<KismetDatasource::DataReportBatch>();
+
+    if (!batch->ParseFromArray(in_content.data(), in_content.length())) {
+        _MSG(std::string("Kismet datasource driver ") + get_source_builder()->get_source_type() + 
+                std::string(" could not parse the data report batch, something is wrong with "
+                    "the remote capture tool"), MSGFLAG_ERROR);
+        trigger_error("Invalid KDSDATAREPORTBATCH");
+        return;
+    }
+
+    // Each report shares ownership of the batch, so the packets can continue to 
+    // refer to their frames inside it; the batch is recycled once the last packet
+    // is done with it
+    for (int i = 0; i < batch->reports_size(); i++) {
+        auto report = std::shared_ptr<KismetDatasource::DataReport>(batch, batch->mutable_reports(i));
+        handle_data_report(report);
+    }
+}
+
+void kis_datasource::handle_data_report(std::shared_ptr<KismetDatasource::DataReport> report) {
     if (report->has_message()) 
         handle_msg_proxy(report->message().msgtext(), report->message().msgtype());
 
@@ -1380,8 +1421,11 @@ void kis_datasource::handle_packet_data_report(uint32_t in_seqno,
 
     auto packet = packetchain->generate_packet();
 
+    // The packet holds the report so that the link frame can refer to the parsed
+    // data directly instead of copying it again
     auto packreport = packetchain->new_packet_component<kis_packreport_packinfo>();
     packreport->set_report(report);
+    packet->insert(pack_comp_report, packreport);
 
     // Process the data chunk
     if (report->has_packet()) {
@@ -1463,7 +1507,8 @@ void kis_datasource::handle_rx_datalayer(std::shared_ptr<kis_packet> packet,
         packet->original_len = report.data().length();
     }
 
-    packet->set_data(report.data());
+    // The report is held by the packet, so refer to the parsed frame in place
+    packet->set_data_ref(report.data());
     datachunk->set_data(packet->data);
 
     get_source_packet_size_rrd()->add_sample(report.data().length(), Globalreg::globalreg->last_tv_sec);
@@ -1629,6 +1674,9 @@ unsigned int kis_datasource::send_open_source(std::string in_definition,
     KismetDatasource::OpenSource o;
     o.set_definition(in_definition);
 
+    // Let the capture driver coalesce data reports; older drivers ignore this
+    o.set_batch_reports(true);
+
     if (protocol_version == 0) {
         std::shared_ptr<KismetExternal::Command> c(new KismetExternal::Command());
         c->set_command("KDSOPENSOURCE");
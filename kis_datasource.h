@@ -64,6 +64,10 @@ public:
         report = r;
     }
 
+    std::shared_ptr<KismetDatasource::DataReport> get_report() const {
+        return report;
+    }
+
     void reset() {
         report.reset();
     }
@@ -583,12 +587,16 @@ protected:
 
     virtual void handle_packet_configure_report(uint32_t in_seqno, const nonstd::string_view& in_packet);
     virtual void handle_packet_data_report(uint32_t in_seqno, const nonstd::string_view& in_packet);
+    virtual void handle_packet_data_report_batch(uint32_t in_seqno, const nonstd::string_view& in_packet);
     virtual void handle_packet_error_report(uint32_t in_seqno, const nonstd::string_view& in_packet);
     virtual void handle_packet_interfaces_report(uint32_t in_seqno, const nonstd::string_view& in_packet);
     virtual void handle_packet_opensource_report(uint32_t in_seqno, const nonstd::string_view& in_packet);
     virtual void handle_packet_probesource_report(uint32_t in_seqno, const nonstd::string_view& in_packet);
     virtual void handle_packet_warning_report(uint32_t in_seqno, const nonstd::string_view& in_packet);
 
+    // Turn a parsed data report, either standalone or part of a batch, into a packet
+    void handle_data_report(std::shared_ptr<KismetDatasource::DataReport> report);
+
     virtual unsigned int send_configure_channel(std::string in_channel, unsigned int in_transaction,
             configure_callback_t in_cb);
     virtual unsigned int send_configure_channel_hop(double in_rate,
@@ -889,8 +889,7 @@ void kis_external_interface::handle_packet_http_register(uint32_t in_seqno,
     httpd->register_route(uri.uri(), {uri.method()}, httpd->LOGON_ROLE,
             std::make_shared<kis_net_web_function_endpoint>(
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
-                    kis_unique_lock<kis_mutex> l(ext_mutex, std::defer_lock,
-                            fmt::format("proxied req {}", con->uri()));
+                    kis_unique_lock<kis_mutex> l(ext_mutex, std::defer_lock, "external proxied req");
                     l.lock();
 
                     auto session = std::make_shared<kis_external_http_session>();
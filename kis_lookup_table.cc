@@ -0,0 +1,326 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "configfile.h"
+#include "globalregistry.h"
+#include "kis_lookup_table.h"
+#include "messagebus.h"
+
+static const char lookup_table_magic[8] = { 'K', 'I', 'S', 'L', 'K', 'U', 'P', '1' };
+static const uint32_t lookup_table_byte_order = 0x01020304;
+
+kis_lookup_table::kis_lookup_table() :
+    map_base{nullptr},
+    map_sz{0},
+    n_records{0},
+    n_fields{0},
+    keys{nullptr},
+    offsets{nullptr},
+    pool{nullptr} { }
+
+kis_lookup_table::~kis_lookup_table() {
+    unmap();
+}
+
+void kis_lookup_table::unmap() {
+    if (map_base != nullptr)
+        munmap(map_base, map_sz);
+
+    map_base = nullptr;
+    map_sz = 0;
+
+    mem_table.clear();
+
+    n_records = 0;
+    n_fields = 0;
+    keys = nullptr;
+    offsets = nullptr;
+    pool = nullptr;
+}
+
+bool kis_lookup_table::attach(const char *base, size_t sz, unsigned int in_fields) {
+    table_header hdr;
+
+    if (sz < sizeof(table_header))
+        return false;
+
+    memcpy(&hdr, base, sizeof(table_header));
+
+    if (memcmp(hdr.magic, lookup_table_magic, sizeof(lookup_table_magic)) != 0)
+        return false;
+
+    // Tables are written in host order; a table from another architecture is rebuilt
+    if (hdr.byte_order != lookup_table_byte_order)
+        return false;
+
+    if (hdr.n_fields != in_fields || in_fields == 0)
+        return false;
+
+    size_t expected_sz = sizeof(table_header) +
+        ((size_t) hdr.n_records * sizeof(uint32_t)) +
+        ((size_t) hdr.n_records * hdr.n_fields * sizeof(uint32_t)) +
+        hdr.pool_sz;
+
+    if (expected_sz != sz || hdr.pool_sz == 0)
+        return false;
+
+    auto t_keys = reinterpret_cast<const uint32_t *>(base + sizeof(table_header));
+    auto t_offsets = t_keys + hdr.n_records;
+    auto t_pool = reinterpret_cast<const char *>(t_offsets + ((size_t) hdr.n_records * hdr.n_fields));
+
+    // Validate once here so that lookups never have to
+    if (t_pool[hdr.pool_sz - 1] != 0)
+        return false;
+
+    for (size_t x = 1; x < hdr.n_records; x++) {
+        if (t_keys[x] <= t_keys[x - 1])
+            return false;
+    }
+
+    for (size_t x = 0; x < (size_t) hdr.n_records * hdr.n_fields; x++) {
+        if (t_offsets[x] >= hdr.pool_sz)
+            return false;
+    }
+
+    n_records = hdr.n_records;
+    n_fields = hdr.n_fields;
+    keys = t_keys;
+    offsets = t_offsets;
+    pool = t_pool;
+
+    return true;
+}
+
+bool kis_lookup_table::map_table(const std::string& path, unsigned int in_fields) {
+    struct stat st;
+
+    unmap();
+
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(table_header)) {
+        close(fd);
+        return false;
+    }
+
+    auto base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+        return false;
+
+    map_base = base;
+    map_sz = st.st_size;
+
+    if (!attach(static_cast<const char *>(base), map_sz, in_fields)) {
+        unmap();
+        return false;
+    }
+
+    return true;
+}
+
+bool kis_lookup_table::build_table(std::vector<table_record>& records, unsigned int in_fields,
+        const std::string& path) {
+    std::vector<char> table;
+    std::vector<char> str_pool;
+    std::unordered_map<std::string, uint32_t> interned;
+
+    unmap();
+
+    if (in_fields == 0)
+        return false;
+
+    std::stable_sort(records.begin(), records.end(),
+            [](const table_record& a, const table_record& b) {
+                return a.key < b.key;
+            });
+
+    records.erase(std::unique(records.begin(), records.end(),
+                [](const table_record& a, const table_record& b) {
+                    return a.key == b.key;
+                }), records.end());
+
+    // Empty string is always offset 0
+    str_pool.push_back(0);
+    interned[""] = 0;
+
+    std::vector<uint32_t> t_keys;
+    std::vector<uint32_t> t_offsets;
+
+    t_keys.reserve(records.size());
+    t_offsets.reserve(records.size() * in_fields);
+
+    for (const auto& r : records) {
+        t_keys.push_back(r.key);
+
+        for (unsigned int f = 0; f < in_fields; f++) {
+            if (f >= r.fields.size()) {
+                t_offsets.push_back(0);
+                continue;
+            }
+
+            auto i = interned.find(r.fields[f]);
+
+            if (i != interned.end()) {
+                t_offsets.push_back(i->second);
+                continue;
+            }
+
+            uint32_t pos = str_pool.size();
+            str_pool.insert(str_pool.end(), r.fields[f].begin(), r.fields[f].end());
+            str_pool.push_back(0);
+            interned[r.fields[f]] = pos;
+            t_offsets.push_back(pos);
+        }
+    }
+
+    table_header hdr;
+    memset(&hdr, 0, sizeof(table_header));
+    memcpy(hdr.magic, lookup_table_magic, sizeof(lookup_table_magic));
+    hdr.byte_order = lookup_table_byte_order;
+    hdr.n_records = t_keys.size();
+    hdr.n_fields = in_fields;
+    hdr.pool_sz = str_pool.size();
+
+    auto keys_sz = t_keys.size() * sizeof(uint32_t);
+    auto offsets_sz = t_offsets.size() * sizeof(uint32_t);
+
+    table.resize(sizeof(table_header) + keys_sz + offsets_sz + str_pool.size());
+
+    auto pos = table.data();
+    memcpy(pos, &hdr, sizeof(table_header));
+    pos += sizeof(table_header);
+    memcpy(pos, t_keys.data(), keys_sz);
+    pos += keys_sz;
+    memcpy(pos, t_offsets.data(), offsets_sz);
+    pos += offsets_sz;
+    memcpy(pos, str_pool.data(), str_pool.size());
+
+    if (path.length() != 0) {
+        // Write to a temporary and rename so a concurrent reader never maps a partial table
+        auto tmp_path = fmt::format("{}.{}.tmp", path, getpid());
+        bool written = false;
+
+        auto tf = fopen(tmp_path.c_str(), "wb");
+
+        if (tf != nullptr) {
+            written = fwrite(table.data(), table.size(), 1, tf) == 1;
+            written = (fclose(tf) == 0) && written;
+
+            if (written)
+                written = rename(tmp_path.c_str(), path.c_str()) == 0;
+
+            if (!written)
+                unlink(tmp_path.c_str());
+        }
+
+        if (written && map_table(path, in_fields))
+            return true;
+
+        _MSG_INFO("Could not cache lookup table {}, keeping it in memory instead.", path);
+    }
+
+    mem_table = std::move(table);
+
+    if (!attach(mem_table.data(), mem_table.size(), in_fields)) {
+        unmap();
+        return false;
+    }
+
+    return true;
+}
+
+bool kis_lookup_table::load(const std::string& source_path, unsigned int in_fields,
+        parse_cb parser) {
+    struct stat src_st, tbl_st;
+
+    bool have_source = stat(source_path.c_str(), &src_st) == 0;
+
+    // kismet_manuf.txt.gz -> kismet_manuf.bin
+    auto slash = source_path.find_last_of('/');
+    auto dir = slash == std::string::npos ? std::string("") : source_path.substr(0, slash + 1);
+    auto name = slash == std::string::npos ? source_path : source_path.substr(slash + 1);
+
+    for (auto ext : {".gz", ".txt"}) {
+        auto ext_len = strlen(ext);
+        if (name.length() > ext_len && name.compare(name.length() - ext_len, ext_len, ext) == 0)
+            name = name.substr(0, name.length() - ext_len);
+    }
+
+    name += ".bin";
+
+    auto config_dir =
+        Globalreg::globalreg->kismet_config->fetch_opt_path("configdir", "%h/.kismet/");
+
+    auto installed_path = dir + name;
+    auto cache_path = config_dir + "/" + name;
+
+    for (const auto& p : {installed_path, cache_path}) {
+        if (stat(p.c_str(), &tbl_st) < 0)
+            continue;
+
+        // A table older than its source is stale and is rebuilt
+        if (have_source && tbl_st.st_mtime < src_st.st_mtime)
+            continue;
+
+        if (map_table(p, in_fields))
+            return true;
+    }
+
+    if (!have_source)
+        return false;
+
+    std::vector<table_record> records;
+
+    if (!parser(records))
+        return false;
+
+    return build_table(records, in_fields, cache_path);
+}
+
+long kis_lookup_table::find(uint32_t key) const {
+    if (keys == nullptr)
+        return -1;
+
+    auto end = keys + n_records;
+    auto i = std::lower_bound(keys, end, key);
+
+    if (i == end || *i != key)
+        return -1;
+
+    return i - keys;
+}
+
@@ -0,0 +1,128 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_LOOKUP_TABLE_H__
+#define __KIS_LOOKUP_TABLE_H__
+
+#include "config.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h>
+#endif
+
+// Compact, read-only lookup table of 32 bit keys (OUIs, ICAO addresses) to a fixed
+// number of string fields.
+//
+// The binary table is a header, the sorted array of keys, an array of offsets (one per
+// field per record) into a string pool, and the pool of interned, null-terminated
+// strings:
+//
+//   header       magic "KISLKUP1", byte order marker 0x01020304, record count,
+//                field count, pool size, 8 reserved bytes
+//   keys         uint32_t[records]
+//   offsets      uint32_t[records * fields]
+//   pool         char[pool size]
+//
+// Strings are stored as they appear in the source; offset 0 is always the empty string.
+//
+// Tables are generated by tools/create_oui_db.py at build time, or generated from the
+// text database on first load and cached in the Kismet config directory.  Once loaded
+// the table is never modified, so lookups do not need a lock.
+
+class kis_lookup_table {
+public:
+    struct table_header {
+        char magic[8];
+        uint32_t byte_order;
+        uint32_t n_records;
+        uint32_t n_fields;
+        uint32_t pool_sz;
+        uint32_t reserved[2];
+    };
+
+    struct table_record {
+        uint32_t key;
+        std::vector<std::string> fields;
+    };
+
+    // Parse the text form of a database into records, returning false on error
+    using parse_cb = std::function<bool (std::vector<table_record>&)>;
+
+    kis_lookup_table();
+    ~kis_lookup_table();
+
+    kis_lookup_table(const kis_lookup_table&) = delete;
+    kis_lookup_table& operator=(const kis_lookup_table&) = delete;
+
+    // Load the table for a text database.  A table installed beside the source file
+    // (kismet_manuf.txt.gz -> kismet_manuf.bin) is used if it is current, then a table
+    // cached in the config directory, and otherwise the source is parsed and the
+    // resulting table is cached for next time.
+    bool load(const std::string& source_path, unsigned int n_fields, parse_cb parser);
+
+    // Map an existing table file
+    bool map_table(const std::string& path, unsigned int n_fields);
+
+    // Build a table from parsed records and write it to path; if the table can't be
+    // written and mapped it is kept in memory instead.  Records are sorted, and only the
+    // first record of any duplicate key is kept.
+    bool build_table(std::vector<table_record>& records, unsigned int n_fields,
+            const std::string& path);
+
+    bool is_loaded() const {
+        return keys != nullptr;
+    }
+
+    size_t size() const {
+        return n_records;
+    }
+
+    // Index of the record for a key, or -1
+    long find(uint32_t key) const;
+
+    // Field of a record; always a valid, null-terminated string
+    const char *field(size_t record, unsigned int field) const {
+        return pool + offsets[record * n_fields + field];
+    }
+
+protected:
+    void unmap();
+    bool attach(const char *base, size_t sz, unsigned int n_fields);
+
+    void *map_base;
+    size_t map_sz;
+
+    // Table storage when it could not be written and mapped
+    std::vector<char> mem_table;
+
+    uint32_t n_records;
+    uint32_t n_fields;
+
+    const uint32_t *keys;
+    const uint32_t *offsets;
+    const char *pool;
+};
+
+#endif
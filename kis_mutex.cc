@@ -0,0 +1,215 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <algorithm>
+
+#include "kis_mutex.h"
+
+std::atomic<bool> kis_lock_profiler::enabled{false};
+
+namespace {
+    // Distinct mutex and op pairs each thread can track; must be a power of two
+    const size_t n_lock_sites = 1024;
+
+    struct lock_site {
+        // Set by the owning thread once op and mutex_name are filled in, and never
+        // cleared, so readers can use the key fields of any used site
+        std::atomic<bool> used{false};
+        const char *op{nullptr};
+        std::string mutex_name;
+
+        std::atomic<uint64_t> count{0}, contended{0};
+        std::atomic<uint64_t> wait_ns{0}, max_wait_ns{0};
+        std::atomic<uint64_t> hold_ns{0}, max_hold_ns{0};
+    };
+
+    struct thread_lock_sites {
+        lock_site sites[n_lock_sites];
+        std::atomic<uint64_t> overflow{0};
+    };
+
+    // Plain std::mutex; a kis_mutex here would profile itself
+    std::mutex lock_sites_mutex;
+    std::vector<std::unique_ptr<thread_lock_sites>> lock_sites_tables;
+
+    thread_lock_sites *local_lock_sites() {
+        static thread_local thread_lock_sites *sites = nullptr;
+
+        if (sites != nullptr)
+            return sites;
+
+        std::lock_guard<std::mutex> lk(lock_sites_mutex);
+
+        lock_sites_tables.push_back(std::make_unique<thread_lock_sites>());
+        sites = lock_sites_tables.back().get();
+
+        return sites;
+    }
+
+    // Counters are only written by the thread owning the table
+    void add_counter(std::atomic<uint64_t>& c, uint64_t v) {
+        c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+
+    void max_counter(std::atomic<uint64_t>& c, uint64_t v) {
+        if (v > c.load(std::memory_order_relaxed))
+            c.store(v, std::memory_order_relaxed);
+    }
+}
+
+void kis_lock_profiler::record(const std::string& mutex_name, const char *op, bool contended,
+        uint64_t wait_ns, uint64_t hold_ns) {
+    auto t = local_lock_sites();
+
+    // Op sites are string literals, so the pointer identifies the site; the same
+    // op is often used on many mutexes ("UNKNOWN", __func__ in component accessors)
+    // so the name is part of the key
+    size_t h = (reinterpret_cast<uintptr_t>(op) * 0x9e3779b97f4a7c15ULL) ^
+        std::hash<std::string>{}(mutex_name);
+
+    lock_site *site = nullptr;
+
+    for (size_t i = 0; i < n_lock_sites; i++) {
+        auto& s = t->sites[(h + i) & (n_lock_sites - 1)];
+
+        if (!s.used.load(std::memory_order_relaxed)) {
+            s.op = op;
+            s.mutex_name = mutex_name;
+            s.used.store(true, std::memory_order_release);
+            site = &s;
+            break;
+        }
+
+        if (s.op == op && s.mutex_name == mutex_name) {
+            site = &s;
+            break;
+        }
+    }
+
+    if (site == nullptr) {
+        add_counter(t->overflow, 1);
+        return;
+    }
+
+    add_counter(site->count, 1);
+
+    if (contended) {
+        add_counter(site->contended, 1);
+        add_counter(site->wait_ns, wait_ns);
+        max_counter(site->max_wait_ns, wait_ns);
+    }
+
+    add_counter(site->hold_ns, hold_ns);
+    max_counter(site->max_hold_ns, hold_ns);
+}
+
+std::vector<kis_lock_profiler::lock_stats> kis_lock_profiler::report(bool per_op,
+        size_t max_entries) {
+    // The same op literal can have a different address in each object, so merge by
+    // the op text
+    std::map<std::pair<std::string, std::string>, lock_stats> totals;
+
+    {
+        std::lock_guard<std::mutex> lk(lock_sites_mutex);
+
+        for (const auto& t : lock_sites_tables) {
+            for (const auto& s : t->sites) {
+                if (!s.used.load(std::memory_order_acquire))
+                    continue;
+
+                std::string op;
+                if (per_op)
+                    op = s.op != nullptr ? s.op : "UNKNOWN";
+
+                auto& st = totals[std::make_pair(s.mutex_name, op)];
+
+                st.count += s.count.load(std::memory_order_relaxed);
+                st.contended += s.contended.load(std::memory_order_relaxed);
+                st.wait_ns += s.wait_ns.load(std::memory_order_relaxed);
+                st.max_wait_ns = std::max(st.max_wait_ns, s.max_wait_ns.load(std::memory_order_relaxed));
+                st.hold_ns += s.hold_ns.load(std::memory_order_relaxed);
+                st.max_hold_ns = std::max(st.max_hold_ns, s.max_hold_ns.load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+    std::vector<lock_stats> ret;
+    ret.reserve(totals.size());
+
+    for (auto& t : totals) {
+        t.second.mutex_name = t.first.first;
+        t.second.op = t.first.second;
+        ret.push_back(std::move(t.second));
+    }
+
+    std::sort(ret.begin(), ret.end(), [](const lock_stats& a, const lock_stats& b) -> bool {
+            if (a.wait_ns != b.wait_ns)
+                return a.wait_ns > b.wait_ns;
+            return a.contended > b.contended;
+        });
+
+    if (max_entries != 0 && ret.size() > max_entries)
+        ret.resize(max_entries);
+
+    return ret;
+}
+
+uint64_t kis_lock_profiler::overflow() {
+    std::lock_guard<std::mutex> lk(lock_sites_mutex);
+
+    uint64_t ret = 0;
+
+    for (const auto& t : lock_sites_tables)
+        ret += t->overflow.load(std::memory_order_relaxed);
+
+    return ret;
+}
+
+void kis_lock_profiler::dump(FILE *f, size_t max_entries) {
+    if (!active()) {
+        fmt::print(f, "Lock profiler is not enabled; set 'lock_profiler=true' to enable it\n");
+        fflush(f);
+        return;
+    }
+
+    auto print_stats = [f](const std::vector<lock_stats>& stats) {
+        fmt::print(f, "  {:>12} {:>10} {:>12} {:>12} {:>12} {:>12}  {}\n",
+                "locks", "contended", "wait ms", "max wait us", "hold ms", "max hold us", "mutex / op");
+
+        for (const auto& s : stats) {
+            fmt::print(f, "  {:>12} {:>10} {:>12.3f} {:>12.1f} {:>12.3f} {:>12.1f}  {}{}{}\n",
+                    s.count, s.contended,
+                    s.wait_ns / 1e6, s.max_wait_ns / 1e3, s.hold_ns / 1e6, s.max_hold_ns / 1e3,
+                    s.mutex_name, s.op.length() ? " / " : "", s.op);
+        }
+    };
+
+    fmt::print(f, "Lock contention by mutex, top {}:\n", max_entries);
+    print_stats(report(false, max_entries));
+
+    fmt::print(f, "Lock contention by op, top {}:\n", max_entries);
+    print_stats(report(true, max_entries));
+
+    auto lost = overflow();
+    if (lost != 0)
+        fmt::print(f, "{} locks not recorded, too many distinct mutex and op sites\n", lost);
+
+    fflush(f);
+}
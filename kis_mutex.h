@@ -29,9 +29,12 @@
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <limits.h>
+#include <stdio.h>
 
 #include "fmt.h"
 
@@ -86,6 +89,28 @@ public:
     }
 };
 
+// Minimal spinlock for short critical sections on small, numerous records (packed RRDs,
+// compact device fields) where a kis_mutex per record would cost more than the data it
+// protects.  Never hold it across anything that can block.
+class kis_spinlock {
+public:
+    void lock() {
+        while (flag.test_and_set(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    bool try_lock() {
+        return !flag.test_and_set(std::memory_order_acquire);
+    }
+
+    void unlock() {
+        flag.clear(std::memory_order_release);
+    }
+
+protected:
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
 class kis_shared_mutex {
 private:
     std::shared_timed_mutex mutex;
@@ -155,6 +180,128 @@ public:
     }
 };
 
+// Optional lock contention profiler, enabled with 'lock_profiler=true'.  When enabled,
+// kis_lock_guard and kis_unique_lock time how long each acquisition waited for the
+// mutex and how long it was then held, keyed by the mutex name and the op site passed
+// to the lock.  Each thread accumulates into its own table, so the counters are only
+// ever written by one thread; reports sum the tables of every thread.
+//
+// When disabled the only cost to a lock is checking the flag.
+class kis_lock_profiler {
+public:
+    static std::atomic<bool> enabled;
+
+    static bool active() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Record one acquisition in the table of the calling thread
+    static void record(const std::string& mutex_name, const char *op, bool contended,
+            uint64_t wait_ns, uint64_t hold_ns);
+
+    struct lock_stats {
+        std::string mutex_name;
+        // Empty when totalled per mutex
+        std::string op;
+        uint64_t count {0};
+        uint64_t contended {0};
+        uint64_t wait_ns {0};
+        uint64_t max_wait_ns {0};
+        uint64_t hold_ns {0};
+        uint64_t max_hold_ns {0};
+    };
+
+    // Totals per op site, or per mutex, across all threads, sorted by the total time
+    // spent waiting.  A max_entries of 0 returns everything.
+    static std::vector<lock_stats> report(bool per_op, size_t max_entries);
+
+    // Acquisitions which didn't fit in the per-thread tables
+    static uint64_t overflow();
+
+    // Print the most contended mutexes and sites, for the SIGUSR1 handler
+    static void dump(FILE *f, size_t max_entries);
+};
+
+// Per-lock timing state for the profiler; acquired_ns is only set when the
+// acquisition is being profiled.
+class kis_lock_timing {
+public:
+    template<class M>
+    void lock(M& m) {
+        if (!kis_lock_profiler::active()) {
+            m.lock();
+            return;
+        }
+
+        if (m.try_lock()) {
+            acquired_ns = kis_lock_profiler::now_ns();
+            wait_ns = 0;
+            contended = false;
+            return;
+        }
+
+        auto start_ns = kis_lock_profiler::now_ns();
+        m.lock();
+        acquired_ns = kis_lock_profiler::now_ns();
+        wait_ns = acquired_ns - start_ns;
+        contended = true;
+    }
+
+    template<class M>
+    bool try_lock(M& m) {
+        if (!m.try_lock())
+            return false;
+
+        adopt();
+        return true;
+    }
+
+    // Start timing a lock which was acquired elsewhere
+    void adopt() {
+        if (!kis_lock_profiler::active())
+            return;
+
+        acquired_ns = kis_lock_profiler::now_ns();
+        wait_ns = 0;
+        contended = false;
+    }
+
+    template<class M>
+    void unlock(M& m, const char *op) {
+        if (acquired_ns == 0) {
+            m.unlock();
+            return;
+        }
+
+        auto hold_ns = kis_lock_profiler::now_ns() - acquired_ns;
+        m.unlock();
+
+        kis_lock_profiler::record(m.get_name(), op, contended, wait_ns, hold_ns);
+        acquired_ns = 0;
+    }
+
+    // Record the wait of a lock which is being handed off still held; whoever
+    // releases it isn't timed, so the hold time is unknown
+    template<class M>
+    void retain(M& m, const char *op) {
+        if (acquired_ns == 0)
+            return;
+
+        kis_lock_profiler::record(m.get_name(), op, contended, wait_ns, 0);
+        acquired_ns = 0;
+    }
+
+protected:
+    uint64_t acquired_ns {0};
+    uint64_t wait_ns {0};
+    bool contended {false};
+};
+
 namespace kismet {
     typedef struct { } retain_lock_t;
     constexpr retain_lock_t retain_lock;
@@ -166,23 +313,25 @@ namespace kismet {
 template<class M>
 class kis_lock_guard {
 public:
-    kis_lock_guard(M& m, const std::string& op = "UNKNOWN") :
+    kis_lock_guard(M& m, const char *op = "UNKNOWN") :
         mutex{m},
         op{op},
         retain{false} {
-            mutex.lock();
+            timing.lock(mutex);
         }
 
-    kis_lock_guard(M& m, std::adopt_lock_t t, const std::string& op = "UNKNOWN") :
+    kis_lock_guard(M& m, std::adopt_lock_t t, const char *op = "UNKNOWN") :
         mutex{m},
         op{op},
-        retain{false} { }
+        retain{false} {
+            timing.adopt();
+        }
 
-    kis_lock_guard(M& m, kismet::retain_lock_t t, const std::string& op = "UNKNOWN") :
+    kis_lock_guard(M& m, kismet::retain_lock_t t, const char *op = "UNKNOWN") :
         mutex{m},
         op{op},
         retain{true} {
-            mutex.lock();
+            timing.lock(mutex);
         }
 
     kis_lock_guard(const kis_lock_guard&) = delete;
@@ -190,20 +339,23 @@ public:
 
     ~kis_lock_guard() {
         if (!retain) {
-            mutex.unlock();
+            timing.unlock(mutex, op);
+        } else {
+            timing.retain(mutex, op);
         }
     }
 
 protected:
     M& mutex;
-    std::string op;
+    const char *op;
     bool retain;
+    kis_lock_timing timing;
 };
 
 template<class M>
 class kis_unique_lock {
 public:
-    kis_unique_lock(M& m, const std::string& op) :
+    kis_unique_lock(M& m, const char *op) :
         mutex{m},
         op{op} {
             /*
@@ -211,46 +363,48 @@ public:
                 throw std::runtime_error(fmt::format("potential deadlock: mutex {} not available within "
                             "timeout period for op {}", mutex.get_name(), op));
                             */
-            mutex.lock();
+            timing.lock(mutex);
             locked = true;
         }
 
-    kis_unique_lock(M& m, std::defer_lock_t t, const std::string& op = "UNKNOWN") :
+    kis_unique_lock(M& m, std::defer_lock_t t, const char *op = "UNKNOWN") :
         mutex{m},
         op{op},
         locked{false} { }
 
-    kis_unique_lock(M& m, std::adopt_lock_t, const std::string& op = "UNKNOWN") :
+    kis_unique_lock(M& m, std::adopt_lock_t, const char *op = "UNKNOWN") :
         mutex{m},
         op{op},
-        locked{true} { }
+        locked{true} {
+            timing.adopt();
+        }
 
     kis_unique_lock(const kis_unique_lock&) = delete;
     kis_unique_lock& operator=(const kis_unique_lock&) = delete;
 
     ~kis_unique_lock() {
         if (locked)
-            mutex.unlock();
+            timing.unlock(mutex, this->op);
     }
 
-    void lock(const std::string& op = "UNKNOWN") {
+    void lock(const char *op = "UNKNOWN") {
         if (locked)
             throw std::runtime_error(fmt::format("invalid use: thread {} attempted to lock "
                         "unique lock {} when already locked for {}", 
                         std::this_thread::get_id(), mutex.get_name(), op));
-        mutex.lock();
+        timing.lock(mutex);
         locked = true;
 
     }
 
-    bool try_lock(const std::string& op = "UNKNOWN") {
+    bool try_lock(const char *op = "UNKNOWN") {
         if (locked)
             throw std::runtime_error(fmt::format("invalid use: thread {} attempted to try_lock "
                         "unique lock {} when already locked for {}", 
                         std::this_thread::get_id(), mutex.get_name(), op));
 
         // auto r = mutex.try_lock_for(std::chrono::seconds(KIS_THREAD_TIMEOUT));
-        auto r = mutex.try_lock();
+        auto r = timing.try_lock(mutex);
         locked = r;
 
         return r;
@@ -262,32 +416,33 @@ public:
                         "unique lock {} when not locked", std::this_thread::get_id(), 
                         mutex.get_name()));
 
-        mutex.unlock();
+        timing.unlock(mutex, this->op);
         locked = false;
     }
 
 protected:
     M& mutex;
-    std::string op;
+    const char *op;
     bool locked{false};
+    kis_lock_timing timing;
 };
 
 template<class M>
 class kis_shared_lock {
 public:
-    kis_shared_lock(M& m, const std::string& op) :
+    kis_shared_lock(M& m, const char *op) :
         mutex{m},
         op{op} {
             mutex.shared_lock();
             locked = true;
         }
 
-    kis_shared_lock(M& m, std::defer_lock_t t, const std::string& op = "UNKNOWN") :
+    kis_shared_lock(M& m, std::defer_lock_t t, const char *op = "UNKNOWN") :
         mutex{m},
         op{op},
         locked{false} { }
 
-    kis_shared_lock(M& m, std::adopt_lock_t, const std::string& op = "UNKNOWN") :
+    kis_shared_lock(M& m, std::adopt_lock_t, const char *op = "UNKNOWN") :
         mutex{m},
         op{op},
         locked{true} { }
@@ -300,7 +455,7 @@ public:
             mutex.shared_unlock();
     }
 
-    void lock(const std::string& op = "UNKNOWN") {
+    void lock(const char *op = "UNKNOWN") {
         if (locked)
             throw std::runtime_error(fmt::format("invalid use: thread {} attempted to lock "
                         "unique lock {} when already locked for {}", 
@@ -322,7 +477,7 @@ public:
 
 protected:
     M& mutex;
-    std::string op;
+    const char *op;
     bool locked{false};
 };
 
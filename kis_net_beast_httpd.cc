@@ -23,6 +23,7 @@
 #include <random>
 
 #include <stdio.h>
+#include <zlib.h>
 
 #include "globalregistry.h"
 
@@ -31,6 +32,7 @@
 #include "configfile.h"
 #include "messagebus.h"
 #include "util.h"
+#include "xxhash.h"
 
 const std::string kis_net_beast_httpd::LOGON_ROLE{"admin"};
 const std::string kis_net_beast_httpd::ANY_ROLE{"any"};
@@ -75,12 +77,240 @@ std::shared_ptr<kis_net_beast_httpd> kis_net_beast_httpd::create_httpd() {
     return mon;
 }
 
+kis_net_beast_worker_pool::kis_net_beast_worker_pool(const std::string& name, size_t max_threads) :
+    state{std::make_shared<pool_state>()} {
+    state->name = name;
+    state->max_threads = std::max((size_t) 1, max_threads);
+    state->n_threads = 0;
+    state->n_idle = 0;
+    state->shutdown = false;
+}
+
+kis_net_beast_worker_pool::~kis_net_beast_worker_pool() {
+    stop();
+}
+
+bool kis_net_beast_worker_pool::post(std::function<void ()> work) {
+    std::lock_guard<std::mutex> lk(state->mutex);
+
+    if (state->shutdown)
+        return false;
+
+    state->queue.push_back(work);
+
+    // Wake an idle thread if there is one for this work, otherwise start a new thread if we
+    // can; if we're at the limit the work waits for the next free thread
+    if (state->n_idle >= state->queue.size()) {
+        state->cv.notify_one();
+    } else if (state->n_threads < state->max_threads) {
+        state->n_threads++;
+        std::thread(&kis_net_beast_worker_pool::worker, state).detach();
+    }
+
+    return true;
+}
+
+void kis_net_beast_worker_pool::stop() {
+    std::lock_guard<std::mutex> lk(state->mutex);
+    state->shutdown = true;
+    state->queue.clear();
+    state->cv.notify_all();
+}
+
+size_t kis_net_beast_worker_pool::threads() {
+    std::lock_guard<std::mutex> lk(state->mutex);
+    return state->n_threads;
+}
+
+size_t kis_net_beast_worker_pool::busy() {
+    std::lock_guard<std::mutex> lk(state->mutex);
+    return state->n_threads - state->n_idle;
+}
+
+size_t kis_net_beast_worker_pool::queued() {
+    std::lock_guard<std::mutex> lk(state->mutex);
+    return state->queue.size();
+}
+
+void kis_net_beast_worker_pool::worker(std::shared_ptr<pool_state> state) {
+    thread_set_process_name(state->name);
+
+    std::unique_lock<std::mutex> lk(state->mutex);
+
+    while (true) {
+        state->n_idle++;
+        state->cv.wait_for(lk, std::chrono::seconds(30),
+                [&state]() { return state->shutdown || !state->queue.empty(); });
+        state->n_idle--;
+
+        // Idle too long, or shutting down
+        if (state->queue.empty()) {
+            state->n_threads--;
+            return;
+        }
+
+        auto work = std::move(state->queue.front());
+        state->queue.pop_front();
+
+        lk.unlock();
+
+        try {
+            work();
+        } catch (const std::exception& e) {
+            _MSG_ERROR("Unhandled error in HTTP worker: {}", e.what());
+        }
+
+        // Release anything the work captured before going idle
+        work = nullptr;
+
+        lk.lock();
+    }
+}
+
+kis_net_beast_response_cache::kis_net_beast_response_cache(size_t max_entries, size_t max_body,
+        bool gzip) :
+    max_entries{max_entries},
+    max_body_{max_body},
+    gzip{gzip},
+    hits_{0},
+    misses_{0},
+    not_modified_{0} {
+    mutex.set_name("kis_net_beast_response_cache");
+}
+
+kis_net_beast_response_cache::shared_entry kis_net_beast_response_cache::get(const slot& s) {
+    try {
+        return s.future.get();
+    } catch (const std::future_error& e) {
+        // The generating request gave up on it
+        return nullptr;
+    }
+}
+
+kis_net_beast_response_cache::shared_entry kis_net_beast_response_cache::lookup(const std::string& key,
+        time_t generation, lead_t& lead) {
+    std::shared_future<shared_entry> wait_future;
+
+    {
+        kis_lock_guard<kis_mutex> lk(mutex, "response_cache lookup");
+
+        auto si = slots.find(key);
+
+        if (si != slots.end()) {
+            if (!ready(si->second)) {
+                // Still being generated, possibly for the previous tick; close enough, and
+                // much cheaper than generating it again
+                wait_future = si->second.future;
+            } else if (si->second.generation == generation) {
+                auto e = get(si->second);
+
+                if (e != nullptr) {
+                    hits_++;
+                    return e;
+                }
+            }
+        } else if (slots.size() >= max_entries) {
+            for (auto i = slots.begin(); i != slots.end(); ) {
+                if (i->second.generation != generation && ready(i->second))
+                    i = slots.erase(i);
+                else
+                    ++i;
+            }
+
+            // Too many distinct requests this tick; don't cache
+            if (slots.size() >= max_entries) {
+                misses_++;
+                return nullptr;
+            }
+        }
+
+        if (!wait_future.valid()) {
+            misses_++;
+
+            lead = std::make_shared<std::promise<shared_entry>>();
+            slots[key] = slot{generation, lead->get_future().share()};
+
+            return nullptr;
+        }
+    }
+
+    auto e = get(slot{generation, wait_future});
+
+    if (e != nullptr)
+        hits_++;
+    else
+        misses_++;
+
+    return e;
+}
+
+kis_net_beast_response_cache::shared_entry kis_net_beast_response_cache::complete(lead_t& lead,
+        const std::string& content_type, std::string body) {
+    auto e = std::make_shared<entry>();
+
+    e->content_type = content_type;
+    e->etag = fmt::format("\"{:016x}\"", XXH64(body.data(), body.size(), 0));
+
+    // Small responses aren't worth compressing
+    if (gzip && body.size() > 1024) {
+        z_stream zs;
+        memset(&zs, 0, sizeof(z_stream));
+
+        // 15 window bits + 16 for a gzip header
+        if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+            e->gz_body.resize(deflateBound(&zs, body.size()));
+
+            zs.next_in = reinterpret_cast<Bytef *>(&body[0]);
+            zs.avail_in = body.size();
+            zs.next_out = reinterpret_cast<Bytef *>(&e->gz_body[0]);
+            zs.avail_out = e->gz_body.size();
+
+            if (deflate(&zs, Z_FINISH) == Z_STREAM_END)
+                e->gz_body.resize(zs.total_out);
+            else
+                e->gz_body.clear();
+
+            deflateEnd(&zs);
+        }
+    }
+
+    e->body = std::move(body);
+
+    lead->set_value(e);
+    lead.reset();
+
+    return e;
+}
+
+size_t kis_net_beast_response_cache::size() {
+    kis_lock_guard<kis_mutex> lk(mutex, "response_cache size");
+    return slots.size();
+}
+
 kis_net_beast_httpd::kis_net_beast_httpd(boost::asio::ip::tcp::endpoint& endpoint) :
     lifetime_global{},
     deferred_startup{},
     running{false},
     endpoint{endpoint},
-    acceptor{Globalreg::globalreg->io} {
+    acceptor{Globalreg::globalreg->io},
+    request_pool{"beast request",
+        (size_t) Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_max_request_threads", 32)},
+    generator_pool{"beast generator",
+        (size_t) Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_max_generator_threads", 64)},
+    connections_total{0},
+    requests_total{0},
+    request_latency_total_us{0},
+    request_latency_max_us{0} {
+
+    for (size_t i = 0; i < n_latency_buckets; i++)
+        request_latency_buckets[i] = 0;
+
+    if (Globalreg::globalreg->kismet_config->fetch_opt_bool("httpd_response_cache", true)) {
+        response_cache_ = std::make_shared<kis_net_beast_response_cache>(
+                Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_response_cache_entries", 256),
+                Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_response_cache_max_kb", 16384) * 1024,
+                Globalreg::globalreg->kismet_config->fetch_opt_bool("httpd_response_cache_gzip", true));
+    }
 
     route_mutex.set_name("kis_net_beast_httpd route vector");
     auth_mutex.set_name("kis_net_beast_httpd auth");
@@ -99,6 +329,8 @@ void kis_net_beast_httpd::trigger_deferred_startup() {
     register_mime_type("itjson", "application/json");
     register_mime_type("cmd", "application/json");
     register_mime_type("jcmd", "application/json");
+    register_mime_type("cbor", "application/cbor");
+    register_mime_type("msgpack", "application/msgpack");
     register_mime_type("xml", "application/xml");
     register_mime_type("png", "image/png");
     register_mime_type("jpg", "image/jpeg");
@@ -381,6 +613,49 @@ void kis_net_beast_httpd::trigger_deferred_startup() {
                 }, auth_mutex));
 
 
+    register_route("/httpd/stats", {"GET"}, RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+
+                // Not a tracked component, like the auth list above; this is only polled by
+                // diagnostic tools
+                auto ret = std::make_shared<tracker_element_string_map>();
+
+                auto add_u64 = [&ret](const std::string& k, uint64_t v) {
+                    ret->insert(std::make_pair(k, std::make_shared<tracker_element_uint64>(0, v)));
+                };
+
+                uint64_t n_requests = requests_total;
+
+                add_u64("kismet.httpd.connections_open", Globalreg::n_tracked_http_connections);
+                add_u64("kismet.httpd.connections_total", connections_total);
+                add_u64("kismet.httpd.requests_total", n_requests);
+                add_u64("kismet.httpd.request_latency_max_us", request_latency_max_us);
+                add_u64("kismet.httpd.request_latency_avg_us",
+                        n_requests == 0 ? 0 : request_latency_total_us / n_requests);
+
+                auto buckets = std::make_shared<tracker_element_vector_double>();
+                for (size_t i = 0; i < n_latency_buckets; i++)
+                    buckets->push_back(request_latency_buckets[i]);
+                ret->insert(std::make_pair("kismet.httpd.request_latency_histogram", buckets));
+
+                add_u64("kismet.httpd.request_threads", request_pool.threads());
+                add_u64("kismet.httpd.request_threads_busy", request_pool.busy());
+                add_u64("kismet.httpd.request_queue", request_pool.queued());
+                add_u64("kismet.httpd.generator_threads", generator_pool.threads());
+                add_u64("kismet.httpd.generator_threads_busy", generator_pool.busy());
+                add_u64("kismet.httpd.generator_queue", generator_pool.queued());
+
+                if (response_cache_ != nullptr) {
+                    add_u64("kismet.httpd.cache_entries", response_cache_->size());
+                    add_u64("kismet.httpd.cache_hits", response_cache_->hits());
+                    add_u64("kismet.httpd.cache_misses", response_cache_->misses());
+                    add_u64("kismet.httpd.cache_not_modified", response_cache_->not_modified());
+                }
+
+                return ret;
+                }));
+
     // Test echo websocket
     register_websocket_route("/debug/echo", LOGON_ROLE, {"ws"},
             std::make_shared<kis_net_web_function_endpoint>(
@@ -486,39 +761,92 @@ void kis_net_beast_httpd::handle_connection(const boost::system::error_code& ec,
     if (!running)
         return;
 
-	// Spin each connection into its own thread
     if (!ec) {
-        std::thread conthread([this, tcp_socket = boost::beast::tcp_stream(std::move(socket))]() mutable {
-                thread_set_process_name("beast connection");
+        connections_total++;
+        read_request(std::make_shared<kis_net_beast_httpd_session>(std::move(socket)));
+    }
 
-                while (tcp_socket.socket().is_open()) {
-					// Reset the timeout every loop through; each request in this 
-					// socket pipeline has up to 30 seconds to complete
-					boost::beast::get_lowest_layer(tcp_socket).expires_after(std::chrono::seconds(30));
+    // Accept another connection
+    return start_accept();
+}
 
-                    // Associate the socket
-                    auto conn = 
-                        std::make_shared<kis_net_beast_httpd_connection>(tcp_socket, shared_from_this());
+void kis_net_beast_httpd::read_request(std::shared_ptr<kis_net_beast_httpd_session> session) {
+    // Each request in this socket pipeline has up to 30 seconds to arrive
+    session->stream.expires_after(std::chrono::seconds(30));
 
-                    // Run the connection
-                    auto retain = conn->start();
+    session->parser.emplace();
+    session->parser->body_limit(100000);
 
-                    if (retain == false)
-                        break;
-                }
+    boost::beast::http::async_read(session->stream, session->buffer, *session->parser,
+            [self = shared_from_this(), session](const boost::system::error_code& ec, size_t) {
+                self->handle_read(session, ec);
+            });
+}
 
-                try {
-                    tcp_socket.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send);
-                } catch (...) {
-                    ;
-                }
+void kis_net_beast_httpd::handle_read(std::shared_ptr<kis_net_beast_httpd_session> session,
+        const boost::system::error_code& ec) {
+    // Silently drop the connection on any error from the transport layer, because we don't
+    // care; we can't deal with a broken client spamming us.  The socket closes when the
+    // last reference to the session goes away.
+    if (ec || !running) {
+        try {
+            session->stream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send);
+        } catch (...) {
+            ;
+        }
+
+        return;
+    }
+
+    session->stream.expires_never();
+
+    // Handlers block, so they run on the request workers instead of the IO threads
+    request_pool.post([self = shared_from_this(), session]() {
+            self->run_request(session);
+        });
+}
+
+void kis_net_beast_httpd::run_request(std::shared_ptr<kis_net_beast_httpd_session> session) {
+    auto start_ts = std::chrono::steady_clock::now();
+
+    bool retain = false;
+
+    {
+        auto conn = std::make_shared<kis_net_beast_httpd_connection>(session, shared_from_this());
+        retain = conn->start();
+    }
+
+    requests_total++;
+    record_request_latency(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start_ts).count());
+
+    if (!retain || !running)
+        return;
+
+    // Go back to waiting on the socket, from its own executor
+    boost::asio::dispatch(session->stream.get_executor(),
+            [self = shared_from_this(), session]() {
+                self->read_request(session);
             });
+}
+
+void kis_net_beast_httpd::record_request_latency(uint64_t latency_us) {
+    request_latency_total_us += latency_us;
 
-        conthread.detach();
+    auto prev_max = request_latency_max_us.load();
+    while (latency_us > prev_max &&
+            !request_latency_max_us.compare_exchange_weak(prev_max, latency_us))
+        ;
+
+    size_t bucket = 0;
+    uint64_t limit = 1000;
+
+    while (bucket < n_latency_buckets - 1 && latency_us >= limit) {
+        bucket++;
+        limit *= 10;
     }
 
-    // Accept another connection
-    return start_accept();
+    request_latency_buckets[bucket]++;
 }
 
 std::string kis_net_beast_httpd::decode_uri(boost::beast::string_view in, bool query) {
@@ -730,6 +1058,17 @@ void kis_net_beast_httpd::register_route(const std::string& route,
     route_vec.emplace_back(std::make_shared<kis_net_beast_route>(route, b_verbs, true, roles, extensions, handler));
 }
 
+void kis_net_beast_httpd::enable_route_cache(const std::string& route) {
+    kis_lock_guard<kis_mutex> lk(route_mutex, "beast_httpd enable_route_cache");
+
+    for (const auto& r : route_vec) {
+        if (r->route() == route) {
+            r->set_cacheable(true);
+            return;
+        }
+    }
+}
+
 void kis_net_beast_httpd::remove_route(const std::string& route) {
     kis_lock_guard<kis_mutex> lk(route_mutex, "beast_httpd remove_route");
 
@@ -1147,17 +1486,16 @@ void kis_net_beast_httpd::strip_uri_prefix(boost::beast::string_view& uri_view)
 
 
 
-kis_net_beast_httpd_connection::kis_net_beast_httpd_connection(boost::beast::tcp_stream& socket,
+kis_net_beast_httpd_connection::kis_net_beast_httpd_connection(std::shared_ptr<kis_net_beast_httpd_session> session,
         std::shared_ptr<kis_net_beast_httpd> httpd) :
     httpd{httpd},
-    stream_{socket},
+    session_{session},
+    stream_{session->stream},
+    request_{session->parser->release()},
     login_valid_{false},
-    first_response_write{false} {
-        Globalreg::n_tracked_http_connections++;
-    }
+    first_response_write{false} { }
 
 kis_net_beast_httpd_connection::~kis_net_beast_httpd_connection() {
-    Globalreg::n_tracked_http_connections--;
     if (closure_cb)
         closure_cb();
 }
@@ -1203,19 +1541,6 @@ void kis_net_beast_httpd_connection::append_header(const std::string& header, co
 }
 
 bool kis_net_beast_httpd_connection::start() {
-    parser_.emplace();
-    parser_->body_limit(100000);
-
-    try {
-        boost::beast::http::read(stream_, buffer, *parser_);
-    } catch (const boost::system::system_error& e) {
-        // Silently catch and fail on any error from the transport layer, because we don't
-        // care; we can't deal with a broken client spamming us
-        return do_close();
-    }
-
-    request_ = boost::beast::http::request<boost::beast::http::string_body>(parser_->release());
-
     uri_ = request_.target();
     verb_ = request_.method();
 
@@ -1393,9 +1718,22 @@ bool kis_net_beast_httpd_connection::start() {
 
         boost::beast::get_lowest_layer(stream_).expires_never();
 
-        route->invoke(shared_from_this());
+        // Websocket handlers run for the life of the socket, so they get their own thread
+        // instead of tying up a request worker
+        std::thread ws_thread([route, self = shared_from_this()]() {
+                thread_set_process_name("beast websocket");
 
-        return do_close();
+                try {
+                    route->invoke(self);
+                } catch (const std::exception& e) {
+                    ;
+                }
+
+                self->do_close();
+            });
+        ws_thread.detach();
+
+        return false;
     }
 
     // Look for a route
@@ -1523,6 +1861,23 @@ bool kis_net_beast_httpd_connection::start() {
         }
     }
 
+    // Cacheable routes are served from the response cache if another request has already
+    // generated the same response this tick; otherwise this request generates it, buffering
+    // the response instead of streaming it so that it can be stored
+    auto cache = httpd->response_cache();
+    kis_net_beast_response_cache::lead_t cache_lead;
+    std::string cache_key;
+    std::string cache_body;
+
+    if (cache != nullptr && route->cacheable()) {
+        cache_key = response_cache_key();
+
+        auto cached = cache->lookup(cache_key, Globalreg::globalreg->last_tv_sec, cache_lead);
+
+        if (cached != nullptr)
+            return write_cached(cached, client_req_close);
+    }
+
     response.result(boost::beast::http::status::ok);
     response.set(boost::beast::http::field::transfer_encoding, "chunked");
 
@@ -1530,17 +1885,44 @@ bool kis_net_beast_httpd_connection::start() {
     boost::beast::http::response_serializer<boost::beast::http::buffer_body,
         boost::beast::http::fields> sr{response};
 
+    boost::system::error_code error;
+
+    auto write_chunk = [this, &sr, &error](const char *data, size_t len) -> bool {
+        // Write the headers once we have body content
+        if (!first_response_write) {
+            boost::beast::http::write_header(stream_, sr, error);
+
+            if (error) {
+                // _MSG_ERROR("(DEBUG) {} {} - Error writing headers - {}", verb_, uri_, error.message());
+                return false;
+            }
+        }
+
+        // we no longer accept header modifiers
+        first_response_write = true;
+
+        response.body().data = (void *) data;
+        response.body().size = len;
+        response.body().more = true;
 
-    // Spawn the generator thread
-    auto generator_launched = std::promise<void>();
-    auto generator_ft = generator_launched.get_future();
+        boost::beast::http::write(stream_, sr, error);
+
+        if (error == boost::beast::http::error::need_buffer) {
+            // Beast returns 'need_buffer' when it's completed writing a buffer, configure
+            // as a non-error
+            error = {};
+        } else if (error) {
+            // _MSG_INFO("(DEBUG) {} {} - chunk write error {}", verb_, uri_, error.message());
+            return false;
+        }
 
-    std::thread tr([this, route, generator_launched = std::move(generator_launched),
-            self = shared_from_this()]() mutable {
-        thread_set_process_name("beast generator");
+        return true;
+    };
 
-        generator_launched.set_value();
 
+    // Run the generator on the generator pool; if the pool is saturated, the request waits
+    // for a free generator
+    auto posted = httpd->post_generator([this, route, self = shared_from_this()]() {
         try {
             route->invoke(self);
         } catch (const std::exception& e) {
@@ -1556,50 +1938,47 @@ bool kis_net_beast_httpd_connection::start() {
 
         response_stream_.complete();
     });
-    tr.detach();
 
-    generator_ft.wait();
+    if (!posted) {
+        response_stream_.cancel();
+        return do_close();
+    }
 
-    boost::system::error_code error;
     while (response_stream_.size() || response_stream_.running()) {
         auto sz = response_stream_.size();
 
         if (sz) {
-            // Write the headers once we have body content
-            if (!first_response_write) {
-                boost::beast::http::write_header(stream_, sr, error);
-
-                if (error) {
-                    // _MSG_ERROR("(DEBUG) {} {} - Error writing headers - {}", verb_, uri_, error.message());
-                    return do_close();
-                }
-            }
-
-            // we no longer accept header modifiers
-            first_response_write = true;
-
             char *body_data;
             auto chunk_sz = response_stream_.get(&body_data);
 
-            response.body().data = (void *) body_data;
-            response.body().size = chunk_sz;
-            response.body().more = true;
+            if (cache_lead != nullptr) {
+                if (cache_body.size() + chunk_sz <= cache->max_body()) {
+                    cache_body.append(body_data, chunk_sz);
+                    response_stream_.consume(chunk_sz);
+                    response_stream_.wait();
+                    continue;
+                }
 
-            boost::beast::http::write(stream_, sr, error);
+                // Too large to cache; release any waiting requests to generate their own,
+                // and stream what we have so far
+                cache_lead.reset();
 
-            response_stream_.consume(chunk_sz);
+                if (cache_body.size() && !write_chunk(cache_body.data(), cache_body.size())) {
+                    response_stream_.cancel();
+                    return do_close();
+                }
 
-            // _MSG_INFO("(DEBUG) {} {} - Consumed {}/{} running {}", verb_, uri_, sz, response_stream_.size(), response_stream_.running());
+                cache_body = std::string{};
+            }
 
-            if (error == boost::beast::http::error::need_buffer) {
-                // Beast returns 'need_buffer' when it's completed writing a buffer, configure
-                // as a non-error
-                error = {};
-            } else if (error) {
-                // _MSG_INFO("(DEBUG) {} {} - chunk write error {}", verb_, uri_, error.message());
+            if (!write_chunk(body_data, chunk_sz)) {
                 response_stream_.cancel();
                 return do_close();
             }
+
+            response_stream_.consume(chunk_sz);
+
+            // _MSG_INFO("(DEBUG) {} {} - Consumed {}/{} running {}", verb_, uri_, sz, response_stream_.size(), response_stream_.running());
         }
 
         // If the buffer has any pending data, regardless of error or completeness,
@@ -1608,6 +1987,21 @@ bool kis_net_beast_httpd_connection::start() {
         response_stream_.wait();
     }
 
+    if (cache_lead != nullptr) {
+        if (response.result() == boost::beast::http::status::ok) {
+            auto entry = cache->complete(cache_lead,
+                    static_cast<std::string>(response[boost::beast::http::field::content_type]),
+                    std::move(cache_body));
+            return write_cached(entry, client_req_close);
+        }
+
+        // Errors aren't cached
+        cache_lead.reset();
+
+        if (cache_body.size() && !write_chunk(cache_body.data(), cache_body.size()))
+            return do_close();
+    }
+
     // _MSG_INFO("(DEBUG) {} {} - Out of buffer poll loop, remaining {}, running {}", verb_, uri_, response_stream_.size(), response_stream_.running());
 
     // Send the completion record for the chunked response
@@ -1628,6 +2022,93 @@ bool kis_net_beast_httpd_connection::start() {
     return true;
 }
 
+std::string kis_net_beast_httpd_connection::response_cache_key() {
+    // Variables are sorted so that their order in the request doesn't matter
+    std::vector<std::pair<std::string, std::string>> vars;
+
+    for (const auto& v : http_variables_) {
+        if (v.first == httpd->AUTH_COOKIE || v.first == "user" || v.first == "password")
+            continue;
+
+        vars.push_back(v);
+    }
+
+    std::sort(vars.begin(), vars.end());
+
+    std::string key = fmt::format("{} {}\n{}\n",
+            static_cast<std::string>(boost::beast::http::to_string(verb_)),
+            static_cast<std::string>(uri_), login_role_);
+
+    for (const auto& v : vars)
+        key += fmt::format("{}={}\n", v.first, v.second);
+
+    key += "\n";
+    key.append(http_post.data(), http_post.size());
+
+    return key;
+}
+
+bool kis_net_beast_httpd_connection::write_cached(kis_net_beast_response_cache::shared_entry entry,
+        bool client_req_close) {
+    boost::system::error_code error;
+
+    auto inm_h = request_.find(boost::beast::http::field::if_none_match);
+
+    if (inm_h != request_.end() && 
+            (inm_h->value() == "*" || inm_h->value().find(entry->etag) != boost::beast::string_view::npos)) {
+        httpd->response_cache()->count_not_modified();
+
+        boost::beast::http::response<boost::beast::http::empty_body> res;
+        res.result(boost::beast::http::status::not_modified);
+        append_common_headers(res, uri_);
+        res.set(boost::beast::http::field::etag, entry->etag);
+
+        boost::beast::http::write(stream_, res, error);
+
+        if (error || client_req_close)
+            return do_close();
+
+        return true;
+    }
+
+    boost::beast::http::response<boost::beast::http::buffer_body> res;
+    res.result(boost::beast::http::status::ok);
+    append_common_headers(res, uri_);
+    res.set(boost::beast::http::field::content_type, entry->content_type);
+    res.set(boost::beast::http::field::etag, entry->etag);
+
+    auto body = &entry->body;
+
+    if (entry->gz_body.size()) {
+        auto ae_h = request_.find(boost::beast::http::field::accept_encoding);
+
+        if (ae_h != request_.end() && ae_h->value().find("gzip") != boost::beast::string_view::npos) {
+            body = &entry->gz_body;
+            res.set(boost::beast::http::field::content_encoding, "gzip");
+        }
+
+        auto vary_h = res.find(boost::beast::http::field::vary);
+        if (vary_h != res.end())
+            res.set(boost::beast::http::field::vary, 
+                    fmt::format("{}, Accept-Encoding", vary_h->value()));
+        else
+            res.set(boost::beast::http::field::vary, "Accept-Encoding");
+    }
+
+    // The entry is immutable and held until the write completes, so it is sent without a copy
+    res.body().data = (void *) body->data();
+    res.body().size = body->size();
+    res.body().more = false;
+    res.content_length(body->size());
+
+    boost::beast::http::write(stream_, res, error);
+
+    if (error || client_req_close)
+        return do_close();
+
+    return true;
+}
+
 bool kis_net_beast_httpd_connection::do_close() {
     if (closure_cb) {
         closure_cb();
@@ -1648,6 +2129,7 @@ kis_net_beast_route::kis_net_beast_route(const std::string& route,
         const std::list<boost::beast::http::verb>& verbs, 
         bool login, const std::list<std::string>& roles, std::shared_ptr<kis_net_web_endpoint> handler) :
     handler{handler},
+    cacheable_{false},
     route_{route},
     verbs_{verbs},
     login_{login},
@@ -1673,6 +2155,7 @@ kis_net_beast_route::kis_net_beast_route(const std::string& route,
         bool login, const std::list<std::string>& roles,
         const std::list<std::string>& extensions, std::shared_ptr<kis_net_web_endpoint> handler) :
     handler{handler},
+    cacheable_{false},
     route_{route},
     verbs_{verbs},
     login_{login},
@@ -22,7 +22,12 @@
 #include "config.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
 #include <list>
+#include <mutex>
 #include <regex>
 #include <string>
 #include <thread>
@@ -49,6 +54,130 @@ class kis_net_beast_route;
 class kis_net_beast_auth;
 class kis_net_web_endpoint;
 
+// Bounded pool of reusable threads for running blocking request handlers and response
+// generators.
+//
+// Threads are started on demand up to a maximum, reused for later work, and exit once
+// they have been idle for a while.  When every thread is busy, new work waits in the
+// queue until one frees up, so the number of threads serving HTTP stays bounded no
+// matter how many clients are polling.
+class kis_net_beast_worker_pool {
+public:
+    kis_net_beast_worker_pool(const std::string& name, size_t max_threads);
+    ~kis_net_beast_worker_pool();
+
+    // Returns false if the pool has been stopped
+    bool post(std::function<void ()> work);
+
+    // Reject new work and let idle threads exit
+    void stop();
+
+    size_t threads();
+    size_t busy();
+    size_t queued();
+
+protected:
+    // Shared with the worker threads, which are detached and may outlive the pool
+    struct pool_state {
+        std::string name;
+        size_t max_threads;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void ()>> queue;
+
+        size_t n_threads;
+        size_t n_idle;
+        bool shutdown;
+    };
+
+    static void worker(std::shared_ptr<pool_state> state);
+
+    std::shared_ptr<pool_state> state;
+};
+
+// Cache of serialized responses for hot, read-only endpoints which many clients poll
+// with identical requests.
+//
+// Entries are keyed by the request (route, role, variables, and POST body) and tagged
+// with the data generation they were built from - the server tick - so every matching
+// request within a tick is served the same bytes.  Requests which arrive while an entry
+// is being generated wait for it instead of serializing their own copy.  The ETag is a
+// hash of the body, so clients revalidating with If-None-Match get a 304 for as long as
+// the content doesn't change, even across ticks.
+class kis_net_beast_response_cache {
+public:
+    struct entry {
+        std::string content_type;
+        std::string body;
+        // gzip encoded body, if precompression is enabled and worthwhile
+        std::string gz_body;
+        std::string etag;
+    };
+
+    using shared_entry = std::shared_ptr<const entry>;
+    using lead_t = std::shared_ptr<std::promise<shared_entry>>;
+
+    kis_net_beast_response_cache(size_t max_entries, size_t max_body, bool gzip);
+
+    // Find the entry for a request in the current generation, waiting for it if another
+    // request is generating it.  If there is no entry, returns nullptr; if the request
+    // should generate the entry, `lead` is set, and the request must call complete() or
+    // release the lead (which sends any waiting requests off to generate their own).
+    shared_entry lookup(const std::string& key, time_t generation, lead_t& lead);
+
+    shared_entry complete(lead_t& lead, const std::string& content_type, std::string body);
+
+    size_t max_body() const { return max_body_; }
+
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    uint64_t not_modified() const { return not_modified_; }
+    size_t size();
+
+    void count_not_modified() { not_modified_++; }
+
+protected:
+    struct slot {
+        time_t generation;
+        std::shared_future<shared_entry> future;
+    };
+
+    static bool ready(const slot& s) {
+        return s.future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    static shared_entry get(const slot& s);
+
+    kis_mutex mutex;
+    std::unordered_map<std::string, slot> slots;
+
+    size_t max_entries;
+    size_t max_body_;
+    bool gzip;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> not_modified_;
+};
+
+// A client connection; holds the socket and read buffer across keep-alive requests, and
+// does not hold a thread while waiting for the next request
+struct kis_net_beast_httpd_session {
+    kis_net_beast_httpd_session(boost::asio::ip::tcp::socket&& socket) :
+        stream{std::move(socket)} {
+        Globalreg::n_tracked_http_connections++;
+    }
+
+    ~kis_net_beast_httpd_session() {
+        Globalreg::n_tracked_http_connections--;
+    }
+
+    boost::beast::tcp_stream stream;
+    boost::beast::flat_buffer buffer;
+    boost::optional<boost::beast::http::request_parser<boost::beast::http::string_body>> parser;
+};
+
 class kis_net_beast_httpd : public lifetime_global, public deferred_startup,
     public std::enable_shared_from_this<kis_net_beast_httpd> {
 public:
@@ -169,6 +298,20 @@ public:
         return redirect_unknown_target_;
     }
 
+    // Run a response generator on the bounded generator pool
+    bool post_generator(std::function<void ()> work) {
+        return generator_pool.post(work);
+    }
+
+    // Serve a registered route from the response cache.  Only suitable for read-only
+    // endpoints whose content depends solely on the request and the current state.
+    void enable_route_cache(const std::string& route);
+
+    // Response cache, or nullptr if caching is disabled
+    std::shared_ptr<kis_net_beast_response_cache> response_cache() {
+        return response_cache_;
+    }
+
 protected:
     std::atomic<bool> running;
     unsigned int port;
@@ -204,6 +347,29 @@ protected:
     void start_accept();
     void handle_connection(const boost::system::error_code& ec, boost::asio::ip::tcp::socket socket);
 
+    // Wait for the next request on a connection, then hand it to a request worker
+    void read_request(std::shared_ptr<kis_net_beast_httpd_session> session);
+    void handle_read(std::shared_ptr<kis_net_beast_httpd_session> session,
+            const boost::system::error_code& ec);
+    void run_request(std::shared_ptr<kis_net_beast_httpd_session> session);
+
+    kis_net_beast_worker_pool request_pool;
+    kis_net_beast_worker_pool generator_pool;
+
+    std::shared_ptr<kis_net_beast_response_cache> response_cache_;
+
+    // Connection and request metrics, reported at /httpd/stats
+    std::atomic<uint64_t> connections_total;
+    std::atomic<uint64_t> requests_total;
+    std::atomic<uint64_t> request_latency_total_us;
+    std::atomic<uint64_t> request_latency_max_us;
+
+    // Request latency histogram: <1ms, <10ms, <100ms, <1s, <10s, >=10s
+    static constexpr size_t n_latency_buckets = 6;
+    std::atomic<uint64_t> request_latency_buckets[n_latency_buckets];
+
+    void record_request_latency(uint64_t latency_us);
+
     bool use_ssl;
     bool serve_files;
 
@@ -237,12 +403,14 @@ class kis_net_beast_httpd_connection : public std::enable_shared_from_this<kis_n
 public:
     friend class kis_net_beast_httpd;
 
-    kis_net_beast_httpd_connection(boost::beast::tcp_stream& stream,
+    kis_net_beast_httpd_connection(std::shared_ptr<kis_net_beast_httpd_session> session,
             std::shared_ptr<kis_net_beast_httpd> httpd);
     virtual ~kis_net_beast_httpd_connection();
 
     using uri_param_t = std::unordered_map<std::string, std::string>;
 
+    // Handle the request read by the session; returns true if the connection should be
+    // kept open for another request
     bool start();
 
     boost::beast::http::request<boost::beast::http::string_body>& request() { return request_; }
@@ -295,10 +463,9 @@ protected:
 
     std::function<void ()> closure_cb;
 
+    std::shared_ptr<kis_net_beast_httpd_session> session_;
     boost::beast::tcp_stream& stream_;
-    boost::beast::flat_buffer buffer;
 
-    boost::optional<boost::beast::http::request_parser<boost::beast::http::string_body>> parser_;
     boost::beast::http::request<boost::beast::http::string_body> request_;
 
     boost::beast::http::response<boost::beast::http::buffer_body> response;
@@ -324,6 +491,12 @@ protected:
 
     bool do_close();
 
+    // Cache key for this request; credentials are left out, since the role is part of it
+    std::string response_cache_key();
+
+    // Send a cached response, or a 304 if the client already has it
+    bool write_cached(kis_net_beast_response_cache::shared_entry entry, bool client_req_close);
+
     template<class Response>
     void append_common_headers(Response& r, boost::beast::string_view uri) {
         // Append the common headers
@@ -617,9 +790,14 @@ public:
 
     std::string& route() { return route_; }
 
+    bool cacheable() const { return cacheable_; }
+    void set_cacheable(bool c) { cacheable_ = c; }
+
 protected:
     std::shared_ptr<kis_net_web_endpoint> handler;
 
+    std::atomic<bool> cacheable_;
+
     std::string route_;
 
     std::list<boost::beast::http::verb> verbs_;
@@ -0,0 +1,161 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_SLAB_H__
+#define __KIS_SLAB_H__
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Fixed-size allocator for large numbers of long-lived records of a single type,
+// such as tracked devices.
+//
+// Records are carved out of large slabs so that they sit next to each other in memory
+// instead of being scattered across the heap with per-allocation malloc overhead; freed
+// records go onto a free list and are reused by the next allocation.  Slabs are never
+// returned to the system.
+template<typename T>
+class kis_slab_pool {
+public:
+    static kis_slab_pool& get() {
+        // Intentionally leaked; records may still be released during static destruction
+        static kis_slab_pool *pool = new kis_slab_pool();
+        return *pool;
+    }
+
+    void *allocate() {
+        std::lock_guard<std::mutex> lk(mutex);
+
+        if (free_list != nullptr) {
+            auto r = free_list;
+            free_list = free_list->next;
+            n_used++;
+            return r;
+        }
+
+        if (slab_pos == slab_end) {
+            auto slab = static_cast<char *>(::operator new(block_sz * blocks_per_slab));
+            slabs.push_back(slab);
+            slab_pos = slab;
+            slab_end = slab + (block_sz * blocks_per_slab);
+        }
+
+        auto r = slab_pos;
+        slab_pos += block_sz;
+        n_used++;
+
+        return r;
+    }
+
+    void release(void *p) {
+        std::lock_guard<std::mutex> lk(mutex);
+
+        auto b = static_cast<free_block *>(p);
+        b->next = free_list;
+        free_list = b;
+        n_used--;
+    }
+
+    size_t used_blocks() {
+        std::lock_guard<std::mutex> lk(mutex);
+        return n_used;
+    }
+
+    size_t reserved_bytes() {
+        std::lock_guard<std::mutex> lk(mutex);
+        return slabs.size() * block_sz * blocks_per_slab;
+    }
+
+protected:
+    struct free_block {
+        free_block *next;
+    };
+
+    static constexpr size_t block_align =
+        std::max(alignof(T), alignof(free_block));
+    static constexpr size_t block_sz =
+        ((std::max(sizeof(T), sizeof(free_block)) + block_align - 1) / block_align) * block_align;
+
+    // Roughly 64k per slab, but never fewer than 16 records
+    static constexpr size_t blocks_per_slab = std::max((size_t) 16, (size_t) 65536 / block_sz);
+
+    static_assert(block_align <= alignof(std::max_align_t),
+            "kis_slab_pool does not support over-aligned types");
+
+    kis_slab_pool() :
+        free_list{nullptr},
+        slab_pos{nullptr},
+        slab_end{nullptr},
+        n_used{0} { }
+
+    std::mutex mutex;
+
+    std::vector<char *> slabs;
+    free_block *free_list;
+    char *slab_pos;
+    char *slab_end;
+    size_t n_used;
+};
+
+// Standard allocator over kis_slab_pool, for use with std::allocate_shared; the
+// shared_ptr control block and the record are allocated as one slab block.
+template<typename T>
+class kis_slab_allocator {
+public:
+    using value_type = T;
+
+    kis_slab_allocator() noexcept { }
+
+    template<typename U>
+    kis_slab_allocator(const kis_slab_allocator<U>&) noexcept { }
+
+    T *allocate(size_t n) {
+        if (n != 1)
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+
+        return static_cast<T *>(kis_slab_pool<T>::get().allocate());
+    }
+
+    void deallocate(T *p, size_t n) noexcept {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+
+        kis_slab_pool<T>::get().release(p);
+    }
+
+    template<typename U>
+    bool operator==(const kis_slab_allocator<U>&) const noexcept {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const kis_slab_allocator<U>&) const noexcept {
+        return false;
+    }
+};
+
+#endif
@@ -124,6 +124,8 @@
 #include "manuf.h"
 #include "entrytracker.h"
 #include "json_adapter.h"
+#include "json_writer.h"
+#include "binary_writer.h"
 
 #include "kis_server_announce.h"
 
@@ -397,6 +399,11 @@ void signal_thread_handler() {
                 // Flag that we need to do a waitpid to reap child processes
                 Globalreg::globalreg->reap_child_procs = true;
                 break;
+
+            case SIGUSR1:
+                // Dump the lock profile
+                kis_lock_profiler::dump(stderr, 50);
+                break;
         }
     }
 
@@ -489,6 +496,7 @@ int main(int argc, char *argv[], char *envp[]) {
     sigaddset(&core_signal_mask, SIGCHLD);
     sigaddset(&core_signal_mask, SIGSEGV);
     sigaddset(&core_signal_mask, SIGPIPE);
+    sigaddset(&core_signal_mask, SIGUSR1);
 
     // Set thread mask for all new threads
     pthread_sigmask(SIG_BLOCK, &core_signal_mask, nullptr);
@@ -709,6 +717,13 @@ int main(int argc, char *argv[], char *envp[]) {
     }
     globalregistry->kismet_config = conf;
 
+    // Enable lock profiling before the rest of the server is built, so it sees every lock
+    if (conf->fetch_opt_bool("lock_profiler", false)) {
+        _MSG_INFO("Enabling lock contention profiling; send SIGUSR1 to dump the most contended "
+                "locks, or see /system/lock_stats");
+        kis_lock_profiler::enabled = true;
+    }
+
     struct stat fstat;
     std::string configdir;
 
@@ -786,11 +801,13 @@ int main(int argc, char *argv[], char *envp[]) {
         SpindownKismet();
 
     // Base serializers
-    entrytracker->register_serializer("json", std::make_shared<json_adapter::serializer>());
+    entrytracker->register_serializer("json", std::make_shared<fast_json_adapter::serializer>());
     entrytracker->register_serializer("tjson", std::make_shared<translated_adapter::serializer>());
-    entrytracker->register_serializer("ekjson", std::make_shared<ek_json_adapter::serializer>());
-    entrytracker->register_serializer("itjson", std::make_shared<it_json_adapter::serializer>());
+    entrytracker->register_serializer("ekjson", std::make_shared<fast_ek_json_adapter::serializer>());
+    entrytracker->register_serializer("itjson", std::make_shared<fast_it_json_adapter::serializer>());
     entrytracker->register_serializer("prettyjson", std::make_shared<pretty_json_adapter::serializer>());
+    entrytracker->register_serializer("cbor", std::make_shared<cbor_adapter::serializer>());
+    entrytracker->register_serializer("msgpack", std::make_shared<msgpack_adapter::serializer>());
 
     entrytracker->register_serializer("jcmd", std::make_shared<json_adapter::serializer>());
     entrytracker->register_serializer("cmd", std::make_shared<json_adapter::serializer>());
@@ -36,6 +36,7 @@
 
 #include "getopt.h"
 
+#include "binary_reader.h"
 #include "fmt.h"
 #include "nlohmann/json.hpp"
 #include "sqlite3_cpp11.h"
@@ -234,6 +235,36 @@ int main(int argc, char *argv[]) {
         exit(0);
     }
 
+    // Devices logged in a binary format (kis_log_device_format=cbor or msgpack) refer to
+    // fields by number; the field names are logged as FIELDS snapshots
+    binary_reader reader;
+
+    try {
+        auto fields_q = _SELECT(db, "snapshots", {"json"}, _WHERE("snaptype", EQ, "FIELDS"));
+
+        for (auto f : fields_q)
+            reader.add_fields(nlohmann::json::parse(sqlite3_column_as<std::string>(f, 0)));
+
+        if (verbose && reader.get_fields().size())
+            fprintf(stderr, "* Found %lu field names for binary device records\n",
+                    reader.get_fields().size());
+    } catch (const std::exception& e) {
+        fprintf(stderr, "WARNING:  Could not load the field names for binary device records: %s\n",
+                e.what());
+    }
+
+    // Logs written with kis_log_device_deltas keep the changes since the last full device
+    // record in the device_deltas table
+    bool has_deltas = false;
+
+    try {
+        auto deltas_q = _SELECT(db, "sqlite_master", {"name"}, 
+                _WHERE("type", EQ, "table", AND, "name", EQ, "device_deltas"));
+        has_deltas = deltas_q.begin() != deltas_q.end();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "WARNING:  Could not check for device deltas: %s\n", e.what());
+    }
+
     if (out_fname == "-") {
         ofile = stdout;
     } else {
@@ -249,7 +280,7 @@ int main(int argc, char *argv[]) {
     if (!ekjson)
         fprintf(ofile, "[\n");
 
-    auto query = _SELECT(db, "devices", {"device"});
+    auto query = _SELECT(db, "devices", {"devkey", "device"});
 
     unsigned long n_logs = 0;
     unsigned long n_division = (n_devices_db / 20);
@@ -269,14 +300,22 @@ int main(int argc, char *argv[]) {
 
         }
 
-        auto json = sqlite3_column_as<std::string>(d, 0);
+        auto devkey = sqlite3_column_as<std::string>(d, 0);
+        auto device = sqlite3_column_as<std::string>(d, 1);
 
         try {
-            std::stringstream ss(json);
+            std::stringstream ss;
+
+            auto parsed_json = reader.decode(device);
 
-            nlohmann::json parsed_json;
+            if (has_deltas) {
+                auto delta_q = _SELECT(db, "device_deltas", {"delta"}, 
+                        _WHERE("devkey", EQ, devkey), ORDERBY, "seq");
 
-            ss >> parsed_json;
+                for (auto dq : delta_q)
+                    binary_reader::apply_device_delta(parsed_json, 
+                            reader.decode(sqlite3_column_as<std::string>(dq, 0)));
+            }
 
             if (reformat)
                 transform_json(parsed_json);
@@ -191,7 +191,7 @@ void log_tracker::trigger_deferred_startup() {
                     if (u.error)
                         throw std::runtime_error("invalid uuid");
 
-                    kis_lock_guard<kis_mutex> lk(tracker_mutex, static_cast<std::string>(con->uri()));
+                    kis_lock_guard<kis_mutex> lk(tracker_mutex, "log_tracker stop log");
 
                     std::shared_ptr<kis_logfile> logfile;
                     for (auto lfi : *logfile_vec) {
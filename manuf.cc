@@ -81,262 +81,99 @@ kis_manuf::kis_manuf() {
     for (auto f : fname) {
         auto expanded = Globalreg::globalreg->kismet_config->expand_log_path(f, "", "", 0, 1);
 
-        if ((zmfile = gzopen(expanded.c_str(), "r")) != nullptr) {
-            _MSG("Opened OUI file '" + expanded, MSGFLAG_INFO);
+        auto parser = [this, expanded](std::vector<kis_lookup_table::table_record>& records) -> bool {
+            return parse_oui_file(expanded, records);
+        };
+
+        if (oui_table.load(expanded, 1, parser)) {
+            _MSG_INFO("Loaded {} manufacturers from OUI file '{}'", oui_table.size(), expanded);
             break;
         }
 
-        _MSG("Could not open OUI file '" + expanded + "': " + std::string(strerror(errno)), MSGFLAG_INFO);
+        _MSG("Could not load OUI file '" + expanded + "'", MSGFLAG_INFO);
     }
 
-    if (zmfile == nullptr) {
+    if (!oui_table.is_loaded()) {
         _MSG("No OUI files were available, will not resolve manufacturer "
              "names for MAC addresses", MSGFLAG_ERROR);
         return;
     }
 
-    IndexOUI();
+    oui_records.resize(oui_table.size());
 }
 
-void kis_manuf::IndexOUI() {
+bool kis_manuf::parse_oui_file(const std::string& fname,
+        std::vector<kis_lookup_table::table_record>& records) {
     char buf[1024];
-    int line = 0;
-    z_off_t prev_pos;
     short int m[3];
-    uint32_t last_oui = 0;
 
-    kis_lock_guard<kis_mutex> lk(mutex);
+    auto zmfile = gzopen(fname.c_str(), "r");
 
     if (zmfile == nullptr)
-        return;
-
-    _MSG("Indexing manufacturer db", MSGFLAG_INFO);
+        return false;
 
-    prev_pos = gzseek(zmfile, 0, SEEK_CUR);
+    _MSG_INFO("Indexing manufacturer db '{}'", fname);
 
     while (!gzeof(zmfile)) {
-        if (gzgets(zmfile, buf, 1024) == NULL || gzeof(zmfile))
+        if (gzgets(zmfile, buf, 1024) == nullptr)
             break;
 
-        if ((line % 50) == 0) {
-            if (sscanf(buf, "%hx:%hx:%hx",
-                       &(m[0]), &(m[1]), &(m[2])) == 3) {
-
-                // Log a position at the previous pos - which is the line before
-                // this one, so we're inclusive
-                index_pos ip;
-                uint32_t oui;
-
-                oui = 0;
-                oui |= (uint32_t) m[0] << 16;
-                oui |= (uint32_t) m[1] << 8;
-                oui |= (uint32_t) m[2];
-
-                if (oui < last_oui) {
-                    _MSG("Warning:  kis_manuf file appears to be out of order, expected "
-                            "sorted manuf OUI data", MSGFLAG_ERROR);
-                }
-
-                ip.oui = oui;
-                ip.pos = prev_pos;
-
-                last_oui = oui;
-
-                index_vec.push_back(ip);
-            } else {
-                // Compensate for not getting a reasonable line (probably a
-                // comment) by decrementing here so we keep trying at each
-                // index point until we get info we're looking for
-                line--;
-            }
-        }
-
-        prev_pos = gzseek(zmfile, 0, SEEK_CUR);
-        line++;
-    }
-
-    _MSG_INFO("Completed indexing manufacturer db, {} lines and {} indexes.",
-            line, index_vec.size());
-}
-
-std::shared_ptr<tracker_element_string> kis_manuf::lookup_oui(mac_addr in_mac) {
-    uint32_t soui = in_mac.OUI(), toui;
-    int matched = -1;
-    char buf[1024];
-    short int m[3];
-
-    if (zmfile == nullptr)
-        return unknown_manuf;
-
-    {
-        kis_lock_guard<kis_mutex> lk(mutex);
-
-        // Use the cache first
-        if (oui_map.find(soui) != oui_map.end()) {
-            return oui_map[soui].manuf;
-        }
-
-        for (unsigned int x = 0; x < index_vec.size(); x++) {
-            if (soui > index_vec[x].oui) {
-                matched = x;
-                continue;
-            }
+        if (strlen(buf) < 10)
+            continue;
 
-            break;
-        }
+        // Trim \n
+        auto mlen = strlen(buf + 9);
+        if (buf[9 + mlen - 1] == '\n')
+            mlen--;
 
-        // Cache unknown to save us effort in the future
-        if (matched < 0) {
-            manuf_data md;
-            md.oui = soui;
-            md.manuf = unknown_manuf;
-            oui_map[soui] = md;
+        if (mlen == 0)
+            continue;
 
-            return md.manuf;
-        }
+        if (sscanf(buf, "%hx:%hx:%hx\t", &(m[0]), &(m[1]), &(m[2])) != 3)
+            continue;
 
-        // Jump backwards one index in the matching unless we're in the first block
-        if (matched > 0)
-            matched -= 1;
+        kis_lookup_table::table_record r;
+        r.key = mac_addr::OUI(m);
+        r.fields.push_back(std::string(buf + 9, mlen));
+        records.push_back(r);
     }
 
-    {
-        kis_lock_guard<kis_mutex> lk(mutex);
-
-        gzseek(zmfile, index_vec[matched].pos, SEEK_SET);
-
-        while (!gzeof(zmfile)) {
-            if (gzgets(zmfile, buf, 1024) == nullptr || gzeof(zmfile))
-                break;
-
-            if (strlen(buf) < 10)
-                continue;
-
-            // Trim \n
-            auto mlen = strlen(buf + 9) - 1;
-
-            if (mlen == 0)
-                continue;
-
-
-            if (sscanf(buf, "%hx:%hx:%hx\t", &(m[0]), &(m[1]), &(m[2])) == 3) {
+    gzclose(zmfile);
 
-                // Log a position at the previous pos - which is the line before
-                // this one, so we're inclusive
-                toui = mac_addr::OUI(m);
+    _MSG_INFO("Completed indexing manufacturer db, {} records.", records.size());
 
-                if (toui == soui) {
-                    manuf_data md;
-                    md.oui = soui;
-
-                    md.manuf = std::make_shared<tracker_element_string>(manuf_id);
-                    md.manuf->set(munge_to_printable(std::string(buf + 9, mlen)));
-                    oui_map[soui] = md;
-                    return md.manuf;
-                }
-
-                if (toui > soui) {
-                    manuf_data md;
-                    md.oui = soui;
-                    md.manuf = unknown_manuf;
-                    oui_map[soui] = md;
-                    return md.manuf;
-                }
-            }
-        }
-    }
+    return true;
+}
 
-    return unknown_manuf;
+std::shared_ptr<tracker_element_string> kis_manuf::lookup_oui(mac_addr in_mac) {
+    return lookup_oui(in_mac.OUI());
 }
 
 std::shared_ptr<tracker_element_string> kis_manuf::lookup_oui(uint32_t in_oui) {
-    uint32_t soui = in_oui, toui;
-    int matched = -1;
-    char buf[1024];
-    short int m[3];
-
-    if (zmfile == nullptr)
-        return unknown_manuf;
-
-    {
-        kis_lock_guard<kis_mutex> lk(mutex);
-
-        // Use the cache first
-        if (oui_map.find(soui) != oui_map.end()) {
-            return oui_map[soui].manuf;
-        }
-
-        for (unsigned int x = 0; x < index_vec.size(); x++) {
-            if (soui > index_vec[x].oui) {
-                matched = x;
-                continue;
-            }
-
-            break;
-        }
-
-        // Cache unknown to save us effort in the future
-        if (matched < 0) {
-            manuf_data md;
-            md.oui = soui;
-            md.manuf = unknown_manuf;
-            oui_map[soui] = md;
-
-            return md.manuf;
-        }
-
-        // Jump backwards one index in the matching unless we're in the first block
-        if (matched > 0)
-            matched -= 1;
+    if (oui_map.size() != 0) {
+        auto ci = oui_map.find(in_oui);
+        if (ci != oui_map.end())
+            return ci->second.manuf;
     }
 
-    {
-        kis_lock_guard<kis_mutex> lk(mutex);
-
-        gzseek(zmfile, index_vec[matched].pos, SEEK_SET);
-
-        while (!gzeof(zmfile)) {
-            if (gzgets(zmfile, buf, 1024) == nullptr || gzeof(zmfile))
-                break;
+    auto r = oui_table.find(in_oui);
 
-            if (strlen(buf) < 10)
-                continue;
-
-            // Trim \n
-            auto mlen = strlen(buf + 9) - 1;
-
-            if (mlen == 0)
-                continue;
-
-
-            if (sscanf(buf, "%hx:%hx:%hx\t", &(m[0]), &(m[1]), &(m[2])) == 3) {
+    if (r < 0)
+        return unknown_manuf;
 
-                // Log a position at the previous pos - which is the line before
-                // this one, so we're inclusive
-                toui = mac_addr::OUI(m);
+    auto manuf = std::atomic_load(&oui_records[r]);
 
-                if (toui == soui) {
-                    manuf_data md;
-                    md.oui = soui;
+    if (manuf != nullptr)
+        return manuf;
 
-                    md.manuf = std::make_shared<tracker_element_string>(manuf_id);
-                    md.manuf->set(munge_to_printable(std::string(buf + 9, mlen)));
-                    oui_map[soui] = md;
-                    return md.manuf;
-                }
+    auto new_manuf = std::make_shared<tracker_element_string>(manuf_id);
+    new_manuf->set(munge_to_printable(oui_table.field(r, 0)));
 
-                if (toui > soui) {
-                    manuf_data md;
-                    md.oui = soui;
-                    md.manuf = unknown_manuf;
-                    oui_map[soui] = md;
-                    return md.manuf;
-                }
-            }
-        }
-    }
+    // If another thread got here first, use theirs
+    if (std::atomic_compare_exchange_strong(&oui_records[r], &manuf, new_manuf))
+        return new_manuf;
 
-    return unknown_manuf;
+    return manuf;
 }
 
 std::shared_ptr<tracker_element_string> kis_manuf::make_manuf(const std::string& in_manuf) {
@@ -37,6 +37,7 @@
 #include <string>
 
 #include "globalregistry.h"
+#include "kis_lookup_table.h"
 #include "robin_hood.h"
 #include "trackedelement.h"
 #include "util.h"
@@ -45,8 +46,6 @@ class kis_manuf {
 public:
     kis_manuf();
 
-    void IndexOUI();
-
     std::shared_ptr<tracker_element_string> lookup_oui(mac_addr in_mac);
     std::shared_ptr<tracker_element_string> lookup_oui(uint32_t in_oui);
 
@@ -56,11 +55,6 @@ public:
         return random_manuf;
     }
 
-    struct index_pos {
-        uint32_t oui;
-        z_off_t pos;
-    };
-
     struct manuf_data {
         uint32_t oui;
         std::shared_ptr<tracker_element_string> manuf;
@@ -69,13 +63,16 @@ public:
     bool is_unknown_manuf(std::shared_ptr<tracker_element_string> in_manuf);
 
 protected:
-    kis_mutex mutex;
-
-    std::vector<index_pos> index_vec;
+    // Parse the text OUI file into table records
+    bool parse_oui_file(const std::string& fname, std::vector<kis_lookup_table::table_record>& records);
 
+    // Manufacturers defined in the config; populated at startup and read-only after
     robin_hood::unordered_node_map<uint32_t, manuf_data> oui_map;
 
-    gzFile zmfile;
+    // Compiled OUI table and the manuf records built from it, created on first lookup
+    // and accessed atomically so that lookups are lock-free
+    kis_lookup_table oui_table;
+    std::vector<std::shared_ptr<tracker_element_string>> oui_records;
 
     // IDs for manufacturer objects
     int manuf_id;
@@ -19,6 +19,8 @@
 #ifndef __OBJECTPOOL_H__
 #define __OBJECTPOOL_H__ 
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <stack>
@@ -26,6 +28,7 @@
 #include <mutex>
 
 #include "kis_mutex.h"
+#include "moodycamel/concurrentqueue.h"
 
 template <class T>
 class shared_object_pool {
@@ -120,5 +123,200 @@ private:
     std::function<void (T*)> reset_;
 };
 
+// Object pool with per-thread caches, for objects which are allocated and released
+// constantly from many threads, such as packets, packet components, and pooled tracked
+// elements.
+//
+// Each thread keeps two magazines (small stacks) of released objects and allocates from
+// and releases into them without any locking; when both are full or both are empty,
+// whole magazines are exchanged with a lock-free depot shared by all threads.
+//
+// There is one pool per type, so callers resolve it at compile time instead of looking
+// it up at runtime.  The pool is never destroyed, so objects may still be released
+// during shutdown.
+template <class T>
+class magazine_object_pool {
+public:
+    static constexpr size_t magazine_sz = 32;
+
+    static magazine_object_pool& get() {
+        static magazine_object_pool *pool = new magazine_object_pool();
+        return *pool;
+    }
+
+    // Enable the pool with a function called to reset each released object, and an
+    // approximate limit on the number of idle objects held in the shared depot (0 for
+    // no limit).  Only the first call has any effect.
+    magazine_object_pool& enable(std::function<void (T*)> reset, size_t max_sz) {
+        std::call_once(enable_once, [&]() {
+            reset_ = reset;
+
+            if (max_sz == 0)
+                max_magazines = SIZE_MAX;
+            else
+                max_magazines = std::max((size_t) 1, max_sz / magazine_sz);
+
+            enabled_.store(true, std::memory_order_release);
+        });
+
+        return *this;
+    }
+
+    bool enabled() const {
+        return enabled_.load(std::memory_order_acquire);
+    }
+
+    std::shared_ptr<T> acquire() {
+        return std::shared_ptr<T>(acquire_raw(), pool_deleter{});
+    }
+
+protected:
+    struct magazine {
+        size_t n;
+        T *objs[magazine_sz];
+    };
+
+    struct pool_deleter {
+        void operator()(T *ptr) const {
+            magazine_object_pool<T>::get().release(ptr);
+        }
+    };
+
+    // Trivially destructible so that it remains usable when objects are released by
+    // other thread-local destructors
+    struct thread_cache {
+        magazine *loaded;
+        magazine *previous;
+        bool exited;
+    };
+
+    static thread_cache& local_cache() {
+        static thread_local thread_cache tc{nullptr, nullptr, false};
+        return tc;
+    }
+
+    // Returns the thread cache to the depot when the thread exits
+    struct thread_reaper {
+        ~thread_reaper() {
+            auto& tc = local_cache();
+            auto& pool = magazine_object_pool<T>::get();
+
+            pool.retire(tc.loaded);
+            pool.retire(tc.previous);
+
+            tc.loaded = nullptr;
+            tc.previous = nullptr;
+            tc.exited = true;
+        }
+    };
+
+    static void register_reaper() {
+        static thread_local thread_reaper reaper;
+        (void) reaper;
+    }
+
+    magazine_object_pool() :
+        max_magazines{0},
+        depot_sz{0},
+        enabled_{false} { }
+
+    T *acquire_raw() {
+        auto& tc = local_cache();
+
+        if (tc.loaded != nullptr && tc.loaded->n > 0)
+            return tc.loaded->objs[--tc.loaded->n];
+
+        if (tc.previous != nullptr && tc.previous->n > 0) {
+            std::swap(tc.loaded, tc.previous);
+            return tc.loaded->objs[--tc.loaded->n];
+        }
+
+        magazine *full;
+
+        if (!tc.exited && depot.try_dequeue(full)) {
+            depot_sz.fetch_sub(1, std::memory_order_relaxed);
+
+            if (tc.loaded == nullptr && tc.previous == nullptr)
+                register_reaper();
+
+            // Both local magazines are empty here
+            retire(tc.previous);
+            tc.previous = tc.loaded;
+            tc.loaded = full;
+
+            return tc.loaded->objs[--tc.loaded->n];
+        }
+
+        return new T();
+    }
+
+    void release(T *ptr) {
+        try {
+            reset_(ptr);
+        } catch (...) {
+            delete ptr;
+            return;
+        }
+
+        auto& tc = local_cache();
+
+        if (tc.exited) {
+            delete ptr;
+            return;
+        }
+
+        if (tc.loaded != nullptr && tc.loaded->n < magazine_sz) {
+            tc.loaded->objs[tc.loaded->n++] = ptr;
+            return;
+        }
+
+        if (tc.previous != nullptr && tc.previous->n < magazine_sz) {
+            std::swap(tc.loaded, tc.previous);
+            tc.loaded->objs[tc.loaded->n++] = ptr;
+            return;
+        }
+
+        if (tc.loaded == nullptr && tc.previous == nullptr)
+            register_reaper();
+
+        // Both local magazines are full; hand one to the depot and start a new one
+        retire(tc.previous);
+        tc.previous = tc.loaded;
+
+        tc.loaded = new magazine();
+        tc.loaded->n = 0;
+        tc.loaded->objs[tc.loaded->n++] = ptr;
+    }
+
+    // Move a magazine to the depot, or free it if it is empty or the depot is full
+    void retire(magazine *m) {
+        if (m == nullptr)
+            return;
+
+        if (m->n > 0 && depot_sz.load(std::memory_order_relaxed) < max_magazines) {
+            depot_sz.fetch_add(1, std::memory_order_relaxed);
+
+            if (depot.enqueue(m))
+                return;
+
+            depot_sz.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        for (size_t i = 0; i < m->n; i++)
+            delete m->objs[i];
+
+        delete m;
+    }
+
+    std::once_flag enable_once;
+    std::function<void (T*)> reset_;
+    size_t max_magazines;
+
+    moodycamel::ConcurrentQueue<magazine *> depot;
+    std::atomic<size_t> depot_sz;
+
+    std::atomic<bool> enabled_;
+};
+
 #endif /* ifndef OBJECTPOOL_H */
 
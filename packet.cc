@@ -44,6 +44,7 @@ kis_packet::kis_packet() {
 	filtered = 0;
     duplicate = 0;
     hash = 0;
+    queue_ns = 0;
 
     raw_data.reserve(MAX_PACKET_LEN);
     data = nonstd::string_view(raw_data);
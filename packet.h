@@ -96,6 +96,10 @@ public:
     // What hash has been calculated, if any?
     uint32_t hash;
 
+    // Monotonic time in ns the packet was queued to a packet thread, when the
+    // packetchain handler stats are enabled
+    uint64_t queue_ns;
+
     // Raw packet data; other packet components refer to this via stringviews
     // whenever possible to minimize the copy duplication.  It is pre-reserved as a
     // max packet size block
@@ -126,6 +130,7 @@ public:
         duplicate = p.duplicate;
         original = p.original;
         hash = p.hash;
+        queue_ns = p.queue_ns;
         process_complete_events = std::move(p.process_complete_events);
         raw_data = std::move(p.raw_data);
         data = std::move(p.data);
@@ -145,10 +150,12 @@ public:
         original.reset();
 
         hash = 0;
+        queue_ns = 0;
 
         // Reset and re-reserve in case we were resized somehow
         raw_data = "";
         raw_data.reserve(MAX_PACKET_LEN);
+        data = nonstd::string_view{raw_data};
 
         process_complete_events.clear();
 
@@ -165,10 +172,18 @@ public:
 
     template<typename T>
     void set_data(const T* tdata, size_t len) {
-        raw_data = std::string(tdata, len);
+        // Assign in place so the reserved buffer is reused instead of reallocated
+        raw_data.assign(tdata, len);
         data = nonstd::string_view{raw_data};
     }
 
+    // Refer to packet data owned by another component of this packet without copying
+    // it into raw_data; the owner must be inserted into the packet so that the data
+    // lives as long as the packet does
+    void set_data_ref(const nonstd::string_view& sdata) {
+        data = sdata;
+    }
+
     // Preferred smart pointers
     void insert(const unsigned int index, std::shared_ptr<packet_component> data);
 
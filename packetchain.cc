@@ -26,6 +26,7 @@
 #endif
 
 #include <pthread.h>
+#include <cmath>
 
 #include "alertracker.h"
 #include "configfile.h"
@@ -47,14 +48,40 @@ public:
     }
 };
 
-packet_chain::packet_chain() {
+packet_chain::packet_chain() :
+    packet_pool{magazine_object_pool<kis_packet>::get().enable([](kis_packet *p) { p->reset(); }, 1024)} {
     packetcomp_mutex.set_name("packetchain packet_comp");
     packetchain_mutex.set_name("packetchain packetchain");
-    pack_no_mutex.set_name("packetchain packetno");
+    cache_stat_mutex.set_name("packetchain cache_stat");
+    timing_mutex.set_name("packetchain timing");
+
+    handler_stats =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("packetchain_handler_stats", false);
+    handler_stats_sample =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("packetchain_handler_stats_sample", 16);
+
+    if (handler_stats_sample == 0)
+        handler_stats_sample = 1;
 
     unique_packet_no = 1;
 
-    dedupe_list_pos = 0;
+    // Size the dedupe window to the next power of two of buckets
+    auto dedupe_sz =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_dedup_size", 2048);
+
+    size_t n_buckets = 1;
+    while (n_buckets * dedupe_bucket_ways < dedupe_sz)
+        n_buckets <<= 1;
+
+    dedupe_buckets = std::make_unique<dedupe_bucket[]>(n_buckets);
+    dedupe_bucket_mask = n_buckets - 1;
+
+    for (size_t b = 0; b < n_buckets; b++)
+        dedupe_buckets[b].mutex.set_name("packetchain dedupe bucket");
+
+    dedupe_lookups = 0;
+    dedupe_hits = 0;
+    dedupe_probes = 0;
 
     Globalreg::enable_pool_type<kis_tracked_packet>([](auto *a) { a->reset(); });
 
@@ -125,6 +152,34 @@ packet_chain::packet_chain() {
     packet_processed_rrd =
         std::make_shared<kis_tracked_rrd<>>(packet_processed_rrd_id);
 
+    dedupe_lookups_id =
+        entrytracker->register_field("kismet.packetchain.dedupe_lookups",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets checked against the dedupe window");
+    dedupe_lookups_elem =
+        std::make_shared<tracker_element_uint64>(dedupe_lookups_id);
+
+    dedupe_hits_id =
+        entrytracker->register_field("kismet.packetchain.dedupe_hits",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets found in the dedupe window");
+    dedupe_hits_elem =
+        std::make_shared<tracker_element_uint64>(dedupe_hits_id);
+
+    dedupe_hit_ratio_id =
+        entrytracker->register_field("kismet.packetchain.dedupe_hit_ratio",
+                tracker_element_factory<tracker_element_double>(),
+                "ratio of packets found in the dedupe window");
+    dedupe_hit_ratio_elem =
+        std::make_shared<tracker_element_double>(dedupe_hit_ratio_id);
+
+    dedupe_probe_len_id =
+        entrytracker->register_field("kismet.packetchain.dedupe_probe_len",
+                tracker_element_factory<tracker_element_double>(),
+                "average number of dedupe entries compared per packet");
+    dedupe_probe_len_elem =
+        std::make_shared<tracker_element_double>(dedupe_probe_len_id);
+
     packet_stats_map = 
         std::make_shared<tracker_element_map>();
     packet_stats_map->insert(packet_peak_rrd);
@@ -134,9 +189,11 @@ packet_chain::packet_chain() {
     packet_stats_map->insert(packet_queue_rrd);
     packet_stats_map->insert(packet_drop_rrd);
     packet_stats_map->insert(packet_processed_rrd);
+    packet_stats_map->insert(dedupe_lookups_elem);
+    packet_stats_map->insert(dedupe_hits_elem);
+    packet_stats_map->insert(dedupe_hit_ratio_elem);
+    packet_stats_map->insert(dedupe_probe_len_elem);
 
-    packet_pool.set_max(1024);
-    packet_pool.set_reset([](kis_packet *p) { p->reset(); });
 
     auto httpd = Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>();
 
@@ -158,6 +215,11 @@ packet_chain::packet_chain() {
             std::make_shared<kis_net_web_tracked_endpoint>(packet_drop_rrd));
     httpd->register_route("/packetchain/packet_processed", {"GET", "POST"}, httpd->RO_ROLE, {},
             std::make_shared<kis_net_web_tracked_endpoint>(packet_processed_rrd));
+    httpd->register_route("/packetchain/handler_stats", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                    return handler_stats_endpoint();
+                }));
 
     packetchain_shutdown = false;
 
@@ -168,6 +230,33 @@ packet_chain::packet_chain() {
         timetracker->register_timer(std::chrono::seconds(1), true, 
                 [this](int) -> int {
 
+                uint64_t lookups = dedupe_lookups;
+                uint64_t hits = dedupe_hits;
+                uint64_t probes = dedupe_probes;
+
+                dedupe_lookups_elem->set(lookups);
+                dedupe_hits_elem->set(hits);
+
+                if (lookups > 0) {
+                    dedupe_hit_ratio_elem->set((double) hits / (double) lookups);
+                    dedupe_probe_len_elem->set((double) probes / (double) lookups);
+                }
+
+                {
+                    kis_lock_guard<kis_mutex> lk(cache_stat_mutex, "packetchain cache stats");
+
+                    for (const auto& c : cache_stats) {
+                        uint64_t c_lookups = c->lookups;
+                        uint64_t c_hits = c->hits;
+
+                        c->lookups_elem->set(c_lookups);
+                        c->hits_elem->set(c_hits);
+
+                        if (c_lookups > 0)
+                            c->hit_ratio_elem->set((double) c_hits / (double) c_lookups);
+                    }
+                }
+
                 auto evt = eventbus->get_eventbus_event(event_packetstats());
                 evt->get_event_content()->insert(event_packetstats(), packet_stats_map);
                 eventbus->publish(evt);
@@ -196,48 +285,33 @@ packet_chain::packet_chain() {
         // Lock every packet at the beginning of the dupe check
         in_pack->mutex.lock();
 
-        kis_lock_guard<kis_shared_mutex> lk(pack_no_mutex, "hash handler");
-
         in_pack->hash = crc32_16bytes_prefetch(chunk->data(), chunk->length(), 0);
 
-        for (unsigned int i = 0; i < 1024; i++) {
-            if (dedupe_list[i].hash == in_pack->hash) {
-                in_pack->duplicate = true;
-                in_pack->packet_no = dedupe_list[i].packno;
-                in_pack->original = dedupe_list[i].original_pkt;
-
-                // We have to wait until everything is done being changed in the packet
-                // before we can copy the duplicate decoded state over, grab the lock that
-                // is released at the end of the chain
-                kis_lock_guard<kis_mutex> lg(dedupe_list[i].original_pkt->mutex);
-                for (unsigned int c = 0; c < MAX_PACKET_COMPONENTS; c++) {
-                    auto cp = dedupe_list[i].original_pkt->content_vec[c];
-                    if (cp != nullptr) {
-                        if (cp->unique())
-                            continue;
-
-                        in_pack->content_vec[c] = cp;
-                    }
-                }
-
-                // Merge the signal levels
-                if (in_pack->has(pack_comp_l1) && in_pack->has(pack_comp_datasource)) {
-                    auto l1 = in_pack->original->fetch<kis_layer1_packinfo>(pack_comp_l1);
-                    auto radio_agg = in_pack->fetch_or_add<kis_layer1_aggregate_packinfo>(pack_comp_l1_agg);
-                    auto datasrc = in_pack->fetch<packetchain_comp_datasource>(pack_comp_datasource);
-                    radio_agg->source_l1_map[datasrc->ref_source->get_source_uuid()] = l1;
+        auto original = dedupe_lookup_insert(in_pack);
+
+        if (original != nullptr) {
+            // We have to wait until everything is done being changed in the packet
+            // before we can copy the duplicate decoded state over, grab the lock that
+            // is released at the end of the chain.  The dedupe bucket is no longer held
+            // so other packets are not stalled behind the original.
+            kis_lock_guard<kis_mutex> lg(original->mutex);
+            for (unsigned int c = 0; c < MAX_PACKET_COMPONENTS; c++) {
+                auto cp = original->content_vec[c];
+                if (cp != nullptr) {
+                    if (cp->unique())
+                        continue;
+
+                    in_pack->content_vec[c] = cp;
                 }
-
             }
-        }
 
-        // Assign a new packet number and cache it in the dedupe
-        if (!in_pack->duplicate) {
-            auto listpos = dedupe_list_pos++ % 1024;
-            in_pack->packet_no = unique_packet_no++;
-            dedupe_list[listpos].hash = in_pack->hash;
-            dedupe_list[listpos].packno = unique_packet_no++;
-            dedupe_list[listpos].original_pkt = in_pack;
+            // Merge the signal levels
+            if (in_pack->has(pack_comp_l1) && in_pack->has(pack_comp_datasource)) {
+                auto l1 = in_pack->original->fetch<kis_layer1_packinfo>(pack_comp_l1);
+                auto radio_agg = in_pack->fetch_or_add<kis_layer1_aggregate_packinfo>(pack_comp_l1_agg);
+                auto datasrc = in_pack->fetch<packetchain_comp_datasource>(pack_comp_datasource);
+                radio_agg->source_l1_map[datasrc->ref_source->get_source_uuid()] = l1;
+            }
         }
 
         return 1;
@@ -317,6 +391,87 @@ packet_chain::~packet_chain() {
 
 }
 
+std::shared_ptr<packet_chain::cache_stat> packet_chain::register_cache_stat(const std::string& in_name,
+        const std::string& in_desc) {
+    auto entrytracker = Globalreg::fetch_mandatory_global_as<entry_tracker>();
+
+    auto c = std::make_shared<cache_stat>();
+
+    c->lookups_elem =
+        std::make_shared<tracker_element_uint64>(entrytracker->register_field(
+                    fmt::format("kismet.packetchain.{}_lookups", in_name),
+                    tracker_element_factory<tracker_element_uint64>(),
+                    fmt::format("lookups in the {}", in_desc)));
+    c->hits_elem =
+        std::make_shared<tracker_element_uint64>(entrytracker->register_field(
+                    fmt::format("kismet.packetchain.{}_hits", in_name),
+                    tracker_element_factory<tracker_element_uint64>(),
+                    fmt::format("hits in the {}", in_desc)));
+    c->hit_ratio_elem =
+        std::make_shared<tracker_element_double>(entrytracker->register_field(
+                    fmt::format("kismet.packetchain.{}_hit_ratio", in_name),
+                    tracker_element_factory<tracker_element_double>(),
+                    fmt::format("ratio of lookups found in the {}", in_desc)));
+
+    kis_lock_guard<kis_mutex> lk(cache_stat_mutex, "register_cache_stat");
+
+    packet_stats_map->insert(c->lookups_elem);
+    packet_stats_map->insert(c->hits_elem);
+    packet_stats_map->insert(c->hit_ratio_elem);
+
+    cache_stats.push_back(c);
+
+    return c;
+}
+
+std::shared_ptr<kis_packet> packet_chain::dedupe_lookup_insert(std::shared_ptr<kis_packet> in_pack) {
+    auto& bucket = dedupe_buckets[in_pack->hash & dedupe_bucket_mask];
+
+    kis_lock_guard<kis_mutex> lk(bucket.mutex, "dedupe_lookup_insert");
+
+    dedupe_lookups++;
+
+    unsigned int oldest = 0;
+
+    for (unsigned int w = 0; w < dedupe_bucket_ways; w++) {
+        auto& e = bucket.entries[w];
+
+        if (e.original_pkt == nullptr) {
+            oldest = w;
+            dedupe_probes += w + 1;
+            break;
+        }
+
+        if (e.hash == in_pack->hash) {
+            dedupe_probes += w + 1;
+            dedupe_hits++;
+
+            in_pack->duplicate = true;
+            in_pack->packet_no = e.packno;
+            in_pack->original = e.original_pkt;
+
+            return e.original_pkt;
+        }
+
+        if (e.packno < bucket.entries[oldest].packno)
+            oldest = w;
+
+        if (w == dedupe_bucket_ways - 1)
+            dedupe_probes += dedupe_bucket_ways;
+    }
+
+    // Assign a new packet number and cache it in the dedupe, replacing the oldest
+    // (or first empty) slot in the bucket
+    in_pack->packet_no = unique_packet_no++;
+
+    auto& slot = bucket.entries[oldest];
+    slot.hash = in_pack->hash;
+    slot.packno = in_pack->packet_no;
+    slot.original_pkt = in_pack;
+
+    return nullptr;
+}
+
 void packet_chain::start_processing() {
     n_packet_threads = Globalreg::globalreg->kismet_config->fetch_opt_as<unsigned int>("kismet_packet_threads", 0);
 
@@ -331,7 +486,7 @@ void packet_chain::start_processing() {
             std::thread([this, n]() {
             auto name = fmt::format("PACKET {}/{}", n, n_packet_threads);
             thread_set_process_name(name);
-            packet_queue_processor(&packet_threads[n]->packet_queue);
+            packet_queue_processor(packet_threads[n], name);
         });
     }
 
@@ -391,9 +546,13 @@ std::shared_ptr<kis_packet> packet_chain::generate_packet() {
     // return std::make_shared<kis_packet>();
 }
 
-void packet_chain::packet_queue_processor(moodycamel::BlockingConcurrentQueue<std::shared_ptr<kis_packet>> *packet_queue) {
+void packet_chain::packet_queue_processor(packet_thread *thread, const std::string& in_name) {
+    auto packet_queue = &thread->packet_queue;
     std::shared_ptr<kis_packet> packet;
 
+    if (handler_stats)
+        local_timing()->name = in_name;
+
     while (!packetchain_shutdown && 
             !Globalreg::globalreg->spindown && 
             !Globalreg::globalreg->fatal_condition &&
@@ -404,6 +563,11 @@ void packet_chain::packet_queue_processor(moodycamel::BlockingConcurrentQueue<st
         if (packet == nullptr)
             break;
 
+        auto timing = sample_timing();
+
+        if (timing != nullptr && packet->queue_ns != 0)
+            timing->queue_wait.add(timing_now_ns() - packet->queue_ns);
+
         {
             // Lock the chain mutexes until we're done processing this packet
             std::shared_lock<kis_shared_mutex> lk(packetchain_mutex);
@@ -412,56 +576,14 @@ void packet_chain::packet_queue_processor(moodycamel::BlockingConcurrentQueue<st
             // the worker thread is in the sync block above, so we shouldn't
             // need to worry about the integrity of these vectors while running
 
-            /* Postcap is now handled before it gets into the per-thread chain
-            for (const auto& pcl : postcap_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
-            */
-
-            for (const auto& pcl : llcdissect_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
-
-            for (const auto& pcl : decrypt_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
+            // Postcap is handled before it gets into the per-thread chain
 
-            for (const auto& pcl : datadissect_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
-
-            for (const auto& pcl : classifier_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
-
-            for (const auto& pcl : tracker_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
-
-            for (const auto& pcl : logging_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
+            run_chain(llcdissect_chain, packet, timing);
+            run_chain(decrypt_chain, packet, timing);
+            run_chain(datadissect_chain, packet, timing);
+            run_chain(classifier_chain, packet, timing);
+            run_chain(tracker_chain, packet, timing);
+            run_chain(logging_chain, packet, timing);
         }
 
         uint64_t now = Globalreg::globalreg->last_tv_sec;
@@ -474,6 +596,8 @@ void packet_chain::packet_queue_processor(moodycamel::BlockingConcurrentQueue<st
 
         packet_processed_rrd->add_sample(1, now);
 
+        thread->n_processed.fetch_add(1, std::memory_order_release);
+
         continue;
     }
 }
@@ -492,12 +616,7 @@ int packet_chain::process_packet(std::shared_ptr<kis_packet> in_pack) {
     std::shared_lock<kis_shared_mutex> lk(packetchain_mutex);
 
     // Run the post-capture processing
-    for (const auto& pcl : postcap_chain) {
-        if (pcl->callback != nullptr)
-            pcl->callback(pcl->auxdata, in_pack);
-        else if (pcl->l_callback != nullptr)
-            pcl->l_callback(in_pack);
-    }
+    run_chain(postcap_chain, in_pack, sample_timing());
 
     // assign it to a thread
     unsigned int processing_id;
@@ -551,16 +670,38 @@ int packet_chain::process_packet(std::shared_ptr<kis_packet> in_pack) {
     }
 
 
-    // Queue the packet to the target thread
+    if (handler_stats)
+        in_pack->queue_ns = timing_now_ns();
+
+    // Queue the packet to the target thread; count it first so it can't be seen as
+    // processed before it is queued
+    packet_threads[processing_id]->n_queued.fetch_add(1, std::memory_order_relaxed);
     packet_threads[processing_id]->packet_queue.enqueue(in_pack);
     packet_queue_rrd->add_sample(qsize, now);
 
     return 1;
 }
 
+uint64_t packet_chain::fetch_packets_pending() {
+    uint64_t queued = 0, processed = 0;
+
+    if (packet_threads == nullptr)
+        return 0;
+
+    // Read processed first, so a packet finishing between the two reads can only
+    // make the count high, never wrap it
+    for (unsigned int n = 0; n < n_packet_threads; n++)
+        processed += packet_threads[n]->n_processed.load(std::memory_order_acquire);
+
+    for (unsigned int n = 0; n < n_packet_threads; n++)
+        queued += packet_threads[n]->n_queued.load(std::memory_order_relaxed);
+
+    return queued - processed;
+}
+
 int packet_chain::register_int_handler(pc_callback in_cb, void *in_aux,
         std::function<int (std::shared_ptr<kis_packet>)> in_l_cb, 
-        int in_chain, int in_prio) {
+        int in_chain, int in_prio, const char *in_file, int in_line) {
 
     kis_lock_guard<kis_shared_mutex> lk(packetchain_mutex, "register_int_handler");
 
@@ -573,6 +714,9 @@ int packet_chain::register_int_handler(pc_callback in_cb, void *in_aux,
     link->l_callback = in_l_cb;
     link->auxdata = in_aux;
     link->id = next_handlerid++;
+    link->chain = in_chain;
+    link->site_file = in_file;
+    link->site_line = in_line;
 
     switch (in_chain) {
         case CHAINPOS_POSTCAP:
@@ -626,12 +770,162 @@ int packet_chain::register_int_handler(pc_callback in_cb, void *in_aux,
     return link->id;
 }
 
-int packet_chain::register_handler(pc_callback in_cb, void *in_aux, int in_chain, int in_prio) {
-    return register_int_handler(in_cb, in_aux, NULL, in_chain, in_prio);
+int packet_chain::register_handler(pc_callback in_cb, void *in_aux, int in_chain, int in_prio,
+        const char *in_file, int in_line) {
+    return register_int_handler(in_cb, in_aux, NULL, in_chain, in_prio, in_file, in_line);
 }
 
-int packet_chain::register_handler(std::function<int (std::shared_ptr<kis_packet>)> in_cb, int in_chain, int in_prio) {
-    return register_int_handler(NULL, NULL, in_cb, in_chain, in_prio);
+int packet_chain::register_handler(std::function<int (std::shared_ptr<kis_packet>)> in_cb, int in_chain, int in_prio,
+        const char *in_file, int in_line) {
+    return register_int_handler(NULL, NULL, in_cb, in_chain, in_prio, in_file, in_line);
+}
+
+packet_chain::thread_timing *packet_chain::local_timing() {
+    static thread_local thread_timing *timing = nullptr;
+
+    if (timing != nullptr)
+        return timing;
+
+    kis_lock_guard<kis_mutex> lk(timing_mutex, "packetchain local_timing");
+
+    timing_tables.push_back(std::make_unique<thread_timing>());
+    timing = timing_tables.back().get();
+
+    // Packet threads rename themselves; anything else running the chain is
+    // a capture thread running the postcap handlers
+    timing->name = fmt::format("capture {}", timing_tables.size());
+
+    return timing;
+}
+
+std::shared_ptr<tracker_element> packet_chain::handler_stats_endpoint() {
+    // Not a tracked component, like the httpd stats; this is only polled by diagnostic
+    // tools
+    auto ret = std::make_shared<tracker_element_string_map>();
+
+    ret->insert(std::make_pair("kismet.packetchain.handler_stats.enabled",
+                std::make_shared<tracker_element_uint8>(0, handler_stats)));
+    ret->insert(std::make_pair("kismet.packetchain.handler_stats.sample",
+                std::make_shared<tracker_element_uint64>(0, handler_stats_sample)));
+
+    // Upper bound of each histogram bucket
+    auto bounds = std::make_shared<tracker_element_vector_double>();
+    for (unsigned int b = 0; b < n_timing_buckets; b++)
+        bounds->push_back((double) ((uint64_t) 1 << (b + 1)));
+    ret->insert(std::make_pair("kismet.packetchain.handler_stats.bucket_ns", bounds));
+
+    auto handlers_vec = std::make_shared<tracker_element_vector>();
+    ret->insert(std::make_pair("kismet.packetchain.handler_stats.handlers", handlers_vec));
+
+    auto threads_vec = std::make_shared<tracker_element_vector>();
+    ret->insert(std::make_pair("kismet.packetchain.handler_stats.threads", threads_vec));
+
+    struct timing_sum {
+        uint64_t count = 0, total_ns = 0, max_ns = 0;
+        uint64_t buckets[n_timing_buckets] = {};
+
+        void add(const handler_timing& t) {
+            count += t.count.load(std::memory_order_relaxed);
+            total_ns += t.total_ns.load(std::memory_order_relaxed);
+            max_ns = std::max(max_ns, t.max_ns.load(std::memory_order_relaxed));
+
+            for (unsigned int b = 0; b < n_timing_buckets; b++)
+                buckets[b] += t.buckets[b].load(std::memory_order_relaxed);
+        }
+
+        // Upper bound of the bucket holding the given fraction of samples
+        uint64_t percentile(double p) const {
+            uint64_t target = (uint64_t) std::ceil(count * p);
+            uint64_t seen = 0;
+
+            for (unsigned int b = 0; b < n_timing_buckets; b++) {
+                seen += buckets[b];
+                if (seen >= target && seen > 0)
+                    return (uint64_t) 1 << (b + 1);
+            }
+
+            return 0;
+        }
+
+        void fill(std::shared_ptr<tracker_element_string_map> m) const {
+            auto add_u64 = [&m](const std::string& k, uint64_t v) {
+                m->insert(std::make_pair(k, std::make_shared<tracker_element_uint64>(0, v)));
+            };
+
+            add_u64("kismet.packetchain.timing.count", count);
+            add_u64("kismet.packetchain.timing.total_ns", total_ns);
+            add_u64("kismet.packetchain.timing.avg_ns", count == 0 ? 0 : total_ns / count);
+            add_u64("kismet.packetchain.timing.max_ns", max_ns);
+            add_u64("kismet.packetchain.timing.p50_ns", percentile(0.5));
+            add_u64("kismet.packetchain.timing.p99_ns", percentile(0.99));
+
+            auto hist = std::make_shared<tracker_element_vector_double>();
+            for (unsigned int b = 0; b < n_timing_buckets; b++)
+                hist->push_back(buckets[b]);
+            m->insert(std::make_pair("kismet.packetchain.timing.histogram", hist));
+        }
+    };
+
+    if (!handler_stats)
+        return ret;
+
+    std::vector<timing_sum> handler_sums(max_timed_handlers);
+
+    {
+        kis_lock_guard<kis_mutex> lk(timing_mutex, "packetchain handler_stats_endpoint");
+
+        for (const auto& t : timing_tables) {
+            for (int h = 0; h < max_timed_handlers; h++)
+                handler_sums[h].add(t->handlers[h]);
+
+            timing_sum wait;
+            wait.add(t->queue_wait);
+
+            auto tm = std::make_shared<tracker_element_string_map>();
+            tm->insert(std::make_pair("kismet.packetchain.thread.name",
+                        std::make_shared<tracker_element_string>(t->name)));
+            wait.fill(tm);
+            threads_vec->push_back(tm);
+        }
+    }
+
+    auto add_chain = [&](const std::vector<pc_link *>& chain, const std::string& chain_name) {
+        for (const auto& pcl : chain) {
+            if (pcl->id >= max_timed_handlers)
+                continue;
+
+            // Name handlers by their registration site, without the build path
+            std::string site = pcl->site_file != nullptr ? pcl->site_file : "unknown";
+            auto slash = site.find_last_of('/');
+            if (slash != std::string::npos)
+                site = site.substr(slash + 1);
+
+            auto hm = std::make_shared<tracker_element_string_map>();
+            hm->insert(std::make_pair("kismet.packetchain.handler.name",
+                        std::make_shared<tracker_element_string>(fmt::format("{}:{}", site, pcl->site_line))));
+            hm->insert(std::make_pair("kismet.packetchain.handler.chain",
+                        std::make_shared<tracker_element_string>(chain_name)));
+            hm->insert(std::make_pair("kismet.packetchain.handler.priority",
+                        std::make_shared<tracker_element_int64>(0, pcl->priority)));
+            hm->insert(std::make_pair("kismet.packetchain.handler.id",
+                        std::make_shared<tracker_element_uint64>(0, pcl->id)));
+            handler_sums[pcl->id].fill(hm);
+
+            handlers_vec->push_back(hm);
+        }
+    };
+
+    std::shared_lock<kis_shared_mutex> lk(packetchain_mutex);
+
+    add_chain(postcap_chain, "postcap");
+    add_chain(llcdissect_chain, "llcdissect");
+    add_chain(decrypt_chain, "decrypt");
+    add_chain(datadissect_chain, "datadissect");
+    add_chain(classifier_chain, "classifier");
+    add_chain(tracker_chain, "tracker");
+    add_chain(logging_chain, "logging");
+
+    return ret;
 }
 
 int packet_chain::remove_handler(int in_id, int in_chain) {
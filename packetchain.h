@@ -35,6 +35,9 @@
 #include <functional>
 #include <queue>
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
 
 #include "eventbus.h"
 #include "globalregistry.h"
@@ -130,6 +133,12 @@ public:
 
     // Inject a packet into the chain
     int process_packet(std::shared_ptr<kis_packet> in_pack);
+
+    // Packets queued to the packet threads which have not finished the chain yet
+    uint64_t fetch_packets_pending();
+
+    // Per-handler timing report, as served at /packetchain/handler_stats
+    std::shared_ptr<tracker_element> handler_stats_endpoint();
  
     // Callback and information 
     typedef int (*pc_callback)(CHAINCALL_PARMS);
@@ -139,40 +148,143 @@ public:
         std::function<int (std::shared_ptr<kis_packet>)> l_callback;
         void *auxdata;
 		int id;
+        int chain;
+        // Where the handler was registered, to name it in the handler stats
+        const char *site_file;
+        int site_line;
     } pc_link;
 
-    // Register a callback, aux data, a chain to put it in, and the priority 
-    int register_handler(pc_callback in_cb, void *in_aux, int in_chain, int in_prio);
-    int register_handler(std::function<int (std::shared_ptr<kis_packet>)> in_cb, int in_chain, int in_prio);
+    // Register a callback, aux data, a chain to put it in, and the priority.  The 
+    // registration site is filled in by the compiler.
+    int register_handler(pc_callback in_cb, void *in_aux, int in_chain, int in_prio,
+            const char *in_file = __builtin_FILE(), int in_line = __builtin_LINE());
+    int register_handler(std::function<int (std::shared_ptr<kis_packet>)> in_cb, int in_chain, int in_prio,
+            const char *in_file = __builtin_FILE(), int in_line = __builtin_LINE());
     int remove_handler(pc_callback in_cb, int in_chain);
 	int remove_handler(int in_id, int in_chain);
 
     static std::string event_packetstats() { return "PACKETCHAIN_STATS"; }
 
+    // Lookup and hit counters for a cache in the packet path, reported with the
+    // packet stats
+    class cache_stat {
+    public:
+        void count(bool hit) {
+            lookups.fetch_add(1, std::memory_order_relaxed);
+            if (hit)
+                hits.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    protected:
+        friend class packet_chain;
+
+        std::atomic<uint64_t> lookups{0}, hits{0};
+
+        std::shared_ptr<tracker_element_uint64> lookups_elem, hits_elem;
+        std::shared_ptr<tracker_element_double> hit_ratio_elem;
+    };
+
+    // Register a cache; reported as kismet.packetchain.[name]_lookups, _hits, and
+    // _hit_ratio
+    std::shared_ptr<cache_stat> register_cache_stat(const std::string& in_name,
+            const std::string& in_desc);
+
     template<typename T>
     std::shared_ptr<T> new_packet_component() {
-        kis_lock_guard<kis_mutex> lk(packetcomp_mutex);
-
-        auto p = component_pool_map.find(typeid(T).hash_code());
-
-        if (p != component_pool_map.end()) {
-            return std::static_pointer_cast<shared_object_pool<T>>(p->second)->acquire();
-        } else {
-            auto pool = std::make_shared<shared_object_pool<T>>();
-            pool->set_max(1024);
-            pool->set_reset([](T *c) { c->reset(); });
-            component_pool_map.insert({typeid(T).hash_code(), pool});
-            return pool->acquire();
-        }
+        static auto& pool =
+            magazine_object_pool<T>::get().enable([](T *c) { c->reset(); }, 1024);
+        return pool.acquire();
     }
 
 protected:
-    void packet_queue_processor(moodycamel::BlockingConcurrentQueue<std::shared_ptr<kis_packet>> *packet_queue);
+    struct packet_thread;
+
+    void packet_queue_processor(packet_thread *thread, const std::string& in_name);
 
     // Common function for both insertion methods
     int register_int_handler(pc_callback in_cb, void *in_aux, 
             std::function<int (std::shared_ptr<kis_packet>)> in_l_cb, 
-            int in_chain, int in_prio);
+            int in_chain, int in_prio, const char *in_file, int in_line);
+
+    // Optional per-handler timing.  Each thread which runs handlers accumulates into
+    // its own table, so the counters are only ever written by one thread and need no
+    // locking; the stats endpoint sums the tables of every thread.  Times are kept 
+    // in power-of-two nanosecond buckets.
+    static constexpr unsigned int n_timing_buckets = 32;
+    static constexpr int max_timed_handlers = 256;
+
+    struct handler_timing {
+        std::atomic<uint64_t> count{0}, total_ns{0}, max_ns{0};
+        std::atomic<uint64_t> buckets[n_timing_buckets] = {};
+
+        // Only called by the thread owning the table
+        void add(uint64_t ns) {
+            unsigned int b = 0;
+            while (b < n_timing_buckets - 1 && (ns >> (b + 1)) != 0)
+                b++;
+
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            total_ns.store(total_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+            if (ns > max_ns.load(std::memory_order_relaxed))
+                max_ns.store(ns, std::memory_order_relaxed);
+            buckets[b].store(buckets[b].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    };
+
+    struct thread_timing {
+        std::string name;
+        uint64_t n_seen {0};
+        // Indexed by handler id
+        handler_timing handlers[max_timed_handlers];
+        // Time packets spent in the queue before this thread picked them up
+        handler_timing queue_wait;
+    };
+
+    bool handler_stats;
+    unsigned int handler_stats_sample;
+
+    kis_mutex timing_mutex;
+    std::vector<std::unique_ptr<thread_timing>> timing_tables;
+
+    // Timing table of the calling thread, created on first use
+    thread_timing *local_timing();
+
+    // Timing table to record this packet in, or nullptr if it isn't sampled
+    thread_timing *sample_timing() {
+        if (!handler_stats)
+            return nullptr;
+
+        auto t = local_timing();
+
+        if (t->n_seen++ % handler_stats_sample != 0)
+            return nullptr;
+
+        return t;
+    }
+
+    static uint64_t timing_now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Run every handler in a chain, timing each one if we have a timing table
+    void run_chain(const std::vector<pc_link *>& chain, std::shared_ptr<kis_packet>& in_pack,
+            thread_timing *timing) {
+        for (const auto& pcl : chain) {
+            uint64_t start = 0;
+
+            if (timing != nullptr)
+                start = timing_now_ns();
+
+            if (pcl->callback != nullptr)
+                pcl->callback(pcl->auxdata, in_pack);
+            else if (pcl->l_callback != nullptr)
+                pcl->l_callback(in_pack);
+
+            if (timing != nullptr && pcl->id < max_timed_handlers)
+                timing->handlers[pcl->id].add(timing_now_ns() - start);
+        }
+    }
 
     int next_componentid, next_handlerid;
 
@@ -197,10 +309,12 @@ protected:
     struct packet_thread {
         std::thread packet_thread;
         moodycamel::BlockingConcurrentQueue<std::shared_ptr<kis_packet>> packet_queue;
+        // Packets handed to this thread, and packets it has finished
+        std::atomic<uint64_t> n_queued{0}, n_processed{0};
     };
 
-    packet_thread **packet_threads;
-    size_t n_packet_threads;
+    packet_thread **packet_threads {nullptr};
+    size_t n_packet_threads {0};
 
     bool packetchain_shutdown;
 
@@ -237,18 +351,13 @@ protected:
     int event_timer_id;
     std::shared_ptr<event_bus> eventbus;
 
-    // Packet & data component pools
-    shared_object_pool<kis_packet> packet_pool;
-
-    robin_hood::unordered_map<size_t, std::shared_ptr<void>> component_pool_map;
-
-    // Unique lock for packet number and dedupe
-    kis_shared_mutex pack_no_mutex;
+    // Packet pool; component pools are per type, see new_packet_component
+    magazine_object_pool<kis_packet>& packet_pool;
 
     // Next unique packet number
     std::atomic<uint64_t> unique_packet_no;
 
-    // A simple array of hash to packet ID for the past 1024 unique packets
+    // Hash to packet ID for the recent unique packets
     typedef struct packno_map {
         packno_map() {
             hash = 0;
@@ -260,10 +369,32 @@ protected:
         std::shared_ptr<kis_packet> original_pkt;
     } packno_map_t;
 
-    packno_map_t dedupe_list[1024];
+    // The dedupe window is a set-associative table indexed by the packet hash; each
+    // bucket holds a few recent packets under its own lock, so packet threads only
+    // contend when their packets land in the same bucket.  When a bucket is full the
+    // oldest packet in it is replaced, bounding the window to packet_dedup_size packets.
+    static constexpr unsigned int dedupe_bucket_ways = 4;
+
+    struct dedupe_bucket {
+        kis_mutex mutex;
+        packno_map_t entries[dedupe_bucket_ways];
+    };
+
+    std::unique_ptr<dedupe_bucket[]> dedupe_buckets;
+    size_t dedupe_bucket_mask;
+
+    // Look up a packet in the dedupe window, caching it if it is not already present;
+    // returns the original packet if this is a duplicate
+    std::shared_ptr<kis_packet> dedupe_lookup_insert(std::shared_ptr<kis_packet> in_pack);
+
+    std::atomic<uint64_t> dedupe_lookups, dedupe_hits, dedupe_probes;
+
+    std::shared_ptr<tracker_element_uint64> dedupe_lookups_elem, dedupe_hits_elem;
+    std::shared_ptr<tracker_element_double> dedupe_hit_ratio_elem, dedupe_probe_len_elem;
+    int dedupe_lookups_id, dedupe_hits_id, dedupe_hit_ratio_id, dedupe_probe_len_id;
 
-    // Current position in the dedupe list
-    std::atomic<unsigned int> dedupe_list_pos;
+    kis_mutex cache_stat_mutex;
+    std::vector<std::shared_ptr<cache_stat>> cache_stats;
 
 	int pack_comp_linkframe, pack_comp_decap, pack_comp_l1_agg, pack_comp_l1, pack_comp_datasource;
     
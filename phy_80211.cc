@@ -810,6 +810,14 @@ kis_80211_phy::kis_80211_phy(int in_phyid) :
         _MSG_INFO("Keeping a copy of advertised IE tags for each SSID; this can use more CPU and RAM.");
 
 
+    beacon_fingerprint_cache =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("dot11_beacon_cache", true);
+    if (!beacon_fingerprint_cache)
+        _MSG_INFO("Fully processing every beacon; this can use significantly more CPU.");
+
+    beacon_cache_stat =
+        packetchain->register_cache_stat("dot11_beacon_cache", "802.11 beacon fingerprint cache");
+
     keep_eapol_packets =
         Globalreg::globalreg->kismet_config->fetch_opt_bool("dot11_keep_eapol", true);
     if (keep_eapol_packets)
@@ -2536,23 +2544,41 @@ void kis_80211_phy::handle_ssid(std::shared_ptr<kis_tracked_device_base> basedev
     }
 
     // If we've processed an identical ssid, don't waste time parsing again, just tweak
-    // the few fields we need to update
-    if (dot11dev->get_last_adv_ie_csum() == dot11info->ietag_csum) {
-        ssid = dot11dev->get_last_adv_ssid();
+    // the few fields we need to update.  The fingerprint leaves out the tags which change
+    // every beacon; when we keep a copy of the tags, use the checksum of all of them.
+    auto ie_csum = keep_ie_tags_per_bssid ? dot11info->ietag_csum : dot11info->ie_fingerprint;
 
-        if (ssid != nullptr) {
-            if (ssid->get_last_time() < in_pack->ts.tv_sec)
-                ssid->set_last_time(in_pack->ts.tv_sec);
+    if (beacon_fingerprint_cache && !dot11dev->get_snap_next_beacon()) {
+        bool hit = false;
 
-            if (dot11info->subtype == packet_sub_beacon) {
-                ssid->inc_beacons_sec();
+        if (ie_csum != 0 && dot11dev->get_last_adv_ie_csum() == ie_csum) {
+            ssid = dot11dev->get_last_adv_ssid();
+
+            if (ssid != nullptr) {
+                hit = true;
+
+                if (ssid->get_last_time() < in_pack->ts.tv_sec)
+                    ssid->set_last_time(in_pack->ts.tv_sec);
+
+                if (dot11info->subtype == packet_sub_beacon) {
+                    ssid->inc_beacons_sec();
+
+                    if (dot11info->qbss_stations >= 0) {
+                        ssid->set_dot11e_qbss_stations(dot11info->qbss_stations);
+                        ssid->set_dot11e_qbss_channel_load(
+                                ((double) dot11info->qbss_channel_utilization / 255.0f) * 100.0f);
+                    }
+                }
             }
         }
 
-        return;
+        beacon_cache_stat->count(hit);
+
+        if (hit)
+            return;
     }
 
-    dot11dev->set_last_adv_ie_csum(dot11info->ietag_csum);
+    dot11dev->set_last_adv_ie_csum(ie_csum);
 
     // If we fail parsing...
     if (packet_dot11_ie_dissector(in_pack, dot11info) < 0) {
@@ -24,6 +24,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <list>
 #include <map>
@@ -150,6 +151,9 @@ class dot11_packinfo : public packet_component {
 
             // Many of these will not be available until the IE tags are parsed
             ietag_csum = 0;
+            ie_fingerprint = 0;
+            qbss_stations = -1;
+            qbss_channel_utilization = 0;
 
             dot11d_country = "";
 
@@ -272,6 +276,15 @@ class dot11_packinfo : public packet_component {
         uint32_t ssid_csum;
         uint32_t ietag_csum;
 
+        // Checksum of the beacon or probe response IE tags, less the tags which change
+        // from one beacon to the next (TIM and BSS load); 0 if not computed
+        uint32_t ie_fingerprint;
+
+        // BSS load values, picked up while computing the fingerprint so that a cached
+        // beacon can still update them; stations is -1 if there is no BSS load tag
+        int qbss_stations;
+        uint8_t qbss_channel_utilization;
+
         // Tupled hash map
         std::multimap<std::tuple<uint8_t, uint32_t, uint8_t>, size_t> ietag_hash_map;
 
@@ -459,6 +472,13 @@ public:
         return hash.hash();
     }
 
+    // Hash SSID tag data in place; as when hashing the tag from a C string, only the
+    // SSID up to the first NUL is hashed, along with the full tag length
+    static size_t ssid_hash(const nonstd::string_view& ssid) {
+        return ssid_hash(std::string(ssid.data(), strnlen(ssid.data(), ssid.length())),
+                ssid.length());
+    }
+
     virtual bool device_is_a(std::shared_ptr<kis_tracked_device_base> dev) override;
 
     std::shared_ptr<dot11_tracked_device> fetch_dot11_record(std::shared_ptr<kis_tracked_device_base> dev);
@@ -612,6 +632,10 @@ protected:
     // Do we store the last beaconed tags in the ssid record?
     bool keep_ie_tags_per_bssid;
 
+    // Do we skip processing beacons whose IE fingerprint has not changed?
+    bool beacon_fingerprint_cache;
+    std::shared_ptr<packet_chain::cache_stat> beacon_cache_stat;
+
     // Do we keep WPA packets?
     bool keep_eapol_packets;
 
@@ -228,6 +228,46 @@ static const uint32_t dot11_wep_crc32_table[256] = {
     0x2d02ef8dL
 };
 
+// Fingerprint the IE tags of a beacon or probe response for the per-BSSID beacon cache.
+// The TIM and BSS load tags change from beacon to beacon, so they are left out of the
+// checksum and the BSS load values are kept in the packinfo instead.  The subtype seeds
+// the checksum so that a beacon and a probe response with the same tags differ.
+static void dot11_ie_fingerprint(const char *data, size_t len,
+        std::shared_ptr<dot11_packinfo> packinfo) {
+    uint8_t subtype = packinfo->subtype;
+    uint32_t csum = crc32_16bytes_prefetch(&subtype, 1);
+
+    size_t pos = 0;
+    size_t seg_start = 0;
+
+    while (pos + 2 <= len) {
+        uint8_t tag_num = data[pos];
+        uint8_t tag_len = data[pos + 1];
+
+        if (pos + 2 + tag_len > len)
+            break;
+
+        if (tag_num == 5 || tag_num == 11) {
+            csum = crc32_16bytes_prefetch(data + seg_start, pos - seg_start, csum);
+            seg_start = pos + 2 + tag_len;
+
+            if (tag_num == 11 && (tag_len == 4 || tag_len == 5)) {
+                packinfo->qbss_stations =
+                    (uint8_t) data[pos + 2] | ((uint8_t) data[pos + 3] << 8);
+                packinfo->qbss_channel_utilization = data[pos + 4];
+            }
+        }
+
+        pos += 2 + tag_len;
+    }
+
+    // Anything trailing, including a truncated tag, is checksummed as-is
+    csum = crc32_16bytes_prefetch(data + seg_start, len - seg_start, csum);
+
+    // 0 means no fingerprint
+    packinfo->ie_fingerprint = csum == 0 ? 1 : csum;
+}
+
 // Convert WPA cipher elements into crypt_set stuff
 int kis_80211_phy::wpa_cipher_conv(uint8_t cipher_index) {
     int ret = crypt_wpa;
@@ -649,6 +689,9 @@ int kis_80211_phy::packet_dot11_dissector(std::shared_ptr<kis_packet> in_pack) {
                     crc32_16bytes_prefetch(chunk->data() + packinfo->header_offset,
                                            chunk->length() - packinfo->header_offset);
 
+                dot11_ie_fingerprint(chunk->data() + packinfo->header_offset,
+                        chunk->length() - packinfo->header_offset, packinfo);
+
                 break;
 
             case 8:
@@ -699,6 +742,9 @@ int kis_80211_phy::packet_dot11_dissector(std::shared_ptr<kis_packet> in_pack) {
                     crc32_16bytes_prefetch(chunk->data() + packinfo->header_offset,
                                            chunk->length() - packinfo->header_offset);
 
+                dot11_ie_fingerprint(chunk->data() + packinfo->header_offset,
+                        chunk->length() - packinfo->header_offset, packinfo);
+
                 break;
 
             case 9:
@@ -1218,43 +1264,29 @@ std::shared_ptr<std::vector<kis_80211_phy::ie_tag_tuple>> kis_80211_phy::packet_
         if (chunk->dlt != KDLT_IEEE802_11)
             return packinfo->ie_tags_listed;
 
-        membuf tags_membuf((char *) &(chunk->data()[packinfo->header_offset]), 
-                (char *) &(chunk->data()[chunk->length()]));
-        std::istream istream_ietags(&tags_membuf);
+        if (chunk->length() < packinfo->header_offset)
+            return packinfo->ie_tags_listed;
 
 		packinfo->ie_tags = Globalreg::new_from_pool<dot11_ie>();
 
+        // Tags reference the packet data in place
         try {
-            std::shared_ptr<kaitai::kstream> stream_ietags(new kaitai::kstream(&istream_ietags));
-            packinfo->ie_tags->parse(stream_ietags);
+            packinfo->ie_tags->parse(chunk->data() + packinfo->header_offset,
+                    chunk->length() - packinfo->header_offset);
         } catch (const std::exception& e) {
             return packinfo->ie_tags_listed;
         }
     }
 
     for (auto ie_tag : *(packinfo->ie_tags->tags())) {
-        if (ie_tag->tag_num() == 150) {
-            try {
-                ie_tag->tag_data_stream()->seek(0);
-
-				auto vendor = Globalreg::new_from_pool<dot11_ie_150_vendor>();
-                vendor->parse(ie_tag->tag_data_stream());
+        if (ie_tag->tag_num() == 150 || ie_tag->tag_num() == 221) {
+            uint32_t oui;
+            uint8_t oui_type;
 
-                packinfo->ie_tags_listed->push_back(ie_tag_tuple{150, vendor->vendor_oui_int(), vendor->vendor_oui_type()});
-            } catch (const std::exception &e) {
+            if (!ie_tag->vendor_oui(oui, oui_type))
                 return packinfo->ie_tags_listed;
-            }
-        } else if (ie_tag->tag_num() == 221) {
-            try {
-                ie_tag->tag_data_stream()->seek(0);
-
-				auto vendor = Globalreg::new_from_pool<dot11_ie_221_vendor>();
-                vendor->parse(ie_tag->tag_data_stream());
 
-                packinfo->ie_tags_listed->push_back(ie_tag_tuple{221, vendor->vendor_oui_int(), vendor->vendor_oui_type()});
-            } catch (const std::exception &e) {
-                return packinfo->ie_tags_listed;
-            }
+            packinfo->ie_tags_listed->push_back(ie_tag_tuple{ie_tag->tag_num(), oui, oui_type});
         } else {
             packinfo->ie_tags_listed->push_back(ie_tag_tuple{ie_tag->tag_num(), 0, 0});
         }
@@ -1286,15 +1318,17 @@ int kis_80211_phy::packet_dot11_ie_dissector(std::shared_ptr<kis_packet> in_pack
         return 0;
 
     if (packinfo->ie_tags == nullptr) {
-        membuf tags_membuf((char *) &(chunk->data()[packinfo->header_offset]), 
-                (char *) &(chunk->data()[chunk->length()]));
-        std::istream istream_ietags(&tags_membuf);
+        if (chunk->length() < packinfo->header_offset) {
+            packinfo->corrupt = 1;
+            return -1;
+        }
 
 		packinfo->ie_tags = Globalreg::new_from_pool<dot11_ie>();
 
+        // Tags reference the packet data in place
         try {
-            std::shared_ptr<kaitai::kstream> stream_ietags(new kaitai::kstream(&istream_ietags));
-            packinfo->ie_tags->parse(stream_ietags);
+            packinfo->ie_tags->parse(chunk->data() + packinfo->header_offset,
+                    chunk->length() - packinfo->header_offset);
         } catch (const std::exception& e) {
             // fmt::print(stderr, "debug - IE tag structure corrupt\n");
             packinfo->corrupt = 1;
@@ -1312,33 +1346,23 @@ int kis_80211_phy::packet_dot11_ie_dissector(std::shared_ptr<kis_packet> in_pack
     unsigned int wmmtspec_responses = 0;
 
     for (auto ie_tag : *(packinfo->ie_tags->tags())) {
-        auto hash = std::hash<std::string>{};
+        const auto& tag_data = ie_tag->tag_data_view();
+        auto tag_hash = std::hash<nonstd::string_view>{}(tag_data);
 
-        if (ie_tag->tag_num() == 150) {
-            try {
-				auto vendor = Globalreg::new_from_pool<dot11_ie_150_vendor>();
-                vendor->parse(ie_tag->tag_data_stream());
+        if (ie_tag->tag_num() == 150 || ie_tag->tag_num() == 221) {
+            uint32_t oui;
+            uint8_t oui_type;
 
-                packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{150, vendor->vendor_oui_int(), 
-                    vendor->vendor_oui_type()}, hash(ie_tag->tag_data())));
-            } catch (const std::exception& e) {
+            if (!ie_tag->vendor_oui(oui, oui_type)) {
                 packinfo->corrupt = 1;
                 return -1;
             }
-        } else if (ie_tag->tag_num() == 221) {
-            try {
-				auto vendor = Globalreg::new_from_pool<dot11_ie_221_vendor>();
-                vendor->parse(ie_tag->tag_data_stream());
 
-                packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{221, vendor->vendor_oui_int(), 
-                    vendor->vendor_oui_type()}, hash(ie_tag->tag_data())));
-            } catch (const std::exception& e) {
-                packinfo->corrupt = 1;
-                return -1;
-            }
+            packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{ie_tag->tag_num(), oui, oui_type},
+                        tag_hash));
         } else {
             packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{ie_tag->tag_num(), 0, 0}, 
-                                                           hash(ie_tag->tag_data())));
+                        tag_hash));
         }
 
         // IE 0 SSID
@@ -1351,9 +1375,8 @@ int kis_80211_phy::packet_dot11_ie_dissector(std::shared_ptr<kis_packet> in_pack
             seen_ssid = true;
             */
 
-            packinfo->ssid_len = ie_tag->tag_data().length();
-            packinfo->ssid_csum = kis_80211_phy::ssid_hash(ie_tag->tag_data().data(), 
-                    ie_tag->tag_data().length());
+            packinfo->ssid_len = tag_data.length();
+            packinfo->ssid_csum = kis_80211_phy::ssid_hash(tag_data);
 
             if (packinfo->ssid_len == 0) {
                 packinfo->ssid_blank = true;
@@ -1361,7 +1384,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(std::shared_ptr<kis_packet> in_pack
             }
 
             if (packinfo->ssid_len <= DOT11_PROTO_SSID_LEN) {
-                if (ie_tag->tag_data().find_first_not_of('\0') == std::string::npos) {
+                if (tag_data.find_first_not_of('\0') == nonstd::string_view::npos) {
                     packinfo->ssid_blank = true;
                 } else {
                     packinfo->ssid = munge_to_printable(ie_tag->tag_data().data());
@@ -1403,7 +1426,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(std::shared_ptr<kis_packet> in_pack
                 */
             }
 
-            if (ie_tag->tag_data().find("\x75\xEB\x49") != std::string::npos) {
+            if (tag_data.find("\x75\xEB\x49") != nonstd::string_view::npos) {
                 _ALERT(alert_msfdlinkrate_ref, in_pack, packinfo,
                         "MSF-style poisoned rate field in beacon for network " +
                         packinfo->bssid_mac.mac_to_string() + ", exploit attempt "
@@ -1414,7 +1437,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(std::shared_ptr<kis_packet> in_pack
             }
 
             std::vector<std::string> basicrates;
-            for (uint8_t r : ie_tag->tag_data()) {
+            for (uint8_t r : tag_data) {
                 std::string rate;
 
                 switch (r) {
@@ -1577,7 +1600,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(std::shared_ptr<kis_packet> in_pack
                 return -1;
             }
                 
-            packinfo->channel = fmt::format("{}", (uint8_t) (ie_tag->tag_data()[0]));
+            packinfo->channel = fmt::format("{}", (uint8_t) (tag_data[0]));
             continue;
         }
 
@@ -1872,8 +1895,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(std::shared_ptr<kis_packet> in_pack
 			// If we have no SSID tag, use the mesh ID as the SSID checksum to differentiate
 			// between multiple mesh advertisements; otherwise use the SSID
 			if (packinfo->ssid_len == 0) {
-				packinfo->ssid_csum = kis_80211_phy::ssid_hash(ie_tag->tag_data().data(), 
-						ie_tag->tag_data().length());
+				packinfo->ssid_csum = kis_80211_phy::ssid_hash(tag_data);
 			}
 
             continue;
@@ -2006,7 +2028,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(std::shared_ptr<kis_packet> in_pack
                 if (packinfo->subtype == packet_sub_beacon &&
                         vendor->vendor_oui_int() == 0x0050f2 &&
                         vendor->vendor_oui_type() == 2 &&
-                        ie_tag->tag_data().length() > 24) {
+                        tag_data.length() > 24) {
 
                     std::string al = "IEEE80211 Access Point BSSID " + 
                         packinfo->bssid_mac.mac_to_string() + " sent association "
@@ -970,7 +970,32 @@ kis_adsb_phy::adsb_map_endp_handler(std::shared_ptr<kis_net_beast_httpd_connecti
             return false;
         });
 
-    adsb_view->do_readonly_device_work(recent_worker);
+    // Clients which only display part of the map can post the visible area as 
+    // 'bbox': [min_lat, min_lon, max_lat, max_lon] and only walk the devices inside it
+    auto bbox = con->json()["bbox"];
+    auto spatial_index = devicetracker->get_spatial_index();
+
+    if (spatial_index != nullptr && bbox.is_array() && bbox.size() == 4) {
+        try {
+            auto candidates = spatial_index->query_bbox(bbox[0].get<double>(), bbox[1].get<double>(),
+                    bbox[2].get<double>(), bbox[3].get<double>());
+
+            auto candidate_vec = std::make_shared<tracker_element_vector>();
+            candidate_vec->reserve(candidates.size());
+
+            for (const auto& d : candidates) 
+                candidate_vec->push_back(d);
+
+            adsb_view->do_readonly_device_work(recent_worker, candidate_vec);
+        } catch (const std::exception& e) {
+            con->set_status(400);
+            std::ostream os(&con->response_stream());
+            os << "Invalid bbox: " << e.what() << "\n";
+            return nullptr;
+        }
+    } else {
+        adsb_view->do_readonly_device_work(recent_worker);
+    }
 
     return ret_map;
 }
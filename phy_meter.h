@@ -63,11 +63,12 @@ public:
     }
 
     // Simple average
-    static int64_t combine_vector(std::shared_ptr<tracker_element_vector_double> e) {
+    template<typename C>
+    static int64_t combine_vector(const C& e) {
         int64_t avg = 0;
         int64_t avg_c = 0;
 
-        for (auto i : *e) {
+        for (auto i : e) {
             if (i != default_val()) {
                 avg += i;
                 avg_c++;
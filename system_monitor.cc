@@ -107,6 +107,7 @@ Systemmonitor::Systemmonitor() :
 
     monitor_endp = std::make_shared<kis_net_web_tracked_endpoint>(status, monitor_mutex);
     httpd->register_route("/system/status", {"GET", "POST"}, httpd->RO_ROLE, {}, monitor_endp);
+    httpd->enable_route_cache("/system/status");
 
     user_monitor_endp = std::make_shared<kis_net_web_tracked_endpoint>(
             [this](std::shared_ptr<kis_net_beast_httpd_connection>) -> std::shared_ptr<tracker_element> {
@@ -134,6 +135,12 @@ Systemmonitor::Systemmonitor() :
             }, monitor_mutex);
     httpd->register_route("/system/timestamp", {"GET", "POST"}, httpd->RO_ROLE, {}, timestamp_endp);
 
+    httpd->register_route("/system/lock_stats", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection>) {
+                    return lock_stats_endpoint();
+                }));
+
     if (Globalreg::globalreg->kismet_config->fetch_opt_bool("kis_log_system_status", true)) {
         auto snap_time_s = 
             Globalreg::globalreg->kismet_config->fetch_opt_as<unsigned int>("kis_log_system_status_rate", 30);
@@ -250,6 +257,58 @@ Systemmonitor::~Systemmonitor() {
     eventbus->remove_listener(logopen_evt_id);
 }
 
+std::shared_ptr<tracker_element> Systemmonitor::lock_stats_endpoint() {
+    // Like the packetchain handler stats, this is only polled by diagnostic tools, so
+    // it isn't a tracked component
+    auto ret = std::make_shared<tracker_element_string_map>();
+
+    ret->insert(std::make_pair("kismet.lock_stats.enabled",
+                std::make_shared<tracker_element_uint8>(0, kis_lock_profiler::active())));
+
+    if (!kis_lock_profiler::active())
+        return ret;
+
+    auto stats_vec = [](const std::vector<kis_lock_profiler::lock_stats>& stats, bool per_op) {
+        auto vec = std::make_shared<tracker_element_vector>();
+
+        for (const auto& s : stats) {
+            auto m = std::make_shared<tracker_element_string_map>();
+
+            auto add_u64 = [&m](const std::string& k, uint64_t v) {
+                m->insert(std::make_pair(k, std::make_shared<tracker_element_uint64>(0, v)));
+            };
+
+            m->insert(std::make_pair("kismet.lock_stats.mutex",
+                        std::make_shared<tracker_element_string>(s.mutex_name)));
+            if (per_op)
+                m->insert(std::make_pair("kismet.lock_stats.op",
+                            std::make_shared<tracker_element_string>(s.op)));
+
+            add_u64("kismet.lock_stats.count", s.count);
+            add_u64("kismet.lock_stats.contended", s.contended);
+            add_u64("kismet.lock_stats.wait_ns", s.wait_ns);
+            add_u64("kismet.lock_stats.avg_wait_ns", s.contended == 0 ? 0 : s.wait_ns / s.contended);
+            add_u64("kismet.lock_stats.max_wait_ns", s.max_wait_ns);
+            add_u64("kismet.lock_stats.hold_ns", s.hold_ns);
+            add_u64("kismet.lock_stats.avg_hold_ns", s.count == 0 ? 0 : s.hold_ns / s.count);
+            add_u64("kismet.lock_stats.max_hold_ns", s.max_hold_ns);
+
+            vec->push_back(m);
+        }
+
+        return vec;
+    };
+
+    ret->insert(std::make_pair("kismet.lock_stats.mutexes",
+                stats_vec(kis_lock_profiler::report(false, 50), false)));
+    ret->insert(std::make_pair("kismet.lock_stats.ops",
+                stats_vec(kis_lock_profiler::report(true, 50), true)));
+    ret->insert(std::make_pair("kismet.lock_stats.overflow",
+                std::make_shared<tracker_element_uint64>(0, kis_lock_profiler::overflow())));
+
+    return ret;
+}
+
 void tracked_system_status::register_fields() {
     register_field("kismet.system.battery.percentage", "remaining battery percentage", &battery_perc);
     register_field("kismet.system.battery.charging", "battery charging state", &battery_charging);
@@ -166,6 +166,9 @@ protected:
     std::shared_ptr<kis_net_web_tracked_endpoint> user_monitor_endp;
     std::shared_ptr<kis_net_web_tracked_endpoint> timestamp_endp;
 
+    // Most contended locks, when the lock profiler is enabled
+    std::shared_ptr<tracker_element> lock_stats_endpoint();
+
     std::shared_ptr<device_tracker> devicetracker;
 
     std::shared_ptr<tracked_system_status> status;
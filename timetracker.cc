@@ -25,15 +25,17 @@
 
 #include "timetracker.h"
 
+#include "entrytracker.h"
+#include "kis_net_beast_httpd.h"
 #include "messagebus.h"
 
 time_tracker::time_tracker() {
     time_mutex.set_name("time_tracker");
-    removed_id_mutex.set_name("time_tracker_removed_id");
 
     next_timer_id = 1;
 
-    timer_sort_required = true;
+    wheel_tick = 0;
+    wheel_start = std::chrono::steady_clock::now();
 
     struct timeval cur_tm;
     gettimeofday(&cur_tm, NULL);
@@ -44,22 +46,72 @@ time_tracker::time_tracker() {
 
     shutdown = false;
 
-    // Allocate workers and fill them with joinable threads
-    auto n_worker_threads = static_cast<unsigned int>(std::thread::hardware_concurrency());
-    time_workers.resize(n_worker_threads);
-
-    for (unsigned int x = 0; x < time_workers.size(); x++) {
-        time_workers[x] = std::thread([]() { });
+    auto entrytracker = Globalreg::fetch_mandatory_global_as<entry_tracker>();
+
+    timer_entry_id =
+        entrytracker->register_field("kismet.timer.timer",
+                tracker_element_factory<tracker_element_map>(),
+                "Timer statistics");
+    timer_id_id =
+        entrytracker->register_field("kismet.timer.id",
+                tracker_element_factory<tracker_element_int32>(),
+                "Timer ID");
+    timer_name_id =
+        entrytracker->register_field("kismet.timer.name",
+                tracker_element_factory<tracker_element_string>(),
+                "Timer registration site");
+    timer_interval_id =
+        entrytracker->register_field("kismet.timer.interval_ms",
+                tracker_element_factory<tracker_element_double>(),
+                "Timer interval (ms)");
+    timer_runs_id =
+        entrytracker->register_field("kismet.timer.runs",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Number of times the timer has run");
+    timer_overruns_id =
+        entrytracker->register_field("kismet.timer.overruns",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Number of runs which took longer than the timer interval");
+    timer_last_ms_id =
+        entrytracker->register_field("kismet.timer.last_ms",
+                tracker_element_factory<tracker_element_double>(),
+                "Run time of the most recent callback (ms)");
+    timer_max_ms_id =
+        entrytracker->register_field("kismet.timer.max_ms",
+                tracker_element_factory<tracker_element_double>(),
+                "Longest callback run time (ms)");
+    timer_avg_ms_id =
+        entrytracker->register_field("kismet.timer.avg_ms",
+                tracker_element_factory<tracker_element_double>(),
+                "Average callback run time (ms)");
+    timer_max_latency_id =
+        entrytracker->register_field("kismet.timer.max_latency_ms",
+                tracker_element_factory<tracker_element_double>(),
+                "Longest delay between the timer expiring and the callback starting (ms)");
+    timer_avg_latency_id =
+        entrytracker->register_field("kismet.timer.avg_latency_ms",
+                tracker_element_factory<tracker_element_double>(),
+                "Average delay between the timer expiring and the callback starting (ms)");
+
+    // Start the persistent worker pool
+    auto n_worker_threads = std::max(static_cast<unsigned int>(std::thread::hardware_concurrency()), 2U);
+
+    for (unsigned int x = 0; x < n_worker_threads; x++) {
+        time_workers.push_back(std::thread([this]() {
+                    thread_set_process_name("TIME_EVT");
+                    time_worker();
+                }));
     }
+}
 
-    /*
-    time_dispatch_t =
-        std::thread([this]() {
-                thread_set_process_name("timers");
-                time_dispatcher();
-            });
-            */
+void time_tracker::trigger_deferred_startup() {
+    auto httpd = Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>();
 
+    httpd->register_route("/timetracker/slow_timers", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) -> std::shared_ptr<tracker_element> {
+                    return slow_timers_endp_handler(con);
+                }));
 }
 
 void time_tracker::spawn_timetracker_thread() {
@@ -76,16 +128,63 @@ time_tracker::~time_tracker() {
     if (time_dispatch_t.joinable())
         time_dispatch_t.join();
 
-    // time_dispatch_t.join();
+    // Wake up and retire the workers
+    for (unsigned int x = 0; x < time_workers.size(); x++)
+        time_worker_queue.enqueue(nullptr);
+
+    for (auto& t : time_workers) {
+        if (t.joinable())
+            t.join();
+    }
 
     Globalreg::globalreg->remove_global("TIMETRACKER");
     Globalreg::globalreg->timetracker = NULL;
 }
 
+uint64_t time_tracker::current_wheel_tick() {
+    return std::chrono::duration_cast<slice>(std::chrono::steady_clock::now() - wheel_start).count();
+}
+
+void time_tracker::wheel_insert(std::shared_ptr<timer_event> evt) {
+    // Timers placed during a cascade may be due on the current tick, anything else
+    // goes no earlier than the next tick
+    if (evt->expire_tick < wheel_tick)
+        evt->expire_tick = wheel_tick + 1;
+
+    auto delta = evt->expire_tick - wheel_tick;
+
+    for (unsigned int l = 0; l < wheel_levels; l++) {
+        if (delta < (1ULL << (wheel_bits * (l + 1)))) {
+            auto slot = (evt->expire_tick >> (wheel_bits * l)) & (wheel_slots - 1);
+            timer_wheel[l][slot].push_back(evt);
+            return;
+        }
+    }
+
+    // Past the span of the wheel; park it in the furthest slot of the top level and
+    // it will be re-placed when that slot cascades
+    auto top = wheel_levels - 1;
+    auto slot = ((wheel_tick + (1ULL << (wheel_bits * wheel_levels)) - 1) >> (wheel_bits * top)) &
+        (wheel_slots - 1);
+    timer_wheel[top][slot].push_back(evt);
+}
+
+void time_tracker::wheel_cascade(unsigned int level) {
+    auto slot = (wheel_tick >> (wheel_bits * level)) & (wheel_slots - 1);
+
+    auto cascade = std::move(timer_wheel[level][slot]);
+    timer_wheel[level][slot].clear();
+
+    for (const auto& evt : cascade) {
+        if (evt->timer_cancelled)
+            continue;
+
+        wheel_insert(evt);
+    }
+}
+
 void time_tracker::time_dispatcher() {
     while (!shutdown && !Globalreg::globalreg->spindown && !Globalreg::globalreg->fatal_condition) {
-        kis_unique_lock<kis_mutex> lock(time_mutex, std::defer_lock, "time_tracker time_dispatcher");
-
         // Calculate the next tick
         auto start = std::chrono::system_clock::now();
         auto end = start + std::chrono::milliseconds(1000 / SERVER_TIMESLICES_SEC);
@@ -97,176 +196,112 @@ void time_tracker::time_dispatcher() {
         Globalreg::globalreg->last_tv_sec = cur_tm.tv_sec;
         Globalreg::globalreg->last_tv_usec = cur_tm.tv_usec;
 
-        // Sort and duplicate the vector to a safe list; we have to re-sort 
-        // timers from recurring events
-        lock.lock();
-
-        if (timer_sort_required)
-            sort(sorted_timers.begin(), sorted_timers.end(), sort_timer_events_trigger());
-
-        timer_sort_required = false;
-
-        // Sort the timers
-        auto action_timers = std::vector<std::shared_ptr<timer_event>>(sorted_timers.begin(), sorted_timers.end());
-        lock.unlock();
+        auto now_tick = current_wheel_tick();
 
-        for (auto evt : action_timers) {
-            // If we're pending cancellation, throw us out
-            if (evt->timer_cancelled) {
-                kis_lock_guard<kis_mutex> rl(removed_id_mutex);
-                removed_timer_ids.push_back(evt->timer_id);
-                continue;
-            }
-
-            // We're into the future, bail
-            if ((cur_tm.tv_sec < evt->trigger_tm.tv_sec) ||
-                    ((cur_tm.tv_sec == evt->trigger_tm.tv_sec) && (cur_tm.tv_usec < evt->trigger_tm.tv_usec))) {
-                break;
-            }
-
-            // Find a usable worker slot; this is a fast-burn while loop for now
-            // to see how it performs, if we need to add a sleep we will
-            bool launched = false;
-            time_t started_looking = time(0);
-            while (!launched) {
-                // Catch an unwinnable situation for timers; 5 seconds is actually excessively long for
-                // timers that could be executing at 10Hz.
-                if (started_looking - time(0) > 5) {
-                    throw std::runtime_error("Couldn't find a slot in the timer handlers in 5 seconds; something "
-                                             "has gone wrong, most likely thread deadlocks.");
+        {
+            kis_lock_guard<kis_mutex> lk(time_mutex, "time_tracker time_dispatcher");
+
+            // Advance the wheel to the current tick, catching up on any ticks we
+            // missed if the dispatcher was delayed
+            while (wheel_tick < now_tick) {
+                wheel_tick++;
+
+                // Cascade the higher levels first so that timers cascading from the top
+                // land in lower slots before those slots are cascaded themselves
+                for (unsigned int l = wheel_levels - 1; l > 0; l--) {
+                    if ((wheel_tick & ((1ULL << (wheel_bits * l)) - 1)) == 0)
+                        wheel_cascade(l);
                 }
 
-                for (unsigned int t = 0; t < time_workers.size(); t++) {
-                    // Found a worker slot
-                    if (time_workers[t].joinable()) {
-                        time_workers[t].join();
-
-                        time_workers[t] = std::thread([evt, this]() {
-                            thread_set_process_name("TIME_EVT");
-
-                            // Call the function with the given parameters
-                            int ret = 0;
-                            if (evt->callback != NULL) {
-                                ret = (*evt->callback)(evt.get(), evt->callback_parm, Globalreg::globalreg);
-                            } else if (evt->event != NULL) {
-                                ret = evt->event->timetracker_event(evt->timer_id);
-                            } else if (evt->event_func != NULL) {
-                                ret = evt->event_func(evt->timer_id);
-                            }
-
-                            if (ret > 0 && evt->timeslices != -1 && evt->recurring) {
-                                kis_lock_guard<kis_mutex> tl(time_mutex, "event rescheduler");
-
-                                struct timeval cur_tm;
-                                gettimeofday(&cur_tm, NULL);
-
-                                evt->schedule_tm.tv_sec = cur_tm.tv_sec;
-                                evt->schedule_tm.tv_usec = cur_tm.tv_usec;
-                                evt->trigger_tm.tv_sec = evt->schedule_tm.tv_sec + (evt->timeslices / SERVER_TIMESLICES_SEC);
-                                evt->trigger_tm.tv_usec = evt->schedule_tm.tv_usec + 
-                                    ((evt->timeslices % SERVER_TIMESLICES_SEC) * (1000000L / SERVER_TIMESLICES_SEC));
-
-                                if (evt->trigger_tm.tv_usec >= 999999L) {
-                                    evt->trigger_tm.tv_sec++;
-                                    evt->trigger_tm.tv_usec %= 1000000L;
-                                }
-
-                                timer_sort_required = true;
-                            } else {
-                                kis_lock_guard<kis_mutex> rl(removed_id_mutex);
-                                removed_timer_ids.push_back(evt->timer_id);
-                            }
-                        });
-
-                        launched = true;
-                        break;
-                    }
-                }
-            }
-        }
+                auto& slot = timer_wheel[0][wheel_tick & (wheel_slots - 1)];
+                auto due = std::move(slot);
+                slot.clear();
 
-        {
-            // Actually remove the timers under dual lock
-            std::lock(time_mutex, removed_id_mutex);
-            kis_lock_guard<kis_mutex> l(time_mutex, std::adopt_lock);
-            kis_lock_guard<kis_mutex> rl(removed_id_mutex, std::adopt_lock);
-
-            for (auto x : removed_timer_ids) {
-                auto itr = timer_map.find(x);
-
-                if (itr != timer_map.end()) {
-                    for (auto sorted_itr = sorted_timers.begin(); sorted_itr != sorted_timers.end(); ++sorted_itr) {
-                        if ((*sorted_itr)->timer_id == x) {
-                            sorted_timers.erase(sorted_itr);
-                            break;
-                        }
+                for (const auto& evt : due) {
+                    if (evt->timer_cancelled)
+                        continue;
+
+                    // Parked beyond the span of the wheel
+                    if (evt->expire_tick > wheel_tick) {
+                        wheel_insert(evt);
+                        continue;
                     }
 
-                    timer_map.erase(itr);
+                    time_worker_queue.enqueue(evt);
                 }
             }
-
-            removed_timer_ids.clear();
         }
 
-        /*
-        if (std::chrono::system_clock::now() >= end) {
-            fmt::print("debug - timetracker missed time slot by {} ms\n",
-                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - end).count());
-        }
-        */
-
-
         std::this_thread::sleep_until(end);
     }
 }
 
-int time_tracker::register_timer(int in_timeslices, struct timeval *in_trigger,
-                               int in_recurring, 
-                               int (*in_callback)(TIMEEVENT_PARMS),
-                               void *in_parm) {
-    kis_lock_guard<kis_mutex> lk(time_mutex);
+void time_tracker::time_worker() {
+    while (true) {
+        std::shared_ptr<timer_event> evt;
 
-    auto evt = std::make_shared<timer_event>();
+        time_worker_queue.wait_dequeue(evt);
 
-    evt->total_ms = 0;
-    evt->last_ms = 0;
+        if (evt == nullptr || shutdown)
+            return;
 
-    evt->timer_id = next_timer_id++;
-    gettimeofday(&(evt->schedule_tm), NULL);
+        if (evt->timer_cancelled)
+            continue;
 
-    if (in_trigger != NULL) {
-        evt->trigger_tm.tv_sec = in_trigger->tv_sec;
-        evt->trigger_tm.tv_usec = in_trigger->tv_usec;
-        evt->timeslices = -1;
-    } else {
-        evt->trigger_tm.tv_sec = evt->schedule_tm.tv_sec + (in_timeslices / 10);
-        evt->trigger_tm.tv_usec = evt->schedule_tm.tv_usec + (in_timeslices % 10);
-        evt->timeslices = in_timeslices;
-    }
+        auto start_tick = current_wheel_tick();
+        auto start_tm = std::chrono::steady_clock::now();
 
-    evt->recurring = in_recurring;
-    evt->callback = in_callback;
-    evt->callback_parm = in_parm;
-    evt->event = NULL;
+        // Call the function with the given parameters
+        int ret = 0;
+        if (evt->callback != NULL) {
+            ret = (*evt->callback)(evt.get(), evt->callback_parm, Globalreg::globalreg);
+        } else if (evt->event != NULL) {
+            ret = evt->event->timetracker_event(evt->timer_id);
+        } else if (evt->event_func != NULL) {
+            ret = evt->event_func(evt->timer_id);
+        }
 
-    timer_map[evt->timer_id] = evt;
-    sorted_timers.push_back(evt);
+        auto run_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_tm).count();
+        double latency_ms = 0;
+        if (start_tick > evt->expire_tick)
+            latency_ms = (start_tick - evt->expire_tick) * (1000.0f / SERVER_TIMESLICES_SEC);
 
-    // Resort the list
-    timer_sort_required = true;
+        kis_lock_guard<kis_mutex> tl(time_mutex, "time_tracker time_worker");
 
-    return evt->timer_id;
+        evt->run_count++;
+        evt->last_ms = run_ms;
+        evt->total_ms += run_ms;
+        evt->max_ms = std::max(evt->max_ms, run_ms);
+        evt->total_latency_ms += latency_ms;
+        evt->max_latency_ms = std::max(evt->max_latency_ms, latency_ms);
+
+        if (evt->timeslices > 0 && run_ms > evt->timeslices * (1000.0f / SERVER_TIMESLICES_SEC))
+            evt->overrun_count++;
+
+        if (ret > 0 && evt->timeslices != -1 && evt->recurring && !evt->timer_cancelled) {
+            gettimeofday(&evt->schedule_tm, NULL);
+
+            evt->expire_tick = wheel_tick + std::max(evt->timeslices, 1);
+            wheel_insert(evt);
+        } else {
+            timer_map.erase(evt->timer_id);
+        }
+    }
 }
 
-int time_tracker::register_timer(int in_timeslices, struct timeval *in_trigger,
-        int in_recurring, time_tracker_event *in_event) {
-    kis_lock_guard<kis_mutex> lk(time_mutex);
+int time_tracker::schedule_new_timer(std::shared_ptr<timer_event> evt, int in_timeslices,
+        struct timeval *in_trigger, int in_recurring, const char *in_file, int in_line) {
+    kis_lock_guard<kis_mutex> lk(time_mutex, "time_tracker schedule_new_timer");
 
-    auto evt = std::make_shared<timer_event>();
+    evt->name = fmt::format("{}:{}", in_file, in_line);
 
     evt->total_ms = 0;
     evt->last_ms = 0;
+    evt->max_ms = 0;
+    evt->total_latency_ms = 0;
+    evt->max_latency_ms = 0;
+    evt->run_count = 0;
+    evt->overrun_count = 0;
 
     evt->timer_cancelled = false;
     evt->timer_id = next_timer_id++;
@@ -277,6 +312,17 @@ int time_tracker::register_timer(int in_timeslices, struct timeval *in_trigger,
         evt->trigger_tm.tv_sec = in_trigger->tv_sec;
         evt->trigger_tm.tv_usec = in_trigger->tv_usec;
         evt->timeslices = -1;
+
+        // Convert the absolute trigger time to a number of ticks from now, rounding up
+        long long delta_us = 
+            (long long) (evt->trigger_tm.tv_sec - evt->schedule_tm.tv_sec) * 1000000LL +
+            (evt->trigger_tm.tv_usec - evt->schedule_tm.tv_usec);
+        long long slice_us = 1000000LL / SERVER_TIMESLICES_SEC;
+
+        if (delta_us < 0)
+            delta_us = 0;
+
+        evt->expire_tick = wheel_tick + std::max((delta_us + slice_us - 1) / slice_us, 1LL);
     } else {
         evt->trigger_tm.tv_sec = evt->schedule_tm.tv_sec + 
             (in_timeslices / SERVER_TIMESLICES_SEC);
@@ -290,152 +336,84 @@ int time_tracker::register_timer(int in_timeslices, struct timeval *in_trigger,
         }
             
         evt->timeslices = in_timeslices;
+
+        evt->expire_tick = wheel_tick + std::max(in_timeslices, 1);
     }
 
     evt->recurring = in_recurring;
-    evt->callback = NULL;
-    evt->callback_parm = NULL;
-    evt->event = in_event;
 
     timer_map[evt->timer_id] = evt;
-    sorted_timers.push_back(evt);
-
-    // Resort the list
-    timer_sort_required = true;
+    wheel_insert(evt);
 
     return evt->timer_id;
 }
 
 int time_tracker::register_timer(int in_timeslices, struct timeval *in_trigger,
-        int in_recurring, std::function<int (int)> in_event) {
-    kis_lock_guard<kis_mutex> lk(time_mutex);
-
+                               int in_recurring, 
+                               int (*in_callback)(TIMEEVENT_PARMS),
+                               void *in_parm, const char *in_file, int in_line) {
     auto evt = std::make_shared<timer_event>();
 
-    evt->total_ms = 0;
-    evt->last_ms = 0;
+    evt->callback = in_callback;
+    evt->callback_parm = in_parm;
+    evt->event = NULL;
 
-    evt->timer_cancelled = false;
-    evt->timer_id = next_timer_id++;
+    return schedule_new_timer(evt, in_timeslices, in_trigger, in_recurring, in_file, in_line);
+}
 
-    gettimeofday(&(evt->schedule_tm), NULL);
+int time_tracker::register_timer(int in_timeslices, struct timeval *in_trigger,
+        int in_recurring, time_tracker_event *in_event, const char *in_file, int in_line) {
+    auto evt = std::make_shared<timer_event>();
 
-    if (in_trigger != NULL) {
-        evt->trigger_tm.tv_sec = in_trigger->tv_sec;
-        evt->trigger_tm.tv_usec = in_trigger->tv_usec;
-        evt->timeslices = -1;
-    } else {
-        evt->trigger_tm.tv_sec = evt->schedule_tm.tv_sec + 
-            (in_timeslices / SERVER_TIMESLICES_SEC);
-        evt->trigger_tm.tv_usec = evt->schedule_tm.tv_usec + 
-            ((in_timeslices % SERVER_TIMESLICES_SEC) * 
-             (1000000L / SERVER_TIMESLICES_SEC));
-        evt->timeslices = in_timeslices;
+    evt->callback = NULL;
+    evt->callback_parm = NULL;
+    evt->event = in_event;
 
-        if (evt->trigger_tm.tv_usec >= 999999L) {
-            evt->trigger_tm.tv_sec++;
-            evt->trigger_tm.tv_usec %= 1000000L;
-        }
-    }
+    return schedule_new_timer(evt, in_timeslices, in_trigger, in_recurring, in_file, in_line);
+}
+
+int time_tracker::register_timer(int in_timeslices, struct timeval *in_trigger,
+        int in_recurring, std::function<int (int)> in_event, const char *in_file, int in_line) {
+    auto evt = std::make_shared<timer_event>();
 
-    evt->recurring = in_recurring;
     evt->callback = NULL;
     evt->callback_parm = NULL;
     evt->event = NULL;
     
     evt->event_func = in_event;
 
-    timer_map[evt->timer_id] = evt;
-    sorted_timers.push_back(evt);
-
-    // Resort the list
-    timer_sort_required = true;
-
-    return evt->timer_id;
+    return schedule_new_timer(evt, in_timeslices, in_trigger, in_recurring, in_file, in_line);
 }
 
 int time_tracker::register_timer(const slice& in_timeslices,
                                int in_recurring, 
                                int (*in_callback)(TIMEEVENT_PARMS),
-                               void *in_parm) {
-    kis_lock_guard<kis_mutex> lk(time_mutex);
-
+                               void *in_parm, const char *in_file, int in_line) {
     auto evt = std::make_shared<timer_event>();
 
-    evt->total_ms = 0;
-    evt->last_ms = 0;
-
-    evt->timer_id = next_timer_id++;
-    gettimeofday(&(evt->schedule_tm), NULL);
-
-    evt->trigger_tm.tv_sec = evt->schedule_tm.tv_sec + (in_timeslices.count() / 10);
-    evt->trigger_tm.tv_usec = evt->schedule_tm.tv_usec + (in_timeslices.count() % 10);
-    evt->timeslices = in_timeslices.count();
-
-    if (evt->trigger_tm.tv_usec >= 999999L) {
-        evt->trigger_tm.tv_sec++;
-        evt->trigger_tm.tv_usec %= 1000000L;
-    }
-
-    evt->recurring = in_recurring;
     evt->callback = in_callback;
     evt->callback_parm = in_parm;
     evt->event = NULL;
 
-    timer_map[evt->timer_id] = evt;
-    sorted_timers.push_back(evt);
-
-    // Resort the list
-    timer_sort_required = true;
-
-    return evt->timer_id;
+    return schedule_new_timer(evt, in_timeslices.count(), NULL, in_recurring, in_file, in_line);
 }
 
 int time_tracker::register_timer(const slice& in_timeslices,
-        int in_recurring, std::function<int (int)> in_event) {
-    kis_lock_guard<kis_mutex> lk(time_mutex);
-
+        int in_recurring, std::function<int (int)> in_event, const char *in_file, int in_line) {
     auto evt = std::make_shared<timer_event>();
 
-    evt->total_ms = 0;
-    evt->last_ms = 0;
-
-    evt->timer_cancelled = false;
-    evt->timer_id = next_timer_id++;
-
-    gettimeofday(&(evt->schedule_tm), NULL);
-
-    evt->trigger_tm.tv_sec = evt->schedule_tm.tv_sec + 
-        (in_timeslices.count() / SERVER_TIMESLICES_SEC);
-    evt->trigger_tm.tv_usec = evt->schedule_tm.tv_usec + 
-        ((in_timeslices.count() % SERVER_TIMESLICES_SEC) * 
-         (1000000L / SERVER_TIMESLICES_SEC));
-    evt->timeslices = in_timeslices.count();
-
-    if (evt->trigger_tm.tv_usec >= 999999L) {
-        evt->trigger_tm.tv_sec++;
-        evt->trigger_tm.tv_usec %= 1000000L;
-    }
-
-    evt->recurring = in_recurring;
     evt->callback = NULL;
     evt->callback_parm = NULL;
     evt->event = NULL;
     
     evt->event_func = in_event;
 
-    timer_map[evt->timer_id] = evt;
-    sorted_timers.push_back(evt);
-
-    // Resort the list
-    timer_sort_required = true;
-
-    return evt->timer_id;
+    return schedule_new_timer(evt, in_timeslices.count(), NULL, in_recurring, in_file, in_line);
 }
 
 int time_tracker::remove_timer(int in_timerid) {
-    // Removing a timer sets the atomic cancelled and puts us on the abort list;
-    // we'll get cleaned out of the main list the next iteration through the main code.
+    // Removing a timer sets the atomic cancelled and drops it from the timer map; the
+    // wheel drops cancelled timers when their slot is reached.
     
     kis_lock_guard<kis_mutex> lk(time_mutex);
 
@@ -443,9 +421,7 @@ int time_tracker::remove_timer(int in_timerid) {
 
     if (itr != timer_map.end()) {
         itr->second->timer_cancelled = true;
-
-        kis_lock_guard<kis_mutex> lk(removed_id_mutex);
-        removed_timer_ids.push_back(in_timerid);
+        timer_map.erase(itr);
     } else {
         return 0;
     }
@@ -453,3 +429,48 @@ int time_tracker::remove_timer(int in_timerid) {
     return 1;
 }
 
+std::shared_ptr<tracker_element> time_tracker::slow_timers_endp_handler(std::shared_ptr<kis_net_beast_httpd_connection> con) {
+    auto ret_vec = std::make_shared<tracker_element_vector>();
+
+    std::vector<std::shared_ptr<timer_event>> timers;
+
+    kis_lock_guard<kis_mutex> lk(time_mutex, "time_tracker slow_timers_endp_handler");
+
+    for (const auto& t : timer_map)
+        timers.push_back(t.second);
+
+    // Slowest callbacks first
+    std::sort(timers.begin(), timers.end(), 
+            [](const std::shared_ptr<timer_event>& a, const std::shared_ptr<timer_event>& b) -> bool {
+                return a->max_ms > b->max_ms;
+            });
+
+    for (const auto& t : timers) {
+        auto timer = std::make_shared<tracker_element_map>(timer_entry_id);
+
+        timer->insert(std::make_shared<tracker_element_int32>(timer_id_id, t->timer_id));
+        timer->insert(std::make_shared<tracker_element_string>(timer_name_id, t->name));
+        timer->insert(std::make_shared<tracker_element_double>(timer_interval_id, 
+                    t->timeslices * (1000.0f / SERVER_TIMESLICES_SEC)));
+        timer->insert(std::make_shared<tracker_element_uint64>(timer_runs_id, t->run_count));
+        timer->insert(std::make_shared<tracker_element_uint64>(timer_overruns_id, t->overrun_count));
+        timer->insert(std::make_shared<tracker_element_double>(timer_last_ms_id, t->last_ms));
+        timer->insert(std::make_shared<tracker_element_double>(timer_max_ms_id, t->max_ms));
+
+        if (t->run_count > 0) {
+            timer->insert(std::make_shared<tracker_element_double>(timer_avg_ms_id, 
+                        t->total_ms / t->run_count));
+            timer->insert(std::make_shared<tracker_element_double>(timer_avg_latency_id, 
+                        t->total_latency_ms / t->run_count));
+        } else {
+            timer->insert(std::make_shared<tracker_element_double>(timer_avg_ms_id, 0));
+            timer->insert(std::make_shared<tracker_element_double>(timer_avg_latency_id, 0));
+        }
+
+        timer->insert(std::make_shared<tracker_element_double>(timer_max_latency_id, t->max_latency_ms));
+
+        ret_vec->push_back(timer);
+    }
+
+    return ret_vec;
+}
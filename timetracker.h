@@ -34,6 +34,9 @@
 
 #include "globalregistry.h"
 #include "kis_mutex.h"
+#include "trackedelement.h"
+
+#include "moodycamel/blockingconcurrentqueue.h"
 
 // For ubertooth and a few older plugins that compile against both svn and old
 #define KIS_NEW_TIMER_PARM	1
@@ -42,24 +45,38 @@
     void *auxptr __attribute__ ((unused)), global_registry *globalreg __attribute__ ((unused))
 
 class time_tracker_event;
+class kis_net_beast_httpd_connection;
 
-class time_tracker : public lifetime_global {
+class time_tracker : public lifetime_global, public deferred_startup {
 public:
     using slice = std::chrono::duration<int, std::ratio<1, 10>>;
 
     struct timer_event {
         int timer_id;
 
-        // Event name
+        // Event name, the registration site of the timer
         std::string name;
 
         // Time running in ms
         double total_ms;
         double last_ms;
+        double max_ms;
+
+        // Delay between the scheduled tick and the callback starting, in ms
+        double total_latency_ms;
+        double max_latency_ms;
+
+        // Number of times the callback has run, and the number of runs which took
+        // longer than the timer interval
+        uint64_t run_count;
+        uint64_t overrun_count;
 
         // Is the timer cancelled?
         std::atomic<bool> timer_cancelled;
 
+        // Wheel tick the timer expires on
+        uint64_t expire_tick;
+
         // Time it was scheduled
         struct timeval schedule_tm;
 
@@ -81,26 +98,13 @@ public:
         void *callback_parm;
     };
 
-    // Sort alerts by alert trigger time
-    class sort_timer_events_trigger {
-    public:
-        inline bool operator() (std::shared_ptr<time_tracker::timer_event> x, 
-								std::shared_ptr<time_tracker::timer_event> y) const {
-            if ((x->trigger_tm.tv_sec < y->trigger_tm.tv_sec) ||
-                ((x->trigger_tm.tv_sec == y->trigger_tm.tv_sec) && 
-				 (x->trigger_tm.tv_usec < y->trigger_tm.tv_usec)))
-                return 1;
-
-            return 0;
-        }
-    };
-
     static std::string global_name() { return "TIMETRACKER"; }
 
     static std::shared_ptr<time_tracker> create_timetracker() {
         std::shared_ptr<time_tracker> mon(new time_tracker());
         Globalreg::globalreg->timetracker = mon.get();
         Globalreg::globalreg->register_lifetime_global(mon);
+        Globalreg::globalreg->register_deferred_global(mon);
         Globalreg::globalreg->insert_global(global_name(), mon);
         return mon;
     }
@@ -111,25 +115,33 @@ private:
 public:
     virtual ~time_tracker();
 
-    // Register an optionally recurring timer.  
+    virtual void trigger_deferred_startup() override;
+
+    // Register an optionally recurring timer.  The file and line default to the
+    // caller, and are used to name the timer in the timer statistics.
     int register_timer(int in_timeslices, struct timeval *in_trigger,
                       int in_recurring, 
                       int (*in_callback)(timer_event *, void *, global_registry *),
-                      void *in_parm);
+                      void *in_parm,
+                      const char *in_file = __builtin_FILE(), int in_line = __builtin_LINE());
 
     int register_timer(int timeslices, struct timeval *in_trigger,
-            int in_recurring, time_tracker_event *event);
+            int in_recurring, time_tracker_event *event,
+            const char *in_file = __builtin_FILE(), int in_line = __builtin_LINE());
 
     int register_timer(int timeslices, struct timeval *in_trigger,
-            int in_recurring, std::function<int (int)> event);
+            int in_recurring, std::function<int (int)> event,
+            const char *in_file = __builtin_FILE(), int in_line = __builtin_LINE());
 
     int register_timer(const slice& in_timeslices,
             int in_recurring,
             int (*in_callbacK)(timer_event *, void *, global_registry *),
-            void *in_parm); 
+            void *in_parm,
+            const char *in_file = __builtin_FILE(), int in_line = __builtin_LINE());
 
     int register_timer(const slice& in_timeslices,
-            int in_recurring, std::function<int (int)> event);
+            int in_recurring, std::function<int (int)> event,
+            const char *in_file = __builtin_FILE(), int in_line = __builtin_LINE());
 
     // Remove a timer that's going to execute
     int remove_timer(int timer_id);
@@ -139,21 +151,49 @@ public:
 protected:
     kis_mutex time_mutex;
 
+    // Persistent pool of workers which run timer callbacks; timers which fire are
+    // queued to the pool instead of launching a thread per callback
     std::vector<std::thread> time_workers;
+    moodycamel::BlockingConcurrentQueue<std::shared_ptr<timer_event>> time_worker_queue;
 
     void time_dispatcher(void);
-
-    // Do we have to re-sort the list of timers?
-    std::atomic<bool> timer_sort_required;
+    void time_worker(void);
 
     // Next timer ID to be assigned
     std::atomic<int> next_timer_id;
 
     std::map<int, std::shared_ptr<timer_event>> timer_map;
-    std::vector<std::shared_ptr<timer_event>> sorted_timers;
 
-    kis_mutex removed_id_mutex;
-    std::vector<int> removed_timer_ids;
+    // Hierarchical timing wheel.  Each level has 64 slots; a level 0 slot is a
+    // single timeslice, and each slot of a higher level spans a full rotation of the
+    // level below it.  Timers are cascaded down a level when the lower level wraps,
+    // so each tick only touches the timers which are due.
+    static constexpr unsigned int wheel_bits = 6;
+    static constexpr unsigned int wheel_slots = 1 << wheel_bits;
+    static constexpr unsigned int wheel_levels = 4;
+
+    std::vector<std::shared_ptr<timer_event>> timer_wheel[wheel_levels][wheel_slots];
+
+    // Current tick of the wheel, in timeslices since the tracker started
+    uint64_t wheel_tick;
+    std::chrono::steady_clock::time_point wheel_start;
+
+    uint64_t current_wheel_tick();
+
+    // Place a timer in the wheel, must be called under the time mutex
+    void wheel_insert(std::shared_ptr<timer_event> evt);
+    void wheel_cascade(unsigned int level);
+
+    // Common timer setup for all the registration methods
+    int schedule_new_timer(std::shared_ptr<timer_event> evt, int in_timeslices,
+            struct timeval *in_trigger, int in_recurring,
+            const char *in_file, int in_line);
+
+    std::shared_ptr<tracker_element> slow_timers_endp_handler(std::shared_ptr<kis_net_beast_httpd_connection> con);
+
+    int timer_entry_id, timer_id_id, timer_name_id, timer_interval_id, timer_runs_id,
+        timer_overruns_id, timer_last_ms_id, timer_max_ms_id, timer_avg_ms_id,
+        timer_max_latency_id, timer_avg_latency_id;
 
     std::thread time_dispatch_t;
     std::atomic<bool> shutdown;
@@ -1,33 +1,159 @@
 #!/usr/bin/env python3
 
+# Downloads the IEEE OUI registry and prints the sorted Kismet manuf text database.
+#
+# With --compile, instead converts a manuf (or ADSB ICAO) text database into the
+# precompiled binary lookup table loaded by Kismet (see kis_lookup_table.h):
+#
+#   create_oui_db.py --compile conf/kismet_manuf.txt.gz conf/kismet_manuf.bin
+#   create_oui_db.py --compile --icao conf/kismet_adsb_icao.txt.gz conf/kismet_adsb_icao.bin
+
 from __future__ import print_function
+import argparse
+import gzip
 import os
 import sys
 import re
-import requests
+import struct
+
+TABLE_MAGIC = b"KISLKUP1"
+TABLE_BYTE_ORDER = 0x01020304
+
+def tokenize(line):
+    # Matches quote_str_tokenize: split on tabs outside of quotes, dropping the quotes
+    fields = []
+    val = ""
+    quoted = False
+
+    for c in line:
+        if c == '"':
+            quoted = not quoted
+        elif c == '\t' and not quoted:
+            fields.append(val)
+            val = ""
+        else:
+            val += c
+
+    fields.append(val)
+    return fields
+
+def parse_manuf(f):
+    records = []
+
+    for line in f:
+        line = line.rstrip("\n")
+
+        if len(line) < 10:
+            continue
+
+        m = re.match("([0-9A-Fa-f]{2}):([0-9A-Fa-f]{2}):([0-9A-Fa-f]{2})\t", line)
+        if m is None:
+            continue
+
+        oui = (int(m.group(1), 16) << 16) | (int(m.group(2), 16) << 8) | int(m.group(3), 16)
+        records.append((oui, [line[9:]]))
+
+    return records
+
+def parse_icao(f):
+    records = []
+
+    for line in f:
+        if line.startswith("#"):
+            continue
+
+        fields = tokenize(line.rstrip("\n"))
+
+        if len(fields) != 6 or len(fields[5]) == 0:
+            raise ValueError("Invalid ICAO entry: '{}'".format(line))
+
+        records.append((int(fields[0], 16), fields[1:5] + [fields[5][0]]))
+
+    return records
+
+def compile_table(records, n_fields, out_path):
+    # Sort by key, keeping the first of any duplicate
+    records.sort(key = lambda r: r[0])
+
+    keys = []
+    offsets = []
+    pool = bytearray(b"\0")
+    interned = { b"": 0 }
+
+    for (key, fields) in records:
+        if len(keys) and keys[-1] == key:
+            continue
+
+        keys.append(key)
+
+        for f in range(n_fields):
+            v = fields[f].encode("UTF-8", "surrogateescape") if f < len(fields) else b""
+
+            if v not in interned:
+                interned[v] = len(pool)
+                pool += v + b"\0"
+
+            offsets.append(interned[v])
+
+    tmp_path = out_path + ".tmp"
+
+    with open(tmp_path, "wb") as out:
+        out.write(struct.pack("=8sIIIIII", TABLE_MAGIC, TABLE_BYTE_ORDER,
+            len(keys), n_fields, len(pool), 0, 0))
+        out.write(struct.pack("={}I".format(len(keys)), *keys))
+        out.write(struct.pack("={}I".format(len(offsets)), *offsets))
+        out.write(pool)
+
+    os.rename(tmp_path, out_path)
+
+    print("Compiled {} records into {}".format(len(keys), out_path), file=sys.stderr)
+
+def download_manuf():
+    import requests
+
+    manufs = []
+
+    # Original IEEE URI
+    OUIURI = "http://standards-oui.ieee.org/oui.txt"
+
+    # Sanitized and cleaned up maintained version
+    # OUIURI = "http://linuxnet.ca/ieee/oui.txt"
+
+    with requests.get(OUIURI) as r:
+        for rl in r.iter_lines():
+            l = rl.decode('UTF-8')
+            p = re.compile("([0-9A-F]{2}-[0-9A-F]{2}-[0-9A-F]{2}) +\(hex\)\t+(.*)")
+            m = p.match(l)
+
+            if m is not None and len(m.groups()) == 2:
+                oui = m.group(1).replace("-", ":")
+                manufs.append("{}\t{}".format(oui, m.group(2)))
+
+    print("Parsed {} manufs".format(len(manufs)), file=sys.stderr)
+
+    manufs.sort()
 
-manufs = []
+    for m in manufs:
+        print(m)
 
-# Original IEEE URI
-OUIURI = "http://standards-oui.ieee.org/oui.txt"
+parser = argparse.ArgumentParser(description = "Kismet manuf database generator")
+parser.add_argument("--compile", nargs = 2, metavar = ("SOURCE", "TABLE"),
+        help = "compile a text database into a binary lookup table")
+parser.add_argument("--icao", action = "store_true",
+        help = "source is an ADSB ICAO database instead of a manuf database")
 
-# Sanitized and cleaned up maintained version
-# OUIURI = "http://linuxnet.ca/ieee/oui.txt"
+args = parser.parse_args()
 
-with requests.get(OUIURI) as r:
-    for rl in r.iter_lines():
-        l = rl.decode('UTF-8')
-        p = re.compile("([0-9A-F]{2}-[0-9A-F]{2}-[0-9A-F]{2}) +\(hex\)\t+(.*)")
-        m = p.match(l)
-        
-        if m is not None and len(m.groups()) == 2:
-            oui = m.group(1).replace("-", ":")
-            manufs.append("{}\t{}".format(oui, m.group(2)))
+if args.compile is None:
+    download_manuf()
+    sys.exit(0)
 
-print("Parsed {} manufs".format(len(manufs)), file=sys.stderr)
+(source, table) = args.compile
 
-manufs.sort()
+opener = gzip.open if source.endswith(".gz") else open
 
-for m in manufs:
-    print(m)
-    
+with opener(source, "rt", encoding = "UTF-8", errors = "surrogateescape") as f:
+    if args.icao:
+        compile_table(parse_icao(f), 5, table)
+    else:
+        compile_table(parse_manuf(f), 1, table)
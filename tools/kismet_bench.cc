@@ -0,0 +1,1148 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Offline packet throughput benchmark.
+ *
+ * Builds the server core in-process (packetchain, DLTs, phys, device tracker) without
+ * the webserver, logging, or capture helpers, loads frames from pcap, pcapng, kismetdb,
+ * or line-delimited JSON files into memory, and feeds them straight into the packet
+ * chain as fast as it will take them.  Reports frames per second, the time spent in
+ * each packetchain stage and handler, allocations per frame, and peak RSS.
+ *
+ * Optional micro benchmarks cover the device tracker at scale with synthetic access
+ * points, device serialization, the 802.11 IE walker, and the location history cascade.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifndef HAVE_PCAPPCAP_H
+#include <pcap.h>
+#else
+#include <pcap/pcap.h>
+#endif
+
+#include <sqlite3.h>
+
+#include "version.h"
+
+#include "alertracker.h"
+#include "antennatracker.h"
+#include "binary_writer.h"
+#include "channeltracker2.h"
+#include "configfile.h"
+#include "datasource_virtual.h"
+#include "datasourcetracker.h"
+#include "devicetracker.h"
+#include "devicetracker_view_workers.h"
+#include "dlttracker.h"
+#include "dot11_parsers/dot11_ie.h"
+#include "entrytracker.h"
+#include "eventbus.h"
+#include "fmt.h"
+#include "globalregistry.h"
+#include "gpstracker.h"
+#include "ipctracker_v2.h"
+#include "json_adapter.h"
+#include "json_writer.h"
+#include "kis_dissector_ipdata.h"
+#include "kis_dlt_btle_radio.h"
+#include "kis_dlt_ppi.h"
+#include "kis_dlt_radiotap.h"
+#include "kis_httpd_registry.h"
+#include "kis_net_beast_httpd.h"
+#include "manuf.h"
+#include "messagebus.h"
+#include "messagebus_restclient.h"
+#include "packetchain.h"
+#include "phy_80211.h"
+#include "phy_802154.h"
+#include "phy_adsb.h"
+#include "phy_bluetooth.h"
+#include "phy_btle.h"
+#include "phy_meter.h"
+#include "phy_nrf_mousejack.h"
+#include "phy_radiation.h"
+#include "phy_rtl433.h"
+#include "phy_uav_drone.h"
+#include "phy_zwave.h"
+#include "sqlite3_cpp11.h"
+#include "streamtracker.h"
+#include "timetracker.h"
+#include "trackedlocation.h"
+#include "util.h"
+
+// Allocation counting.  Every operator new in the process is counted into a per-thread
+// slot, so the packet threads don't fight over one counter; this doesn't see malloc
+// calls made directly by C libraries.
+namespace {
+    const unsigned int n_alloc_slots = 256;
+
+    struct alignas(64) alloc_slot {
+        std::atomic<uint64_t> n{0};
+    };
+
+    alloc_slot alloc_slots[n_alloc_slots];
+    std::atomic<unsigned int> next_alloc_slot{0};
+
+    thread_local unsigned int alloc_slot_id =
+        next_alloc_slot.fetch_add(1, std::memory_order_relaxed) % n_alloc_slots;
+
+    void *counted_alloc(size_t sz) {
+        alloc_slots[alloc_slot_id].n.fetch_add(1, std::memory_order_relaxed);
+
+        auto p = malloc(sz == 0 ? 1 : sz);
+
+        if (p == nullptr)
+            throw std::bad_alloc();
+
+        return p;
+    }
+
+    void *counted_aligned_alloc(size_t sz, std::align_val_t al) {
+        alloc_slots[alloc_slot_id].n.fetch_add(1, std::memory_order_relaxed);
+
+        auto a = static_cast<size_t>(al);
+        auto p = aligned_alloc(a, ((sz + a - 1) / a) * a);
+
+        if (p == nullptr)
+            throw std::bad_alloc();
+
+        return p;
+    }
+
+    uint64_t count_allocs() {
+        uint64_t n = 0;
+
+        for (unsigned int i = 0; i < n_alloc_slots; i++)
+            n += alloc_slots[i].n.load(std::memory_order_relaxed);
+
+        return n;
+    }
+}
+
+void *operator new(size_t sz) { return counted_alloc(sz); }
+void *operator new[](size_t sz) { return counted_alloc(sz); }
+void *operator new(size_t sz, std::align_val_t al) { return counted_aligned_alloc(sz, al); }
+void *operator new[](size_t sz, std::align_val_t al) { return counted_aligned_alloc(sz, al); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { free(p); }
+
+namespace {
+    // A frame held in memory for the whole run, so reading the input isn't timed;
+    // packets refer to the data in place, as they do to the capture report in the server
+    struct bench_frame {
+        // Link type, or 0 for a JSON record
+        unsigned int dlt;
+        std::string json_type;
+        std::string data;
+    };
+
+    struct bench_input {
+        std::string fname;
+        std::string format;
+        std::vector<bench_frame> frames;
+        std::shared_ptr<kis_datasource> source;
+    };
+
+    struct bench_state {
+        std::shared_ptr<packet_chain> packetchain;
+        int pack_comp_linkframe, pack_comp_json, pack_comp_datasrc;
+        unsigned int backlog;
+    };
+
+    double now_sec() {
+        return std::chrono::duration_cast<std::chrono::duration<double>>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    double peak_rss_mb() {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_maxrss / 1024.0;
+    }
+
+    double current_rss_mb() {
+        long pages = 0, rss = 0;
+
+        FILE *f = fopen("/proc/self/statm", "r");
+
+        if (f == nullptr)
+            return 0;
+
+        if (fscanf(f, "%ld %ld", &pages, &rss) != 2)
+            rss = 0;
+
+        fclose(f);
+
+        return (double) rss * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+    }
+
+    std::string file_magic(const std::string& fname) {
+        std::ifstream f(fname, std::ios::binary);
+        char buf[16] = {0};
+        f.read(buf, sizeof(buf));
+        return std::string(buf, f.gcount());
+    }
+
+    bool load_pcap(bench_input& in) {
+        char errbuf[PCAP_ERRBUF_SIZE];
+
+        auto pd = pcap_open_offline(in.fname.c_str(), errbuf);
+
+        if (pd == nullptr) {
+            fmt::print(stderr, "ERROR: Could not open '{}': {}\n", in.fname, errbuf);
+            return false;
+        }
+
+        auto dlt = pcap_datalink(pd);
+        struct pcap_pkthdr *hdr;
+        const u_char *data;
+
+        while (pcap_next_ex(pd, &hdr, &data) == 1)
+            in.frames.push_back(bench_frame{(unsigned int) dlt, "",
+                    std::string((const char *) data, hdr->caplen)});
+
+        pcap_close(pd);
+
+        in.format = fmt::format("pcap, DLT {}", dlt);
+
+        return true;
+    }
+
+    bool load_kismetdb(bench_input& in) {
+        sqlite3 *db = nullptr;
+
+        if (sqlite3_open_v2(in.fname.c_str(), &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+            fmt::print(stderr, "ERROR: Could not open '{}': {}\n", in.fname, sqlite3_errmsg(db));
+            sqlite3_close(db);
+            return false;
+        }
+
+        using namespace kissqlite3;
+
+        std::map<unsigned int, size_t> dlts;
+        std::map<std::string, size_t> types;
+
+        try {
+            auto packets_q = _SELECT(db, "packets", {"dlt", "packet"});
+
+            for (auto p : packets_q) {
+                auto dlt = sqlite3_column_as<unsigned int>(p, 0);
+                auto bytes = sqlite3_column_as<std::string>(p, 1);
+
+                if (dlt == 0 || bytes.length() == 0)
+                    continue;
+
+                dlts[dlt]++;
+                in.frames.push_back(bench_frame{dlt, "", bytes});
+            }
+
+            auto data_q = _SELECT(db, "data", {"type", "json"});
+
+            for (auto d : data_q) {
+                auto type = sqlite3_column_as<std::string>(d, 0);
+
+                types[type]++;
+                in.frames.push_back(bench_frame{0, type, sqlite3_column_as<std::string>(d, 1)});
+            }
+        } catch (const std::exception& e) {
+            fmt::print(stderr, "ERROR: Could not read '{}': {}\n", in.fname, e.what());
+            sqlite3_close(db);
+            return false;
+        }
+
+        sqlite3_close(db);
+
+        std::vector<std::string> kinds;
+        for (const auto& d : dlts)
+            kinds.push_back(fmt::format("DLT {} x{}", d.first, d.second));
+        for (const auto& t : types)
+            kinds.push_back(fmt::format("{} x{}", t.first, t.second));
+
+        in.format = fmt::format("kismetdb, {}", str_join(kinds, ", "));
+
+        return true;
+    }
+
+    // One JSON record per line, as written by rtl_433 -F json and similar tools
+    bool load_json(bench_input& in, const std::string& json_type) {
+        if (json_type.length() == 0) {
+            fmt::print(stderr, "ERROR: '{}' is not a pcap, pcapng, or kismetdb file; JSON record "
+                    "files need --json-type\n", in.fname);
+            return false;
+        }
+
+        std::ifstream f(in.fname);
+
+        if (!f.is_open()) {
+            fmt::print(stderr, "ERROR: Could not open '{}': {}\n", in.fname, strerror(errno));
+            return false;
+        }
+
+        std::string line;
+
+        while (std::getline(f, line)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+
+            in.frames.push_back(bench_frame{0, json_type, line});
+        }
+
+        in.format = fmt::format("JSON, type {}", json_type);
+
+        return true;
+    }
+
+    bool load_input(bench_input& in, const std::string& json_type) {
+        auto magic = file_magic(in.fname);
+
+        if (magic.length() >= 4) {
+            uint32_t m;
+            memcpy(&m, magic.data(), 4);
+
+            // pcap in either byte order and either timestamp resolution, or a pcapng
+            // section header
+            if (m == 0xa1b2c3d4 || m == 0xd4c3b2a1 || m == 0xa1b23c4d || m == 0x4d3cb2a1 ||
+                    m == 0x0a0d0d0a)
+                return load_pcap(in);
+        }
+
+        if (magic.compare(0, 15, "SQLite format 3") == 0)
+            return load_kismetdb(in);
+
+        return load_json(in, json_type);
+    }
+
+    // Synthetic beacon from a unique BSSID, behind a radiotap header with the channel
+    // and signal, as a monitor mode capture would deliver it
+    std::string synthetic_beacon(uint32_t n, uint16_t seq) {
+        std::string f;
+
+        auto u8 = [&f](uint8_t v) { f.push_back((char) v); };
+        auto le16 = [&u8](uint16_t v) { u8(v & 0xFF); u8(v >> 8); };
+        auto mac = [&u8](uint32_t n) {
+            u8(0x02); u8(0x00); u8(n >> 24); u8(n >> 16); u8(n >> 8); u8(n);
+        };
+
+        // Radiotap: channel (2437MHz, 2GHz CCK) and dBm signal
+        u8(0); u8(0); le16(13);
+        le16(0x0028); le16(0);
+        le16(2437); le16(0x00a0);
+        u8((uint8_t) (int8_t) (-40 - (int) (n % 50)));
+
+        // Beacon header
+        u8(0x80); u8(0x00); le16(0);
+        for (int i = 0; i < 6; i++)
+            u8(0xFF);
+        mac(n);
+        mac(n);
+        le16(seq << 4);
+
+        // Timestamp, interval, capabilities (ESS, privacy)
+        for (int i = 0; i < 8; i++)
+            u8(0);
+        le16(100);
+        le16(0x0411);
+
+        auto ssid = fmt::format("bench-{:08x}", n);
+        u8(0); u8(ssid.length());
+        f.append(ssid);
+
+        const uint8_t rates[] = { 0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12, 0x18, 0x24 };
+        u8(1); u8(sizeof(rates));
+        for (auto r : rates)
+            u8(r);
+
+        u8(3); u8(1); u8(6);
+
+        u8(5); u8(4); u8(0); u8(1); u8(0); u8(0);
+
+        // RSN, CCMP/PSK
+        const uint8_t rsn[] = { 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00,
+            0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x02, 0x00, 0x00 };
+        u8(48); u8(sizeof(rsn));
+        for (auto r : rsn)
+            u8(r);
+
+        return f;
+    }
+
+    // IE tags of a beacon or probe response, skipping the capture header
+    bool beacon_ies(const bench_frame& frame, const char **ies, size_t *ies_len) {
+        size_t offt = 0;
+        const auto& d = frame.data;
+
+        if (frame.dlt == 127 || frame.dlt == 192) {
+            // Radiotap and PPI both lead with a little-endian header length
+            if (d.length() < 4)
+                return false;
+            offt = (uint8_t) d[2] | ((uint8_t) d[3] << 8);
+        } else if (frame.dlt != 105) {
+            return false;
+        }
+
+        // 24 byte header and 12 bytes of fixed beacon fields
+        if (d.length() < offt + 36)
+            return false;
+
+        auto fc = (uint8_t) d[offt];
+
+        if (fc != 0x80 && fc != 0x50)
+            return false;
+
+        *ies = d.data() + offt + 36;
+        *ies_len = d.length() - offt - 36;
+
+        return true;
+    }
+
+    std::shared_ptr<kis_datasource> make_source(const std::string& name) {
+        auto datasourcetracker = Globalreg::fetch_mandatory_global_as<datasource_tracker>();
+        auto virtual_builder = Globalreg::fetch_mandatory_global_as<datasource_virtual_builder>();
+
+        auto source = virtual_builder->build_datasource(virtual_builder);
+        auto vs = std::static_pointer_cast<kis_datasource_virtual>(source);
+
+        uuid u;
+        u.generate_random_time_uuid();
+
+        vs->set_virtual_hardware("kismet_bench");
+        source->set_source_uuid(u);
+        source->set_source_key(adler32_checksum(u.uuid_to_string()));
+        source->set_source_name(name);
+
+        datasourcetracker->merge_source(source);
+
+        return source;
+    }
+
+    void inject(bench_state& st, kis_datasource *source, const bench_frame& frame) {
+        auto packet = st.packetchain->generate_packet();
+
+        // Like a source with clobber_timestamp, so old captures look live to the trackers
+        gettimeofday(&packet->ts, NULL);
+
+        if (frame.dlt != 0) {
+            auto chunk = st.packetchain->new_packet_component<kis_datachunk>();
+
+            chunk->dlt = frame.dlt;
+            packet->original_len = frame.data.length();
+            packet->set_data_ref(frame.data);
+            chunk->set_data(packet->data);
+
+            packet->insert(st.pack_comp_linkframe, chunk);
+        } else {
+            auto json = st.packetchain->new_packet_component<kis_json_packinfo>();
+
+            json->type = frame.json_type;
+            json->json_string = frame.data;
+
+            packet->insert(st.pack_comp_json, json);
+        }
+
+        auto srcinfo = st.packetchain->new_packet_component<packetchain_comp_datasource>();
+        srcinfo->ref_source = source;
+        packet->insert(st.pack_comp_datasrc, srcinfo);
+
+        source->inc_source_num_packets(1);
+
+        st.packetchain->process_packet(packet);
+    }
+
+    // Keep the packet threads fed without letting the queue, and the RSS, grow without
+    // bound
+    void throttle(bench_state& st, uint64_t n) {
+        if (n % 64 != 0)
+            return;
+
+        while (st.packetchain->fetch_packets_pending() > st.backlog)
+            std::this_thread::yield();
+    }
+
+    void drain(bench_state& st) {
+        while (st.packetchain->fetch_packets_pending() > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    struct run_result {
+        uint64_t frames;
+        double secs;
+        uint64_t allocs;
+    };
+
+    template<typename F>
+    run_result timed_run(bench_state& st, F feed) {
+        run_result r;
+
+        auto start_allocs = count_allocs();
+        auto start = now_sec();
+
+        r.frames = feed();
+        drain(st);
+
+        r.secs = now_sec() - start;
+        r.allocs = count_allocs() - start_allocs;
+
+        return r;
+    }
+
+    void print_run(const std::string& name, const run_result& r) {
+        fmt::print("{}: {} frames in {:.3f}s, {:.0f} frames/sec, {:.1f} allocations/frame\n",
+                name, r.frames, r.secs, r.secs > 0 ? r.frames / r.secs : 0,
+                r.frames > 0 ? (double) r.allocs / r.frames : 0);
+    }
+
+    uint64_t map_u64(const std::shared_ptr<tracker_element_string_map>& m, const std::string& k) {
+        auto i = m->find(k);
+        if (i == m->end())
+            return 0;
+        return std::static_pointer_cast<tracker_element_uint64>(i->second)->get();
+    }
+
+    std::string map_str(const std::shared_ptr<tracker_element_string_map>& m, const std::string& k) {
+        auto i = m->find(k);
+        if (i == m->end())
+            return "";
+        return std::static_pointer_cast<tracker_element_string>(i->second)->get();
+    }
+
+    // Per-stage and per-handler latency, from the packetchain handler stats
+    void print_handler_stats(bench_state& st, uint64_t frames, size_t top) {
+        auto stats = std::static_pointer_cast<tracker_element_string_map>(
+                st.packetchain->handler_stats_endpoint());
+
+        auto hi = stats->find("kismet.packetchain.handler_stats.handlers");
+        if (hi == stats->end() || frames == 0)
+            return;
+
+        struct handler {
+            std::string name, chain;
+            uint64_t count, total_ns, avg_ns, p50_ns, p99_ns, max_ns;
+        };
+
+        std::vector<std::string> chain_order;
+        std::map<std::string, uint64_t> chain_ns;
+        std::vector<handler> handlers;
+
+        for (const auto& h : *std::static_pointer_cast<tracker_element_vector>(hi->second)) {
+            auto hm = std::static_pointer_cast<tracker_element_string_map>(h);
+
+            handler r;
+            r.name = map_str(hm, "kismet.packetchain.handler.name");
+            r.chain = map_str(hm, "kismet.packetchain.handler.chain");
+            r.count = map_u64(hm, "kismet.packetchain.timing.count");
+            r.total_ns = map_u64(hm, "kismet.packetchain.timing.total_ns");
+            r.avg_ns = map_u64(hm, "kismet.packetchain.timing.avg_ns");
+            r.p50_ns = map_u64(hm, "kismet.packetchain.timing.p50_ns");
+            r.p99_ns = map_u64(hm, "kismet.packetchain.timing.p99_ns");
+            r.max_ns = map_u64(hm, "kismet.packetchain.timing.max_ns");
+
+            if (chain_ns.find(r.chain) == chain_ns.end())
+                chain_order.push_back(r.chain);
+            chain_ns[r.chain] += r.total_ns;
+
+            handlers.push_back(r);
+        }
+
+        fmt::print("\nTime per frame in each packetchain stage, across all {} frames:\n", frames);
+        for (const auto& c : chain_order)
+            fmt::print("  {:<12} {:>10.0f} ns\n", c, (double) chain_ns[c] / frames);
+
+        std::sort(handlers.begin(), handlers.end(), [](const handler& a, const handler& b) -> bool {
+                return a.total_ns > b.total_ns;
+            });
+
+        if (handlers.size() > top)
+            handlers.resize(top);
+
+        fmt::print("\nMost expensive handlers (percentiles are power-of-two bucket bounds):\n");
+        fmt::print("  {:<12} {:<36} {:>10} {:>10} {:>10} {:>10} {:>12}\n",
+                "stage", "handler", "calls", "avg ns", "p50 ns", "p99 ns", "max ns");
+        for (const auto& h : handlers)
+            fmt::print("  {:<12} {:<36} {:>10} {:>10} {:>10} {:>10} {:>12}\n",
+                    h.chain, h.name, h.count, h.avg_ns, h.p50_ns, h.p99_ns, h.max_ns);
+    }
+
+    // Device tracker at scale: create count synthetic access points, then update each
+    // of them once
+    void bench_devices(bench_state& st, uint32_t count) {
+        auto source = make_source("kismet_bench synthetic");
+        auto devicetracker = Globalreg::fetch_mandatory_global_as<device_tracker>();
+
+        // Build frames on the fly in batches, so the corpus doesn't inflate the RSS
+        // we're trying to measure
+        auto feed_pass = [&](uint16_t seq) {
+            return [&, seq]() -> uint64_t {
+                std::vector<bench_frame> batch(4096);
+                uint64_t n = 0;
+
+                for (uint32_t base = 0; base < count; base += batch.size()) {
+                    // Frames are referenced in place; wait for the last batch to finish
+                    // before overwriting it
+                    drain(st);
+
+                    auto batch_n = std::min<uint32_t>(batch.size(), count - base);
+
+                    for (uint32_t i = 0; i < batch_n; i++)
+                        batch[i] = bench_frame{127, "", synthetic_beacon(base + i, seq)};
+
+                    for (uint32_t i = 0; i < batch_n; i++) {
+                        inject(st, source.get(), batch[i]);
+                        throttle(st, ++n);
+                    }
+                }
+
+                return n;
+            };
+        };
+
+        auto rss_start = current_rss_mb();
+        auto devs_start = devicetracker->fetch_num_devices();
+
+        auto create = timed_run(st, feed_pass(1));
+
+        auto rss_created = current_rss_mb();
+        auto devs_created = devicetracker->fetch_num_devices() - devs_start;
+
+        auto update = timed_run(st, feed_pass(2));
+
+        fmt::print("\nSynthetic devices, {} access points:\n", count);
+        print_run("  create", create);
+        print_run("  update", update);
+        fmt::print("  {} new devices, RSS grew {:.1f}MB, {:.0f} bytes per device\n",
+                devs_created, rss_created - rss_start,
+                devs_created > 0 ? (rss_created - rss_start) * 1024 * 1024 / devs_created : 0);
+    }
+
+    // Output sink which only counts bytes
+    class counting_streambuf : public std::streambuf {
+    public:
+        size_t count {0};
+
+    protected:
+        virtual int overflow(int c) override {
+            if (c != EOF)
+                count++;
+            return c;
+        }
+
+        virtual std::streamsize xsputn(const char *, std::streamsize n) override {
+            count += n;
+            return n;
+        }
+    };
+
+    void bench_serialize() {
+        auto devicetracker = Globalreg::fetch_mandatory_global_as<device_tracker>();
+        auto entrytracker = Globalreg::fetch_mandatory_global_as<entry_tracker>();
+
+        auto worker = device_tracker_view_function_worker(
+                [](std::shared_ptr<kis_tracked_device_base>) -> bool { return true; });
+        auto devices = devicetracker->do_readonly_device_work(worker);
+
+        fmt::print("\nSerializing {} devices:\n", devices->size());
+
+        if (devices->size() == 0)
+            return;
+
+        for (const auto& type : { "json", "ekjson", "itjson", "cbor", "msgpack" }) {
+            if (!entrytracker->can_serialize(type))
+                continue;
+
+            counting_streambuf sb;
+            std::ostream os(&sb);
+
+            auto start_allocs = count_allocs();
+            auto start = now_sec();
+
+            entrytracker->serialize(type, os, devices);
+
+            auto secs = now_sec() - start;
+            auto allocs = count_allocs() - start_allocs;
+
+            fmt::print("  {:<8} {:>10.1f}MB in {:.3f}s, {:>8.1f}MB/s, {:>10.0f} devices/s, "
+                    "{:.1f} allocations/device\n",
+                    type, sb.count / (1024.0 * 1024.0), secs,
+                    secs > 0 ? sb.count / (1024.0 * 1024.0) / secs : 0,
+                    secs > 0 ? devices->size() / secs : 0,
+                    (double) allocs / devices->size());
+        }
+    }
+
+    // The in-place IE walker, over the beacons in the inputs or synthetic ones, reusing
+    // one parser as the 802.11 dissector does
+    void bench_ie(const std::vector<bench_input>& inputs) {
+        std::vector<std::pair<const char *, size_t>> corpus;
+        std::vector<bench_frame> synthetic;
+
+        for (const auto& in : inputs) {
+            for (const auto& f : in.frames) {
+                const char *ies;
+                size_t len;
+
+                if (beacon_ies(f, &ies, &len))
+                    corpus.push_back(std::make_pair(ies, len));
+            }
+        }
+
+        auto corpus_name = fmt::format("{} captured beacons", corpus.size());
+
+        if (corpus.size() == 0) {
+            for (uint32_t i = 0; i < 1024; i++)
+                synthetic.push_back(bench_frame{127, "", synthetic_beacon(i, 1)});
+
+            for (const auto& f : synthetic) {
+                const char *ies;
+                size_t len;
+
+                if (beacon_ies(f, &ies, &len))
+                    corpus.push_back(std::make_pair(ies, len));
+            }
+
+            corpus_name = fmt::format("{} synthetic beacons", corpus.size());
+        }
+
+        dot11_ie ie;
+        uint64_t n = 0, tags = 0, corrupt = 0;
+
+        auto start_allocs = count_allocs();
+        auto start = now_sec();
+        double secs = 0;
+
+        // At least a second, and at least one pass over the corpus
+        do {
+            for (const auto& c : corpus) {
+                ie.reset();
+
+                try {
+                    ie.parse(c.first, c.second);
+                    tags += ie.tags()->size();
+                } catch (const std::exception& e) {
+                    // Trailing FCS, or a truncated capture
+                    corrupt++;
+                }
+
+                n++;
+            }
+
+            secs = now_sec() - start;
+        } while (secs < 1.0);
+
+        auto allocs = count_allocs() - start_allocs;
+
+        fmt::print("\n802.11 IE walker over {}:\n", corpus_name);
+        fmt::print("  {} beacons in {:.3f}s, {:.0f} ns/beacon, {:.1f} tags/beacon, "
+                "{:.2f} allocations/beacon, {} corrupt\n",
+                n, secs, secs * 1e9 / n, (double) tags / n, (double) allocs / n, corrupt);
+    }
+
+    // Location history cascade, as fed for each packet with a GPS fix when history
+    // clouds are enabled
+    void bench_location(uint64_t count) {
+        auto rrd = std::make_shared<kis_location_rrd>();
+
+        kis_historic_location_sample s;
+        s.lat = 40.0;
+        s.lon = -75.0;
+        s.alt = 100;
+        s.heading = 0;
+        s.speed = 1;
+        s.frequency = 2437000;
+        s.signal = -50;
+        s.time_sec = time(0);
+
+        auto start_allocs = count_allocs();
+        auto start = now_sec();
+
+        for (uint64_t i = 0; i < count; i++) {
+            s.lat += 0.00001;
+            s.lon -= 0.00001;
+            s.signal = -40 - (int) (i % 50);
+            s.time_sec++;
+
+            rrd->add_sample(s);
+        }
+
+        auto secs = now_sec() - start;
+        auto allocs = count_allocs() - start_allocs;
+
+        fmt::print("\nLocation history cascade:\n");
+        fmt::print("  {} samples in {:.3f}s, {:.1f} ns/sample, {:.2f} allocations/sample\n",
+                count, secs, secs * 1e9 / count, (double) allocs / count);
+    }
+
+    void print_help(char *argv) {
+        printf("Kismet packetchain benchmark\n");
+        printf("Feeds captured frames through the Kismet packet processing core as fast as\n"
+               "possible, and reports throughput, time per packetchain stage, allocations,\n"
+               "and memory use.\n");
+        printf("usage: %s [OPTION] [file ...]\n", argv);
+        printf("Input files may be pcap, pcapng, kismetdb, or line-delimited JSON records.\n"
+               " -f, --config-file [file]       Kismet config file to load (default: the installed\n"
+               "                                kismet.conf, like the server)\n"
+               " -l, --loops [n]                Feed the inputs [n] times (default 1)\n"
+               " -t, --json-type [type]         Record type of JSON record inputs, as the capture\n"
+               "                                helper would report it (RTL433, adsb, RTLamr, ...)\n"
+               "     --backlog [n]              Maximum packets waiting in the packetchain (default 4096)\n"
+               "     --devices [n]              Create [n] synthetic access points, then update each\n"
+               "                                once, reporting throughput and memory per device\n"
+               "     --serialize                Time serializing every device with each serializer\n"
+               "     --ie                       Time the 802.11 IE walker over the input beacons, or\n"
+               "                                synthetic beacons if there are none\n"
+               "     --location [n]             Time [n] samples through the location history cascade\n"
+               "     --no-handler-stats         Don't time each packetchain handler\n"
+               "     --top [n]                  Number of handlers to report (default 20)\n"
+               " -v, --verbose                  Show Kismet info messages\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+#define OPT_BACKLOG         1
+#define OPT_DEVICES         2
+#define OPT_SERIALIZE       3
+#define OPT_IE              4
+#define OPT_LOCATION        5
+#define OPT_NO_HANDLERS     6
+#define OPT_TOP             7
+    static struct option longopt[] = {
+        { "config-file", required_argument, 0, 'f' },
+        { "loops", required_argument, 0, 'l' },
+        { "json-type", required_argument, 0, 't' },
+        { "verbose", no_argument, 0, 'v' },
+        { "help", no_argument, 0, 'h' },
+        { "backlog", required_argument, 0, OPT_BACKLOG },
+        { "devices", required_argument, 0, OPT_DEVICES },
+        { "serialize", no_argument, 0, OPT_SERIALIZE },
+        { "ie", no_argument, 0, OPT_IE },
+        { "location", required_argument, 0, OPT_LOCATION },
+        { "no-handler-stats", no_argument, 0, OPT_NO_HANDLERS },
+        { "top", required_argument, 0, OPT_TOP },
+        { 0, 0, 0, 0 }
+    };
+
+    int option_idx = 0;
+    optind = 0;
+    opterr = 0;
+
+    std::string configfilename;
+    std::string json_type;
+    unsigned int loops = 1;
+    unsigned int backlog = 4096;
+    unsigned int n_devices = 0;
+    unsigned long n_location = 0;
+    unsigned int top = 20;
+    bool serialize = false;
+    bool ie_bench = false;
+    bool handler_stats = true;
+    bool verbose = false;
+
+    while (1) {
+        int r = getopt_long(argc, argv,
+                            "hf:l:t:v",
+                            longopt, &option_idx);
+        if (r < 0) break;
+
+        if (r == 'h') {
+            print_help(argv[0]);
+            exit(1);
+        } else if (r == 'f') {
+            configfilename = std::string(optarg);
+        } else if (r == 'l') {
+            if (sscanf(optarg, "%u", &loops) != 1 || loops == 0) {
+                fmt::print(stderr, "ERROR: Expected number of loops\n");
+                exit(1);
+            }
+        } else if (r == 't') {
+            json_type = std::string(optarg);
+        } else if (r == 'v') {
+            verbose = true;
+        } else if (r == OPT_BACKLOG) {
+            if (sscanf(optarg, "%u", &backlog) != 1 || backlog == 0) {
+                fmt::print(stderr, "ERROR: Expected backlog size\n");
+                exit(1);
+            }
+        } else if (r == OPT_DEVICES) {
+            if (sscanf(optarg, "%u", &n_devices) != 1) {
+                fmt::print(stderr, "ERROR: Expected number of devices\n");
+                exit(1);
+            }
+        } else if (r == OPT_SERIALIZE) {
+            serialize = true;
+        } else if (r == OPT_IE) {
+            ie_bench = true;
+        } else if (r == OPT_LOCATION) {
+            if (sscanf(optarg, "%lu", &n_location) != 1) {
+                fmt::print(stderr, "ERROR: Expected number of location samples\n");
+                exit(1);
+            }
+        } else if (r == OPT_NO_HANDLERS) {
+            handler_stats = false;
+        } else if (r == OPT_TOP) {
+            if (sscanf(optarg, "%u", &top) != 1) {
+                fmt::print(stderr, "ERROR: Expected number of handlers\n");
+                exit(1);
+            }
+        } else {
+            fmt::print(stderr, "ERROR: Unknown option\n");
+            print_help(argv[0]);
+            exit(1);
+        }
+    }
+
+    std::vector<bench_input> inputs;
+    for (int i = optind; i < argc; i++) {
+        inputs.push_back(bench_input());
+        inputs.back().fname = argv[i];
+    }
+
+    if (inputs.size() == 0 && n_devices == 0 && !serialize && !ie_bench && n_location == 0) {
+        print_help(argv[0]);
+        exit(1);
+    }
+
+    // Load everything before the server exists, so it isn't in the RSS deltas
+    uint64_t total_frames = 0;
+
+    for (auto& in : inputs) {
+        if (!load_input(in, json_type))
+            exit(1);
+
+        total_frames += in.frames.size();
+    }
+
+    // Build the server core, in the same order as the server
+    Globalreg::globalreg = new global_registry;
+    auto globalreg = Globalreg::globalreg;
+
+    Globalreg::n_tracked_fields = 0;
+    Globalreg::n_tracked_components = 0;
+
+    globalreg->version_major = VERSION_MAJOR;
+    globalreg->version_minor = VERSION_MINOR;
+    globalreg->version_tiny = VERSION_TINY;
+    globalreg->version_git_rev = VERSION_GIT_COMMIT;
+    globalreg->build_date = VERSION_BUILD_TIME;
+
+    globalreg->argc = argc;
+    globalreg->argv = argv;
+
+    auto entrytracker = entry_tracker::create_entrytracker();
+
+    globalreg->server_uuid =
+        entrytracker->register_and_get_field_as<tracker_element_uuid>("kismet.server.uuid",
+                tracker_element_factory<tracker_element_uuid>(),
+                "unique server UUID");
+
+    uuid server_uuid;
+    server_uuid.generate_random_time_uuid();
+    globalreg->server_uuid->set(server_uuid);
+    globalreg->server_uuid_hash = server_uuid.hash;
+
+    boost::asio::io_service::work work(globalreg->io);
+
+    auto timetracker = time_tracker::create_timetracker();
+    auto eventbus = event_bus::create_eventbus();
+
+    auto messagebus = message_bus::create_messagebus();
+    globalreg->messagebus = messagebus;
+
+    eventbus->register_listener(message_bus::event_message(),
+            [verbose](std::shared_ptr<eventbus_event> evt) {
+                auto msg_k = evt->get_event_content()->find(message_bus::event_message());
+                if (msg_k == evt->get_event_content()->end())
+                    return;
+
+                auto msg = std::static_pointer_cast<tracked_message>(msg_k->second);
+
+                if (verbose || (msg->get_flags() & (MSGFLAG_ERROR | MSGFLAG_FATAL)))
+                    fmt::print(stderr, "{}\n", msg->get_message());
+            });
+
+    auto conf = new config_file();
+
+    if (configfilename == "")
+        configfilename = fmt::format("{}/kismet.conf",
+                getenv("KISMET_CONF") != NULL ? getenv("KISMET_CONF") : SYSCONF_LOC);
+
+    if (conf->parse_config(configfilename) < 0) {
+        fmt::print(stderr, "ERROR: Could not load config file '{}'\n", configfilename);
+        exit(1);
+    }
+
+    globalreg->kismet_config = conf;
+
+    // The bench paces itself against the packet threads, so the packetchain never drops
+    // or warns about the backlog
+    conf->set_opt("packet_backlog_limit", 0, false);
+    conf->set_opt("packet_log_warning", 0, false);
+
+    if (handler_stats) {
+        conf->set_opt("packetchain_handler_stats", "true", false);
+        conf->set_opt("packetchain_handler_stats_sample", 1, false);
+    }
+
+    // The server registers routes as it builds; the webserver is never started
+    kis_net_beast_httpd::create_httpd();
+
+    globalreg->manufdb = new kis_manuf();
+
+    entrytracker->register_serializer("json", std::make_shared<fast_json_adapter::serializer>());
+    entrytracker->register_serializer("ekjson", std::make_shared<fast_ek_json_adapter::serializer>());
+    entrytracker->register_serializer("itjson", std::make_shared<fast_it_json_adapter::serializer>());
+    entrytracker->register_serializer("cbor", std::make_shared<cbor_adapter::serializer>());
+    entrytracker->register_serializer("msgpack", std::make_shared<msgpack_adapter::serializer>());
+
+    ipc_tracker_v2::create_ipctracker();
+    stream_tracker::create_streamtracker();
+    rest_message_client::create_messageclient();
+    kis_httpd_registry::create_http_registry();
+
+    auto packetchain = packet_chain::create_packetchain();
+    dlt_tracker::create_dltt();
+    antenna_tracker::create_at();
+    datasource_tracker::create_dst();
+    alert_tracker::create_alertracker();
+
+    auto devicetracker = device_tracker::create_device_tracker();
+    channel_tracker_v2::create_channeltracker();
+
+    kis_dlt_ppi::create_dlt();
+    kis_dlt_radiotap::create_dlt();
+    kis_dlt_btle_radio::create_dlt();
+
+    kis_dissector_ip_data::create_dissector_ip_data();
+
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new kis_80211_phy()));
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new Kis_RTL433_Phy()));
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new Kis_Zwave_Phy()));
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new kis_bluetooth_phy()));
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new Kis_UAV_Phy()));
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new Kis_Mousejack_Phy()));
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new kis_btle_phy()));
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new kis_meter_phy()));
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new kis_adsb_phy()));
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new kis_802154_phy()));
+    devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new kis_radiation_phy()));
+
+    datasource_virtual_builder::create_virtualbuilder();
+
+    gps_tracker::create_gpsmanager();
+
+    globalreg->start_deferred();
+
+    if (globalreg->fatal_condition) {
+        fmt::print(stderr, "ERROR: Fatal error building the Kismet core\n");
+        exit(1);
+    }
+
+    timetracker->spawn_timetracker_thread();
+    packetchain->start_processing();
+
+    bench_state st;
+    st.packetchain = packetchain;
+    st.pack_comp_linkframe = packetchain->register_packet_component("LINKFRAME");
+    st.pack_comp_json = packetchain->register_packet_component("JSON");
+    st.pack_comp_datasrc = packetchain->register_packet_component("KISDATASRC");
+    st.backlog = backlog;
+
+    fmt::print("Kismet {}-{}-{} ({}) packetchain benchmark\n",
+            VERSION_MAJOR, VERSION_MINOR, VERSION_TINY, VERSION_GIT_COMMIT);
+
+    uint64_t fed = 0;
+
+    if (inputs.size() > 0) {
+        fmt::print("\nInputs:\n");
+        for (auto& in : inputs) {
+            in.source = make_source(fmt::format("kismet_bench {}", in.fname));
+            fmt::print("  {}: {} frames ({})\n", in.fname, in.frames.size(), in.format);
+        }
+
+        auto replay = timed_run(st, [&]() -> uint64_t {
+                uint64_t n = 0;
+
+                for (unsigned int l = 0; l < loops; l++) {
+                    for (auto& in : inputs) {
+                        for (const auto& f : in.frames) {
+                            inject(st, in.source.get(), f);
+                            throttle(st, ++n);
+                        }
+                    }
+                }
+
+                return n;
+            });
+
+        fed += replay.frames;
+
+        fmt::print("\n");
+        print_run(fmt::format("Replay, {} frames x {} loops", total_frames, loops), replay);
+        fmt::print("{} devices\n", devicetracker->fetch_num_devices());
+    }
+
+    if (n_devices > 0) {
+        bench_devices(st, n_devices);
+        fed += (uint64_t) n_devices * 2;
+    }
+
+    if (handler_stats && fed > 0)
+        print_handler_stats(st, fed, top);
+
+    if (serialize)
+        bench_serialize();
+
+    if (ie_bench)
+        bench_ie(inputs);
+
+    if (n_location > 0)
+        bench_location(n_location);
+
+    fmt::print("\nPeak RSS {:.1f}MB\n", peak_rss_mb());
+
+    globalreg->shutdown_deferred();
+    globalreg->spindown = 1;
+    globalreg->io.stop();
+    globalreg->delete_lifetime_globals();
+    globalreg->complete = true;
+
+    exit(0);
+}
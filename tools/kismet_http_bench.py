@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+
+# HTTP load generator for the Kismet webserver.
+#
+# Simulates a number of polling clients (web UIs, scripts) each issuing requests as
+# fast as they can over a keep-alive connection, and reports the request rate and
+# latency percentiles, followed by the server side connection and worker stats from
+# /httpd/stats.json.
+#
+#   kismet_http_bench.py --user kismet --password kismet --clients 50 --duration 30 \
+#       /system/status.json /devices/last-time/-30/devices.json
+#
+# With --etag, clients revalidate with If-None-Match and count 304 responses.
+
+from __future__ import print_function
+import argparse
+import base64
+import json
+import sys
+import threading
+import time
+
+try:
+    import http.client as httplib
+except ImportError:
+    import httplib
+
+def percentile(values, p):
+    if len(values) == 0:
+        return 0
+
+    idx = min(len(values) - 1, int(round((p / 100.0) * (len(values) - 1))))
+    return values[idx]
+
+class Client(threading.Thread):
+    def __init__(self, args, headers, stop_time):
+        threading.Thread.__init__(self)
+        self.daemon = True
+
+        self.args = args
+        self.headers = headers
+        self.stop_time = stop_time
+
+        self.latencies = []
+        self.errors = 0
+        self.reconnects = 0
+        self.not_modified = 0
+
+        # Last ETag seen per URI, for --etag
+        self.etags = {}
+
+    def connect(self):
+        self.reconnects += 1
+        return httplib.HTTPConnection(self.args.host, self.args.port, timeout=self.args.timeout)
+
+    def run(self):
+        conn = self.connect()
+        n = 0
+
+        while time.time() < self.stop_time:
+            uri = self.args.uri[n % len(self.args.uri)]
+            n += 1
+
+            start = time.time()
+
+            headers = self.headers
+
+            if self.args.etag and uri in self.etags:
+                headers = dict(self.headers)
+                headers["If-None-Match"] = self.etags[uri]
+
+            try:
+                conn.request("GET", uri, headers=headers)
+                resp = conn.getresponse()
+                resp.read()
+
+                if resp.status == 304:
+                    self.not_modified += 1
+                elif resp.status != 200:
+                    self.errors += 1
+                    continue
+
+                etag = resp.getheader("ETag")
+                if etag is not None:
+                    self.etags[uri] = etag
+
+                self.latencies.append(time.time() - start)
+
+                if self.args.close:
+                    conn.close()
+                    conn = self.connect()
+
+            except Exception:
+                self.errors += 1
+                conn.close()
+                conn = self.connect()
+
+        conn.close()
+
+def main():
+    parser = argparse.ArgumentParser(description="Kismet HTTP load benchmark")
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--port", type=int, default=2501)
+    parser.add_argument("--user", default=None)
+    parser.add_argument("--password", default=None)
+    parser.add_argument("--apikey", default=None, help="API key, sent as the KISMET cookie")
+    parser.add_argument("--clients", type=int, default=20, help="concurrent clients")
+    parser.add_argument("--duration", type=float, default=10, help="seconds to run")
+    parser.add_argument("--timeout", type=float, default=30, help="per-request timeout")
+    parser.add_argument("--close", action="store_true",
+            help="open a new connection for every request instead of keep-alive")
+    parser.add_argument("--etag", action="store_true",
+            help="revalidate with If-None-Match, like a caching client")
+    parser.add_argument("uri", nargs="*", default=["/system/status.json"])
+
+    args = parser.parse_args()
+
+    headers = {}
+
+    if args.user is not None and args.password is not None:
+        auth = "{}:{}".format(args.user, args.password).encode("utf-8")
+        headers["Authorization"] = "Basic " + base64.b64encode(auth).decode("ascii")
+
+    if args.apikey is not None:
+        headers["Cookie"] = "KISMET={}".format(args.apikey)
+
+    stop_time = time.time() + args.duration
+    clients = [Client(args, headers, stop_time) for _ in range(args.clients)]
+
+    start = time.time()
+
+    for c in clients:
+        c.start()
+
+    for c in clients:
+        c.join()
+
+    elapsed = time.time() - start
+
+    latencies = sorted([l for c in clients for l in c.latencies])
+    errors = sum([c.errors for c in clients])
+    connections = sum([c.reconnects for c in clients])
+    not_modified = sum([c.not_modified for c in clients])
+
+    print("clients:      {}".format(args.clients))
+    print("requests:     {} ({} errors) over {} connections".format(len(latencies), errors, connections))
+    print("rate:         {:.1f} req/s".format(len(latencies) / elapsed))
+
+    if args.etag:
+        print("not modified: {}".format(not_modified))
+
+    for p in [50, 90, 99]:
+        print("latency p{}:  {:.2f} ms".format(p, percentile(latencies, p) * 1000))
+
+    if len(latencies) > 0:
+        print("latency max:  {:.2f} ms".format(latencies[-1] * 1000))
+
+    try:
+        conn = httplib.HTTPConnection(args.host, args.port, timeout=args.timeout)
+        conn.request("GET", "/httpd/stats.json", headers=headers)
+        resp = conn.getresponse()
+
+        if resp.status == 200:
+            print("\nserver stats:")
+            stats = json.loads(resp.read().decode("utf-8"))
+            for k in sorted(stats.keys()):
+                print("  {}: {}".format(k, stats[k]))
+    except Exception as e:
+        print("could not fetch server stats: {}".format(e), file=sys.stderr)
+
+if __name__ == "__main__":
+    main()
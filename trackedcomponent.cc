@@ -127,11 +127,13 @@ shared_tracker_element tracker_component::get_child_path(const std::vector<std::
 
         if (next_elem == nullptr) {
             // If we're just starting, find the top element in this object
+            materialize();
             next_elem = get_sub(id);
         } else if (next_elem->get_type() == tracker_type::tracker_map) {
             // Otherwise, find the next element of the path in the object in the chain
             // we're currently inspecting, assuming it's a map
             // next_elem = std::static_pointer_cast<tracker_element_map>(next_elem)->get_sub(id);
+            next_elem->materialize();
             next_elem = static_cast<tracker_element_map *>(next_elem.get())->get_sub(id);
         }
 
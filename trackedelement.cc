@@ -74,9 +74,8 @@ device_key::device_key(std::string in_keystr) {
 }
 
 std::string device_key::as_string() const {
-    std::stringstream ss;
-    ss << *this;
-    return ss.str();
+    // Same format as operator<<, without building a stream for every key
+    return fmt::format("{:02X}_{:X}", kis_hton64(spkey), kis_hton64(dkey));
 }
 
 uint32_t device_key::gen_pkey(std::string phy) {
@@ -860,11 +859,13 @@ shared_tracker_element get_tracker_element_path(const std::vector<std::string>&
 #if TE_TYPE_SAFETY == 1
             elem->enforce_type(tracker_type::tracker_map);
 #endif
+            elem->materialize();
             next_elem = static_cast<tracker_element_map *>(elem.get())->get_sub(id);
         } else {
 #if TE_TYPE_SAFETY == 1
             next_elem->enforce_type(tracker_type::tracker_map);
 #endif
+            next_elem->materialize();
             next_elem = static_cast<tracker_element_map *>(next_elem.get())->get_sub(id);
         }
 
@@ -899,6 +900,7 @@ shared_tracker_element get_tracker_element_path(const std::vector<int>& in_path,
                 return nullptr;
             }
 #endif
+            elem->materialize();
             next_elem = static_cast<tracker_element_map *>(elem.get())->get_sub(pe);
         } else {
             // Descend down the alias trail
@@ -913,6 +915,7 @@ shared_tracker_element get_tracker_element_path(const std::vector<int>& in_path,
             }
 #endif
 
+            next_elem->materialize();
             next_elem = static_cast<tracker_element_map *>(next_elem.get())->get_sub(pe);
         }
 
@@ -960,6 +963,7 @@ std::vector<shared_tracker_element> get_tracker_element_multi_path(const std::ve
 #if TE_TYPE_SAFETY == 1
             elem->enforce_type(tracker_type::tracker_map);
 #endif
+            elem->materialize();
             next_elem = static_cast<tracker_element_map *>(elem.get())->get_sub(id);
         } else {
             // Descend down the alias trail
@@ -969,6 +973,7 @@ std::vector<shared_tracker_element> get_tracker_element_multi_path(const std::ve
 #if TE_TYPE_SAFETY == 1
             next_elem->enforce_type(tracker_type::tracker_map);
 #endif
+            next_elem->materialize();
             next_elem = static_cast<tracker_element_map *>(next_elem.get())->get_sub(id);
         }
 
@@ -244,6 +244,10 @@ public:
     // Called after serialization is completed
     virtual void post_serialize() { }
 
+    // Called before a field path descends into this element; elements which only 
+    // create their child fields when they are needed create them here
+    virtual void materialize() { }
+
     template<typename CT>
     static std::shared_ptr<CT> safe_cast_as(const std::shared_ptr<tracker_element>& e) {
         if (e == nullptr)
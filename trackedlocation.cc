@@ -434,3 +434,235 @@ void kis_tracked_location::register_fields() {
                 "Last location", &last_loc);
 }
 
+
+void kis_historic_location_ring::push(const kis_historic_location_sample& s) {
+    if (lat.size() < capacity) {
+        lat.push_back(s.lat);
+        lon.push_back(s.lon);
+        alt.push_back(s.alt);
+        heading.push_back(s.heading);
+        speed.push_back(s.speed);
+        signal.push_back(s.signal);
+        frequency.push_back(s.frequency);
+        time_sec.push_back(s.time_sec);
+        return;
+    }
+
+    lat[head] = s.lat;
+    lon[head] = s.lon;
+    alt[head] = s.alt;
+    heading[head] = s.heading;
+    speed[head] = s.speed;
+    signal[head] = s.signal;
+    frequency[head] = s.frequency;
+    time_sec[head] = s.time_sec;
+
+    head = (head + 1) % capacity;
+}
+
+kis_historic_location_sample kis_historic_location_ring::at(size_t i) const {
+    auto pos = (head + i) % lat.size();
+
+    kis_historic_location_sample s;
+
+    s.lat = lat[pos];
+    s.lon = lon[pos];
+    s.alt = alt[pos];
+    s.heading = heading[pos];
+    s.speed = speed[pos];
+    s.signal = signal[pos];
+    s.frequency = frequency[pos];
+    s.time_sec = time_sec[pos];
+
+    return s;
+}
+
+kis_historic_location_sample kis_historic_location_ring::average() const {
+    kis_historic_location_sample r = {};
+
+    auto n = lat.size();
+
+    if (n == 0)
+        return r;
+
+    double avg_x = 0, avg_y = 0, avg_z = 0;
+
+    // Convert to vector for average
+    for (size_t i = 0; i < n; i++) {
+        double mod_lat = lat[i] * M_PI / 180;
+        double mod_lon = lon[i] * M_PI / 180;
+
+        avg_x += cos(mod_lat) * cos(mod_lon);
+        avg_y += cos(mod_lat) * sin(mod_lon);
+        avg_z += sin(mod_lat);
+    }
+
+    double r_x = avg_x / n;
+    double r_y = avg_y / n;
+    double r_z = avg_z / n;
+
+    double central_lon = atan2(r_y, r_x);
+    double central_sqr = sqrt(r_x * r_x + r_y * r_y);
+    double central_lat = atan2(r_z, central_sqr);
+
+    r.lat = central_lat * 180 / M_PI;
+    r.lon = central_lon * 180 / M_PI;
+
+    // Altitude and signal only average the samples which have them
+    double avg_alt = 0, num_alt = 0;
+    for (auto a : alt) {
+        if (a != 0) {
+            avg_alt += a;
+            num_alt++;
+        }
+    }
+
+    if (num_alt > 0)
+        r.alt = avg_alt / num_alt;
+
+    double avg_signal = 0, num_signal = 0;
+    for (auto s : signal) {
+        if (s != 0) {
+            avg_signal += s;
+            num_signal++;
+        }
+    }
+
+    if (num_signal > 0)
+        r.signal = avg_signal / num_signal;
+
+    double avg_heading = 0, avg_speed = 0, avg_time = 0, avg_freq = 0;
+
+    for (auto h : heading)
+        avg_heading += h;
+    for (auto s : speed)
+        avg_speed += s;
+    for (auto t : time_sec)
+        avg_time += t;
+    for (auto f : frequency)
+        avg_freq += f;
+
+    r.heading = avg_heading / n;
+    r.speed = avg_speed / n;
+    r.time_sec = avg_time / n;
+    r.frequency = avg_freq / n;
+
+    return r;
+}
+
+kis_location_rrd_ids::kis_location_rrd_ids() {
+    auto entrytracker = Globalreg::globalreg->entrytracker;
+
+    samples_100_id =
+        entrytracker->register_field("kis.gps.rrd.samples_100",
+                tracker_element_factory<tracker_element_vector>(),
+                "last 100 historic GPS records");
+    samples_10k_id =
+        entrytracker->register_field("kis.gps.rrd.samples_10k",
+                tracker_element_factory<tracker_element_vector>(),
+                "last 10,000 historic GPS records, as averages of 100");
+    samples_1m_id =
+        entrytracker->register_field("kis.gps.rrd.samples_1m",
+                tracker_element_factory<tracker_element_vector>(),
+                "last 1,000,000 historic GPS records, as averages of 10,000");
+    last_sample_ts_id =
+        entrytracker->register_field("kis.gps.rrd.last_sample_ts",
+                tracker_element_factory<tracker_element_uint64>(),
+                "time (unix ts) of last sample");
+
+    historic_location_builder = std::make_shared<kis_historic_location>();
+}
+
+void kis_location_rrd::add_sample(const kis_historic_location_sample& in_sample) {
+    std::lock_guard<kis_spinlock> lk(lock);
+
+    last_sample_ts = in_sample.time_sec;
+
+    samples_100.push(in_sample);
+
+    // We've gotten 100 samples, cascade up to our next bucket
+    if (++samples_100_cascade < kis_historic_location_ring::capacity)
+        return;
+
+    samples_100_cascade = 0;
+    samples_10k.push(samples_100.average());
+
+    // If we've gotten 100 samples in the 10k bucket, cascade up again
+    if (++samples_10k_cascade < kis_historic_location_ring::capacity)
+        return;
+
+    samples_10k_cascade = 0;
+    samples_1m.push(samples_10k.average());
+}
+
+kis_location_rrd_fields *kis_location_rrd::materialize_fields() {
+    auto f = fields.load(std::memory_order_acquire);
+
+    if (f != nullptr)
+        return f;
+
+    std::lock_guard<kis_spinlock> lk(lock);
+
+    f = fields.load(std::memory_order_relaxed);
+
+    if (f != nullptr)
+        return f;
+
+    const auto& ids = kis_location_rrd_ids::get();
+
+    f = new kis_location_rrd_fields();
+
+    f->samples_100 = std::make_shared<tracker_element_vector>(ids.samples_100_id);
+    f->samples_10k = std::make_shared<tracker_element_vector>(ids.samples_10k_id);
+    f->samples_1m = std::make_shared<tracker_element_vector>(ids.samples_1m_id);
+    f->last_sample_ts = std::make_shared<tracker_element_uint64>(ids.last_sample_ts_id);
+
+    insert(f->samples_100);
+    insert(f->samples_10k);
+    insert(f->samples_1m);
+    insert(f->last_sample_ts);
+
+    fields.store(f, std::memory_order_release);
+
+    return f;
+}
+
+void kis_location_rrd::fill_samples(const kis_historic_location_ring& ring,
+        std::shared_ptr<tracker_element_vector> vec) {
+    const auto& builder = kis_location_rrd_ids::get().historic_location_builder;
+
+    // Rings never shrink, so neither does the vector
+    while (vec->size() < ring.size())
+        vec->push_back(Globalreg::new_from_pool<kis_historic_location>(builder.get()));
+
+    for (size_t i = 0; i < ring.size(); i++) {
+        auto s = ring.at(i);
+        auto hl = std::static_pointer_cast<kis_historic_location>(*(vec->begin() + i));
+
+        hl->set_lat(s.lat);
+        hl->set_lon(s.lon);
+        hl->set_alt(s.alt);
+        hl->set_heading(s.heading);
+        hl->set_speed(s.speed);
+        hl->set_signal(s.signal);
+        hl->set_frequency(s.frequency);
+        hl->set_time_sec(s.time_sec);
+    }
+}
+
+void kis_location_rrd::pre_serialize() {
+    auto f = materialize_fields();
+
+    // Released in post_serialize
+    f->mutex.lock();
+
+    tracker_component::pre_serialize();
+
+    std::lock_guard<kis_spinlock> lk(lock);
+
+    fill_samples(samples_100, f->samples_100);
+    fill_samples(samples_10k, f->samples_10k);
+    fill_samples(samples_1m, f->samples_1m);
+
+    f->last_sample_ts->set(last_sample_ts);
+}
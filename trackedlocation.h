@@ -27,6 +27,7 @@
 #include <map>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <string>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -36,6 +37,7 @@
 #include "trackedelement.h"
 #include "trackedcomponent.h"
 #include "entrytracker.h"
+#include "kis_mutex.h"
 
 class kis_gps_packinfo;
 
@@ -334,44 +336,101 @@ protected:
     std::shared_ptr<tracker_element_uint64> time_sec;
 };
 
-// RRD-like history track
+// One historic location sample, as recorded in a kis_location_rrd
+struct kis_historic_location_sample {
+    double lat, lon, alt, heading, speed;
+    int32_t signal;
+    uint64_t frequency;
+    uint64_t time_sec;
+};
+
+// Fixed-capacity ring of historic location samples, stored as parallel columns so
+// that a sample costs a few bytes per field instead of a tracked map of elements, 
+// and a full ring overwrites the oldest sample instead of shifting the rest down.
+class kis_historic_location_ring {
+public:
+    static const unsigned int capacity = 100;
+
+    void push(const kis_historic_location_sample& s);
+
+    size_t size() const {
+        return lat.size();
+    }
+
+    // Sample i, oldest first
+    kis_historic_location_sample at(size_t i) const;
+
+    // Combine all the samples into one, by the center of the locations and the 
+    // mean of the other fields
+    kis_historic_location_sample average() const;
+
+protected:
+    std::vector<double> lat, lon, alt, heading, speed;
+    std::vector<int32_t> signal;
+    std::vector<uint64_t> frequency;
+    std::vector<uint64_t> time_sec;
+
+    // Position of the oldest sample once the ring is full
+    unsigned int head {0};
+};
+
+// Field IDs shared by all location RRDs, registered with the entrytracker on first use
+class kis_location_rrd_ids {
+public:
+    static const kis_location_rrd_ids& get() {
+        static kis_location_rrd_ids ids;
+        return ids;
+    }
+
+    int samples_100_id;
+    int samples_10k_id;
+    int samples_1m_id;
+    int last_sample_ts_id;
+
+    std::shared_ptr<kis_historic_location> historic_location_builder;
+
+protected:
+    kis_location_rrd_ids();
+};
+
+// Tracked fields of a location RRD, created the first time it is serialized and
+// refreshed from the sample rings on each serialization
+struct kis_location_rrd_fields {
+    kis_location_rrd_fields() {
+        mutex.set_name("kis_location_rrd serialize");
+    }
+
+    // Held from pre_serialize to post_serialize
+    kis_mutex mutex;
+
+    std::shared_ptr<tracker_element_vector> samples_100;
+    std::shared_ptr<tracker_element_vector> samples_10k;
+    std::shared_ptr<tracker_element_vector> samples_1m;
+    std::shared_ptr<tracker_element_uint64> last_sample_ts;
+};
+
+// RRD-like history track of the last 100 locations, the last 10,000 as averages of
+// 100, and the last 1,000,000 as averages of 10,000
 class kis_location_rrd : public tracker_component {
 public:
     kis_location_rrd() :
         tracker_component{0} {
-        register_fields();
-        reserve_fields(nullptr);
-        samples_10k_cascade = 0;
-        samples_100_cascade = 0;
+        init_rrd();
     }
 
     kis_location_rrd(int in_id) :
         tracker_component{in_id} {
-        register_fields();
-        reserve_fields(nullptr);
-        samples_10k_cascade = 0;
-        samples_100_cascade = 0;
+        init_rrd();
     }
 
     kis_location_rrd(int in_id, std::shared_ptr<tracker_element_map> e) :
         tracker_component(in_id) {
-        register_fields();
-        reserve_fields(e);
-        samples_10k_cascade = 0;
-        samples_100_cascade = 0;
+        init_rrd();
     }
 
-    kis_location_rrd(const kis_location_rrd* p) :
-        tracker_component{p} {
-
-            __ImportField(samples_100, p);
-            __ImportField(samples_10k, p);
-            __ImportField(samples_1m, p);
-            __ImportField(last_sample_ts, p);
-
-            __ImportField(historic_location_builder, p);
-
-        }
+    virtual ~kis_location_rrd() {
+        delete fields.load();
+    }
 
     virtual uint32_t get_signature() const override {
         return adler32_checksum("kis_location_rrd");
@@ -383,202 +442,54 @@ public:
 
     virtual std::shared_ptr<tracker_element> clone_type() override {
         using this_t = std::remove_pointer<decltype(this)>::type;
-        auto dup = std::shared_ptr<this_t>(new this_t(this));
-        return dup;
+        auto r = std::make_shared<this_t>();
+        r->set_id(this->get_id());
+        return r;
     }
 
-    void add_sample(std::shared_ptr<kis_historic_location> in_sample) {
-        set_int_last_sample_ts(in_sample->get_time_sec());
-
-        samples_100->push_back(in_sample);
-
-        if (samples_100->size() > 100) 
-            samples_100->erase(samples_100->begin());
-
-        samples_100_cascade++;
-
-        // We've gotten 100 samples, cascade up to our next bucket
-        if (samples_100_cascade >= 100) {
-            double avg_x = 0, avg_y = 0, avg_z = 0, avg_alt = 0;
-
-            double heading, speed, signal, timesec, frequency;
-            double num_signal, num_alt;
-
-            heading = speed = signal = timesec = frequency = 0;
-            num_signal = num_alt = 0;
-
-            for (auto g : *samples_100) {
-                std::shared_ptr<kis_historic_location> gl =
-                    std::static_pointer_cast<kis_historic_location>(g);
+    void add_sample(const kis_historic_location_sample& in_sample);
 
-                // Convert to vector for average
-                double mod_lat = gl->get_lat() * M_PI / 180;
-                double mod_lon = gl->get_lon() * M_PI / 180;
-
-                avg_x += cos(mod_lat) * cos(mod_lon);
-                avg_y += cos(mod_lat) * sin(mod_lon);
-                avg_z += sin(mod_lat);
-
-                if (gl->get_alt()) {
-                    avg_alt += gl->get_alt();
-                    num_alt++;
-                }
-
-                heading += gl->get_heading();
-                speed += gl->get_speed();
-
-                if (gl->get_signal() != 0) {
-                    signal += gl->get_signal();
-                    num_signal++;
-                }
-
-                timesec += gl->get_time_sec();
-                frequency += gl->get_frequency();
-            }
-
-            auto aggloc =
-                Globalreg::new_from_pool<kis_historic_location>(historic_location_builder.get());
-
-            double r_x = avg_x / samples_100->size();
-            double r_y = avg_y / samples_100->size();
-            double r_z = avg_z / samples_100->size();
-
-            double central_lon = atan2(r_y, r_x);
-            double central_sqr = sqrt(r_x * r_x + r_y * r_y);
-            double central_lat = atan2(r_z, central_sqr);
-
-            double r_alt = 0;
-
-            if (num_alt > 0) 
-                r_alt =  avg_alt / num_alt;
-
-            aggloc->set_lat(central_lat * 180 / M_PI);
-            aggloc->set_lon(central_lon * 180 / M_PI);
-            aggloc->set_alt(r_alt);
-
-            aggloc->set_heading(heading / samples_100->size());
-            aggloc->set_speed(speed / samples_100->size());
-            aggloc->set_signal(signal / num_signal);
-            aggloc->set_time_sec(timesec / samples_100->size());
-            aggloc->set_frequency(frequency / samples_100->size());
-
-            samples_100_cascade = 0;
-
-            samples_10k->push_back(aggloc);
-            if (samples_10k->size() > 100)
-                samples_10k->erase(samples_10k->begin());
-
-            samples_10k_cascade++;
-
-            if (samples_10k_cascade >= 100) {
-                // If we've gotten 100 samples in the 10k bucket, cascade up again
-                avg_x = avg_y = avg_z = avg_alt = heading = speed = signal = timesec = frequency = 0;
-                num_alt = num_signal = 0;
-
-                for (auto g : *samples_10k) {
-                    std::shared_ptr<kis_historic_location> gl =
-                        std::static_pointer_cast<kis_historic_location>(g);
-
-                    // Convert to vector for average
-                    double mod_lat = gl->get_lat() * M_PI / 180;
-                    double mod_lon = gl->get_lon() * M_PI / 180;
-
-                    avg_x += cos(mod_lat) * cos(mod_lon);
-                    avg_y += cos(mod_lat) * sin(mod_lon);
-                    avg_z += sin(mod_lat);
-
-                    if (gl->get_alt()) {
-                        avg_alt += gl->get_alt();
-                        num_alt++;
-                    }
-
-                    heading += gl->get_heading();
-                    speed += gl->get_speed();
-
-                    if (gl->get_signal()) {
-                        signal += gl->get_signal();
-                        num_signal++;
-                    }
-
-                    timesec += gl->get_time_sec();
-                    frequency += gl->get_frequency();
-                }
-
-                auto aggloc10 =
-                    Globalreg::new_from_pool<kis_historic_location>(historic_location_builder.get());
-
-                r_x = avg_x / samples_100->size();
-                r_y = avg_y / samples_100->size();
-                r_z = avg_z / samples_100->size();
-
-                central_lon = atan2(r_y, r_x);
-                central_sqr = sqrt(r_x * r_x + r_y * r_y);
-                central_lat = atan2(r_z, central_sqr);
-
-                r_alt = 0;
-
-                if (num_alt > 0) 
-                    r_alt =  avg_alt / num_alt;
-
-                aggloc10->set_lat(central_lat * 180 / M_PI);
-                aggloc10->set_lon(central_lat * 180 / M_PI);
-                aggloc10->set_alt(r_alt);
-
-                aggloc10->set_heading(heading / samples_10k->size());
-                aggloc10->set_speed(speed / samples_10k->size());
-                aggloc10->set_signal(signal / num_signal);
-                aggloc10->set_time_sec(timesec / samples_10k->size());
-                aggloc10->set_frequency(timesec / samples_10k->size());
+    time_t get_last_sample_ts() const {
+        return last_sample_ts;
+    }
 
-                samples_10k_cascade = 0;
+    virtual void materialize() override {
+        materialize_fields();
+    }
 
-                samples_1m->push_back(aggloc10);
-                if (samples_1m->size() > 100)
-                    samples_1m->erase(samples_1m->begin());
-            }
-        }
+    virtual void pre_serialize() override;
 
+    virtual void post_serialize() override {
+        fields.load(std::memory_order_acquire)->mutex.unlock();
     }
 
-    __ProxyPrivSplit(last_sample_ts, uint64_t, time_t, time_t, last_sample_ts);
-
 protected:
-    virtual void register_fields() override {
-        tracker_component::register_fields();
-
-        register_field("kis.gps.rrd.samples_100",
-            "last 100 historic GPS records", &samples_100);
-        register_field("kis.gps.rrd.samples_10k",
-            "last 10,000 historic GPS records, as averages of 100",
-            &samples_10k);
-        register_field("kis.gps.rrd.samples_1m",
-            "last 1,000,000 historic GPS records, as averages of 10,000",
-            &samples_1m);
-        register_field("kis.gps.rrd.last_sample_ts",
-            "time (unix ts) of last sample", &last_sample_ts);
+    void init_rrd() {
+        // Make sure the fields are registered even if no RRD is ever serialized
+        kis_location_rrd_ids::get();
 
-        historic_location_builder = 
-            Globalreg::new_from_pool<kis_historic_location>();
+        fields.store(nullptr, std::memory_order_relaxed);
     }
 
-    virtual void reserve_fields(std::shared_ptr<tracker_element_map> e) override {
-        tracker_component::reserve_fields(e);
+    kis_location_rrd_fields *materialize_fields();
 
-        samples_100_cascade = 0;
-        samples_10k_cascade = 0;
-    }
+    // Copy a ring into a tracked vector, reusing the historic location records
+    // from the last serialization
+    static void fill_samples(const kis_historic_location_ring& ring, 
+            std::shared_ptr<tracker_element_vector> vec);
 
-    std::shared_ptr<tracker_element_vector> samples_100;
-    std::shared_ptr<tracker_element_vector> samples_10k;
-    std::shared_ptr<tracker_element_vector> samples_1m;
-    
-    std::shared_ptr<tracker_element_uint64> last_sample_ts;
+    kis_spinlock lock;
 
-    std::shared_ptr<kis_historic_location> historic_location_builder;
+    kis_historic_location_ring samples_100;
+    kis_historic_location_ring samples_10k;
+    kis_historic_location_ring samples_1m;
+
+    unsigned int samples_100_cascade {0};
+    unsigned int samples_10k_cascade {0};
 
-    unsigned int samples_100_cascade;
-    unsigned int samples_10k_cascade;
+    time_t last_sample_ts {0};
 
+    std::atomic<kis_location_rrd_fields *> fields;
 };
 
 #endif
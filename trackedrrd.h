@@ -23,11 +23,14 @@
 
 #include <stdio.h>
 #include <time.h>
+#include <array>
+#include <atomic>
 #include <list>
 #include <map>
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <thread>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -57,12 +60,13 @@ public:
 
     // Combine a vector for a higher-level record (seconds to minutes, minutes to 
     // hours, and so on).
-    static int64_t combine_vector(std::shared_ptr<tracker_element_vector_double> e) {
+    template<typename C>
+    static int64_t combine_vector(const C& e) {
         int64_t avg = 0;
-        for (const auto i : *e)
+        for (const auto i : e)
             avg += i;
 
-        return avg / e->size();
+        return avg / e.size();
     }
 
     // Default 'empty' value
@@ -75,33 +79,110 @@ public:
     }
 };
 
+// Field IDs shared by all RRDs, registered with the entrytracker on first use
+class kis_tracked_rrd_ids {
+public:
+    static const kis_tracked_rrd_ids& get() {
+        static kis_tracked_rrd_ids ids;
+        return ids;
+    }
+
+    int last_time_id;
+    int serial_time_id;
+    int minute_vec_id;
+    int hour_vec_id;
+    int day_vec_id;
+    int blank_val_id;
+
+    int second_entry_id;
+    int minute_entry_id;
+    int hour_entry_id;
+
+protected:
+    kis_tracked_rrd_ids() {
+        auto entrytracker = Globalreg::globalreg->entrytracker;
+
+        last_time_id =
+            entrytracker->register_field("kismet.common.rrd.last_time",
+                    tracker_element_factory<tracker_element_uint64>(), "last time updated");
+        serial_time_id =
+            entrytracker->register_field("kismet.common.rrd.serial_time",
+                    tracker_element_factory<tracker_element_uint64>(), "timestamp of serialization");
+        minute_vec_id =
+            entrytracker->register_field("kismet.common.rrd.minute_vec",
+                    tracker_element_factory<tracker_element_vector_double>(),
+                    "past minute values per second");
+        hour_vec_id =
+            entrytracker->register_field("kismet.common.rrd.hour_vec",
+                    tracker_element_factory<tracker_element_vector_double>(),
+                    "past hour values per minute");
+        day_vec_id =
+            entrytracker->register_field("kismet.common.rrd.day_vec",
+                    tracker_element_factory<tracker_element_vector_double>(),
+                    "past day values per hour");
+        blank_val_id =
+            entrytracker->register_field("kismet.common.rrd.blank_val",
+                    tracker_element_factory<tracker_element_int64>(), "blank value");
+
+        second_entry_id =
+            entrytracker->register_field("kismet.common.rrd.second",
+                    tracker_element_factory<tracker_element_int64>(), "second value");
+        minute_entry_id =
+            entrytracker->register_field("kismet.common.rrd.minute",
+                    tracker_element_factory<tracker_element_int64>(), "minute value");
+        hour_entry_id =
+            entrytracker->register_field("kismet.common.rrd.hour",
+                    tracker_element_factory<tracker_element_int64>(), "hour value");
+    }
+};
+
+// Tracked fields of an RRD.  RRD samples are kept in packed arrays; the tracked
+// elements are only created the first time an RRD is serialized or a field path 
+// descends into it, and are refreshed from the packed arrays on each serialization.
+struct kis_tracked_rrd_fields {
+    kis_tracked_rrd_fields() {
+        mutex.set_name("kis_tracked_rrd serialize");
+    }
+
+    // Held from pre_serialize to post_serialize
+    kis_mutex mutex;
+
+    std::shared_ptr<tracker_element_uint64> last_time;
+    std::shared_ptr<tracker_element_uint64> serial_time;
+    std::shared_ptr<tracker_element_vector_double> minute_vec;
+    std::shared_ptr<tracker_element_vector_double> hour_vec;
+    std::shared_ptr<tracker_element_vector_double> day_vec;
+    std::shared_ptr<tracker_element_int64> blank_val;
+};
+
+// Packed RRD of the past minute per second, the past hour per minute, and the past day
+// per hour.
+//
+// Samples within the current second are combined into the second bucket with an atomic
+// compare-and-swap, without locking.  The first sample of a new second takes a spinlock
+// to advance the buckets.  The minute is rolled up into the hour, and the hour into the
+// day, only when the minute changes or the RRD is serialized, instead of on every sample.
 template <class M_Aggregator = kis_tracked_rrd_default_aggregator, 
          class H_Aggregator = M_Aggregator, class D_Aggregator = M_Aggregator>
 class kis_tracked_rrd : public tracker_component {
 public:
     kis_tracked_rrd() :
         tracker_component() {
-        register_fields();
-        reserve_fields(NULL);
-        update_first = true;
-        mutex.set_name("kis_tracked_rrd");
+        init_rrd();
     }
 
     kis_tracked_rrd(int in_id) :
         tracker_component(in_id) {
-        register_fields();
-        reserve_fields(NULL);
-        update_first = true;
-        mutex.set_name("kis_tracked_rrd");
+        init_rrd();
     }
 
     kis_tracked_rrd(int in_id, std::shared_ptr<tracker_element_map> e) :
         tracker_component(in_id) {
+        init_rrd();
+    }
 
-        register_fields();
-        reserve_fields(e);
-        update_first = true;
-        mutex.set_name("kis_tracked_rrd");
+    virtual ~kis_tracked_rrd() {
+        delete fields.load();
     }
 
     virtual uint32_t get_signature() const override {
@@ -125,197 +206,62 @@ public:
         update_first = in_upd;
     }
 
-    __Proxy(last_time, uint64_t, time_t, time_t, last_time);
-    __Proxy(serial_time, uint64_t, time_t, time_t, serial_time);
-
-    __ProxyTrackable(minute_vec, tracker_element_vector_double, minute_vec);
-    __ProxyTrackable(hour_vec, tracker_element_vector_double, hour_vec);
-    __ProxyTrackable(day_vec, tracker_element_vector_double, day_vec);
+    time_t get_last_time() const {
+        return last_time.load(std::memory_order_acquire);
+    }
 
     // Add a sample.  Use combinator function 'c' to derive the new sample value
     void add_sample(int64_t in_s, time_t in_time) {
-        kis_lock_guard<kis_mutex> lk(mutex, "kis_tracked_rrd add_sample");
-
-        M_Aggregator m_agg;
-        H_Aggregator h_agg;
-        D_Aggregator d_agg;
-
-        int sec_bucket = in_time % 60;
-        int min_bucket = (in_time / 60) % 60;
-        int hour_bucket = (in_time / 3600) % 24;
-
-        time_t ltime = get_last_time();
-
-        // The second slot for the last time
-        int last_sec_bucket = ltime % 60;
-        // The minute of the hour the last known data would go in
-        int last_min_bucket = (ltime / 60) % 60;
-        // The hour of the day the last known data would go in
-        int last_hour_bucket = (ltime / 3600) % 24;
+        auto ltime = last_time.load(std::memory_order_acquire);
 
-        // Allow backfilling w/in the past minute because packets might come out-of-order
-        if (in_time < ltime) {
-            if (ltime - in_time > 60)
-                return;
-
-            uint64_t v = *(minute_vec->begin() + sec_bucket);
-            *(minute_vec->begin() + sec_bucket) = m_agg.combine_element(v, in_s);
-        } else {
-            // If we haven't seen data in a day, we reset everything because
-            // none of it is valid.  This is the simplest case.
-            if (in_time - ltime > (60 * 60 * 24)) {
-                // Directly fill in this second, clear rest of the minute
-                for (auto i = minute_vec->begin(); i != minute_vec->end(); ++i) {
-                    if (i - minute_vec->begin() == sec_bucket)
-                        *i = in_s;
-                    else
-                        *i = m_agg.default_val();
-                }
-
-                // Reset the last hour, setting it to a single sample
-                // Get the combined value for the minute
-                int64_t min_val = h_agg.combine_vector(minute_vec);
-                for (auto i = hour_vec->begin(); i != hour_vec->end(); ++i) {
-                    if (i - hour_vec->begin() == min_bucket)
-                        *i = min_val;
-                    else
-                        *i = h_agg.default_val();
-                }
-
-                // Reset the last day, setting it to a single sample
-                int64_t hr_val = d_agg.combine_vector(hour_vec);
-                for (auto i = day_vec->begin(); i != day_vec->end(); ++i) {
-                    if (i - day_vec->begin() == hour_bucket)
-                        *i = hr_val;
-                    else
-                        *i = d_agg.default_val();
-                }
-
-                set_last_time(in_time);
-
-                return;
-            } else if (in_time - ltime > (60*60)) {
-                // printf("debug - rrd - been an hour since last value\n");
-                // If we haven't seen data in an hour but we're still w/in the day:
-                //   - Average the seconds we know about & set the minute record
-                //   - Clear seconds data & set our current value
-                //   - Average the minutes we know about & set the hour record
-                //
-
-                int64_t sec_avg = 0, min_avg = 0;
-
-                // We only have this entry in the minute, so set it and get the 
-                // combined value
-
-                for (auto i = minute_vec->begin(); i != minute_vec->end(); ++i) {
-                    if (i - minute_vec->begin() == sec_bucket)
-                        *i = in_s;
-                    else
-                        *i = m_agg.default_val();
-                }
-                sec_avg = h_agg.combine_vector(minute_vec);
-
-                // We haven't seen anything in this hour, so clear it, set the minute
-                // and get the aggregate
-                for (auto i = hour_vec->begin(); i != hour_vec->end(); ++i) {
-                    if (i - hour_vec->begin() == min_bucket)
-                        *i = sec_avg;
-                    else
-                        *i = h_agg.default_val();
-                }
-                min_avg = d_agg.combine_vector(hour_vec);
-
-                // Fill the hours between the last time we saw data and now with
-                // zeroes; fastforward time
-                for (int h = 0; h < hours_different(last_hour_bucket + 1, hour_bucket); h++) {
-                    *(hour_vec->begin() + ((last_hour_bucket + 1 + h) % 24)) = d_agg.default_val();
-                }
-
-                *(day_vec->begin() + hour_bucket) = min_avg;
-
-            } else if (in_time - ltime > 60) {
-                // - Calculate the average seconds
-                // - Wipe the seconds
-                // - Set the new second value
-                // - Update minutes
-                // - Update hours
-                // printf("debug - rrd - been over a minute since last value\n");
-
-                int64_t sec_avg = 0, min_avg = 0;
-
-                for (auto i = minute_vec->begin(); i != minute_vec->end(); ++i) {
-                    if (i - minute_vec->begin() == sec_bucket)
-                        *i = in_s;
-                    else
-                        *i = m_agg.default_val();
-                }
-                sec_avg = h_agg.combine_vector(minute_vec);
-
-                // Zero between last and current
-                for (int m = 0; m < minutes_different(last_min_bucket + 1, min_bucket); m++) {
-                    *(hour_vec->begin() + ((last_min_bucket + 1 + m) % 60)) = h_agg.default_val();
-                }
-
-                // Set the updated value
-                *(hour_vec->begin() + min_bucket) = sec_avg;;
-
-                min_avg = d_agg.combine_vector(hour_vec);
-
-                // Reset the hour
-                *(day_vec->begin() + hour_bucket) = min_avg;
-            } else {
-                // printf("debug - rrd - w/in the last minute %d seconds\n", in_time - last_time);
-                // If in_time == last_time then we're updating an existing record,
-                // use the aggregator class to combine it
-
-                // Otherwise, fast-forward seconds with zero data, then propagate the
-                // changes up
-                if (in_time == ltime) {
-                    int64_t v = *(minute_vec->begin() + sec_bucket);
-                    *(minute_vec->begin() + sec_bucket) = m_agg.combine_element(v, in_s);
-                } else {
-                    for (int s = 0; s < minutes_different(last_sec_bucket + 1, sec_bucket); s++) {
-                        *(minute_vec->begin() + ((last_sec_bucket + 1 + s) % 60)) = m_agg.default_val();
-                    }
-
-                    *(minute_vec->begin() + sec_bucket) = in_s;
-                }
-
-                // Update all the averages
-                int64_t sec_avg = 0, min_avg = 0;
-
-                sec_avg = h_agg.combine_vector(minute_vec);
-
-                // Set the minute
-                *(hour_vec->begin() + min_bucket) = sec_avg;
-
-                min_avg = d_agg.combine_vector(hour_vec);
-
-                // Set the hour
-                *(day_vec->begin() + hour_bucket) = min_avg;
-            }
+        if (in_time <= ltime) {
+            combine_second(in_s, in_time, ltime);
+            return;
         }
 
-        set_last_time(in_time);
+        std::lock_guard<kis_spinlock> lk(lock);
+        advance(in_s, in_time);
+    }
+
+    virtual void materialize() override {
+        materialize_fields();
     }
 
     virtual void pre_serialize() override {
-        kis_lock_guard<kis_mutex> lk(mutex, kismet::retain_lock, "kis_tracked_rrd serialize");
+        auto f = materialize_fields();
+
+        // Released in post_serialize
+        f->mutex.lock();
 
         tracker_component::pre_serialize();
         M_Aggregator m_agg;
 
         uint64_t now = Globalreg::globalreg->last_tv_sec;
-        set_serial_time(now);
+
+        std::lock_guard<kis_spinlock> lk(lock);
 
         // Update the averages
-        if (update_first) {
-            add_sample(m_agg.default_val(), now);
-        }
+        if (update_first)
+            advance(m_agg.default_val(), now);
+
+        auto ltime = last_time.load(std::memory_order_relaxed);
+        rollup(ltime);
+
+        f->last_time->set(ltime);
+        f->serial_time->set(now);
+
+        for (unsigned int x = 0; x < minute.size(); x++)
+            *(f->minute_vec->begin() + x) = minute[x].load(std::memory_order_relaxed);
+
+        for (unsigned int x = 0; x < hour.size(); x++)
+            *(f->hour_vec->begin() + x) = hour[x];
+
+        for (unsigned int x = 0; x < day.size(); x++)
+            *(f->day_vec->begin() + x) = day[x];
     }
 
     virtual void post_serialize() override {
-        kis_lock_guard<kis_mutex> lk(mutex, std::adopt_lock);
+        fields.load(std::memory_order_acquire)->mutex.unlock();
     }
 
 protected:
@@ -347,88 +293,184 @@ protected:
         }
     }
 
-    inline int days_different(int d1, int d2) const {
-        // Sanity check
-        d1 = d1 % 7;
-        d2 = d2 % 7;
+    void init_rrd() {
+        // Make sure the fields are registered even if no RRD is ever serialized
+        kis_tracked_rrd_ids::get();
 
-        if (d1 == d2) {
-            return 0;
-        } else if (d1 < d2) {
-            return d2 - d1;
-        } else {
-            return 7 - d1 + d2;
-        }
-    }
+        update_first = true;
+        last_time.store(0, std::memory_order_relaxed);
+        fields.store(nullptr, std::memory_order_relaxed);
 
-    virtual void register_fields() override {
-        tracker_component::register_fields();
+        for (auto& s : minute)
+            s.store(0, std::memory_order_relaxed);
 
-        register_field("kismet.common.rrd.last_time", "last time updated", &last_time);
-        register_field("kismet.common.rrd.serial_time", "timestamp of serialization", &serial_time);
+        hour.fill(0);
+        day.fill(0);
+    }
 
-        register_field("kismet.common.rrd.minute_vec", "past minute values per second", &minute_vec);
-        register_field("kismet.common.rrd.hour_vec", "past hour values per minute", &hour_vec);
-        register_field("kismet.common.rrd.day_vec", "past day values per hour", &day_vec);
+    // Combine a sample into an existing second
+    void combine_second(int64_t in_s, time_t in_time, time_t ltime) {
+        // Allow backfilling w/in the past minute because packets might come out-of-order
+        if (ltime - in_time > 60)
+            return;
 
-        register_field("kismet.common.rrd.blank_val", "blank value", &blank_val);
+        M_Aggregator m_agg;
 
-        second_entry_id = 
-            register_field("kismet.common.rrd.second", 
-                    tracker_element_factory<tracker_element_int64>(),
-                    "second value");
-        minute_entry_id = 
-            register_field("kismet.common.rrd.minute", 
-                    tracker_element_factory<tracker_element_int64>(),
-                    "minute value");
-        hour_entry_id = 
-            register_field("kismet.common.rrd.hour", 
-                    tracker_element_factory<tracker_element_int64>(),
-                    "hour value", NULL);
+        auto& slot = minute[in_time % 60];
+        auto v = slot.load(std::memory_order_relaxed);
 
-    } 
+        while (!slot.compare_exchange_weak(v, m_agg.combine_element(v, in_s), 
+                    std::memory_order_relaxed))
+            ;
+    }
 
-    virtual void reserve_fields(std::shared_ptr<tracker_element_map> e) override {
-        tracker_component::reserve_fields(e);
+    // Reset the minute to a single sample
+    void reset_minute(int64_t in_s, int sec_bucket) {
+        M_Aggregator m_agg;
 
-        // Build slots for all the times
-        int x;
-        if ((x = minute_vec->size()) != 60) {
-            for ( ; x < 60; x++) {
-                minute_vec->push_back(0);
-            }
+        for (int x = 0; x < (int) minute.size(); x++) {
+            if (x == sec_bucket)
+                minute[x].store(in_s, std::memory_order_relaxed);
+            else
+                minute[x].store(m_agg.default_val(), std::memory_order_relaxed);
         }
+    }
 
-        if ((x = hour_vec->size()) != 60) {
-            for ( ; x < 60; x++) {
-                hour_vec->push_back(0);
-            }
-        }
+    // Set the hour record for the minute of 'in_time' from the seconds, and the day record
+    // for the hour of 'in_time' from the minutes.  Must be called with the lock held.
+    void rollup(time_t in_time) {
+        H_Aggregator h_agg;
+        D_Aggregator d_agg;
+
+        std::array<int64_t, 60> seconds;
+        for (unsigned int x = 0; x < seconds.size(); x++)
+            seconds[x] = minute[x].load(std::memory_order_relaxed);
 
-        if ((x = day_vec->size()) != 24) {
-            for ( ; x < 24; x++) {
-                day_vec->push_back(0);
-            }
+        hour[(in_time / 60) % 60] = h_agg.combine_vector(seconds);
+        day[(in_time / 3600) % 24] = d_agg.combine_vector(hour);
+    }
+
+    // Advance the RRD to a new second.  Must be called with the lock held.
+    void advance(int64_t in_s, time_t in_time) {
+        time_t ltime = last_time.load(std::memory_order_relaxed);
+
+        // Someone else got here first
+        if (in_time <= ltime) {
+            combine_second(in_s, in_time, ltime);
+            return;
         }
 
         M_Aggregator m_agg;
-        (*blank_val).set(m_agg.default_val());
+        H_Aggregator h_agg;
+        D_Aggregator d_agg;
+
+        int sec_bucket = in_time % 60;
+        int min_bucket = (in_time / 60) % 60;
+        int hour_bucket = (in_time / 3600) % 24;
+
+        // The second slot for the last time
+        int last_sec_bucket = ltime % 60;
+        // The minute of the hour the last known data would go in
+        int last_min_bucket = (ltime / 60) % 60;
+        // The hour of the day the last known data would go in
+        int last_hour_bucket = (ltime / 3600) % 24;
+
+        if (in_time - ltime > (60 * 60 * 24)) {
+            // If we haven't seen data in a day, we reset everything because
+            // none of it is valid.
+            hour.fill(h_agg.default_val());
+            day.fill(d_agg.default_val());
+
+            reset_minute(in_s, sec_bucket);
+        } else if (in_time - ltime > (60 * 60)) {
+            // If we haven't seen data in an hour but we're still w/in the day, close
+            // out the last minute we saw, clear the hour, and clear the hours between
+            // the last time we saw data and now
+            rollup(ltime);
+
+            hour.fill(h_agg.default_val());
+
+            for (int h = 0; h < hours_different(last_hour_bucket + 1, hour_bucket); h++)
+                day[(last_hour_bucket + 1 + h) % 24] = d_agg.default_val();
+
+            reset_minute(in_s, sec_bucket);
+        } else if (in_time - ltime > 60) {
+            // Close out the last minute we saw, and zero the minutes between then
+            // and now
+            rollup(ltime);
+
+            for (int m = 0; m < minutes_different(last_min_bucket + 1, min_bucket); m++)
+                hour[(last_min_bucket + 1 + m) % 60] = h_agg.default_val();
+
+            reset_minute(in_s, sec_bucket);
+        } else {
+            // Close out the previous minute if we crossed into a new one, then
+            // fast-forward seconds with zero data
+            if (in_time / 60 != ltime / 60)
+                rollup(ltime);
+
+            for (int s = 0; s < minutes_different(last_sec_bucket + 1, sec_bucket); s++)
+                minute[(last_sec_bucket + 1 + s) % 60].store(m_agg.default_val(), 
+                        std::memory_order_relaxed);
+
+            minute[sec_bucket].store(in_s, std::memory_order_relaxed);
+        }
+
+        last_time.store(in_time, std::memory_order_release);
     }
 
-    kis_mutex mutex;
+    kis_tracked_rrd_fields *materialize_fields() {
+        auto f = fields.load(std::memory_order_acquire);
 
-    std::shared_ptr<tracker_element_uint64> last_time;
-    std::shared_ptr<tracker_element_uint64> serial_time;
+        if (f != nullptr)
+            return f;
 
-    std::shared_ptr<tracker_element_vector_double> minute_vec;
-    std::shared_ptr<tracker_element_vector_double> hour_vec;
-    std::shared_ptr<tracker_element_vector_double> day_vec;
+        std::lock_guard<kis_spinlock> lk(lock);
 
-    std::shared_ptr<tracker_element_int64> blank_val;
+        f = fields.load(std::memory_order_relaxed);
 
-    int second_entry_id;
-    int minute_entry_id;
-    int hour_entry_id;
+        if (f != nullptr)
+            return f;
+
+        const auto& ids = kis_tracked_rrd_ids::get();
+        M_Aggregator m_agg;
+
+        f = new kis_tracked_rrd_fields();
+
+        f->last_time = std::make_shared<tracker_element_uint64>(ids.last_time_id);
+        f->serial_time = std::make_shared<tracker_element_uint64>(ids.serial_time_id);
+        f->minute_vec = 
+            std::make_shared<tracker_element_vector_double>(ids.minute_vec_id, 
+                    std::vector<double>(minute.size(), 0));
+        f->hour_vec = 
+            std::make_shared<tracker_element_vector_double>(ids.hour_vec_id, 
+                    std::vector<double>(hour.size(), 0));
+        f->day_vec = 
+            std::make_shared<tracker_element_vector_double>(ids.day_vec_id, 
+                    std::vector<double>(day.size(), 0));
+        f->blank_val = std::make_shared<tracker_element_int64>(ids.blank_val_id, m_agg.default_val());
+
+        insert(f->last_time);
+        insert(f->serial_time);
+        insert(f->minute_vec);
+        insert(f->hour_vec);
+        insert(f->day_vec);
+        insert(f->blank_val);
+
+        fields.store(f, std::memory_order_release);
+
+        return f;
+    }
+
+    kis_spinlock lock;
+
+    std::atomic<time_t> last_time;
+
+    std::array<std::atomic<int64_t>, 60> minute;
+    std::array<int64_t, 60> hour;
+    std::array<int64_t, 24> day;
+
+    std::atomic<kis_tracked_rrd_fields *> fields;
 
     bool update_first;
 };
@@ -442,28 +484,21 @@ class kis_tracked_minute_rrd : public tracker_component {
 public:
     kis_tracked_minute_rrd() :
         tracker_component(0) {
-        register_fields();
-        reserve_fields(NULL);
-        mutex.set_name("kis_tracked_minute_rrd");
-        update_first = true;
+        init_rrd();
     }
 
     kis_tracked_minute_rrd(int in_id) :
         tracker_component(in_id) {
-
-        register_fields();
-        reserve_fields(NULL);
-        update_first = true;
-        mutex.set_name("kis_tracked_minute_rrd");
+        init_rrd();
     }
 
     kis_tracked_minute_rrd(int in_id, std::shared_ptr<tracker_element_map> e) :
         tracker_component(in_id) {
+        init_rrd();
+    }
 
-        register_fields();
-        reserve_fields(e);
-        update_first = true;
-        mutex.set_name("kis_tracked_minute_rrd");
+    virtual ~kis_tracked_minute_rrd() {
+        delete fields.load();
     }
 
     virtual uint32_t get_signature() const override {
@@ -487,72 +522,51 @@ public:
         update_first = in_upd;
     }
 
-    __Proxy(last_time, uint64_t, time_t, time_t, last_time);
-    __Proxy(serial_time, uint64_t, time_t, time_t, serial_time);
+    time_t get_last_time() const {
+        return last_time.load(std::memory_order_acquire);
+    }
 
     void add_sample(int64_t in_s, time_t in_time) {
-        kis_lock_guard<kis_mutex> lk(mutex, "kis_tracked_minute_rrd add_sample");
-
-        Aggregator agg;
-
-        int sec_bucket = in_time % 60;
-
-        time_t ltime = get_last_time();
-
-        // The second slot for the last time
-        int last_sec_bucket = ltime % 60;
-
-        // Allow backfilling w/in the past minute because packets might come out-of-order
-        if (in_time < ltime) {
-            if (ltime - in_time > 60)
-                return;
+        auto ltime = last_time.load(std::memory_order_acquire);
 
-            uint64_t v = *(minute_vec->begin() + sec_bucket);
-            *(minute_vec->begin() + sec_bucket) = agg.combine_element(v, in_s);
-        } else {
-            // If we haven't seen data in a minute, wipe
-            if (in_time - ltime > 60) {
-                for (int x = 0; x < 60; x++) {
-                    *(minute_vec->begin() + x) = agg.default_val();
-                }
-            } else {
-                // If in_time == last_time then we're updating an existing record, so
-                // add that in.
-                // Otherwise, fast-forward seconds with zero data, average the seconds,
-                // and propagate the averages up
-                if (in_time == ltime) {
-                    uint64_t v = *(minute_vec->begin() + sec_bucket);
-                    *(minute_vec->begin() + sec_bucket) = agg.combine_element(v, in_s);
-                } else {
-                    for (int s = 0; s < minutes_different(last_sec_bucket + 1, sec_bucket); s++) {
-                        *(minute_vec->begin() + ((last_sec_bucket + 1 + s) % 60)) = agg.default_val();
-                    }
-
-                    *(minute_vec->begin() + sec_bucket) = in_s;
-                }
-            }
+        if (in_time <= ltime) {
+            combine_second(in_s, in_time, ltime);
+            return;
         }
 
-        set_last_time(in_time);
+        std::lock_guard<kis_spinlock> lk(lock);
+        advance(in_s, in_time);
+    }
+
+    virtual void materialize() override {
+        materialize_fields();
     }
 
     virtual void pre_serialize() override {
-        kis_lock_guard<kis_mutex> lk(mutex, kismet::retain_lock, "kis_tracked_rrd serialize");
+        auto f = materialize_fields();
+
+        // Released in post_serialize
+        f->mutex.lock();
 
         tracker_component::pre_serialize();
         Aggregator agg;
 
         uint64_t now = Globalreg::globalreg->last_tv_sec;
 
-        set_serial_time(now);
+        std::lock_guard<kis_spinlock> lk(lock);
 
-        if (update_first) {
-            add_sample(agg.default_val(), now);
-        }
+        if (update_first)
+            advance(agg.default_val(), now);
+
+        f->last_time->set(last_time.load(std::memory_order_relaxed));
+        f->serial_time->set(now);
+
+        for (unsigned int x = 0; x < minute.size(); x++)
+            *(f->minute_vec->begin() + x) = minute[x].load(std::memory_order_relaxed);
     }
 
     virtual void post_serialize() override {
-        kis_lock_guard<kis_mutex> lk(mutex, std::adopt_lock);
+        fields.load(std::memory_order_acquire)->mutex.unlock();
     }
 
 protected:
@@ -570,47 +584,105 @@ protected:
         }
     }
 
-    virtual void register_fields() override {
-        tracker_component::register_fields();
+    void init_rrd() {
+        kis_tracked_rrd_ids::get();
+
+        update_first = true;
+        last_time.store(0, std::memory_order_relaxed);
+        fields.store(nullptr, std::memory_order_relaxed);
 
-        register_field("kismet.common.rrd.last_time", "last time updated", &last_time);
-        register_field("kismet.common.rrd.serial_time", "time of serialization", &serial_time);
+        for (auto& s : minute)
+            s.store(0, std::memory_order_relaxed);
+    }
 
-        register_field("kismet.common.rrd.minute_vec", "past minute values per second", &minute_vec);
+    void combine_second(int64_t in_s, time_t in_time, time_t ltime) {
+        // Allow backfilling w/in the past minute because packets might come out-of-order
+        if (ltime - in_time > 60)
+            return;
 
-        second_entry_id = 
-            register_field("kismet.common.rrd.second", 
-                    tracker_element_factory<tracker_element_int64>(),
-                    "second value");
+        Aggregator agg;
 
-        register_field("kismet.common.rrd.blank_val", "blank value", &blank_val);
-    } 
+        auto& slot = minute[in_time % 60];
+        auto v = slot.load(std::memory_order_relaxed);
 
-    virtual void reserve_fields(std::shared_ptr<tracker_element_map> e) override {
-        tracker_component::reserve_fields(e);
+        while (!slot.compare_exchange_weak(v, agg.combine_element(v, in_s), 
+                    std::memory_order_relaxed))
+            ;
+    }
 
-        set_last_time(0);
+    // Advance the RRD to a new second.  Must be called with the lock held.
+    void advance(int64_t in_s, time_t in_time) {
+        time_t ltime = last_time.load(std::memory_order_relaxed);
 
-        // Build slots for all the times
-        int x;
-        if ((x = minute_vec->size()) != 60) {
-            for ( ; x < 60; x++) {
-                minute_vec->push_back(0);
-            }
+        if (in_time <= ltime) {
+            combine_second(in_s, in_time, ltime);
+            return;
         }
 
         Aggregator agg;
-        (*blank_val).set(agg.default_val());
+
+        int sec_bucket = in_time % 60;
+
+        // The second slot for the last time
+        int last_sec_bucket = ltime % 60;
+
+        if (in_time - ltime > 60) {
+            // If we haven't seen data in a minute, wipe
+            for (int x = 0; x < (int) minute.size(); x++)
+                minute[x].store(agg.default_val(), std::memory_order_relaxed);
+        } else {
+            // Fast-forward seconds with zero data
+            for (int s = 0; s < minutes_different(last_sec_bucket + 1, sec_bucket); s++)
+                minute[(last_sec_bucket + 1 + s) % 60].store(agg.default_val(), 
+                        std::memory_order_relaxed);
+        }
+
+        minute[sec_bucket].store(in_s, std::memory_order_relaxed);
+
+        last_time.store(in_time, std::memory_order_release);
     }
 
-    kis_mutex mutex;
+    kis_tracked_rrd_fields *materialize_fields() {
+        auto f = fields.load(std::memory_order_acquire);
 
-    std::shared_ptr<tracker_element_uint64> last_time;
-    std::shared_ptr<tracker_element_uint64> serial_time;
-    std::shared_ptr<tracker_element_vector_double> minute_vec;
-    std::shared_ptr<tracker_element_int64> blank_val;
+        if (f != nullptr)
+            return f;
 
-    int second_entry_id;
+        std::lock_guard<kis_spinlock> lk(lock);
+
+        f = fields.load(std::memory_order_relaxed);
+
+        if (f != nullptr)
+            return f;
+
+        const auto& ids = kis_tracked_rrd_ids::get();
+        Aggregator agg;
+
+        f = new kis_tracked_rrd_fields();
+
+        f->last_time = std::make_shared<tracker_element_uint64>(ids.last_time_id);
+        f->serial_time = std::make_shared<tracker_element_uint64>(ids.serial_time_id);
+        f->minute_vec = 
+            std::make_shared<tracker_element_vector_double>(ids.minute_vec_id, 
+                    std::vector<double>(minute.size(), 0));
+        f->blank_val = std::make_shared<tracker_element_int64>(ids.blank_val_id, agg.default_val());
+
+        insert(f->last_time);
+        insert(f->serial_time);
+        insert(f->minute_vec);
+        insert(f->blank_val);
+
+        fields.store(f, std::memory_order_release);
+
+        return f;
+    }
+
+    kis_spinlock lock;
+
+    std::atomic<time_t> last_time;
+    std::array<std::atomic<int64_t>, 60> minute;
+
+    std::atomic<kis_tracked_rrd_fields *> fields;
 
     bool update_first;
 };
@@ -633,10 +705,11 @@ public:
     }
 
     // Select the strongest signal of the bucket
-    static int64_t combine_vector(std::shared_ptr<tracker_element_vector_double> e) {
+    template<typename C>
+    static int64_t combine_vector(const C& e) {
         int64_t avg = 0, avgc = 0;
 
-        for (auto i : *e) {
+        for (auto i : e) {
             int64_t v = i;
 
             if (v == 0)
@@ -693,13 +766,14 @@ public:
     }
 
     // Simple average
-    static int64_t combine_vector(std::shared_ptr<tracker_element_vector_double> e) {
+    template<typename C>
+    static int64_t combine_vector(const C& e) {
         int64_t avg = 0;
 
-        for (auto i : *e) 
+        for (auto i : e) 
             avg += i;
 
-        return avg / e->size();
+        return avg / e.size();
     }
 
     // Default 'empty' value, no legit signal would be 0
@@ -739,10 +813,11 @@ public:
     }
 
     // Simple average
-    static int64_t combine_vector(std::shared_ptr<tracker_element_vector_double> e) {
+    template<typename C>
+    static int64_t combine_vector(const C& e) {
         int64_t most = 0;
 
-        for (auto i : *e) {
+        for (auto i : e) {
             if (i > most)
                 most = i;
         }